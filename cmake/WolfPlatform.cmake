@@ -39,6 +39,12 @@ if(UNIX)
 	set(CMAKE_CXX_FLAGS_RELEASE "${CMAKE_CXX_FLAGS_RELEASE} -ffast-math")
 	set(CMAKE_CXX_FLAGS_DEBUG "${CMAKE_CXX_FLAGS_DEBUG} -Wall")
 
+	# 32 bit x86 gets SSE2 for the delta encoder's change detection only,
+	# with -ffast-math it would let the rest vectorize float loops
+	if(WOLF_X86 AND CMAKE_SIZEOF_VOID_P EQUAL 4)
+		set_source_files_properties("${CMAKE_SOURCE_DIR}/src/qcommon/msg.c" PROPERTIES COMPILE_FLAGS "-msse2")
+	endif()
+
 	if(ENABLE_ASAN)
 		include (CheckCCompilerFlag)
 		include (CheckCXXCompilerFlag)
@@ -1173,6 +1173,7 @@ void CL_InitCGame( void ) {
 	const char          *info;
 	const char          *mapname;
 	int t1, t2;
+	int workers;
 	cls.cgameNewDemoPlayer = qfalse;
 	t1 = Sys_Milliseconds();
 
@@ -1191,11 +1192,18 @@ void CL_InitCGame( void ) {
 	}
 	cls.state = CA_LOADING;
 
+	// the images and sounds the cgame registers are decoded on the worker pool
+	workers = CL_LoadWorkersBegin();
+	S_BeginLoadBatch();
+
 	// init for this gamestate
 	// use the lastExecutedServerCommand instead of the serverCommandSequence
 	// otherwise server commands sent just before a gamestate are dropped
 	VM_Call( cgvm, CG_INIT, clc.serverMessageSequence, clc.lastExecutedServerCommand, clc.clientNum );
 
+	S_EndLoadBatch();
+	CL_LoadWorkersEnd( workers );
+
 	// we will send a usercmd this frame, which
 	// will cause the server to send us the first snapshot
 	cls.state = CA_PRIMED;
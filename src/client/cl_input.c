@@ -814,7 +814,7 @@ void CL_WritePacket( void ) {
 	usercmd_t nullcmd;
 	int packetNum;
 	int oldPacketNum;
-	int count, key;
+	int count, key, ack;
 
 	// don't send anything if playing back a demo
 	if ( clc.demoplaying || cls.state == CA_CINEMATIC ) {
@@ -834,7 +834,9 @@ void CL_WritePacket( void ) {
 	// write the last message we received, which can
 	// be used for delta compression, and is also used
 	// to tell if we dropped a gamestate
-	MSG_WriteLong( &buf, clc.serverMessageSequence );
+	// after a lost svc_snapshotPart, the last one that can be delta'd from
+	ack = cl.snapshotAck > 0 ? cl.snapshotAck : clc.serverMessageSequence;
+	MSG_WriteLong( &buf, ack );
 
 	// write the last reliable message we received
 	MSG_WriteLong( &buf, clc.serverCommandSequence );
@@ -868,8 +870,8 @@ void CL_WritePacket( void ) {
 		}
 
 		// begin a client move command
-		if ( cl_nodelta->integer || !cl.snap.valid || clc.demowaiting
-			 || clc.serverMessageSequence != cl.snap.messageNum ) {
+		if ( cl_nodelta->integer || !cl.snap.valid || clc.demowaiting || cl.snapshotAck < 0
+			 || ( !cl.snapshotAck && clc.serverMessageSequence != cl.snap.messageNum ) ) {
 			MSG_WriteByte( &buf, clc_moveNoDelta );
 		} else {
 			MSG_WriteByte( &buf, clc_move );
@@ -881,7 +883,7 @@ void CL_WritePacket( void ) {
 		// use the checksum feed in the key
 		key = clc.checksumFeed;
 		// also use the message acknowledge
-		key ^= clc.serverMessageSequence;
+		key ^= ack;
 		// also use the last acknowledged server command in the key
 		key ^= Com_HashKey( clc.serverCommands[ clc.serverCommandSequence & ( MAX_RELIABLE_COMMANDS - 1 ) ], 32 );
 
@@ -29,6 +29,7 @@ If you have questions concerning this license or the applicable additional terms
 // cl_main.c  -- client main loop
 
 #include "client.h"
+#include "../qcommon/threads.h"
 #include <limits.h>
 
 #ifdef __linux__
@@ -48,6 +49,7 @@ cvar_t  *rconAddress;
 
 cvar_t  *cl_timeout;
 cvar_t  *cl_maxpackets;
+cvar_t  *cl_loadWorkers;        // worker threads decoding assets while a level loads
 cvar_t  *cl_packetdup;
 cvar_t  *cl_autoNudge;
 cvar_t  *cl_timeNudge;
@@ -833,6 +835,7 @@ void CL_Disconnect( qboolean showMainMenu ) {
 
 	SCR_StopCinematic();
 	S_ClearSoundBuffer();
+	CL_LoadWorkersReset();
 
 	// send a disconnect message to the server
 	// send it a few times in case one is dropped
@@ -2579,6 +2582,44 @@ qbool CL_IsRecordingVideo(void){
 	return !!cl_avidemo->integer;
 }
 
+static int cl_loadWorkersRestore = -1;      // pool size before a load grew it, -1 when it didn't
+
+/*
+============
+CL_LoadWorkersBegin
+
+Grows the worker pool to cl_loadWorkers while something loads, the
+return value goes to CL_LoadWorkersEnd to put the pool back.  A load
+that errors out never gets to CL_LoadWorkersEnd, CL_Disconnect puts the
+pool back instead.
+============
+*/
+int CL_LoadWorkersBegin( void ) {
+	int workers;
+
+	workers = Threads_NumWorkers();
+	if ( cl_loadWorkers->integer > workers ) {
+		if ( cl_loadWorkersRestore < 0 ) {
+			cl_loadWorkersRestore = workers;
+		}
+		Threads_InitWorkers( cl_loadWorkers->integer );
+	}
+	return workers;
+}
+
+void CL_LoadWorkersEnd( int workers ) {
+	Threads_InitWorkers( workers );
+	if ( workers == cl_loadWorkersRestore ) {
+		cl_loadWorkersRestore = -1;
+	}
+}
+
+void CL_LoadWorkersReset( void ) {
+	if ( cl_loadWorkersRestore >= 0 ) {
+		CL_LoadWorkersEnd( cl_loadWorkersRestore );
+	}
+}
+
 /*
 ============
 CL_InitRef
@@ -2636,6 +2677,11 @@ void CL_InitRef( void ) {
 	ri.IsRecordingVideo = CL_IsRecordingVideo;
 	ri.CL_ImGUI_Update = CL_ImGUI_Update;
 	ri.CL_CG_ImGUI_Update = CL_CG_ImGUI_Update;
+	ri.Microseconds = Sys_Microseconds;
+	ri.NumWorkers = Threads_NumWorkers;
+	ri.RunJobs = Threads_RunJobs;
+	ri.LoadWorkersBegin = CL_LoadWorkersBegin;
+	ri.LoadWorkersEnd = CL_LoadWorkersEnd;
 	#endif
 
 	ret = GetRefAPI( REF_API_VERSION, &ri );
@@ -2742,6 +2788,7 @@ void CL_Init( void ) {
 	cl_anglespeedkey = Cvar_Get( "cl_anglespeedkey", "1.5", 0 );
 
 	cl_maxpackets = Cvar_Get( "cl_maxpackets", "30", CVAR_ARCHIVE );
+	cl_loadWorkers = Cvar_Get( "cl_loadWorkers", "3", CVAR_ARCHIVE );
 	cl_packetdup = Cvar_Get( "cl_packetdup", "1", CVAR_ARCHIVE );
 
 	cl_run = Cvar_Get( "cl_run", "1", CVAR_ARCHIVE );
@@ -2815,6 +2862,7 @@ void CL_Init( void ) {
 	Cvar_Get( "name", "WolfPlayer", CVAR_USERINFO | CVAR_ARCHIVE );
 	Cvar_Get( "rate", "5000", CVAR_USERINFO | CVAR_ARCHIVE );     // NERVE - SMF - changed from 3000
 	Cvar_Get( "snaps", "20", CVAR_USERINFO | CVAR_ARCHIVE );
+	Cvar_Get( "cl_snapshotParts", "1", CVAR_USERINFO | CVAR_ARCHIVE );   // take split snapshots
 //	Cvar_Get ("model", "american", CVAR_USERINFO | CVAR_ARCHIVE );	// temp until we have an skeletal american model
 	Cvar_Get( "model", "multi", CVAR_USERINFO | CVAR_ARCHIVE );
 	Cvar_Get( "head", "default", CVAR_USERINFO | CVAR_ARCHIVE );
@@ -3076,6 +3124,7 @@ void CL_ServerInfoPacket( netadr_t from, msg_t *msg ) {
 			{
 			case NA_BROADCAST:
 			case NA_IP:
+			case NA_IP6:
 				type = 1;
 				break;
 
@@ -39,7 +39,9 @@ char *svc_strings[256] = {
 	"svc_baseline",
 	"svc_serverCommand",
 	"svc_download",
-	"svc_snapshot"
+	"svc_snapshot",
+	"svc_EOF",
+	"svc_snapshotPart"
 };
 
 void SHOWNET( msg_t *msg, char *s ) {
@@ -322,6 +324,77 @@ void CL_ParsePacketEntities( msg_t *msg, clSnapshot_t *oldframe, clSnapshot_t *n
 }
 
 
+/*
+================
+CL_MergeSnapshotPart
+
+A svc_snapshotPart only has the entities from start up to end, the
+rest are taken from the parts of the same snapshot that got here
+before it, or left as they were in the frame it deltas from.
+
+The server takes the frame of a part to be what the client has after
+all the parts up to it, so one that came after a lost part can't be
+delta compressed from.  The last one that can is acknowledged instead.
+================
+*/
+static void CL_MergeSnapshotPart( clSnapshot_t *newSnap, int part, int start, int end ) {
+	static entityState_t merged[MAX_GENTITIES];
+	entityState_t   *ent;
+	clSnapshot_t    *prev;
+	int i, count;
+
+	if ( newSnap->serverTime != cl.snapshotPartTime || newSnap->deltaNum != cl.snapshotPartDelta ) {
+		// the first to get here of a new snapshot
+		cl.snapshotPartTime = newSnap->serverTime;
+		cl.snapshotPartDelta = newSnap->deltaNum;
+		cl.snapshotPartNext = 0;
+		cl.snapshotPartGood = newSnap->deltaNum > 0 ? newSnap->deltaNum : -1;
+		prev = NULL;
+	} else {
+		prev = &cl.snap;
+	}
+
+	if ( part == cl.snapshotPartNext ) {
+		cl.snapshotPartNext++;
+		cl.snapshotPartGood = newSnap->messageNum;
+		cl.snapshotAck = 0;
+	} else {
+		cl.snapshotPartNext = -1;
+		cl.snapshotAck = cl.snapshotPartGood;
+	}
+
+	// the entities outside the range already are the delta frame's
+	if ( !prev ) {
+		return;
+	}
+
+	count = 0;
+	for ( i = 0 ; i < prev->numEntities ; i++ ) {
+		ent = &cl.parseEntities[( prev->parseEntitiesNum + i ) & ( MAX_PARSE_ENTITIES - 1 )];
+		if ( ent->number < start ) {
+			merged[count++] = *ent;
+		}
+	}
+	for ( i = 0 ; i < newSnap->numEntities ; i++ ) {
+		ent = &cl.parseEntities[( newSnap->parseEntitiesNum + i ) & ( MAX_PARSE_ENTITIES - 1 )];
+		if ( ent->number >= start && ent->number < end ) {
+			merged[count++] = *ent;
+		}
+	}
+	for ( i = 0 ; i < prev->numEntities ; i++ ) {
+		ent = &cl.parseEntities[( prev->parseEntitiesNum + i ) & ( MAX_PARSE_ENTITIES - 1 )];
+		if ( ent->number >= end ) {
+			merged[count++] = *ent;
+		}
+	}
+
+	for ( i = 0 ; i < count ; i++ ) {
+		cl.parseEntities[( newSnap->parseEntitiesNum + i ) & ( MAX_PARSE_ENTITIES - 1 )] = merged[i];
+	}
+	newSnap->numEntities = count;
+	cl.parseEntitiesNum = newSnap->parseEntitiesNum + count;
+}
+
 /*
 ================
 CL_ParseSnapshot
@@ -329,15 +402,21 @@ CL_ParseSnapshot
 If the snapshot is parsed properly, it will be copied to
 cl.snap and saved in cl.snapshots[].  If the snapshot is invalid
 for any reason, no changes to the state will be made at all.
+
+A svc_snapshotPart has the part number in front and the range
+of entities it is for after the entities.
 ================
 */
-void CL_ParseSnapshot( msg_t *msg ) {
+void CL_ParseSnapshot( msg_t *msg, qboolean isPart ) {
 	int len;
 	clSnapshot_t    *old;
 	clSnapshot_t newSnap;
 	int deltaNum;
 	int oldMessageNum;
 	int i, packetNum;
+	int part, start, end;
+
+	part = isPart ? MSG_ReadByte( msg ) : 0;
 
 	// get the reliable sequence acknowledge number
 	// NOTE: now sent with all server to client messages
@@ -409,12 +488,24 @@ void CL_ParseSnapshot( msg_t *msg ) {
 	SHOWNET( msg, "packet entities" );
 	CL_ParsePacketEntities( msg, old, &newSnap );
 
+	if ( isPart ) {
+		start = MSG_ReadBits( msg, GENTITYNUM_BITS );
+		end = MSG_ReadBits( msg, GENTITYNUM_BITS );
+	}
+
 	// if not valid, dump the entire thing now that it has
 	// been properly read
 	if ( !newSnap.valid ) {
 		return;
 	}
 
+	if ( isPart ) {
+		CL_MergeSnapshotPart( &newSnap, part, start, end );
+	} else {
+		cl.snapshotPartTime = 0;
+		cl.snapshotAck = 0;
+	}
+
 	// clear the valid flags of any snapshots between the last
 	// received and this one, so if there was a dropped packet
 	// it won't look like something valid to delta from next
@@ -782,7 +873,10 @@ void CL_ParseServerMessage( msg_t *msg ) {
 			CL_ParseGamestate( msg );
 			break;
 		case svc_snapshot:
-			CL_ParseSnapshot( msg );
+			CL_ParseSnapshot( msg, qfalse );
+			break;
+		case svc_snapshotPart:
+			CL_ParseSnapshot( msg, qtrue );
 			break;
 		case svc_download:
 			CL_ParseDownload( msg );
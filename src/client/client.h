@@ -85,8 +85,8 @@ typedef struct {
 
 // the parseEntities array must be large enough to hold PACKET_BACKUP frames of
 // entities, so that when a delta compressed message arives from the server
-// it can be un-deltad from the original
-#define MAX_PARSE_ENTITIES  2048
+// it can be un-deltad from the original.  MAX_PARSE_ENTITIES is in qcommon.h
+// for the server bench.
 
 extern int g_console_field_width;
 
@@ -116,6 +116,13 @@ typedef struct {
 
 	int parseEntitiesNum;           // index (not anded off) into cl_parse_entities[]
 
+	// svc_snapshotPart, see CL_MergeSnapshotPart
+	int snapshotPartTime;           // serverTime of the snapshot the parts are of
+	int snapshotPartDelta;          // the message they delta from
+	int snapshotPartNext;           // part that comes next if none are lost, -1 once one was
+	int snapshotPartGood;           // last message that matches what the server thinks we have
+	int snapshotAck;                // message to acknowledge instead of the last one, -1 for none
+
 	int mouseDx[2], mouseDy[2];         // added to by mouse events
 	int mouseIndex;
 	int joystickAxis[MAX_JOYSTICK_AXIS];            // set by joystick events
@@ -404,6 +411,7 @@ extern cvar_t  *cl_debugMove;
 extern cvar_t  *cl_noprint;
 extern cvar_t  *cl_timegraph;
 extern cvar_t  *cl_maxpackets;
+extern cvar_t  *cl_loadWorkers;
 extern cvar_t  *cl_packetdup;
 extern cvar_t  *cl_shownet;
 extern cvar_t  *cl_shownuments;             // DHM - Nerve
@@ -489,6 +497,9 @@ int CL_GetPingQueueCount( void );
 
 void CL_ShutdownRef( void );
 void CL_InitRef( void );
+int CL_LoadWorkersBegin( void );
+void CL_LoadWorkersEnd( int workers );
+void CL_LoadWorkersReset( void );
 qboolean CL_CDKeyValidate( const char *key, const char *checksum );
 int CL_ServerStatus( char *serverAddress, char *serverStatusString, int maxLen );
 
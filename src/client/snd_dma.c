@@ -173,6 +173,7 @@ void S_SoundInfo_f( void ) {
 		} else {
 			Com_Printf( "No background file.\n" );
 		}
+		S_LoadBatchInfo();
 
 	}
 	Com_Printf( "----------------------\n" );
@@ -482,6 +483,7 @@ are no longer valid.
 ===================
 */
 void S_DisableSounds( void ) {
+	S_CancelLoadBatch();
 	S_StopAllSounds();
 	s_soundMuted = qtrue;
 }
@@ -540,6 +542,10 @@ sfxHandle_t S_RegisterSound( const char *name, qboolean compressed ) {
 	sfx->inMemory = qfalse;
 	sfx->soundCompressed = compressed;
 
+	if ( S_QueueBatchSound( sfx ) ) {
+		return sfx - s_knownSfx;
+	}
+
 //	if (!compressed) {
 	S_memoryLoad( sfx );
 //	}
@@ -58,6 +58,7 @@ typedef struct sfx_s {
 	qboolean defaultSound;                  // couldn't be loaded, so use buzz
 	qboolean inMemory;                      // not in Memory
 	qboolean soundCompressed;               // not in Memory
+	qboolean loadQueued;                    // waiting for S_EndLoadBatch
 	int soundCompressionMethod;
 	int soundLength;
 	char soundName[MAX_QPATH];
@@ -204,6 +205,10 @@ extern cvar_t   *s_testsound;
 extern cvar_t   *s_separation;
 
 qboolean S_LoadSound( sfx_t *sfx );
+qboolean S_QueueBatchSound( sfx_t *sfx );
+void S_CancelLoadBatch( void );
+void S_LoadBatchInfo( void );
+void S_DefaultSound( sfx_t *sfx );
 
 void        SND_free( sndBuffer *v );
 sndBuffer*  SND_malloc();
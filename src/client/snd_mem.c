@@ -37,6 +37,7 @@ If you have questions concerning this license or the applicable additional terms
  *****************************************************************************/
 
 #include "snd_local.h"
+#include "../qcommon/threads.h"
 
 #define DEF_COMSOUNDMEGS "24"    // (SA) upped for GD
 
@@ -438,6 +439,266 @@ qboolean S_LoadSound( sfx_t *sfx ) {
 	return qtrue;
 }
 
+/*
+===============================================================================
+
+BATCHED LOADING
+
+Between S_BeginLoadBatch and S_EndLoadBatch registering a sound only
+checks that the file is there.  The files are read at the end, their
+resampling spread over the worker pool, and the samples moved into
+sound memory on the main thread.  A sound played before that loads on
+its own like it always did.
+
+===============================================================================
+*/
+
+#define MAX_BATCH_SOUNDS    1024
+#define SOUND_BATCH_BYTES   ( 16 * 1024 * 1024 )   // files read before they get resampled
+
+typedef struct {
+	sfx_t       *sfx;
+	byte        *data;          // copy of the file
+	wavinfo_t info;
+	short       *samples;
+	int numSamples;
+} soundLoad_t;
+
+typedef struct {
+	int sounds;
+	int fallbacks;              // loaded on their own after all
+	int workers;
+	int64_t readUsec;
+	int64_t resampleUsec;       // wall clock
+	int64_t storeUsec;
+} soundBatchTimes_t;
+
+static sfx_t        *s_loadBatch[MAX_BATCH_SOUNDS];
+static int s_numLoadBatch;
+static qboolean s_batching;
+static soundBatchTimes_t s_batchTimes;
+
+void S_BeginLoadBatch( void ) {
+	S_CancelLoadBatch();
+	s_batching = qtrue;
+}
+
+/*
+================
+S_CancelLoadBatch
+
+The queued sounds stay out of memory and load when first played
+================
+*/
+void S_CancelLoadBatch( void ) {
+	int i;
+
+	for ( i = 0 ; i < s_numLoadBatch ; i++ ) {
+		s_loadBatch[i]->loadQueued = qfalse;
+	}
+	s_numLoadBatch = 0;
+	s_batching = qfalse;
+}
+
+/*
+================
+S_QueueBatchSound
+
+Returns qfalse when the sound has to be loaded right away
+================
+*/
+qboolean S_QueueBatchSound( sfx_t *sfx ) {
+	if ( !s_batching || s_numLoadBatch == MAX_BATCH_SOUNDS ) {
+		return qfalse;
+	}
+	if ( sfx->loadQueued ) {
+		return qtrue;
+	}
+#ifdef COMPRESSION
+	return qfalse;              // the mu-law and wavelet encoders are only in S_LoadSound
+#else
+	// player specific sounds and missing files fail the usual way
+	if ( sfx->soundName[0] == '*' || FS_ReadFile( sfx->soundName, NULL ) <= 0 ) {
+		return qfalse;
+	}
+	sfx->loadQueued = qtrue;
+	s_loadBatch[s_numLoadBatch++] = sfx;
+	return qtrue;
+#endif
+}
+
+static void S_ResampleJob( void *data, int index ) {
+	soundLoad_t *l = (soundLoad_t *)data + index;
+
+	l->samples = malloc( l->info.samples * sizeof( short ) * 2 );
+	if ( l->samples ) {
+		l->numSamples = ResampleSfxRaw( l->samples, l->info.rate, l->info.width, l->info.samples, l->data + l->info.dataofs );
+	}
+}
+
+/*
+================
+S_StoreSamples
+
+Same as ResampleSfx, from samples that are already resampled
+================
+*/
+static void S_StoreSamples( sfx_t *sfx, const short *samples ) {
+	sndBuffer   *chunk, *newchunk;
+	int i, n;
+
+	chunk = sfx->soundData;
+	for ( i = 0 ; i < sfx->soundLength ; i += SND_CHUNK_SIZE ) {
+		n = sfx->soundLength - i;
+		if ( n > SND_CHUNK_SIZE ) {
+			n = SND_CHUNK_SIZE;
+		}
+		newchunk = SND_malloc();
+		if ( chunk == NULL ) {
+			sfx->soundData = newchunk;
+		} else {
+			chunk->next = newchunk;
+		}
+		chunk = newchunk;
+		memcpy( chunk->sndChunk, samples + i, n * sizeof( short ) );
+	}
+}
+
+/*
+================
+S_LoadFallback
+
+A queued sound that can't go through the batch, the handle given out
+for it plays the default sound if it doesn't load
+================
+*/
+static void S_LoadFallback( sfx_t *sfx ) {
+	s_batchTimes.fallbacks++;
+	S_memoryLoad( sfx );
+	if ( sfx->defaultSound && !sfx->soundData ) {
+		S_DefaultSound( sfx );
+	}
+}
+
+/*
+================
+S_EndLoadBatch
+================
+*/
+void S_EndLoadBatch( void ) {
+	soundLoad_t *loads, *l;
+	sfx_t       *sfx;
+	byte        *data;
+	int64_t start;
+	int i, j, n, size, bytes;
+
+	if ( !s_batching ) {
+		return;
+	}
+	s_batching = qfalse;
+
+	memset( &s_batchTimes, 0, sizeof( s_batchTimes ) );
+	s_batchTimes.workers = Threads_NumWorkers();
+
+	loads = malloc( s_numLoadBatch * sizeof( *loads ) );
+	if ( !loads ) {
+		S_CancelLoadBatch();
+		return;
+	}
+
+	for ( i = 0 ; i < s_numLoadBatch ; ) {
+		// read some files on the main thread
+		start = Sys_Microseconds();
+		for ( n = 0, bytes = 0 ; i < s_numLoadBatch && bytes < SOUND_BATCH_BYTES ; i++ ) {
+			sfx = s_loadBatch[i];
+			sfx->loadQueued = qfalse;
+			if ( sfx->inMemory ) {
+				continue;           // played before the batch got to it
+			}
+
+			l = &loads[n];
+			memset( l, 0, sizeof( *l ) );
+			l->sfx = sfx;
+			size = FS_ReadFile( sfx->soundName, (void **)&data );
+			if ( !data ) {
+				S_LoadFallback( sfx );
+				continue;
+			}
+			l->data = malloc( size );
+			if ( l->data ) {
+				memcpy( l->data, data, size );
+				l->info = GetWavinfo( sfx->soundName, l->data, size );
+			}
+			FS_FreeFile( data );
+			if ( !l->data || l->info.channels != 1 ) {
+				free( l->data );
+				S_LoadFallback( sfx );
+				continue;
+			}
+			bytes += size;
+			n++;
+		}
+		s_batchTimes.readUsec += Sys_Microseconds() - start;
+
+		start = Sys_Microseconds();
+		Threads_RunJobs( S_ResampleJob, loads, n );
+		s_batchTimes.resampleUsec += Sys_Microseconds() - start;
+
+		// sound memory is only touched from here
+		start = Sys_Microseconds();
+		for ( j = 0 ; j < n ; j++ ) {
+			l = &loads[j];
+			sfx = l->sfx;
+			free( l->data );
+			if ( !l->samples ) {
+				S_LoadFallback( sfx );
+				continue;
+			}
+
+			if ( l->info.width == 1 ) {
+				Com_DPrintf( S_COLOR_YELLOW "WARNING: %s is a 8 bit wav file\n", sfx->soundName );
+			}
+			if ( l->info.rate != 22050 ) {
+				Com_DPrintf( S_COLOR_YELLOW "WARNING: %s is not a 22kHz wav file\n", sfx->soundName );
+			}
+
+			sfx->lastTimeUsed = Sys_Milliseconds() + 1;
+			sfx->soundData = NULL;
+			sfx->soundLength = l->numSamples;
+			if ( !s_nocompressed->value && sfx->soundCompressed == qtrue ) {
+				sfx->soundCompressionMethod = 1;
+				S_AdpcmEncodeSound( sfx, l->samples );
+			} else {
+				sfx->soundCompressionMethod = 0;
+				S_StoreSamples( sfx, l->samples );
+			}
+			sfx->inMemory = qtrue;
+			free( l->samples );
+			s_batchTimes.sounds++;
+		}
+		s_batchTimes.storeUsec += Sys_Microseconds() - start;
+	}
+
+	free( loads );
+	s_numLoadBatch = 0;
+}
+
+/*
+================
+S_LoadBatchInfo
+================
+*/
+void S_LoadBatchInfo( void ) {
+	if ( !s_batchTimes.sounds && !s_batchTimes.fallbacks ) {
+		Com_Printf( "No sounds loaded in a batch.\n" );
+		return;
+	}
+	Com_Printf( "Last load batch: %i sounds, %i loaded on their own\n", s_batchTimes.sounds, s_batchTimes.fallbacks );
+	Com_Printf( "  read %.1f ms, resample %.1f ms on %i threads, store %.1f ms\n",
+				s_batchTimes.readUsec / 1000.0, s_batchTimes.resampleUsec / 1000.0,
+				s_batchTimes.workers + 1, s_batchTimes.storeUsec / 1000.0 );
+}
+
 /*
 ================
 S_DisplayFreeMemory
@@ -81,6 +81,10 @@ void S_DisableSounds( void );
 
 void S_BeginRegistration( void );
 
+// sounds registered in between are read and resampled together at the end
+void S_BeginLoadBatch( void );
+void S_EndLoadBatch( void );
+
 // RegisterSound will allways return a valid sample, even if it
 // has to create a placeholder.  This prevents continuous filesystem
 // checks for missing files
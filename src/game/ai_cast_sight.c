@@ -96,6 +96,29 @@ qboolean AICast_InFieldOfVision( vec3_t viewangles, float fov, vec3_t angles ) {
 	return qtrue;
 }
 
+/*
+==============
+AICast_SightRayHits
+
+Finishes a sight trace that stopped in water, lava or slime and
+tells if it got to hitent
+==============
+*/
+static qboolean AICast_SightRayHits( trace_t *trace, vec3_t end, int contents_mask, int passent, int hitent ) {
+	//if water was hit
+	if ( trace->contents & ( CONTENTS_LAVA | CONTENTS_SLIME | CONTENTS_WATER ) ) {
+		//if the water surface is translucent
+//		if (trace.surface.flags & (SURF_TRANS33|SURF_TRANS66))
+		{
+			//trace through the water
+			contents_mask &= ~( CONTENTS_LAVA | CONTENTS_SLIME | CONTENTS_WATER );
+			trap_Trace( trace, trace->endpos, NULL, NULL, end, passent, contents_mask );
+		} //end if
+	} //end if
+	  //if a full trace or the hitent was hit
+	return ( trace->fraction >= 1 || trace->entityNum == hitent );
+}
+
 /*
 ==============
 AICast_VisibleFromPos
@@ -103,14 +126,18 @@ AICast_VisibleFromPos
 */
 qboolean AICast_VisibleFromPos( vec3_t srcpos, int srcnum,
 								vec3_t destpos, int destnum, qboolean updateVisPos ) {
-	int i, contents_mask, passent, hitent;
+	int i, j, contents_mask, passent, hitent;
 	trace_t trace;
 	vec3_t start, end, middle, eye;
 	cast_state_t        *cs = NULL;
 	int srcviewheight;
 	vec3_t destmins, destmaxs;
 	vec3_t right, vec;
-	qboolean inPVS;
+	qboolean inPVS, batched;
+	int numRays;
+	vec3_t starts[5], ends[5];
+	int masks[5], passents[5], hitents[5];
+	trace_t traces[5];
 
 	if ( g_entities[destnum].flags & FL_NOTARGET ) {
 		return qfalse;
@@ -147,7 +174,10 @@ qboolean AICast_VisibleFromPos( vec3_t srcpos, int srcnum,
 	right[2] = 0;
 	//
 	inPVS = qfalse;
+	numRays = 0;
 	//
+	// the first ray is the one most often seen, it is traced as soon as it
+	// is known, the others are only worked out when it's blocked
 	for ( i = 0; i < 5; i++ )
 	{
 		if ( cs && updateVisPos ) {   // if it's a grenade or something, PVS checks don't work very well
@@ -182,21 +212,17 @@ qboolean AICast_VisibleFromPos( vec3_t srcpos, int srcnum,
 			} //end if
 			contents_mask ^= ( CONTENTS_LAVA | CONTENTS_SLIME | CONTENTS_WATER );
 		} //end if
-		  //trace from start to end
-		trap_Trace( &trace, start, NULL, NULL, end, ENTITYNUM_NONE /*passent*/, contents_mask );
-		//if water was hit
-		if ( trace.contents & ( CONTENTS_LAVA | CONTENTS_SLIME | CONTENTS_WATER ) ) {
-			//if the water surface is translucent
-//			if (trace.surface.flags & (SURF_TRANS33|SURF_TRANS66))
-			{
-				//trace through the water
-				contents_mask &= ~( CONTENTS_LAVA | CONTENTS_SLIME | CONTENTS_WATER );
-				trap_Trace( &trace, trace.endpos, NULL, NULL, end, passent, contents_mask );
-			} //end if
-		} //end if
-		  //if a full trace or the hitent was hit
-		if ( trace.fraction >= 1 || trace.entityNum == hitent ) {
-			return qtrue;
+		VectorCopy( start, starts[numRays] );
+		VectorCopy( end, ends[numRays] );
+		masks[numRays] = contents_mask;
+		passents[numRays] = passent;
+		hitents[numRays] = hitent;
+		numRays++;
+		if ( numRays == 1 ) {
+			trap_Trace( &trace, start, NULL, NULL, end, ENTITYNUM_NONE /*passent*/, contents_mask );
+			if ( AICast_SightRayHits( &trace, end, contents_mask, passent, hitent ) ) {
+				return qtrue;
+			}
 		}
 		//check bottom and top of bounding box as well
 		if ( i == 0 ) {
@@ -211,6 +237,31 @@ qboolean AICast_VisibleFromPos( vec3_t srcpos, int srcnum,
 		}
 	} //end for
 
+	// trace the rest together if they share a mask
+	batched = qfalse;
+	for ( i = 1; i < numRays; i++ )
+	{
+		if ( i == 1 && numRays > 2 ) {
+			for ( j = 2; j < numRays && masks[j] == masks[1]; j++ ) {
+			}
+			if ( j == numRays ) {
+				trap_TraceBatch( &traces[1], numRays - 1, (const vec3_t *)&starts[1], NULL, NULL, (const vec3_t *)&ends[1],
+								 ENTITYNUM_NONE /*passent*/, masks[1] );
+				batched = qtrue;
+			}
+		}
+		//
+		  //trace from start to end
+		if ( batched ) {
+			trace = traces[i];
+		} else {
+			trap_Trace( &trace, starts[i], NULL, NULL, ends[i], ENTITYNUM_NONE /*passent*/, masks[i] );
+		}
+		if ( AICast_SightRayHits( &trace, ends[i], masks[i], passents[i], hitents[i] ) ) {
+			return qtrue;
+		}
+	} //end for
+
 	return qfalse;
 }
 
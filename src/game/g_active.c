@@ -1662,5 +1662,6 @@ void ClientEndFrame( gentity_t *ent ) {
 	}
 	// dhm
 
-	
+	// store the client's position for backward reconciliation later
+	G_StoreHistory( ent );
 }
@@ -2024,6 +2024,9 @@ void ClientSpawn( gentity_t *ent, qboolean revived ) {
 		trap_LinkEntity( ent );
 	}
 
+	// don't reconcile back to wherever we were before spawning
+	G_ResetHistory( ent );
+
 	// run the presend to set anything else
 	ClientEndFrame( ent );
 
@@ -599,24 +599,12 @@ typedef struct {
 	int deathYaw;
 } clientPersistant_t;
 
-typedef struct {
-	vec3_t mins;
-	vec3_t maxs;
-
-	vec3_t origin;
-
-	int time;
-	int servertime;
-} clientMarker_t;
-
-#define MAX_CLIENT_MARKERS 10
-
 #define LT_SPECIAL_PICKUP_MOD   3       // JPW NERVE # of times (minus one for modulo) LT must drop ammo before scoring a point
 #define MEDIC_SPECIAL_PICKUP_MOD    4   // JPW NERVE same thing for medic
 
 //unlagged - backward reconciliation #1
-// the size of history we'll keep
-#define NUM_CLIENT_HISTORY 17
+// the size of history we'll keep, a power of two
+#define NUM_CLIENT_HISTORY 32
 
 // everything we need to know to backward reconcile
 typedef struct {
@@ -631,8 +619,9 @@ typedef struct unlagged_s {
 	// the serverTime the button was pressed
 	// (stored before pmove_fixed changes serverTime)
 	int attackTime;
-	// the head of the history queue
+	// the head of the history queue and how many records it holds
 	int	historyHead;
+	int	historyCount;
 	// the history queue
 	clientHistory_t	history[NUM_CLIENT_HISTORY];
 	// the client's saved position
@@ -740,11 +729,6 @@ struct gclient_s {
 	int PCSpecialPickedUpCount;         // JPW NERVE used to count # of times somebody's picked up this LTs ammo (or medic health) (for scoring)
 	int saved_persistant[MAX_PERSISTANT];           // DHM - Nerve :: Save ps->persistant here during Limbo
 
-	// g_antilag.c
-	int topMarker;
-	clientMarker_t clientMarkers[MAX_CLIENT_MARKERS];
-	clientMarker_t backupMarker;
-
 	gentity_t       *tempHead;  // Gordon: storing a temporary head for bullet head shot detection
 
 	pmoveExt_t pmext;
@@ -1276,6 +1260,8 @@ void Props_Chair_Skyboxtouch( gentity_t *ent );
 //g_unlagged.c
 void G_DoTimeShiftFor( gentity_t *ent );
 void G_UndoTimeShiftFor( gentity_t *ent );
+
+//g_antilag.c
 void G_DettachBodyParts(void);
 void G_AttachBodyParts( gentity_t* ent );
 int G_SwitchBodyPartEntity( gentity_t* ent );
@@ -1434,6 +1420,7 @@ extern vmCvar_t g_floatPlayerPosition;
 extern vmCvar_t g_delagHitscan;
 extern vmCvar_t g_maxExtrapolatedFrames;
 extern vmCvar_t g_maxLagCompensation;
+extern vmCvar_t g_antilagCull;
 extern vmCvar_t g_delagMissiles;
 
 extern vmCvar_t match_timeoutcount;
@@ -1480,6 +1467,7 @@ void    trap_GetServerinfo( char *buffer, int bufferSize );
 void    trap_SetBrushModel( gentity_t *ent, const char *name );
 void    trap_Trace( trace_t *results, const vec3_t start, const vec3_t mins, const vec3_t maxs, const vec3_t end, int passEntityNum, int contentmask );
 void    trap_TraceCapsule( trace_t *results, const vec3_t start, const vec3_t mins, const vec3_t maxs, const vec3_t end, int passEntityNum, int contentmask );
+void    trap_TraceBatch( trace_t *results, int count, const vec3_t *start, const vec3_t mins, const vec3_t maxs, const vec3_t *end, int passEntityNum, int contentmask );
 int     trap_PointContents( const vec3_t point, int passEntityNum );
 qboolean trap_InPVS( const vec3_t p1, const vec3_t p2 );
 qboolean trap_InPVSIgnorePortals( const vec3_t p1, const vec3_t p2 );
@@ -1673,10 +1661,6 @@ typedef enum
 	shard_rubble
 } shards_t;
 
-// g_antilag.c
-void G_StoreClientPosition( gentity_t* ent );
-void G_HistoricalTrace( gentity_t* ent, trace_t *results, const vec3_t start, const vec3_t mins, const vec3_t maxs, const vec3_t end, int passEntityNum, int contentmask );
-void G_ResetMarkers( gentity_t* ent );
 
 
 // Pause
@@ -1729,8 +1713,12 @@ void G_swapTeams( void );
 void DecolorString( char *in, char *out);
 
 //g_unlagged.c
-void G_TimeShiftAllClients(int time, gentity_t* skip);
+void G_ResetHistory( gentity_t *ent );
+void G_StoreHistory( gentity_t *ent );
+void G_TimeShiftAllClients( int time, gentity_t *skip, const vec3_t shotMins, const vec3_t shotMaxs );
 void G_UnTimeShiftAllClients(gentity_t* skip);
+void G_DoTimeShiftForShots( gentity_t *ent, const vec3_t start, const vec3_t *ends, int numEnds );
+void Svcmd_LagBench_f( void );
 
 void G_Hitsounds( gentity_t *target, gentity_t *attacker, int mod, qboolean headshot );
 
@@ -176,6 +176,7 @@ vmCvar_t g_floatPlayerPosition;
 vmCvar_t g_delagHitscan;
 vmCvar_t g_maxExtrapolatedFrames;
 vmCvar_t g_maxLagCompensation;
+vmCvar_t g_antilagCull;
 vmCvar_t g_delagMissiles;
 
 vmCvar_t match_timeoutlength;
@@ -344,6 +345,7 @@ cvarTable_t gameCvarTable[] = {
 	{ &g_delagHitscan, "g_delagHitscan", "1", CVAR_ARCHIVE | CVAR_SERVERINFO, 0, qtrue },
 	{ &g_maxExtrapolatedFrames, "g_maxExtrapolatedFrames", "2", 0 , 0, qfalse },
 	{ &g_maxLagCompensation, "g_maxLagCompensation", "500", CVAR_ARCHIVE | CVAR_SERVERINFO, 0, qtrue },
+	{ &g_antilagCull, "g_antilagCull", "1", CVAR_ARCHIVE, 0, qfalse },
 	{ &g_delagMissiles, "g_delagMissiles", "0", CVAR_ARCHIVE | CVAR_SERVERINFO, 0, qtrue }, 
 	
 	{ &g_hitsounds, "g_hitsounds", "1", CVAR_ARCHIVE, 0, qfalse },
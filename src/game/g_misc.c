@@ -152,6 +152,9 @@ void TeleportPlayer( gentity_t *player, vec3_t origin, vec3_t angles ) {
 	if ( player->client->sess.sessionTeam != TEAM_SPECTATOR ) {
 		trap_LinkEntity( player );
 	}
+
+	// we don't want players being backward-reconciled back through teleporters
+	G_ResetHistory( player );
 }
 
 
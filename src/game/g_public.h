@@ -422,7 +422,10 @@ typedef enum {
 	BOTLIB_PC_READ_TOKEN,
 	BOTLIB_PC_SOURCE_FILE_AND_LINE, 
 
-	G_CMD_ARGSFROM
+	G_CMD_ARGSFROM,
+
+	G_TRACEBATCH    // ( trace_t *results, int count, const vec3_t *start, const vec3_t mins, const vec3_t maxs, const vec3_t *end, int passEntityNum, int contentmask );
+	// the same results as G_TRACE for each start / end pair, for bursts of rays from about the same place
 
 } gameImport_t;
 
@@ -720,6 +720,11 @@ qboolean    ConsoleCommand( void ) {
 		return qtrue;
 	}
 
+	if ( Q_stricmp( cmd, "lagbench" ) == 0 ) {
+		Svcmd_LagBench_f();
+		return qtrue;
+	}
+
 
 	// NERVE - SMF
 	if ( Q_stricmp( cmd, "start_match" ) == 0 ) {
@@ -23,6 +23,17 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 //Sago: For some reason the Niels version must use a different char set.
 #include "g_local.h"
 
+/*
+============
+G_HistoryRecord
+
+The history is a ring of records in increasing time order, "n" counts
+from the oldest record still kept
+============
+*/
+#define G_HistoryRecord( u, n ) ( &( u )->history[( ( u )->historyHead - ( u )->historyCount + 1 + ( n ) ) & ( NUM_CLIENT_HISTORY - 1 )] )
+
+
 /*
 ============
 G_ResetHistory
@@ -31,15 +42,16 @@ Clear out the given client's history (should be called when the teleport bit is
 ============
 */
 void G_ResetHistory( gentity_t *ent ) {
-	// fill up the history with data (assume the current position)
-	ent->client->unlag.historyHead = NUM_CLIENT_HISTORY - 1;
-	for (int i = ent->client->unlag.historyHead, time = level.time; i >= 0; i--, time -= 50 ) {
-		VectorCopy( ent->r.mins, ent->client->unlag.history[i].mins );
-		VectorCopy( ent->r.maxs, ent->client->unlag.history[i].maxs );
-		VectorCopy( ent->r.currentOrigin, ent->client->unlag.history[i].currentOrigin );
-		ent->client->unlag.history[i].leveltime = time;
-		//ent->client->unlag.history[i].animInfo = ent->client->unlag.animationInfo;
-	}
+	unlagged_t *unlag = &ent->client->unlag;
+
+	// a single record of the current position, anything older
+	// than that resolves to it
+	unlag->historyHead = 0;
+	unlag->historyCount = 1;
+	VectorCopy( ent->r.mins, unlag->history[0].mins );
+	VectorCopy( ent->r.maxs, unlag->history[0].maxs );
+	VectorCopy( ent->r.currentOrigin, unlag->history[0].currentOrigin );
+	unlag->history[0].leveltime = level.time;
 }
 
 
@@ -51,20 +63,26 @@ Keep track of where the client's been
 ============
 */
 void G_StoreHistory( gentity_t *ent ) {
-	ent->client->unlag.historyHead++;
-	if ( ent->client->unlag.historyHead >= NUM_CLIENT_HISTORY ) {
-		ent->client->unlag.historyHead = 0;
+	unlagged_t *unlag = &ent->client->unlag;
+	clientHistory_t *rec;
+
+	// the search needs strictly increasing times, so a second store in
+	// the same frame (spawning runs ClientEndFrame itself) replaces the first
+	if ( !unlag->historyCount || unlag->history[unlag->historyHead].leveltime != level.time ) {
+		unlag->historyHead = ( unlag->historyHead + 1 ) & ( NUM_CLIENT_HISTORY - 1 );
+		if ( unlag->historyCount < NUM_CLIENT_HISTORY ) {
+			unlag->historyCount++;
+		}
 	}
 
-	int head = ent->client->unlag.historyHead;
+	rec = &unlag->history[unlag->historyHead];
 
 	// store all the collision-detection info and the time
-	VectorCopy( ent->r.mins, ent->client->unlag.history[head].mins );
-	VectorCopy( ent->r.maxs, ent->client->unlag.history[head].maxs );
-	VectorCopy( ent->s.pos.trBase, ent->client->unlag.history[head].currentOrigin );
-	SnapVector( ent->client->unlag.history[head].currentOrigin );
-	ent->client->unlag.history[head].leveltime = level.time;
-	//ent->client->unlag.history[head].animInfo = ent->client->unlag.animationInfo;
+	VectorCopy( ent->r.mins, rec->mins );
+	VectorCopy( ent->r.maxs, rec->maxs );
+	VectorCopy( ent->s.pos.trBase, rec->currentOrigin );
+	SnapVector( rec->currentOrigin );
+	rec->leveltime = level.time;
 }
 
 
@@ -93,119 +111,88 @@ static void TimeShiftLerp( float frac, vec3_t start, vec3_t end, vec3_t result )
 
 /*
 =================
-G_TimeShiftClient
+G_HistoricalPosition
 
-Move a client back to where he was at the specified "time"
+Where the client was at "time".  Returns qfalse if it doesn't need to be
+moved, which is the case when "time" isn't older than the newest record
 =================
 */
-void G_TimeShiftClient( gentity_t *ent, int time, qboolean debug, gentity_t *debugger ) {
-	int		j, k;
+static qboolean G_HistoricalPosition( gentity_t *ent, int time, clientHistory_t *out ) {
+	unlagged_t *unlag = &ent->client->unlag;
+	clientHistory_t *j, *k;
+	int lo, hi, mid, found;
+	float frac;
+
+	if ( !unlag->historyCount ) {
+		return qfalse;
+	}
 
-	//Clamp max backward reconcilation time 
-	if (level.time - time > g_maxLagCompensation.integer) {
-		time = level.time + g_maxLagCompensation.integer;
+	// binary search for the newest record at or before "time"
+	found = -1;
+	lo = 0;
+	hi = unlag->historyCount - 1;
+	while ( lo <= hi ) {
+		mid = ( lo + hi ) >> 1;
+		if ( G_HistoryRecord( unlag, mid )->leveltime <= time ) {
+			found = mid;
+			lo = mid + 1;
+		} else {
+			hi = mid - 1;
+		}
 	}
 
-	// find two entries in the history whose times sandwich "time"
-	// assumes no two adjacent records have the same timestamp
-	j = k = ent->client->unlag.historyHead;
-	do {
-		if ( ent->client->unlag.history[j].leveltime <= time )
-			break;
+	if ( found == unlag->historyCount - 1 ) {
+		// this only happens when the client is using a negative timenudge, because that
+		// number is added to the command time
+		return qfalse;
+	}
 
-		k = j;
-		j--;
-		if ( j < 0 ) {
-			j = NUM_CLIENT_HISTORY - 1;
-		}
+	if ( found < 0 ) {
+		// older than anything we kept, so grab the earliest
+		*out = *G_HistoryRecord( unlag, 0 );
+		return qtrue;
 	}
-	while ( j != ent->client->unlag.historyHead );
-
-	// if we got past the first iteration above, we've sandwiched (or wrapped)
-	if ( j != k ) {
-		// make sure it doesn't get re-saved
-		if ( ent->client->unlag.saved.leveltime != level.time ) {
-			// save the current origin and bounding box
-			VectorCopy( ent->r.mins, ent->client->unlag.saved.mins );
-			VectorCopy( ent->r.maxs, ent->client->unlag.saved.maxs );
-			VectorCopy( ent->r.currentOrigin, ent->client->unlag.saved.currentOrigin );
-			ent->client->unlag.saved.leveltime = level.time;
-			//ent->client->unlag.saved.animInfo = ent->client->unlag.animationInfo;
-		}
 
-		// if we haven't wrapped back to the head, we've sandwiched, so
-		// we shift the client's position back to where he was at "time"
-		if ( j != ent->client->unlag.historyHead ) {
-			float	frac = (float)(time - ent->client->unlag.history[j].leveltime) /
-				(float)(ent->client->unlag.history[k].leveltime - ent->client->unlag.history[j].leveltime);
-
-			// interpolate between the two origins to give position at time index "time"
-			TimeShiftLerp( frac,
-				ent->client->unlag.history[j].currentOrigin, ent->client->unlag.history[k].currentOrigin,
-				ent->r.currentOrigin );
-
-			// lerp these too, just for fun (and ducking)
-			TimeShiftLerp( frac,
-				ent->client->unlag.history[j].mins, ent->client->unlag.history[k].mins,
-				ent->r.mins );
-
-			TimeShiftLerp( frac,
-				ent->client->unlag.history[j].maxs, ent->client->unlag.history[k].maxs,
-				ent->r.maxs );
-
-			/*if ( debug && debugger != NULL ) {
-				// print some debugging stuff exactly like what the client does
-
-				// it starts with "Rec:" to let you know it backward-reconciled
-				Com_sprintf( msg, sizeof(msg),
-					"print \"^1Rec: time: %d, j: %d, k: %d, origin: %0.2f %0.2f %0.2f\n"
-					"^2frac: %0.4f, origin1: %0.2f %0.2f %0.2f, origin2: %0.2f %0.2f %0.2f\n"
-					"^7level.time: %d, est time: %d, level.time delta: %d, est real ping: %d\n\"",
-					time, ent->client->history[j].leveltime, ent->client->history[k].leveltime,
-					ent->r.currentOrigin[0], ent->r.currentOrigin[1], ent->r.currentOrigin[2],
-					frac,
-					ent->client->history[j].currentOrigin[0],
-					ent->client->history[j].currentOrigin[1],
-					ent->client->history[j].currentOrigin[2], 
-					ent->client->history[k].currentOrigin[0],
-					ent->client->history[k].currentOrigin[1],
-					ent->client->history[k].currentOrigin[2],
-					level.time, level.time + debugger->client->frameOffset,
-					level.time - time, level.time + debugger->client->frameOffset - time);
-
-				trap_SendServerCommand( debugger - g_entities, msg );
-			}*/
-
-			// ported from nobo antilag for custom head animations
-			// find the "best" origin between the sandwiching trail nodes via interpolation
-			//Interpolate(frac, ent->client->history[j].currentOrigin, ent->client->history[k].currentOrigin, ent->r.currentOrigin);
-			// find the "best" mins & maxs (crouching/standing).
-			// it doesn't make sense to interpolate mins and maxs. the server either thinks the client
-			// is crouching or not, and updates the mins & maxs immediately. there's no inbetween.
-			// use the trail node's animation info that's nearest "time" (for head hitbox).
-			// the current server animation code used for head hitboxes doesn't support interpolating
-			// between two different animation frames (i.e. crouch -> standing animation), so can't interpolate here either.
-			//ent->client->unlag.animationInfo = ent->client->unlag.history[nearest_trail_node_index].animInfo;
-
-			// this will recalculate absmin and absmax
-			trap_LinkEntity(ent);
+	// sandwiched, so shift the client's position back to where he was at "time"
+	j = G_HistoryRecord( unlag, found );
+	k = G_HistoryRecord( unlag, found + 1 );
+	frac = (float)( time - j->leveltime ) / (float)( k->leveltime - j->leveltime );
 
-		} else {
-			// we wrapped, so grab the earliest
-			VectorCopy( ent->client->unlag.history[k].currentOrigin, ent->r.currentOrigin );
-			VectorCopy( ent->client->unlag.history[k].mins, ent->r.mins );
-			VectorCopy( ent->client->unlag.history[k].maxs, ent->r.maxs );
+	// interpolate between the two origins to give position at time index "time"
+	TimeShiftLerp( frac, j->currentOrigin, k->currentOrigin, out->currentOrigin );
 
-			// this will recalculate absmin and absmax
-			trap_LinkEntity( ent );
+	// lerp these too, just for fun (and ducking)
+	TimeShiftLerp( frac, j->mins, k->mins, out->mins );
+	TimeShiftLerp( frac, j->maxs, k->maxs, out->maxs );
 
-			//ent->client->unlag.animationInfo = ent->client->unlag.history[k].animInfo;
-		}
-	}
-	else {
-		// this only happens when the client is using a negative timenudge, because that
-		// number is added to the command time
+	out->leveltime = time;
+	return qtrue;
+}
+
+
+/*
+=================
+G_TimeShiftClient
+
+Move a client back to where he was at the specified "time"
+=================
+*/
+static void G_TimeShiftClient( gentity_t *ent, const clientHistory_t *pos ) {
+	// make sure it doesn't get re-saved
+	if ( ent->client->unlag.saved.leveltime != level.time ) {
+		// save the current origin and bounding box
+		VectorCopy( ent->r.mins, ent->client->unlag.saved.mins );
+		VectorCopy( ent->r.maxs, ent->client->unlag.saved.maxs );
+		VectorCopy( ent->r.currentOrigin, ent->client->unlag.saved.currentOrigin );
+		ent->client->unlag.saved.leveltime = level.time;
 	}
+
+	VectorCopy( pos->currentOrigin, ent->r.currentOrigin );
+	VectorCopy( pos->mins, ent->r.mins );
+	VectorCopy( pos->maxs, ent->r.maxs );
+
+	// this will recalculate absmin and absmax
+	trap_LinkEntity( ent );
 }
 
 static qbool PlayerIsVisible(gentity_t* attacker, gentity_t* target) {
@@ -226,6 +213,32 @@ static qbool PlayerIsVisible(gentity_t* attacker, gentity_t* target) {
 	return (traceEnt == target);
 }
 
+// G_AttachBodyParts gives every player a head box that can stick out of
+// their bounding box: G_BuildHead's fake offset puts it up to about 19
+// units from the origin, tag_head on a leaning model up to 28 sideways,
+// and the box itself is 12 x 12 x 12.  The shot volume is padded by this
+// much so a shot at just the head still shifts the player.
+static const vec3_t headCullPad = { 40, 40, 24 };
+
+static qboolean G_BoxesTouch( const vec3_t mins1, const vec3_t maxs1, const vec3_t mins2, const vec3_t maxs2 ) {
+	return mins1[0] <= maxs2[0] && maxs1[0] >= mins2[0]
+		   && mins1[1] <= maxs2[1] && maxs1[1] >= mins2[1]
+		   && mins1[2] <= maxs2[2] && maxs1[2] >= mins2[2];
+}
+
+static qboolean G_CanTimeShift( gentity_t *ent, gentity_t *skip ) {
+	return ent->client
+		   && ent->inuse
+		   && ent->client->sess.sessionTeam < TEAM_SPECTATOR
+		   && ent != skip
+		   && ent->health > 0
+		   && !( ent->client->ps.pm_flags & PMF_LIMBO );
+		   // do not timeshift eliminated clients, as
+		   // G_TimeShiftClient() will re-link them when
+		   // they're supposed to stay unlinked
+		   //&& !ent->client->isEliminated
+}
+
 
 /*
 =====================
@@ -233,59 +246,74 @@ G_TimeShiftAllClients
 
 Move ALL clients back to where they were at the specified "time",
 except for "skip"
+
+With a shot volume, clients that are outside of it both now and at
+"time", head box included, are left alone.  Nothing the shot can hit changes, but only the
+few players near the line of fire get searched, traced for visibility
+and relinked
 =====================
 */
-void G_TimeShiftAllClients( int time, gentity_t *skip ) {
+void G_TimeShiftAllClients( int time, gentity_t *skip, const vec3_t shotMins, const vec3_t shotMaxs ) {
 	int			i;
 	gentity_t	*ent;
-	qboolean debug = ( skip != NULL && skip->client ); 
+	clientHistory_t pos;
+	vec3_t		absmin, absmax;
+	vec3_t		cullMins, cullMaxs;
+
+	//Clamp max backward reconcilation time 
+	if ( level.time - time > g_maxLagCompensation.integer ) {
+		time = level.time - g_maxLagCompensation.integer;
+	}
+
+	if ( shotMins ) {
+		VectorSubtract( shotMins, headCullPad, cullMins );
+		VectorAdd( shotMaxs, headCullPad, cullMaxs );
+	}
 
 	// for every client
-	ent = &g_entities[0];
-	for ( i = 0; i < MAX_CLIENTS; i++, ent++ ) {
-		if ( ent->client
-				&& ent->inuse
-				&& ent->client->sess.sessionTeam < TEAM_SPECTATOR
-				&& ent != skip
-				&& ent->health > 0
-				&& !(ent->client->ps.pm_flags & PMF_LIMBO)
-				// do not timeshift eliminated clients, as
-				// G_TimeShiftClient() will re-link them when
-				// they're supposed to stay unlinked
-				//&& !ent->client->isEliminated
-				) {
-
-			//If the target is not visible to the attacker, don't time shift him
-			//e.g. just ran behind a wall 
-			if (skip != NULL) {
-				if (!PlayerIsVisible(skip, ent)) {
-					continue;
-				}
+	for ( i = 0; i < level.numConnectedClients; i++ ) {
+		ent = g_entities + level.sortedClients[i];
+		if ( !G_CanTimeShift( ent, skip ) ) {
+			continue;
+		}
+
+		if ( !G_HistoricalPosition( ent, time, &pos ) ) {
+			continue;
+		}
+
+		if ( shotMins ) {
+			VectorAdd( pos.currentOrigin, pos.mins, absmin );
+			VectorAdd( pos.currentOrigin, pos.maxs, absmax );
+			if ( !G_BoxesTouch( absmin, absmax, cullMins, cullMaxs )
+				 && !G_BoxesTouch( ent->r.absmin, ent->r.absmax, cullMins, cullMaxs ) ) {
+				continue;
 			}
+		}
 
-			G_TimeShiftClient( ent, time, debug, skip );
+		//If the target is not visible to the attacker, don't time shift him
+		//e.g. just ran behind a wall 
+		if (skip != NULL) {
+			if (!PlayerIsVisible(skip, ent)) {
+				continue;
+			}
 		}
+
+		G_TimeShiftClient( ent, &pos );
 	}
 }
 
 
 /*
 ================
-G_DoTimeShiftFor
+G_TimeShiftTime
 
-Decide what time to shift everyone back to, and do it
+Decide what time to shift everyone back to
 ================
 */
-void G_DoTimeShiftFor( gentity_t *ent ) {	
+static int G_TimeShiftTime( gentity_t *ent ) {
 	//int wpflags[WP_NUM_WEAPONS] = { 0, 0, 2, 4, 0, 0, 8, 16, 0, 0, 0, 32, 0, 64 };
 
 	//int wpflag = wpflags[ent->client->ps.weapon];
-	int time;
-
-	// don't time shift for mistakes or bots
-	if ( !ent->inuse || !ent->client || (ent->r.svFlags & SVF_BOT) ) {
-		return;
-	}
 
 	// if it's enabled server-side and the client wants it
 	// or wants it for this weapon (not doing this for Rtcw as we have pistol and SMG)
@@ -293,14 +321,61 @@ void G_DoTimeShiftFor( gentity_t *ent ) {
 		// do the full lag compensation, except what the client nudges
 		//time = ent->client->attackTime + ent->client->pers.cmdTimeNudge;
 		// don't allow the client to nudge anything
-		time = ent->client->unlag.attackTime;
+		return ent->client->unlag.attackTime;
 	}
-	else {
-		// do just 50ms
-		time = level.previousTime + ent->client->unlag.frameOffset;
+
+	// do just 50ms
+	return level.previousTime + ent->client->unlag.frameOffset;
+}
+
+
+/*
+================
+G_DoTimeShiftFor
+
+Shift everyone back for a shot from "ent"
+================
+*/
+void G_DoTimeShiftFor( gentity_t *ent ) {
+	// don't time shift for mistakes or bots
+	if ( !ent->inuse || !ent->client || (ent->r.svFlags & SVF_BOT) ) {
+		return;
 	}
 
-	G_TimeShiftAllClients( time, ent );
+	G_TimeShiftAllClients( G_TimeShiftTime( ent ), ent, NULL, NULL );
+}
+
+
+/*
+================
+G_DoTimeShiftForShots
+
+Like G_DoTimeShiftFor for point traces from "start" to each of "ends",
+only the clients near those lines are moved when g_antilagCull is set.
+Anything that bounces a shot off in a new direction must use
+G_DoTimeShiftFor instead
+================
+*/
+void G_DoTimeShiftForShots( gentity_t *ent, const vec3_t start, const vec3_t *ends, int numEnds ) {
+	vec3_t mins, maxs;
+	int i;
+
+	if ( !ent->inuse || !ent->client || (ent->r.svFlags & SVF_BOT) ) {
+		return;
+	}
+
+	if ( !g_antilagCull.integer ) {
+		G_TimeShiftAllClients( G_TimeShiftTime( ent ), ent, NULL, NULL );
+		return;
+	}
+
+	VectorCopy( start, mins );
+	VectorCopy( start, maxs );
+	for ( i = 0; i < numEnds; i++ ) {
+		AddPointToBounds( ends[i], mins, maxs );
+	}
+
+	G_TimeShiftAllClients( G_TimeShiftTime( ent ), ent, mins, maxs );
 }
 
 
@@ -319,7 +394,6 @@ void G_UnTimeShiftClient( gentity_t *ent ) {
 		VectorCopy( ent->client->unlag.saved.maxs, ent->r.maxs );
 		VectorCopy( ent->client->unlag.saved.currentOrigin, ent->r.currentOrigin );
 		ent->client->unlag.saved.leveltime = 0;
-		//ent->client->unlag.animationInfo = ent->client->unlag.saved.animInfo;
 
 		// this will recalculate absmin and absmax
 		trap_LinkEntity( ent );
@@ -340,16 +414,10 @@ void G_UnTimeShiftAllClients( gentity_t *skip ) {
 	int			i;
 	gentity_t	*ent;
 
-	ent = &g_entities[0];
-	for ( i = 0; i < MAX_CLIENTS; i++, ent++) {
-		if ( ent->client 
-			&& ent->inuse
-			&& ent->client->sess.sessionTeam < TEAM_SPECTATOR
-			&& ent != skip
-			&& ent->health > 0
-			&& !(ent->client->ps.pm_flags & PMF_LIMBO)
-			){
-				G_UnTimeShiftClient( ent );
+	for ( i = 0; i < level.numConnectedClients; i++ ) {
+		ent = g_entities + level.sortedClients[i];
+		if ( G_CanTimeShift( ent, skip ) ) {
+			G_UnTimeShiftClient( ent );
 		}
 	}
 }
@@ -373,6 +441,142 @@ void G_UndoTimeShiftFor( gentity_t *ent ) {
 }
 
 
+/*
+==================
+G_LagBenchShot
+
+A random shot from one of "shooters", the same for the same seed
+==================
+*/
+static gentity_t *G_LagBenchShot( int *seed, gentity_t **shooters, int numShooters, vec3_t start, vec3_t end, vec3_t mins, vec3_t maxs ) {
+	gentity_t	*ent;
+	vec3_t		dir;
+
+	ent = shooters[( Q_rand( seed ) & 0xffff ) % numShooters];
+	VectorCopy( ent->r.currentOrigin, start );
+	start[2] += ent->client->ps.viewheight;
+	dir[0] = Q_crandom( seed );
+	dir[1] = Q_crandom( seed );
+	dir[2] = Q_crandom( seed ) * 0.25f;
+	VectorNormalize( dir );
+	VectorMA( start, 8192, dir, end );
+
+	VectorCopy( start, mins );
+	VectorCopy( start, maxs );
+	AddPointToBounds( end, mins, maxs );
+	return ent;
+}
+
+
+/*
+==================
+G_LagBenchTrace
+
+The trace Bullet_Fire_Extended does, head boxes included.
+Returns qtrue for a head hit.
+==================
+*/
+static qboolean G_LagBenchTrace( trace_t *tr, gentity_t *ent, vec3_t start, vec3_t end ) {
+	qboolean	head;
+
+	G_AttachBodyParts( ent );
+	trap_Trace( tr, start, NULL, NULL, end, ent->s.number, MASK_SHOT );
+	head = ( g_entities[tr->entityNum].s.eType == ET_TEMPHEAD );
+	tr->entityNum = G_SwitchBodyPartEntity( &g_entities[tr->entityNum] );
+	G_DettachBodyParts();
+	return head;
+}
+
+
+/*
+==================
+Svcmd_LagBench_f
+
+lagbench [shots] [lag msec]
+Fires random hitscan shots from the active players with every other
+player shifted back, then with only the ones near the line of fire,
+and checks that both hit the same thing, head boxes included
+==================
+*/
+void Svcmd_LagBench_f( void ) {
+	char		buf[MAX_TOKEN_CHARS];
+	gentity_t	*shooters[MAX_CLIENTS], *ent;
+	vec3_t		start, end, mins, maxs;
+	trace_t		tr, cull;
+	int			shots, lag, numShooters, mismatches, heads, moved[2];
+	int			i, j, pass, seed, startTime, msec[2];
+
+	trap_Argv( 1, buf, sizeof( buf ) );
+	shots = atoi( buf ) > 0 ? atoi( buf ) : 2000;
+	trap_Argv( 2, buf, sizeof( buf ) );
+	lag = atoi( buf ) > 0 ? atoi( buf ) : 100;
+
+	numShooters = 0;
+	for ( i = 0; i < level.numConnectedClients; i++ ) {
+		ent = g_entities + level.sortedClients[i];
+		if ( G_CanTimeShift( ent, NULL ) ) {
+			shooters[numShooters++] = ent;
+		}
+	}
+	if ( numShooters < 2 ) {
+		G_Printf( "lagbench: needs at least two players in the game\n" );
+		return;
+	}
+
+	// both ways fire the same shots, timed separately
+	for ( pass = 0; pass < 2; pass++ ) {
+		seed = 1234;
+		moved[pass] = 0;
+		startTime = trap_Milliseconds();
+		for ( i = 0; i < shots; i++ ) {
+			ent = G_LagBenchShot( &seed, shooters, numShooters, start, end, mins, maxs );
+			if ( pass ) {
+				G_TimeShiftAllClients( level.time - lag, ent, mins, maxs );
+			} else {
+				G_TimeShiftAllClients( level.time - lag, ent, NULL, NULL );
+			}
+			for ( j = 0; j < numShooters; j++ ) {
+				if ( shooters[j]->client->unlag.saved.leveltime == level.time ) {
+					moved[pass]++;
+				}
+			}
+			G_LagBenchTrace( &tr, ent, start, end );
+			G_UnTimeShiftAllClients( ent );
+		}
+		msec[pass] = trap_Milliseconds() - startTime;
+	}
+
+	// and once more shot by shot to compare what got hit
+	mismatches = 0;
+	heads = 0;
+	seed = 1234;
+	for ( i = 0; i < shots; i++ ) {
+		ent = G_LagBenchShot( &seed, shooters, numShooters, start, end, mins, maxs );
+
+		G_TimeShiftAllClients( level.time - lag, ent, NULL, NULL );
+		if ( G_LagBenchTrace( &tr, ent, start, end ) ) {
+			heads++;
+		}
+		G_UnTimeShiftAllClients( ent );
+
+		G_TimeShiftAllClients( level.time - lag, ent, mins, maxs );
+		G_LagBenchTrace( &cull, ent, start, end );
+		G_UnTimeShiftAllClients( ent );
+
+		if ( tr.entityNum != cull.entityNum || tr.fraction != cull.fraction ) {
+			mismatches++;
+		}
+	}
+
+	G_Printf( "%i shots, %i players, %i msec lag\n", shots, numShooters, lag );
+	G_Printf( "shift all: %i msec, %.1f usec/shot, %.1f players moved/shot\n",
+			  msec[0], msec[0] * 1000.0f / shots, (float)moved[0] / shots );
+	G_Printf( "shot cull: %i msec, %.1f usec/shot, %.1f players moved/shot\n",
+			  msec[1], msec[1] * 1000.0f / shots, (float)moved[1] / shots );
+	G_Printf( "%i shots hit something different, %i head hits\n", mismatches, heads );
+}
+
+
 /*
 ===========================
 G_PredictPlayerClipVelocity
@@ -1522,12 +1522,13 @@ Bullet_Fire
 void Bullet_Fire( gentity_t *ent, float spread, int damage ) {
 	vec3_t end;
 
+	Bullet_Endpos( ent, spread, &end );
+
 	if (ent->client && (ent->client->pers.antilag) && g_antilag.integer == 2) 
 	{
-		G_DoTimeShiftFor(ent);
+		G_DoTimeShiftForShots( ent, muzzleTrace, (const vec3_t *)&end, 1 );
 	}
 
-	Bullet_Endpos( ent, spread, &end );
 	Bullet_Fire_Extended( ent, ent, muzzleTrace, end, spread, damage );
 
 	if (ent->client && (ent->client->pers.antilag) && g_antilag.integer == 2)
@@ -1878,23 +1879,35 @@ VENOM GUN TRACING
 #define DEFAULT_VENOM_SPREAD 20
 #define DEFAULT_VENOM_DAMAGE 15
 
-qboolean VenomPellet( vec3_t start, vec3_t end, gentity_t *ent ) {
-	trace_t tr;
+// sets *stale if the damage changed the target enough that traces made
+// before it can't be trusted any more
+qboolean VenomPellet( trace_t *tr, gentity_t *ent, qboolean *stale ) {
 	int damage;
 	gentity_t       *traceEnt;
+	vec3_t absmin, absmax;
+	int contents;
 
-	trap_Trace( &tr, start, NULL, NULL, end, ent->s.number, MASK_SHOT );
-	traceEnt = &g_entities[ tr.entityNum ];
+	traceEnt = &g_entities[ tr->entityNum ];
 
 	// send bullet impact
-	if (  tr.surfaceFlags & SURF_NOIMPACT ) {
+	if (  tr->surfaceFlags & SURF_NOIMPACT ) {
 		return qfalse;
 	}
 
 	if ( traceEnt->takedamage ) {
 		damage = DEFAULT_VENOM_DAMAGE * s_quadFactor;
 
-		G_Damage( traceEnt, ent, ent, forward, tr.endpos, damage, 0, MOD_VENOM );
+		VectorCopy( traceEnt->r.absmin, absmin );
+		VectorCopy( traceEnt->r.absmax, absmax );
+		contents = traceEnt->r.contents;
+
+		G_Damage( traceEnt, ent, ent, forward, tr->endpos, damage, 0, MOD_VENOM );
+
+		if ( !traceEnt->inuse || !traceEnt->r.linked || traceEnt->health <= 0 || traceEnt->r.contents != contents
+			 || !VectorCompare( traceEnt->r.absmin, absmin ) || !VectorCompare( traceEnt->r.absmax, absmax ) ) {
+			*stale = qtrue;
+		}
+
 		if ( LogAccuracyHit( traceEnt, ent ) ) {
 			return qtrue;
 		}
@@ -1906,29 +1919,44 @@ qboolean VenomPellet( vec3_t start, vec3_t end, gentity_t *ent ) {
 void VenomPattern( vec3_t origin, vec3_t origin2, int seed, gentity_t *ent ) {
 	int i;
 	float r, u;
-	vec3_t end;
+	vec3_t starts[DEFAULT_VENOM_COUNT], ends[DEFAULT_VENOM_COUNT];
+	trace_t traces[DEFAULT_VENOM_COUNT];
 	vec3_t forward, right, up;
 	qboolean hitClient = qfalse;
+	qboolean stale = qfalse;
 
 	// derive the right and up vectors from the forward vector, because
 	// the client won't have any other information
 	VectorNormalize2( origin2, forward );
 	PerpendicularVector( right, forward );
 	CrossProduct( forward, right, up );
-	
-	if (ent->client && (ent->client->pers.antilag) && g_antilag.integer == 2) 
-	{
-		G_DoTimeShiftFor(ent);
-	}
 
 	// generate the "random" spread pattern
 	for ( i = 0 ; i < DEFAULT_VENOM_COUNT ; i++ ) {
 		r = Q_crandom( &seed ) * DEFAULT_VENOM_SPREAD;
 		u = Q_crandom( &seed ) * DEFAULT_VENOM_SPREAD;
-		VectorMA( origin, 8192, forward, end );
-		VectorMA( end, r, right, end );
-		VectorMA( end, u, up, end );
-		if ( VenomPellet( origin, end, ent ) && !hitClient ) {
+		VectorCopy( origin, starts[i] );
+		VectorMA( origin, 8192, forward, ends[i] );
+		VectorMA( ends[i], r, right, ends[i] );
+		VectorMA( ends[i], u, up, ends[i] );
+	}
+
+	if (ent->client && (ent->client->pers.antilag) && g_antilag.integer == 2) 
+	{
+		G_DoTimeShiftForShots( ent, origin, (const vec3_t *)ends, DEFAULT_VENOM_COUNT );
+	}
+
+	// the pellets all leave from the same place, so trace them together
+	trap_TraceBatch( traces, DEFAULT_VENOM_COUNT, (const vec3_t *)starts, NULL, NULL, (const vec3_t *)ends,
+					 ent->s.number, MASK_SHOT );
+
+	for ( i = 0 ; i < DEFAULT_VENOM_COUNT ; i++ ) {
+		// once a pellet kills or moves something, the rest have to
+		// be traced again like they would have been one at a time
+		if ( stale ) {
+			trap_Trace( &traces[i], origin, NULL, NULL, ends[i], ent->s.number, MASK_SHOT );
+		}
+		if ( VenomPellet( &traces[i], ent, &stale ) && !hitClient ) {
 			hitClient = qtrue;
 			ent->client->ps.persistant[PERS_ACCURACY_HITS]++;
 		}
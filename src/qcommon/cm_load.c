@@ -29,6 +29,7 @@ If you have questions concerning this license or the applicable additional terms
 // cmodel.c -- model loading
 
 #include "cm_local.h"
+#include "cm_patch.h"
 
 #ifdef BSPC
 
@@ -48,13 +49,6 @@ void SetPlaneSignbits( cplane_t *out ) {
 }
 #endif //BSPC
 
-// to allow boxes to be treated as brush models, we allocate
-// some extra indexes along with those needed by the map
-#define BOX_BRUSHES     1
-#define BOX_SIDES       6
-#define BOX_LEAFS       2
-#define BOX_PLANES      12
-
 #define LL( x ) x = LittleLong( x )
 
 
@@ -69,15 +63,14 @@ byte        *cmod_base;
 cvar_t      *cm_noAreas;
 cvar_t      *cm_noCurves;
 cvar_t      *cm_playerCurveClip;
+cvar_t      *cm_debugSurfaceUpdate;
+cvar_t      *cm_cache;
 #endif
 
-cmodel_t box_model;
-cplane_t    *box_planes;
-cbrush_t    *box_brush;
-
-
+// bumped whenever cm changes, trace contexts from before are no good
+static int cm_loadCount;
 
-void    CM_InitBoxHull( void );
+void    CM_InitBoxHull( cmTraceContext_t *tc );
 void    CM_FloodAreaConnections( void );
 
 
@@ -254,7 +247,7 @@ void CMod_LoadBrushes( lump_t *l ) {
 	}
 	count = l->filelen / sizeof( *in );
 
-	cm.brushes = Hunk_Alloc( ( BOX_BRUSHES + count ) * sizeof( *cm.brushes ), h_high );
+	cm.brushes = Hunk_Alloc( count * sizeof( *cm.brushes ), h_high );
 	cm.numBrushes = count;
 
 	out = cm.brushes;
@@ -295,7 +288,7 @@ void CMod_LoadLeafs( lump_t *l ) {
 		Com_Error( ERR_DROP, "Map with no leafs" );
 	}
 
-	cm.leafs = Hunk_Alloc( ( BOX_LEAFS + count ) * sizeof( *cm.leafs ), h_high );
+	cm.leafs = Hunk_Alloc( count * sizeof( *cm.leafs ), h_high );
 	cm.numLeafs = count;
 
 	out = cm.leafs;
@@ -341,7 +334,7 @@ void CMod_LoadPlanes( lump_t *l ) {
 	if ( count < 1 ) {
 		Com_Error( ERR_DROP, "Map with no planes" );
 	}
-	cm.planes = Hunk_Alloc( ( BOX_PLANES + count ) * sizeof( *cm.planes ), h_high );
+	cm.planes = Hunk_Alloc( count * sizeof( *cm.planes ), h_high );
 	cm.numPlanes = count;
 
 	out = cm.planes;
@@ -435,7 +428,7 @@ void CMod_LoadBrushSides( lump_t *l ) {
 	}
 	count = l->filelen / sizeof( *in );
 
-	cm.brushsides = Hunk_Alloc( ( BOX_SIDES + count ) * sizeof( *cm.brushsides ), h_high );
+	cm.brushsides = Hunk_Alloc( count * sizeof( *cm.brushsides ), h_high );
 	cm.numBrushSides = count;
 
 	out = cm.brushsides;
@@ -492,6 +485,332 @@ void CMod_LoadVisibility( lump_t *l ) {
 //==================================================================
 
 
+#ifndef BSPC
+/*
+===============================================================================
+
+					PATCH COLLIDE CACHE
+
+Generating the facets and border planes for every patch is the bulk of
+the time spent in CM_LoadMap.  The result only depends on the bsp, so it
+is written to the homepath as <game>/maps/<name>.cmc after the first load
+and read back in one piece while the bsp checksum still matches.  It is
+only ever read from the home or base path directories, never from a pk3,
+and everything in it is checked before it is used.
+
+The file is in native byte order, a cache written on a machine with a
+different layout simply fails the header check and gets regenerated.
+
+===============================================================================
+*/
+
+#define CM_CACHE_IDENT      ( ( 'H' << 24 ) + ( 'C' << 16 ) + ( 'M' << 8 ) + 'C' )
+#define CM_CACHE_VERSION    1
+#define CM_CACHE_ALIGN      64      // planes and facets start on a cache line
+
+#define CM_CacheAlign( x )  ( ( ( x ) + CM_CACHE_ALIGN - 1 ) & ~( CM_CACHE_ALIGN - 1 ) )
+
+typedef struct {
+	int ident;
+	int version;
+	int checksum;                   // of the whole bsp
+	int numSurfaces;
+	int numPatches;
+	int planeSize;                  // catches patchPlane_t / facet_t changes
+	int facetSize;
+	int dataSize;                   // bytes following the patch table
+} cmCacheHeader_t;
+
+typedef struct {
+	int surface;
+	vec3_t bounds[2];
+	int numPlanes;
+	int numFacets;
+	int planesOfs;                  // from the start of the data block
+	int facetsOfs;
+} cmCachePatch_t;
+
+static char cm_cacheName[MAX_QPATH];
+static int cm_cacheChecksum;
+
+static struct {
+	qboolean fromCache;
+	int numPatches;
+	int numPlanes;
+	int numFacets;
+	int readMsec;
+	int generateMsec;
+	int mismatches;
+} cm_patchStats;
+
+/*
+=================
+CM_ValidCachePatch
+
+Everything in the cache is checked before it is trusted, a bad index
+would otherwise only show up as a crash in the middle of a trace
+=================
+*/
+static qboolean CM_ValidCachePatch( const cmCachePatch_t *cp, const cmCacheHeader_t *header ) {
+	if ( cp->numPlanes <= 0 || cp->numPlanes > MAX_PATCH_PLANES ) {
+		return qfalse;
+	}
+	if ( cp->numFacets < 0 || cp->numFacets > MAX_FACETS ) {
+		return qfalse;
+	}
+	if ( cp->planesOfs < 0 || ( cp->planesOfs & ( CM_CACHE_ALIGN - 1 ) )
+		 || cp->planesOfs + cp->numPlanes * (int)sizeof( patchPlane_t ) > header->dataSize ) {
+		return qfalse;
+	}
+	if ( cp->facetsOfs < 0 || ( cp->facetsOfs & ( CM_CACHE_ALIGN - 1 ) )
+		 || cp->facetsOfs + cp->numFacets * (int)sizeof( facet_t ) > header->dataSize ) {
+		return qfalse;
+	}
+	return qtrue;
+}
+
+static qboolean CM_ValidCacheFacets( const patchCollide_t *pc ) {
+	const patchPlane_t  *plane;
+	const facet_t       *facet;
+	int i, j, signbits;
+
+	// the traces index tw->offsets with these
+	for ( i = 0, plane = pc->planes ; i < pc->numPlanes ; i++, plane++ ) {
+		for ( j = 0, signbits = 0 ; j < 3 ; j++ ) {
+			if ( plane->plane[j] < 0 ) {
+				signbits |= 1 << j;
+			}
+		}
+		if ( plane->signbits != signbits ) {
+			return qfalse;
+		}
+	}
+
+	for ( i = 0, facet = pc->facets ; i < pc->numFacets ; i++, facet++ ) {
+		if ( facet->surfacePlane < 0 || facet->surfacePlane >= pc->numPlanes ) {
+			return qfalse;
+		}
+		if ( facet->numBorders < 0 || facet->numBorders > ARRAY_LEN( facet->borderPlanes ) ) {
+			return qfalse;
+		}
+		for ( j = 0 ; j < facet->numBorders ; j++ ) {
+			if ( facet->borderPlanes[j] < 0 || facet->borderPlanes[j] >= pc->numPlanes ) {
+				return qfalse;
+			}
+		}
+	}
+	return qtrue;
+}
+
+/*
+=================
+CM_ReadPatchCache
+
+Returns one patchCollide_t per patch surface, in surface order, or NULL
+if there is no usable cache for the current bsp
+=================
+*/
+static patchCollide_t *CM_ReadPatchCache( dsurface_t *in, int count, int numPatches ) {
+	fileHandle_t f;
+	cmCacheHeader_t header;
+	cmCachePatch_t  *table, *cp;
+	patchCollide_t  *pc;
+	byte            *data;
+	int len, tableSize;
+	int i, n;
+
+	len = FS_SV_FOpenFileRead( cm_cacheName, &f );
+	if ( !f ) {
+		return NULL;
+	}
+
+	if ( len < (int)sizeof( header ) || FS_Read( &header, sizeof( header ), f ) != sizeof( header ) ) {
+		FS_FCloseFile( f );
+		return NULL;
+	}
+
+	tableSize = numPatches * sizeof( *table );
+	if ( header.ident != CM_CACHE_IDENT || header.version != CM_CACHE_VERSION
+		 || header.checksum != cm_cacheChecksum || header.numSurfaces != count
+		 || header.numPatches != numPatches || header.planeSize != sizeof( patchPlane_t )
+		 || header.facetSize != sizeof( facet_t ) || header.dataSize < 0
+		 || len != (int)sizeof( header ) + tableSize + header.dataSize ) {
+		Com_DPrintf( "%s is stale\n", cm_cacheName );
+		FS_FCloseFile( f );
+		return NULL;
+	}
+
+	table = Hunk_AllocateTempMemory( tableSize );
+	if ( FS_Read( table, tableSize, f ) != tableSize ) {
+		Hunk_FreeTempMemory( table );
+		FS_FCloseFile( f );
+		return NULL;
+	}
+
+	// the patch table has to line up with the surfaces of this bsp
+	for ( i = 0, n = 0, cp = table ; i < count && n < numPatches ; i++ ) {
+		if ( LittleLong( in[i].surfaceType ) != MST_PATCH ) {
+			continue;
+		}
+		if ( cp->surface != i || !CM_ValidCachePatch( cp, &header ) ) {
+			Com_DPrintf( "%s: bad patch %i\n", cm_cacheName, n );
+			Hunk_FreeTempMemory( table );
+			FS_FCloseFile( f );
+			return NULL;
+		}
+		cp++;
+		n++;
+	}
+
+	// read all planes and facets straight into their final place
+	data = Hunk_Alloc( header.dataSize + CM_CACHE_ALIGN - 1, h_high );
+	data += CM_CacheAlign( (size_t)data ) - (size_t)data;
+	if ( FS_Read( data, header.dataSize, f ) != header.dataSize ) {
+		// the block stays on the hunk until the next map, which is harmless
+		Hunk_FreeTempMemory( table );
+		FS_FCloseFile( f );
+		return NULL;
+	}
+	FS_FCloseFile( f );
+
+	pc = Hunk_Alloc( numPatches * sizeof( *pc ), h_high );
+	for ( i = 0, cp = table ; i < numPatches ; i++, cp++ ) {
+		VectorCopy( cp->bounds[0], pc[i].bounds[0] );
+		VectorCopy( cp->bounds[1], pc[i].bounds[1] );
+		pc[i].numPlanes = cp->numPlanes;
+		pc[i].planes = (patchPlane_t *)( data + cp->planesOfs );
+		pc[i].numFacets = cp->numFacets;
+		pc[i].facets = (facet_t *)( data + cp->facetsOfs );
+
+		if ( !CM_ValidCacheFacets( &pc[i] ) ) {
+			Com_DPrintf( "%s: bad facets in patch %i\n", cm_cacheName, i );
+			Hunk_FreeTempMemory( table );
+			return NULL;
+		}
+	}
+
+	Hunk_FreeTempMemory( table );
+	return pc;
+}
+
+/*
+=================
+CM_WritePatchCache
+=================
+*/
+static void CM_WritePatchCache( int count, int numPatches ) {
+	static byte zero[CM_CACHE_ALIGN];
+	fileHandle_t f;
+	cmCacheHeader_t header;
+	cmCachePatch_t  *table, *cp;
+	patchCollide_t  *pc;
+	int i, size, ofs;
+
+	table = Hunk_AllocateTempMemory( numPatches * sizeof( *table ) );
+
+	ofs = 0;
+	for ( i = 0, cp = table ; i < count ; i++ ) {
+		if ( !cm.surfaces[i] ) {
+			continue;
+		}
+		pc = cm.surfaces[i]->pc;
+		cp->surface = i;
+		VectorCopy( pc->bounds[0], cp->bounds[0] );
+		VectorCopy( pc->bounds[1], cp->bounds[1] );
+		cp->numPlanes = pc->numPlanes;
+		cp->numFacets = pc->numFacets;
+		cp->planesOfs = ofs;
+		ofs = CM_CacheAlign( ofs + pc->numPlanes * sizeof( *pc->planes ) );
+		cp->facetsOfs = ofs;
+		ofs = CM_CacheAlign( ofs + pc->numFacets * sizeof( *pc->facets ) );
+		cp++;
+	}
+
+	header.ident = CM_CACHE_IDENT;
+	header.version = CM_CACHE_VERSION;
+	header.checksum = cm_cacheChecksum;
+	header.numSurfaces = count;
+	header.numPatches = numPatches;
+	header.planeSize = sizeof( patchPlane_t );
+	header.facetSize = sizeof( facet_t );
+	header.dataSize = ofs;
+
+	f = FS_SV_FOpenFileWrite( cm_cacheName );
+	if ( !f ) {
+		Com_DPrintf( "Couldn't write %s\n", cm_cacheName );
+		Hunk_FreeTempMemory( table );
+		return;
+	}
+
+	FS_Write( &header, sizeof( header ), f );
+	FS_Write( table, numPatches * sizeof( *table ), f );
+	for ( i = 0, cp = table ; i < numPatches ; i++, cp++ ) {
+		pc = cm.surfaces[cp->surface]->pc;
+
+		size = pc->numPlanes * sizeof( *pc->planes );
+		FS_Write( pc->planes, size, f );
+		FS_Write( zero, CM_CacheAlign( size ) - size, f );
+
+		size = pc->numFacets * sizeof( *pc->facets );
+		FS_Write( pc->facets, size, f );
+		FS_Write( zero, CM_CacheAlign( size ) - size, f );
+	}
+	FS_FCloseFile( f );
+
+	Hunk_FreeTempMemory( table );
+}
+
+/*
+=================
+CM_ComparePatchCollide
+
+cm_cache 2 regenerates every patch and checks it against the cache
+=================
+*/
+static qboolean CM_ComparePatchCollide( const patchCollide_t *a, const patchCollide_t *b ) {
+	if ( !VectorCompare( a->bounds[0], b->bounds[0] ) || !VectorCompare( a->bounds[1], b->bounds[1] ) ) {
+		return qfalse;
+	}
+	if ( a->numPlanes != b->numPlanes || a->numFacets != b->numFacets ) {
+		return qfalse;
+	}
+	if ( memcmp( a->planes, b->planes, a->numPlanes * sizeof( *a->planes ) ) ) {
+		return qfalse;
+	}
+	if ( memcmp( a->facets, b->facets, a->numFacets * sizeof( *a->facets ) ) ) {
+		return qfalse;
+	}
+	return qtrue;
+}
+
+/*
+=================
+CM_PatchCache_f
+
+Reports how the patches of the current map were loaded, for comparing
+load times with and without cm_cache
+=================
+*/
+void CM_PatchCache_f( void ) {
+	if ( !cm.name[0] ) {
+		Com_Printf( "No map loaded.\n" );
+		return;
+	}
+
+	Com_Printf( "%s: %i patches, %i planes, %i facets\n", cm.name,
+				cm_patchStats.numPatches, cm_patchStats.numPlanes, cm_patchStats.numFacets );
+	if ( cm_patchStats.fromCache ) {
+		Com_Printf( "read from %s in %i msec\n", cm_cacheName, cm_patchStats.readMsec );
+	}
+	if ( !cm_patchStats.fromCache || cm_cache->integer == 2 ) {
+		Com_Printf( "generated in %i msec\n", cm_patchStats.generateMsec );
+	}
+	if ( cm_patchStats.fromCache && cm_cache->integer == 2 ) {
+		Com_Printf( "%i patches differ from the cache\n", cm_patchStats.mismatches );
+	}
+}
+#endif
+
 /*
 =================
 CMod_LoadPatches
@@ -508,6 +827,11 @@ void CMod_LoadPatches( lump_t *surfs, lump_t *verts ) {
 	vec3_t points[MAX_PATCH_VERTS];
 	int width, height;
 	int shaderNum;
+	int numPatches;
+	patchCollide_t  *cached;
+#ifndef BSPC
+	int start;
+#endif
 
 	in = ( void * )( cmod_base + surfs->fileofs );
 	if ( surfs->filelen % sizeof( *in ) ) {
@@ -521,8 +845,28 @@ void CMod_LoadPatches( lump_t *surfs, lump_t *verts ) {
 		Com_Error( ERR_DROP, "MOD_LoadBmodel: funny lump size" );
 	}
 
+	numPatches = 0;
+	for ( i = 0 ; i < count ; i++ ) {
+		if ( LittleLong( in[i].surfaceType ) == MST_PATCH ) {
+			numPatches++;
+		}
+	}
+
+	cached = NULL;
+#ifndef BSPC
+	memset( &cm_patchStats, 0, sizeof( cm_patchStats ) );
+	if ( cm_cache->integer && numPatches ) {
+		start = Sys_Milliseconds();
+		cached = CM_ReadPatchCache( in, count, numPatches );
+		cm_patchStats.readMsec = Sys_Milliseconds() - start;
+		cm_patchStats.fromCache = ( cached != NULL );
+	}
+	start = Sys_Milliseconds();
+#endif
+
 	// scan through all the surfaces, but only load patches,
 	// not planar faces
+	numPatches = 0;
 	for ( i = 0 ; i < count ; i++, in++ ) {
 		if ( LittleLong( in->surfaceType ) != MST_PATCH ) {
 			continue;       // ignore other surfaces
@@ -531,6 +875,19 @@ void CMod_LoadPatches( lump_t *surfs, lump_t *verts ) {
 
 		cm.surfaces[ i ] = patch = Hunk_Alloc( sizeof( *patch ), h_high );
 
+		shaderNum = LittleLong( in->shaderNum );
+		patch->contents = cm.shaders[shaderNum].contentFlags;
+		patch->surfaceFlags = cm.shaders[shaderNum].surfaceFlags;
+
+		if ( cached
+#ifndef BSPC
+			 && cm_cache->integer != 2
+#endif
+			 ) {
+			patch->pc = &cached[numPatches++];
+			continue;
+		}
+
 		// load the full drawverts onto the stack
 		width = LittleLong( in->patchWidth );
 		height = LittleLong( in->patchHeight );
@@ -546,13 +903,38 @@ void CMod_LoadPatches( lump_t *surfs, lump_t *verts ) {
 			points[j][2] = LittleFloat( dv_p->xyz[2] );
 		}
 
-		shaderNum = LittleLong( in->shaderNum );
-		patch->contents = cm.shaders[shaderNum].contentFlags;
-		patch->surfaceFlags = cm.shaders[shaderNum].surfaceFlags;
-
 		// create the internal facet structure
 		patch->pc = CM_GeneratePatchCollide( width, height, points );
+
+#ifndef BSPC
+		if ( cached ) {
+			if ( !CM_ComparePatchCollide( patch->pc, &cached[numPatches] ) ) {
+				cm_patchStats.mismatches++;
+			}
+			patch->pc = &cached[numPatches];
+		}
+#endif
+		numPatches++;
+	}
+
+#ifndef BSPC
+	if ( !cached || cm_cache->integer == 2 ) {
+		cm_patchStats.generateMsec = Sys_Milliseconds() - start;
+	}
+	if ( cm_cache->integer && numPatches && !cached ) {
+		CM_WritePatchCache( count, numPatches );
 	}
+
+	cm_patchStats.numPatches = numPatches;
+	for ( i = 0 ; i < count ; i++ ) {
+		if ( cm.surfaces[i] ) {
+			cm_patchStats.numPlanes += cm.surfaces[i]->pc->numPlanes;
+			cm_patchStats.numFacets += cm.surfaces[i]->pc->numFacets;
+		}
+	}
+	Com_DPrintf( "%i patches %s in %i msec\n", numPatches, cached ? "read" : "generated",
+				 cached ? cm_patchStats.readMsec : cm_patchStats.generateMsec );
+#endif
 }
 
 //==================================================================
@@ -594,6 +976,16 @@ unsigned CM_Checksum( dheader_t *header ) {
 	return LittleLong( Com_BlockChecksum( checksums, 11 * 4 ) );
 }
 
+/*
+==================
+CM_AllocContextChecks
+==================
+*/
+static void CM_AllocContextChecks( cmTraceContext_t *tc ) {
+	tc->brushChecks = Hunk_Alloc( cm.numBrushes * sizeof( *tc->brushChecks ), h_high );
+	tc->patchChecks = Hunk_Alloc( cm.numSurfaces * sizeof( *tc->patchChecks ), h_high );
+}
+
 /*
 ==================
 CM_LoadMap
@@ -607,6 +999,9 @@ void CM_LoadMap( const char *name, qboolean clientload, int *checksum ) {
 	dheader_t header;
 	int length;
 	static unsigned last_checksum;
+#ifndef BSPC
+	char            *gamedir;
+#endif
 
 	if ( !name || !name[0] ) {
 		Com_Error( ERR_DROP, "CM_LoadMap: NULL name" );
@@ -616,6 +1011,8 @@ void CM_LoadMap( const char *name, qboolean clientload, int *checksum ) {
 	cm_noAreas = Cvar_Get( "cm_noAreas", "0", CVAR_CHEAT );
 	cm_noCurves = Cvar_Get( "cm_noCurves", "0", CVAR_CHEAT );
 	cm_playerCurveClip = Cvar_Get( "cm_playerCurveClip", "1", CVAR_ARCHIVE | CVAR_CHEAT );
+	cm_debugSurfaceUpdate = Cvar_Get( "r_debugSurfaceUpdate", "1", 0 );
+	cm_cache = Cvar_Get( "cm_cache", "1", CVAR_ARCHIVE );
 #endif
 	Com_DPrintf( "CM_LoadMap( %s, %i )\n", name, clientload );
 
@@ -627,6 +1024,13 @@ void CM_LoadMap( const char *name, qboolean clientload, int *checksum ) {
 	// free old stuff
 	memset( &cm, 0, sizeof( cm ) );
 	CM_ClearLevelPatches();
+	cm_loadCount++;
+	cm.context.loadCount = cm_loadCount;
+	CM_InitBoxHull( &cm.context );
+	for ( i = 0 ; i < CM_PACKET_RAYS - 1 ; i++ ) {
+		cm.packetContext[i].loadCount = cm_loadCount;
+		CM_InitBoxHull( &cm.packetContext[i] );
+	}
 
 	if ( !name[0] ) {
 		cm.numLeafs = 1;
@@ -653,6 +1057,15 @@ void CM_LoadMap( const char *name, qboolean clientload, int *checksum ) {
 	last_checksum = LittleLong( Com_BlockChecksum( buf, length ) );
 	*checksum = last_checksum;
 
+#ifndef BSPC
+	// FS_SV_ paths start at the home path, not the game directory
+	gamedir = Cvar_VariableString( "fs_game" );
+	Com_sprintf( cm_cacheName, sizeof( cm_cacheName ), "%s/%s", gamedir[0] ? gamedir : BASEGAME, name );
+	COM_StripExtension( cm_cacheName, cm_cacheName );
+	Q_strcat( cm_cacheName, sizeof( cm_cacheName ), ".cmc" );
+	cm_cacheChecksum = last_checksum;
+#endif
+
 	header = *(dheader_t *)buf;
 	for ( i = 0 ; i < sizeof( dheader_t ) / 4 ; i++ ) {
 		( (int *)&header )[i] = LittleLong( ( (int *)&header )[i] );
@@ -682,7 +1095,10 @@ void CM_LoadMap( const char *name, qboolean clientload, int *checksum ) {
 	// we are NOT freeing the file, because it is cached for the ref
 	FS_FreeFile( buf );
 
-	CM_InitBoxHull();
+	CM_AllocContextChecks( &cm.context );
+	for ( i = 0 ; i < CM_PACKET_RAYS - 1 ; i++ ) {
+		CM_AllocContextChecks( &cm.packetContext[i] );
+	}
 
 	CM_FloodAreaConnections();
 
@@ -700,6 +1116,9 @@ CM_ClearMap
 void CM_ClearMap( void ) {
 	Com_Memset( &cm, 0, sizeof( cm ) );
 	CM_ClearLevelPatches();
+	cm_loadCount++;
+	cm.context.loadCount = cm_loadCount;
+	CM_InitBoxHull( &cm.context );
 }
 
 /*
@@ -715,7 +1134,7 @@ cmodel_t    *CM_ClipHandleToModel( clipHandle_t handle ) {
 		return &cm.cmodels[handle];
 	}
 	if ( handle == BOX_MODEL_HANDLE || handle == CAPSULE_MODEL_HANDLE ) {
-		return &box_model;
+		return &cm.context.boxModel;
 	}
 	if ( handle < MAX_SUBMODELS ) {
 		Com_Error( ERR_DROP, "CM_ClipHandleToModel: bad handle %i < %i < %i",
@@ -727,6 +1146,20 @@ cmodel_t    *CM_ClipHandleToModel( clipHandle_t handle ) {
 
 }
 
+/*
+==================
+CM_ContextModel
+
+Box and capsule handles are the temp box of the context
+==================
+*/
+cmodel_t    *CM_ContextModel( cmTraceContext_t *tc, clipHandle_t handle ) {
+	if ( handle == BOX_MODEL_HANDLE || handle == CAPSULE_MODEL_HANDLE ) {
+		return &tc->boxModel;
+	}
+	return CM_ClipHandleToModel( handle );
+}
+
 /*
 ==================
 CM_InlineModel
@@ -772,45 +1205,37 @@ int     CM_LeafArea( int leafnum ) {
 ===================
 CM_InitBoxHull
 
-Set up the planes and nodes so that the six floats of a bounding box
-can just be stored out and get a proper clipping hull structure.
+Set up the planes and sides so that the six floats of a bounding box
+can just be stored out and get a proper clipping brush.
 ===================
 */
-void CM_InitBoxHull( void ) {
+void CM_InitBoxHull( cmTraceContext_t *tc ) {
 	int i;
 	int side;
 	cplane_t    *p;
 	cbrushside_t    *s;
 
-	box_planes = &cm.planes[cm.numPlanes];
-
-	box_brush = &cm.brushes[cm.numBrushes];
-	box_brush->numsides = 6;
-	box_brush->sides = cm.brushsides + cm.numBrushSides;
-	box_brush->contents = CONTENTS_BODY;
-
-	box_model.leaf.numLeafBrushes = 1;
-//	box_model.leaf.firstLeafBrush = cm.numBrushes;
-	box_model.leaf.firstLeafBrush = cm.numLeafBrushes;
-	cm.leafbrushes[cm.numLeafBrushes] = cm.numBrushes;
+	tc->boxBrush.numsides = 6;
+	tc->boxBrush.sides = tc->boxSides;
+	tc->boxBrush.contents = CONTENTS_BODY;
 
 	for ( i = 0 ; i < 6 ; i++ )
 	{
 		side = i & 1;
 
 		// brush sides
-		s = &cm.brushsides[cm.numBrushSides + i];
-		s->plane =  cm.planes + ( cm.numPlanes + i * 2 + side );
+		s = &tc->boxSides[i];
+		s->plane = &tc->boxPlanes[i * 2 + side];
 		s->surfaceFlags = 0;
 
 		// planes
-		p = &box_planes[i * 2];
+		p = &tc->boxPlanes[i * 2];
 		p->type = i >> 1;
 		p->signbits = 0;
 		VectorClear( p->normal );
 		p->normal[i >> 1] = 1;
 
-		p = &box_planes[i * 2 + 1];
+		p = &tc->boxPlanes[i * 2 + 1];
 		p->type = 3 + ( i >> 1 );
 		p->signbits = 0;
 		VectorClear( p->normal );
@@ -825,34 +1250,40 @@ void CM_InitBoxHull( void ) {
 CM_TempBoxModel
 
 To keep everything totally uniform, bounding boxes are turned into small
-BSP trees instead of being compared directly.
+brushes instead of being compared directly.
 Capsules are handled differently though.
 ===================
 */
 clipHandle_t CM_TempBoxModel( const vec3_t mins, const vec3_t maxs, int capsule ) {
+	return CM_TempBoxModelContext( &cm.context, mins, maxs, capsule );
+}
+
+clipHandle_t CM_TempBoxModelContext( cmTraceContext_t *tc, const vec3_t mins, const vec3_t maxs, int capsule ) {
+	cplane_t    *p;
 
-	VectorCopy( mins, box_model.mins );
-	VectorCopy( maxs, box_model.maxs );
+	VectorCopy( mins, tc->boxModel.mins );
+	VectorCopy( maxs, tc->boxModel.maxs );
 
 	if ( capsule ) {
 		return CAPSULE_MODEL_HANDLE;
 	}
 
-	box_planes[0].dist = maxs[0];
-	box_planes[1].dist = -maxs[0];
-	box_planes[2].dist = mins[0];
-	box_planes[3].dist = -mins[0];
-	box_planes[4].dist = maxs[1];
-	box_planes[5].dist = -maxs[1];
-	box_planes[6].dist = mins[1];
-	box_planes[7].dist = -mins[1];
-	box_planes[8].dist = maxs[2];
-	box_planes[9].dist = -maxs[2];
-	box_planes[10].dist = mins[2];
-	box_planes[11].dist = -mins[2];
-
-	VectorCopy( mins, box_brush->bounds[0] );
-	VectorCopy( maxs, box_brush->bounds[1] );
+	p = tc->boxPlanes;
+	p[0].dist = maxs[0];
+	p[1].dist = -maxs[0];
+	p[2].dist = mins[0];
+	p[3].dist = -mins[0];
+	p[4].dist = maxs[1];
+	p[5].dist = -maxs[1];
+	p[6].dist = mins[1];
+	p[7].dist = -mins[1];
+	p[8].dist = maxs[2];
+	p[9].dist = -maxs[2];
+	p[10].dist = mins[2];
+	p[11].dist = -mins[2];
+
+	VectorCopy( mins, tc->boxBrush.bounds[0] );
+	VectorCopy( maxs, tc->boxBrush.bounds[1] );
 
 	return BOX_MODEL_HANDLE;
 }
@@ -860,10 +1291,57 @@ clipHandle_t CM_TempBoxModel( const vec3_t mins, const vec3_t maxs, int capsule
 // DHM - Nerve
 void CM_SetTempBoxModelContents( int contents ) {
 
-	box_brush->contents = contents;
+	cm.context.boxBrush.contents = contents;
 }
 // dhm
 
+void CM_SetTempBoxModelContentsContext( cmTraceContext_t *tc, int contents ) {
+	tc->boxBrush.contents = contents;
+}
+
+#ifndef BSPC
+/*
+===================
+CM_AllocTraceContext
+
+Main thread only, the checkcount arrays come in the same block
+===================
+*/
+cmTraceContext_t *CM_AllocTraceContext( void ) {
+	cmTraceContext_t    *tc;
+
+	tc = Z_Malloc( sizeof( *tc ) + ( cm.numBrushes + cm.numSurfaces ) * sizeof( int ) );
+	tc->brushChecks = (int *)( tc + 1 );
+	tc->patchChecks = tc->brushChecks + cm.numBrushes;
+	tc->loadCount = cm_loadCount;
+	CM_InitBoxHull( tc );
+
+	return tc;
+}
+
+/*
+===================
+CM_FreeTraceContext
+===================
+*/
+void CM_FreeTraceContext( cmTraceContext_t *tc ) {
+	Z_Free( tc );
+}
+#endif
+
+/*
+===================
+CM_CheckTraceContext
+
+A context sized for another map would index past its arrays
+===================
+*/
+void CM_CheckTraceContext( cmTraceContext_t *tc ) {
+	if ( tc->loadCount != cm_loadCount ) {
+		Com_Error( ERR_DROP, "CM_CheckTraceContext: context is from a previous map" );
+	}
+}
+
 /*
 ===================
 CM_ModelBounds
@@ -74,12 +74,10 @@ typedef struct {
 	vec3_t bounds[2];
 	int numsides;
 	cbrushside_t    *sides;
-	int checkcount;             // to avoid repeated testings
 } cbrush_t;
 
 
 typedef struct {
-	int checkcount;                     // to avoid repeated testings
 	int surfaceFlags;
 	int contents;
 	struct patchCollide_s   *pc;
@@ -91,6 +89,24 @@ typedef struct {
 	int floodvalid;
 } cArea_t;
 
+// everything a collision query writes to, so that queries made through
+// different contexts can run on different threads at the same time
+struct cmTraceContext_s {
+	int checkcount;                     // incremented on each query
+	int         *brushChecks;           // [numBrushes] checkcount of the last query that tested each brush
+	int         *patchChecks;           // [numSurfaces] the same for patches
+	int loadCount;                      // the map the arrays were sized for
+
+	// the temp box model, built from the box bounds on each use
+	cmodel_t boxModel;
+	cbrush_t boxBrush;
+	cbrushside_t boxSides[6];
+	cplane_t boxPlanes[12];
+};
+
+// rays walked down the tree together by CM_BoxTraceBatch
+#define CM_PACKET_RAYS      4
+
 typedef struct {
 	char name[MAX_QPATH];
 
@@ -137,7 +153,8 @@ typedef struct {
 	cPatch_t    **surfaces;         // non-patches will be NULL
 
 	int floodvalid;
-	int checkcount;                         // incremented on each trace
+	cmTraceContext_t context;               // for the calls that don't take a context
+	cmTraceContext_t packetContext[CM_PACKET_RAYS - 1];    // the other rays of a packet
 } clipMap_t;
 
 
@@ -151,6 +168,7 @@ extern int c_traces, c_brush_traces, c_patch_traces;
 extern cvar_t      *cm_noAreas;
 extern cvar_t      *cm_noCurves;
 extern cvar_t      *cm_playerCurveClip;
+extern cvar_t      *cm_debugSurfaceUpdate;
 
 // cm_test.c
 
@@ -176,6 +194,7 @@ typedef struct {
 	qboolean isPoint;       // optimized case
 	trace_t trace;          // returned from trace call
 	sphere_t sphere;        // sphere for oriendted capsule collision
+	cmTraceContext_t *tc;   // checkcounts and temp box for this trace
 } traceWork_t;
 
 typedef struct leafList_s {
@@ -186,6 +205,7 @@ typedef struct leafList_s {
 	vec3_t bounds[2];
 	int lastLeaf;           // for overflows where each leaf can't be stored individually
 	void ( *storeLeafs )( struct leafList_s *ll, int nodenum );
+	cmTraceContext_t *tc;   // checkcounts for storeLeafs functions that need them
 } leafList_t;
 
 
@@ -197,6 +217,8 @@ void CM_StoreBrushes( leafList_t *ll, int nodenum );
 void CM_BoxLeafnums_r( leafList_t *ll, int nodenum );
 
 cmodel_t    *CM_ClipHandleToModel( clipHandle_t handle );
+cmodel_t    *CM_ContextModel( cmTraceContext_t *tc, clipHandle_t handle );
+void        CM_CheckTraceContext( cmTraceContext_t *tc );
 
 // cm_patch.c
 
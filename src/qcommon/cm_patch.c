@@ -1362,9 +1362,6 @@ void CM_TracePointThroughPatchCollide( traceWork_t *tw, const struct patchCollid
 	int i, j, k;
 	float offset;
 	float d1, d2;
-#ifndef BSPC
-	static cvar_t *cv;
-#endif //BSPC
 
 #ifndef BSPC
 	if ( !cm_playerCurveClip->integer && !tw->isPoint ) {
@@ -1422,10 +1419,8 @@ void CM_TracePointThroughPatchCollide( traceWork_t *tw, const struct patchCollid
 		if ( j == facet->numBorders ) {
 			// we hit this facet
 #ifndef BSPC
-			if ( !cv ) {
-				cv = Cvar_Get( "r_debugSurfaceUpdate", "1", 0 );
-			}
-			if ( cv->integer ) {
+			// only the main context feeds the debug view, other threads would race on it
+			if ( cm_debugSurfaceUpdate->integer && tw->tc == &cm.context ) {
 				debugPatchCollide = pc;
 				debugFacet = facet;
 			}
@@ -1507,9 +1502,6 @@ void CM_TraceThroughPatchCollide( traceWork_t *tw, const struct patchCollide_s *
 	facet_t *facet;
 	float plane[4], bestplane[4];
 	vec3_t startp, endp;
-#ifndef BSPC
-	static cvar_t *cv;
-#endif //BSPC
 
 	if ( tw->isPoint ) {
 		CM_TracePointThroughPatchCollide( tw, pc );
@@ -1610,10 +1602,7 @@ void CM_TraceThroughPatchCollide( traceWork_t *tw, const struct patchCollide_s *
 					enterFrac = 0;
 				}
 #ifndef BSPC
-				if ( !cv ) {
-					cv = Cvar_Get( "r_debugSurfaceUpdate", "1", 0 );
-				}
-				if ( cv && cv->integer ) {
+				if ( cm_debugSurfaceUpdate->integer && tw->tc == &cm.context ) {
 					debugPatchCollide = pc;
 					debugFacet = facet;
 				}
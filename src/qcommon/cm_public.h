@@ -38,6 +38,18 @@ clipHandle_t CM_InlineModel( int index );       // 0 = world, 1 + are bmodels
 clipHandle_t CM_TempBoxModel( const vec3_t mins, const vec3_t maxs, int capsule );
 void        CM_SetTempBoxModelContents( int contents );     // DHM - Nerve
 
+// the box models, trace and point contents calls below all share one set of
+// checkcounts and one temp box, so they can only be used from the main thread.
+// The Context versions work on a context of their own instead, and any number
+// of threads can run queries at the same time as long as each has a context.
+// A context is only good for the map that was loaded when it was allocated.
+typedef struct cmTraceContext_s cmTraceContext_t;
+
+cmTraceContext_t *CM_AllocTraceContext( void );
+void        CM_FreeTraceContext( cmTraceContext_t *tc );
+clipHandle_t CM_TempBoxModelContext( cmTraceContext_t *tc, const vec3_t mins, const vec3_t maxs, int capsule );
+void        CM_SetTempBoxModelContentsContext( cmTraceContext_t *tc, int contents );
+
 void        CM_ModelBounds( clipHandle_t model, vec3_t mins, vec3_t maxs );
 
 int         CM_NumClusters( void );
@@ -47,6 +59,8 @@ char        *CM_EntityString( void );
 // returns an ORed contents mask
 int         CM_PointContents( const vec3_t p, clipHandle_t model );
 int         CM_TransformedPointContents( const vec3_t p, clipHandle_t model, const vec3_t origin, const vec3_t angles );
+int         CM_TransformedPointContentsContext( cmTraceContext_t *tc, const vec3_t p, clipHandle_t model,
+												const vec3_t origin, const vec3_t angles );
 
 void        CM_BoxTrace( trace_t *results, const vec3_t start, const vec3_t end,
 						 const vec3_t mins, const vec3_t maxs,
@@ -55,6 +69,19 @@ void        CM_TransformedBoxTrace( trace_t *results, const vec3_t start, const
 									const vec3_t mins, const vec3_t maxs,
 									clipHandle_t model, int brushmask,
 									const vec3_t origin, const vec3_t angles, int capsule );
+void        CM_BoxTraceContext( cmTraceContext_t *tc, trace_t *results, const vec3_t start, const vec3_t end,
+								const vec3_t mins, const vec3_t maxs,
+								clipHandle_t model, int brushmask, int capsule );
+void        CM_TransformedBoxTraceContext( cmTraceContext_t *tc, trace_t *results, const vec3_t start, const vec3_t end,
+										   const vec3_t mins, const vec3_t maxs,
+										   clipHandle_t model, int brushmask,
+										   const vec3_t origin, const vec3_t angles, int capsule );
+// world only traces for a burst of rays with the same box, walked through
+// the tree several rays at a time, the results match CM_BoxTrace exactly
+void        CM_BoxTraceBatch( trace_t *results, int count, const vec3_t *starts, const vec3_t *ends,
+							  const vec3_t mins, const vec3_t maxs, int brushmask );
+void        CM_TraceTest_f( void );
+void        CM_PatchCache_f( void );
 
 byte        *CM_ClusterPVS( int cluster );
 
@@ -62,6 +89,7 @@ int         CM_PointLeafnum( const vec3_t p );
 
 // only returns non-solid leafs
 // overflow if return listsize and if *lastLeaf != list[listsize-1]
+// doesn't write to anything shared, so it is safe from any thread
 int         CM_BoxLeafnums( const vec3_t mins, const vec3_t maxs, int *list,
 							int listsize, int *lastLeaf );
 
@@ -110,10 +110,10 @@ void CM_StoreBrushes( leafList_t *ll, int nodenum ) {
 	for ( k = 0 ; k < leaf->numLeafBrushes ; k++ ) {
 		brushnum = cm.leafbrushes[leaf->firstLeafBrush + k];
 		b = &cm.brushes[brushnum];
-		if ( b->checkcount == cm.checkcount ) {
+		if ( ll->tc->brushChecks[brushnum] == ll->tc->checkcount ) {
 			continue;   // already checked this brush in another leaf
 		}
-		b->checkcount = cm.checkcount;
+		ll->tc->brushChecks[brushnum] = ll->tc->checkcount;
 		for ( i = 0 ; i < 3 ; i++ ) {
 			if ( b->bounds[0][i] >= ll->bounds[1][i] || b->bounds[1][i] <= ll->bounds[0][i] ) {
 				break;
@@ -181,8 +181,6 @@ CM_BoxLeafnums
 int CM_BoxLeafnums( const vec3_t mins, const vec3_t maxs, int *list, int listsize, int *lastLeaf ) {
 	leafList_t ll;
 
-	cm.checkcount++;
-
 	VectorCopy( mins, ll.bounds[0] );
 	VectorCopy( maxs, ll.bounds[1] );
 	ll.count = 0;
@@ -191,6 +189,7 @@ int CM_BoxLeafnums( const vec3_t mins, const vec3_t maxs, int *list, int listsiz
 	ll.storeLeafs = CM_StoreLeafs;
 	ll.lastLeaf = 0;
 	ll.overflowed = qfalse;
+	ll.tc = NULL;   // leafs don't need the checkcount
 
 	CM_BoxLeafnums_r( &ll, 0 );
 
@@ -206,7 +205,7 @@ CM_BoxBrushes
 int CM_BoxBrushes( const vec3_t mins, const vec3_t maxs, cbrush_t **list, int listsize ) {
 	leafList_t ll;
 
-	cm.checkcount++;
+	cm.context.checkcount++;
 
 	VectorCopy( mins, ll.bounds[0] );
 	VectorCopy( maxs, ll.bounds[1] );
@@ -216,6 +215,7 @@ int CM_BoxBrushes( const vec3_t mins, const vec3_t maxs, cbrush_t **list, int li
 	ll.storeLeafs = CM_StoreBrushes;
 	ll.lastLeaf = 0;
 	ll.overflowed = qfalse;
+	ll.tc = &cm.context;
 
 	CM_BoxLeafnums_r( &ll, 0 );
 
@@ -228,24 +228,47 @@ int CM_BoxBrushes( const vec3_t mins, const vec3_t maxs, cbrush_t **list, int li
 
 /*
 ==================
-CM_PointContents
+CM_PointContentsInBrush
+==================
+*/
+static int CM_PointContentsInBrush( const vec3_t p, const cbrush_t *b ) {
+	int i;
+	float d;
+
+	// see if the point is in the brush
+	for ( i = 0 ; i < b->numsides ; i++ ) {
+		d = DotProduct( p, b->sides[i].plane->normal );
+// FIXME test for Cash
+//			if ( d >= b->sides[i].plane->dist ) {
+		if ( d > b->sides[i].plane->dist ) {
+			return 0;
+		}
+	}
+
+	return b->contents;
+}
+
+/*
+==================
+CM_ContextPointContents
 
 ==================
 */
-int CM_PointContents( const vec3_t p, clipHandle_t model ) {
+static int CM_ContextPointContents( cmTraceContext_t *tc, const vec3_t p, clipHandle_t model ) {
 	int leafnum;
-	int i, k;
-	int brushnum;
+	int k;
 	cLeaf_t     *leaf;
-	cbrush_t    *b;
 	int contents;
-	float d;
 	cmodel_t    *clipm;
 
 	if ( !cm.numNodes ) { // map not loaded
 		return 0;
 	}
 
+	if ( model == BOX_MODEL_HANDLE || model == CAPSULE_MODEL_HANDLE ) {
+		return CM_PointContentsInBrush( p, &tc->boxBrush );
+	}
+
 	if ( model ) {
 		clipm = CM_ClipHandleToModel( model );
 		leaf = &clipm->leaf;
@@ -256,27 +279,22 @@ int CM_PointContents( const vec3_t p, clipHandle_t model ) {
 
 	contents = 0;
 	for ( k = 0 ; k < leaf->numLeafBrushes ; k++ ) {
-		brushnum = cm.leafbrushes[leaf->firstLeafBrush + k];
-		b = &cm.brushes[brushnum];
-
-		// see if the point is in the brush
-		for ( i = 0 ; i < b->numsides ; i++ ) {
-			d = DotProduct( p, b->sides[i].plane->normal );
-// FIXME test for Cash
-//			if ( d >= b->sides[i].plane->dist ) {
-			if ( d > b->sides[i].plane->dist ) {
-				break;
-			}
-		}
-
-		if ( i == b->numsides ) {
-			contents |= b->contents;
-		}
+		contents |= CM_PointContentsInBrush( p, &cm.brushes[cm.leafbrushes[leaf->firstLeafBrush + k]] );
 	}
 
 	return contents;
 }
 
+/*
+==================
+CM_PointContents
+
+==================
+*/
+int CM_PointContents( const vec3_t p, clipHandle_t model ) {
+	return CM_ContextPointContents( &cm.context, p, model );
+}
+
 /*
 ==================
 CM_TransformedPointContents
@@ -286,10 +304,22 @@ rotating entities
 ==================
 */
 int CM_TransformedPointContents( const vec3_t p, clipHandle_t model, const vec3_t origin, const vec3_t angles ) {
+	return CM_TransformedPointContentsContext( &cm.context, p, model, origin, angles );
+}
+
+/*
+==================
+CM_TransformedPointContentsContext
+==================
+*/
+int CM_TransformedPointContentsContext( cmTraceContext_t *tc, const vec3_t p, clipHandle_t model,
+										const vec3_t origin, const vec3_t angles ) {
 	vec3_t p_l;
 	vec3_t temp;
 	vec3_t forward, right, up;
 
+	CM_CheckTraceContext( tc );
+
 	// subtract origin offset
 	VectorSubtract( p, origin, p_l );
 
@@ -304,7 +334,7 @@ int CM_TransformedPointContents( const vec3_t p, clipHandle_t model, const vec3_
 		p_l[2] = DotProduct( temp, up );
 	}
 
-	return CM_PointContents( p_l, model );
+	return CM_ContextPointContents( tc, p_l, model );
 }
 
 
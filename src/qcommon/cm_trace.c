@@ -27,6 +27,9 @@ If you have questions concerning this license or the applicable additional terms
 */
 
 #include "cm_local.h"
+#ifndef BSPC
+#include "threads.h"
+#endif
 
 // always use bbox vs. bbox collision and never capsule vs. bbox or vice versa
 //#define ALWAYS_BBOX_VS_BBOX
@@ -249,7 +252,7 @@ CM_TestInLeaf
 */
 void CM_TestInLeaf( traceWork_t *tw, cLeaf_t *leaf ) {
 	int k;
-	int brushnum;
+	int brushnum, surfnum;
 	cbrush_t    *b;
 	cPatch_t    *patch;
 
@@ -257,10 +260,10 @@ void CM_TestInLeaf( traceWork_t *tw, cLeaf_t *leaf ) {
 	for ( k = 0 ; k < leaf->numLeafBrushes ; k++ ) {
 		brushnum = cm.leafbrushes[leaf->firstLeafBrush + k];
 		b = &cm.brushes[brushnum];
-		if ( b->checkcount == cm.checkcount ) {
+		if ( tw->tc->brushChecks[brushnum] == tw->tc->checkcount ) {
 			continue;   // already checked this brush in another leaf
 		}
-		b->checkcount = cm.checkcount;
+		tw->tc->brushChecks[brushnum] = tw->tc->checkcount;
 
 		if ( !( b->contents & tw->contents ) ) {
 			continue;
@@ -279,14 +282,15 @@ void CM_TestInLeaf( traceWork_t *tw, cLeaf_t *leaf ) {
 	if ( !cm_noCurves->integer ) {
 #endif //BSPC
 		for ( k = 0 ; k < leaf->numLeafSurfaces ; k++ ) {
-			patch = cm.surfaces[ cm.leafsurfaces[ leaf->firstLeafSurface + k ] ];
+			surfnum = cm.leafsurfaces[ leaf->firstLeafSurface + k ];
+			patch = cm.surfaces[ surfnum ];
 			if ( !patch ) {
 				continue;
 			}
-			if ( patch->checkcount == cm.checkcount ) {
+			if ( tw->tc->patchChecks[surfnum] == tw->tc->checkcount ) {
 				continue;   // already checked this brush in another leaf
 			}
-			patch->checkcount = cm.checkcount;
+			tw->tc->patchChecks[surfnum] = tw->tc->checkcount;
 
 			if ( !( patch->contents & tw->contents ) ) {
 				continue;
@@ -301,6 +305,19 @@ void CM_TestInLeaf( traceWork_t *tw, cLeaf_t *leaf ) {
 	}
 }
 
+/*
+================
+CM_TestInBoxModel
+
+The temp box is a single brush kept in the trace context
+================
+*/
+static void CM_TestInBoxModel( traceWork_t *tw ) {
+	if ( tw->tc->boxBrush.contents & tw->contents ) {
+		CM_TestBoxInBrush( tw, &tw->tc->boxBrush );
+	}
+}
+
 /*
 ==================
 CM_TestCapsuleInCapsule
@@ -316,7 +333,8 @@ void CM_TestCapsuleInCapsule( traceWork_t *tw, clipHandle_t model ) {
 	vec3_t offset, symetricSize[2];
 	float radius, halfwidth, halfheight, offs, r;
 
-	CM_ModelBounds( model, mins, maxs );
+	VectorCopy( tw->tc->boxModel.mins, mins );
+	VectorCopy( tw->tc->boxModel.maxs, maxs );
 
 	VectorAdd( tw->start, tw->sphere.offset, top );
 	VectorSubtract( tw->start, tw->sphere.offset, bottom );
@@ -379,12 +397,11 @@ bounding box inside capsule check
 */
 void CM_TestBoundingBoxInCapsule( traceWork_t *tw, clipHandle_t model ) {
 	vec3_t mins, maxs, offset, size[2];
-	clipHandle_t h;
-	cmodel_t *cmod;
 	int i;
 
 	// mins maxs of the capsule
-	CM_ModelBounds( model, mins, maxs );
+	VectorCopy( tw->tc->boxModel.mins, mins );
+	VectorCopy( tw->tc->boxModel.maxs, maxs );
 
 	// offset for capsule center
 	for ( i = 0 ; i < 3 ; i++ ) {
@@ -402,10 +419,9 @@ void CM_TestBoundingBoxInCapsule( traceWork_t *tw, clipHandle_t model ) {
 	VectorSet( tw->sphere.offset, 0, 0, size[1][2] - tw->sphere.radius );
 
 	// replace the capsule with the bounding box
-	h = CM_TempBoxModel( tw->size[0], tw->size[1], qfalse );
+	CM_TempBoxModelContext( tw->tc, tw->size[0], tw->size[1], qfalse );
 	// calculate collision
-	cmod = CM_ClipHandleToModel( h );
-	CM_TestInLeaf( tw, &cmod->leaf );
+	CM_TestInBoxModel( tw );
 }
 
 /*
@@ -434,14 +450,10 @@ void CM_PositionTest( traceWork_t *tw ) {
 	ll.storeLeafs = CM_StoreLeafs;
 	ll.lastLeaf = 0;
 	ll.overflowed = qfalse;
-
-	cm.checkcount++;
+	ll.tc = tw->tc;
 
 	CM_BoxLeafnums_r( &ll, 0 );
 
-
-	cm.checkcount++;
-
 	// test the contents of the leafs
 	for ( i = 0 ; i < ll.count ; i++ ) {
 		CM_TestInLeaf( tw, &cm.leafs[leafs[i]] );
@@ -469,7 +481,9 @@ CM_TraceThroughPatch
 void CM_TraceThroughPatch( traceWork_t *tw, cPatch_t *patch ) {
 	float oldFrac;
 
-	c_patch_traces++;
+	if ( tw->tc == &cm.context ) {
+		c_patch_traces++;
+	}
 
 	oldFrac = tw->trace.fraction;
 
@@ -507,7 +521,9 @@ void CM_TraceThroughBrush( traceWork_t *tw, cbrush_t *brush ) {
 		return;
 	}
 
-	c_brush_traces++;
+	if ( tw->tc == &cm.context ) {
+		c_brush_traces++;
+	}
 
 	getout = qfalse;
 	startout = qfalse;
@@ -668,7 +684,7 @@ CM_TraceThroughLeaf
 */
 void CM_TraceThroughLeaf( traceWork_t *tw, cLeaf_t *leaf ) {
 	int k;
-	int brushnum;
+	int brushnum, surfnum;
 	cbrush_t    *b;
 	cPatch_t    *patch;
 
@@ -677,10 +693,10 @@ void CM_TraceThroughLeaf( traceWork_t *tw, cLeaf_t *leaf ) {
 		brushnum = cm.leafbrushes[leaf->firstLeafBrush + k];
 
 		b = &cm.brushes[brushnum];
-		if ( b->checkcount == cm.checkcount ) {
+		if ( tw->tc->brushChecks[brushnum] == tw->tc->checkcount ) {
 			continue;   // already checked this brush in another leaf
 		}
-		b->checkcount = cm.checkcount;
+		tw->tc->brushChecks[brushnum] = tw->tc->checkcount;
 
 		if ( !( b->contents & tw->contents ) ) {
 			continue;
@@ -699,14 +715,15 @@ void CM_TraceThroughLeaf( traceWork_t *tw, cLeaf_t *leaf ) {
 	if ( !cm_noCurves->integer ) {
 #endif
 		for ( k = 0 ; k < leaf->numLeafSurfaces ; k++ ) {
-			patch = cm.surfaces[ cm.leafsurfaces[ leaf->firstLeafSurface + k ] ];
+			surfnum = cm.leafsurfaces[ leaf->firstLeafSurface + k ];
+			patch = cm.surfaces[ surfnum ];
 			if ( !patch ) {
 				continue;
 			}
-			if ( patch->checkcount == cm.checkcount ) {
+			if ( tw->tc->patchChecks[surfnum] == tw->tc->checkcount ) {
 				continue;   // already checked this patch in another leaf
 			}
-			patch->checkcount = cm.checkcount;
+			tw->tc->patchChecks[surfnum] = tw->tc->checkcount;
 
 			if ( !( patch->contents & tw->contents ) ) {
 				continue;
@@ -720,6 +737,17 @@ void CM_TraceThroughLeaf( traceWork_t *tw, cLeaf_t *leaf ) {
 	}
 }
 
+/*
+================
+CM_TraceThroughBoxModel
+================
+*/
+static void CM_TraceThroughBoxModel( traceWork_t *tw ) {
+	if ( tw->tc->boxBrush.contents & tw->contents ) {
+		CM_TraceThroughBrush( tw, &tw->tc->boxBrush );
+	}
+}
+
 #define RADIUS_EPSILON      1.0f
 
 /*
@@ -921,7 +949,8 @@ void CM_TraceCapsuleThroughCapsule( traceWork_t *tw, clipHandle_t model ) {
 	vec3_t offset, symetricSize[2];
 	float radius, halfwidth, halfheight, offs, h;
 
-	CM_ModelBounds( model, mins, maxs );
+	VectorCopy( tw->tc->boxModel.mins, mins );
+	VectorCopy( tw->tc->boxModel.maxs, maxs );
 	// test trace bounds vs. capsule bounds
 	if ( tw->bounds[0][0] > maxs[0] + RADIUS_EPSILON
 		 || tw->bounds[0][1] > maxs[1] + RADIUS_EPSILON
@@ -978,12 +1007,11 @@ bounding box vs. capsule collision
 */
 void CM_TraceBoundingBoxThroughCapsule( traceWork_t *tw, clipHandle_t model ) {
 	vec3_t mins, maxs, offset, size[2];
-	clipHandle_t h;
-	cmodel_t *cmod;
 	int i;
 
 	// mins maxs of the capsule
-	CM_ModelBounds( model, mins, maxs );
+	VectorCopy( tw->tc->boxModel.mins, mins );
+	VectorCopy( tw->tc->boxModel.maxs, maxs );
 
 	// offset for capsule center
 	for ( i = 0 ; i < 3 ; i++ ) {
@@ -1001,10 +1029,9 @@ void CM_TraceBoundingBoxThroughCapsule( traceWork_t *tw, clipHandle_t model ) {
 	VectorSet( tw->sphere.offset, 0, 0, size[1][2] - tw->sphere.radius );
 
 	// replace the capsule with the bounding box
-	h = CM_TempBoxModel( tw->size[0], tw->size[1], qfalse );
+	CM_TempBoxModelContext( tw->tc, tw->size[0], tw->size[1], qfalse );
 	// calculate collision
-	cmod = CM_ClipHandleToModel( h );
-	CM_TraceThroughLeaf( tw, &cmod->leaf );
+	CM_TraceThroughBoxModel( tw );
 }
 
 //=========================================================================================
@@ -1140,125 +1167,161 @@ void CM_TraceThroughTree( traceWork_t *tw, int num, float p1f, float p2f, vec3_t
 
 /*
 ==================
-CM_Trace
+CM_TraceWorkInit
+
+Sets up everything but the results for a trace
 ==================
 */
-void CM_Trace( trace_t *results, const vec3_t start, const vec3_t end,
-			   const vec3_t mins, const vec3_t maxs,
-			   clipHandle_t model, const vec3_t origin, int brushmask, int capsule, sphere_t *sphere ) {
+static void CM_TraceWorkInit( traceWork_t *tw, const vec3_t start, const vec3_t end,
+							  const vec3_t mins, const vec3_t maxs, int brushmask, int capsule, sphere_t *sphere ) {
 	int i;
-	traceWork_t tw;
 	vec3_t offset;
-	cmodel_t    *cmod;
-
-	cmod = CM_ClipHandleToModel( model );
-
-	cm.checkcount++;        // for multi-check avoidance
-
-	c_traces++;             // for statistics, may be zeroed
-
-	// fill in a default trace
-	memset( &tw, 0, sizeof( tw ) );
-	tw.trace.fraction = 1;  // assume it goes the entire distance until shown otherwise
-	VectorCopy( origin, tw.modelOrigin );
-
-	if ( !cm.numNodes ) {
-		*results = tw.trace;
-
-		return; // map not loaded, shouldn't happen
-	}
-
-	// allow NULL to be passed in for 0,0,0
-	if ( !mins ) {
-		mins = vec3_origin;
-	}
-	if ( !maxs ) {
-		maxs = vec3_origin;
-	}
 
 	// set basic parms
-	tw.contents = brushmask;
+	tw->contents = brushmask;
 
 	// adjust so that mins and maxs are always symetric, which
 	// avoids some complications with plane expanding of rotated
 	// bmodels
 	for ( i = 0 ; i < 3 ; i++ ) {
 		offset[i] = ( mins[i] + maxs[i] ) * 0.5;
-		tw.size[0][i] = mins[i] - offset[i];
-		tw.size[1][i] = maxs[i] - offset[i];
-		tw.start[i] = start[i] + offset[i];
-		tw.end[i] = end[i] + offset[i];
+		tw->size[0][i] = mins[i] - offset[i];
+		tw->size[1][i] = maxs[i] - offset[i];
+		tw->start[i] = start[i] + offset[i];
+		tw->end[i] = end[i] + offset[i];
 	}
 
 	// if a sphere is already specified
 	if ( sphere ) {
-		tw.sphere = *sphere;
+		tw->sphere = *sphere;
 	} else {
-		tw.sphere.use = capsule;
-		tw.sphere.radius = ( tw.size[1][0] > tw.size[1][2] ) ? tw.size[1][2] : tw.size[1][0];
-		tw.sphere.halfheight = tw.size[1][2];
-		VectorSet( tw.sphere.offset, 0, 0, tw.size[1][2] - tw.sphere.radius );
+		tw->sphere.use = capsule;
+		tw->sphere.radius = ( tw->size[1][0] > tw->size[1][2] ) ? tw->size[1][2] : tw->size[1][0];
+		tw->sphere.halfheight = tw->size[1][2];
+		VectorSet( tw->sphere.offset, 0, 0, tw->size[1][2] - tw->sphere.radius );
 	}
 
-	tw.maxOffset = tw.size[1][0] + tw.size[1][1] + tw.size[1][2];
+	tw->maxOffset = tw->size[1][0] + tw->size[1][1] + tw->size[1][2];
 
-	// tw.offsets[signbits] = vector to apropriate corner from origin
-	tw.offsets[0][0] = tw.size[0][0];
-	tw.offsets[0][1] = tw.size[0][1];
-	tw.offsets[0][2] = tw.size[0][2];
+	// tw->offsets[signbits] = vector to apropriate corner from origin
+	tw->offsets[0][0] = tw->size[0][0];
+	tw->offsets[0][1] = tw->size[0][1];
+	tw->offsets[0][2] = tw->size[0][2];
 
-	tw.offsets[1][0] = tw.size[1][0];
-	tw.offsets[1][1] = tw.size[0][1];
-	tw.offsets[1][2] = tw.size[0][2];
+	tw->offsets[1][0] = tw->size[1][0];
+	tw->offsets[1][1] = tw->size[0][1];
+	tw->offsets[1][2] = tw->size[0][2];
 
-	tw.offsets[2][0] = tw.size[0][0];
-	tw.offsets[2][1] = tw.size[1][1];
-	tw.offsets[2][2] = tw.size[0][2];
+	tw->offsets[2][0] = tw->size[0][0];
+	tw->offsets[2][1] = tw->size[1][1];
+	tw->offsets[2][2] = tw->size[0][2];
 
-	tw.offsets[3][0] = tw.size[1][0];
-	tw.offsets[3][1] = tw.size[1][1];
-	tw.offsets[3][2] = tw.size[0][2];
+	tw->offsets[3][0] = tw->size[1][0];
+	tw->offsets[3][1] = tw->size[1][1];
+	tw->offsets[3][2] = tw->size[0][2];
 
-	tw.offsets[4][0] = tw.size[0][0];
-	tw.offsets[4][1] = tw.size[0][1];
-	tw.offsets[4][2] = tw.size[1][2];
+	tw->offsets[4][0] = tw->size[0][0];
+	tw->offsets[4][1] = tw->size[0][1];
+	tw->offsets[4][2] = tw->size[1][2];
 
-	tw.offsets[5][0] = tw.size[1][0];
-	tw.offsets[5][1] = tw.size[0][1];
-	tw.offsets[5][2] = tw.size[1][2];
+	tw->offsets[5][0] = tw->size[1][0];
+	tw->offsets[5][1] = tw->size[0][1];
+	tw->offsets[5][2] = tw->size[1][2];
 
-	tw.offsets[6][0] = tw.size[0][0];
-	tw.offsets[6][1] = tw.size[1][1];
-	tw.offsets[6][2] = tw.size[1][2];
+	tw->offsets[6][0] = tw->size[0][0];
+	tw->offsets[6][1] = tw->size[1][1];
+	tw->offsets[6][2] = tw->size[1][2];
 
-	tw.offsets[7][0] = tw.size[1][0];
-	tw.offsets[7][1] = tw.size[1][1];
-	tw.offsets[7][2] = tw.size[1][2];
+	tw->offsets[7][0] = tw->size[1][0];
+	tw->offsets[7][1] = tw->size[1][1];
+	tw->offsets[7][2] = tw->size[1][2];
 
 	//
 	// calculate bounds
 	//
-	if ( tw.sphere.use ) {
+	if ( tw->sphere.use ) {
 		for ( i = 0 ; i < 3 ; i++ ) {
-			if ( tw.start[i] < tw.end[i] ) {
-				tw.bounds[0][i] = tw.start[i] - fabs( tw.sphere.offset[i] ) - tw.sphere.radius;
-				tw.bounds[1][i] = tw.end[i] + fabs( tw.sphere.offset[i] ) + tw.sphere.radius;
+			if ( tw->start[i] < tw->end[i] ) {
+				tw->bounds[0][i] = tw->start[i] - fabs( tw->sphere.offset[i] ) - tw->sphere.radius;
+				tw->bounds[1][i] = tw->end[i] + fabs( tw->sphere.offset[i] ) + tw->sphere.radius;
 			} else {
-				tw.bounds[0][i] = tw.end[i] - fabs( tw.sphere.offset[i] ) - tw.sphere.radius;
-				tw.bounds[1][i] = tw.start[i] + fabs( tw.sphere.offset[i] ) + tw.sphere.radius;
+				tw->bounds[0][i] = tw->end[i] - fabs( tw->sphere.offset[i] ) - tw->sphere.radius;
+				tw->bounds[1][i] = tw->start[i] + fabs( tw->sphere.offset[i] ) + tw->sphere.radius;
 			}
 		}
 	} else {
 		for ( i = 0 ; i < 3 ; i++ ) {
-			if ( tw.start[i] < tw.end[i] ) {
-				tw.bounds[0][i] = tw.start[i] + tw.size[0][i];
-				tw.bounds[1][i] = tw.end[i] + tw.size[1][i];
+			if ( tw->start[i] < tw->end[i] ) {
+				tw->bounds[0][i] = tw->start[i] + tw->size[0][i];
+				tw->bounds[1][i] = tw->end[i] + tw->size[1][i];
 			} else {
-				tw.bounds[0][i] = tw.end[i] + tw.size[0][i];
-				tw.bounds[1][i] = tw.start[i] + tw.size[1][i];
+				tw->bounds[0][i] = tw->end[i] + tw->size[0][i];
+				tw->bounds[1][i] = tw->start[i] + tw->size[1][i];
 			}
 		}
 	}
+}
+
+/*
+==================
+CM_TraceWorkFinish
+==================
+*/
+static void CM_TraceWorkFinish( traceWork_t *tw, trace_t *results, const vec3_t start, const vec3_t end ) {
+	int i;
+
+	// generate endpos from the original, unmodified start/end
+	if ( tw->trace.fraction == 1 ) {
+		VectorCopy( end, tw->trace.endpos );
+	} else {
+		for ( i = 0 ; i < 3 ; i++ ) {
+			tw->trace.endpos[i] = start[i] + tw->trace.fraction * ( end[i] - start[i] );
+		}
+	}
+
+	*results = tw->trace;
+}
+
+/*
+==================
+CM_Trace
+==================
+*/
+void CM_Trace( cmTraceContext_t *tc, trace_t *results, const vec3_t start, const vec3_t end,
+			   const vec3_t mins, const vec3_t maxs,
+			   clipHandle_t model, const vec3_t origin, int brushmask, int capsule, sphere_t *sphere ) {
+	traceWork_t tw;
+	cmodel_t    *cmod;
+
+	cmod = CM_ContextModel( tc, model );
+
+	tc->checkcount++;       // for multi-check avoidance
+
+	if ( tc == &cm.context ) {
+		c_traces++;         // for statistics, may be zeroed, main thread only
+	}
+
+	// fill in a default trace
+	memset( &tw, 0, sizeof( tw ) );
+	tw.tc = tc;
+	tw.trace.fraction = 1;  // assume it goes the entire distance until shown otherwise
+	VectorCopy( origin, tw.modelOrigin );
+
+	if ( !cm.numNodes ) {
+		*results = tw.trace;
+
+		return; // map not loaded, shouldn't happen
+	}
+
+	// allow NULL to be passed in for 0,0,0
+	if ( !mins ) {
+		mins = vec3_origin;
+	}
+	if ( !maxs ) {
+		maxs = vec3_origin;
+	}
+
+	CM_TraceWorkInit( &tw, start, end, mins, maxs, brushmask, capsule, sphere );
 
 	//
 	// check for position test special case
@@ -1268,7 +1331,7 @@ void CM_Trace( trace_t *results, const vec3_t start, const vec3_t end,
 #ifdef ALWAYS_BBOX_VS_BBOX
 			if ( model == BOX_MODEL_HANDLE || model == CAPSULE_MODEL_HANDLE ) {
 				tw.sphere.use = qfalse;
-				CM_TestInLeaf( &tw, &cmod->leaf );
+				CM_TestInBoxModel( &tw );
 			} else
 #elif defined( ALWAYS_CAPSULE_VS_CAPSULE )
 			if ( model == BOX_MODEL_HANDLE || model == CAPSULE_MODEL_HANDLE ) {
@@ -1281,6 +1344,8 @@ void CM_Trace( trace_t *results, const vec3_t start, const vec3_t end,
 				} else {
 					CM_TestBoundingBoxInCapsule( &tw, model );
 				}
+			} else if ( model == BOX_MODEL_HANDLE ) {
+				CM_TestInBoxModel( &tw );
 			} else {
 				CM_TestInLeaf( &tw, &cmod->leaf );
 			}
@@ -1308,7 +1373,7 @@ void CM_Trace( trace_t *results, const vec3_t start, const vec3_t end,
 #ifdef ALWAYS_BBOX_VS_BBOX
 			if ( model == BOX_MODEL_HANDLE || model == CAPSULE_MODEL_HANDLE ) {
 				tw.sphere.use = qfalse;
-				CM_TraceThroughLeaf( &tw, &cmod->leaf );
+				CM_TraceThroughBoxModel( &tw );
 			} else
 #elif defined( ALWAYS_CAPSULE_VS_CAPSULE )
 			if ( model == BOX_MODEL_HANDLE || model == CAPSULE_MODEL_HANDLE ) {
@@ -1321,6 +1386,8 @@ void CM_Trace( trace_t *results, const vec3_t start, const vec3_t end,
 				} else {
 					CM_TraceBoundingBoxThroughCapsule( &tw, model );
 				}
+			} else if ( model == BOX_MODEL_HANDLE ) {
+				CM_TraceThroughBoxModel( &tw );
 			} else {
 				CM_TraceThroughLeaf( &tw, &cmod->leaf );
 			}
@@ -1329,16 +1396,7 @@ void CM_Trace( trace_t *results, const vec3_t start, const vec3_t end,
 		}
 	}
 
-	// generate endpos from the original, unmodified start/end
-	if ( tw.trace.fraction == 1 ) {
-		VectorCopy( end, tw.trace.endpos );
-	} else {
-		for ( i = 0 ; i < 3 ; i++ ) {
-			tw.trace.endpos[i] = start[i] + tw.trace.fraction * ( end[i] - start[i] );
-		}
-	}
-
-	*results = tw.trace;
+	CM_TraceWorkFinish( &tw, results, start, end );
 }
 
 /*
@@ -1349,7 +1407,22 @@ CM_BoxTrace
 void CM_BoxTrace( trace_t *results, const vec3_t start, const vec3_t end,
 				  const vec3_t mins, const vec3_t maxs,
 				  clipHandle_t model, int brushmask, int capsule ) {
-	CM_Trace( results, start, end, mins, maxs, model, vec3_origin, brushmask, capsule, NULL );
+	CM_Trace( &cm.context, results, start, end, mins, maxs, model, vec3_origin, brushmask, capsule, NULL );
+}
+
+/*
+==================
+CM_BoxTraceContext
+
+Same as CM_BoxTrace, but only touches the given context, so
+any number of threads can trace at once with their own
+==================
+*/
+void CM_BoxTraceContext( cmTraceContext_t *tc, trace_t *results, const vec3_t start, const vec3_t end,
+						 const vec3_t mins, const vec3_t maxs,
+						 clipHandle_t model, int brushmask, int capsule ) {
+	CM_CheckTraceContext( tc );
+	CM_Trace( tc, results, start, end, mins, maxs, model, vec3_origin, brushmask, capsule, NULL );
 }
 
 /*
@@ -1364,6 +1437,18 @@ void CM_TransformedBoxTrace( trace_t *results, const vec3_t start, const vec3_t
 							 const vec3_t mins, const vec3_t maxs,
 							 clipHandle_t model, int brushmask,
 							 const vec3_t origin, const vec3_t angles, int capsule ) {
+	CM_TransformedBoxTraceContext( &cm.context, results, start, end, mins, maxs, model, brushmask, origin, angles, capsule );
+}
+
+/*
+==================
+CM_TransformedBoxTraceContext
+==================
+*/
+void CM_TransformedBoxTraceContext( cmTraceContext_t *tc, trace_t *results, const vec3_t start, const vec3_t end,
+									const vec3_t mins, const vec3_t maxs,
+									clipHandle_t model, int brushmask,
+									const vec3_t origin, const vec3_t angles, int capsule ) {
 	trace_t trace;
 	vec3_t start_l, end_l;
 	qboolean rotated;
@@ -1434,7 +1519,7 @@ void CM_TransformedBoxTrace( trace_t *results, const vec3_t start, const vec3_t
 	}
 
 	// sweep the box through the model
-	CM_Trace( &trace, start_l, end_l, symetricSize[0], symetricSize[1], model, origin, brushmask, capsule, &sphere );
+	CM_Trace( tc, &trace, start_l, end_l, symetricSize[0], symetricSize[1], model, origin, brushmask, capsule, &sphere );
 
 	// if the bmodel was rotated and there was a collision
 	if ( rotated && trace.fraction != 1.0 ) {
@@ -1451,3 +1536,588 @@ void CM_TransformedBoxTrace( trace_t *results, const vec3_t start, const vec3_t
 
 	*results = trace;
 }
+
+/*
+===============================================================================
+
+BATCHED TRACES
+
+Bursts of rays that start from nearly the same place, like a spread of
+pellets or a sight check against several points of a box, go down the
+same nodes for most of the tree.  CM_BoxTraceBatch walks a packet of up
+to CM_PACKET_RAYS rays down the tree together, testing all of them
+against a node's plane at once, for as long as they all stay on the same
+side.  Where the packet parts the rays that still agree keep going as
+smaller packets, and a ray that crosses the plane finishes on its own
+through CM_TraceThroughTree from that node.
+
+A ray only follows the packet when it is clearly on one side, by a
+margin much larger than any rounding in the plane distance, so every ray
+takes exactly the path, and gets exactly the result, of a CM_BoxTrace.
+
+===============================================================================
+*/
+
+#if defined( __SSE__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 1 )
+#define CM_SSE      1
+#include <xmmintrin.h>
+#else
+#define CM_SSE      0
+#endif
+
+#define PACKET_EPSILON      0.125f
+
+typedef struct {
+	float start[3][CM_PACKET_RAYS];     // one row per axis, one column per ray
+	float end[3][CM_PACKET_RAYS];
+	vec3_t extents;
+	qboolean isPoint;
+} tracePacket_t;
+
+/*
+==================
+CM_PacketSides
+
+Bit i of *front / *back is set when ray i is well in front of / behind the plane
+==================
+*/
+static void CM_PacketSides( const tracePacket_t *pk, const cplane_t *plane, float offset, int *front, int *back ) {
+#if CM_SSE
+	__m128 t1, t2, dist, lim, nlim;
+
+	dist = _mm_set1_ps( plane->dist );
+	if ( plane->type < 3 ) {
+		t1 = _mm_sub_ps( _mm_loadu_ps( pk->start[plane->type] ), dist );
+		t2 = _mm_sub_ps( _mm_loadu_ps( pk->end[plane->type] ), dist );
+	} else {
+		__m128 nx, ny, nz;
+
+		nx = _mm_set1_ps( plane->normal[0] );
+		ny = _mm_set1_ps( plane->normal[1] );
+		nz = _mm_set1_ps( plane->normal[2] );
+		t1 = _mm_add_ps( _mm_add_ps( _mm_mul_ps( nx, _mm_loadu_ps( pk->start[0] ) ),
+									 _mm_mul_ps( ny, _mm_loadu_ps( pk->start[1] ) ) ),
+						 _mm_mul_ps( nz, _mm_loadu_ps( pk->start[2] ) ) );
+		t2 = _mm_add_ps( _mm_add_ps( _mm_mul_ps( nx, _mm_loadu_ps( pk->end[0] ) ),
+									 _mm_mul_ps( ny, _mm_loadu_ps( pk->end[1] ) ) ),
+						 _mm_mul_ps( nz, _mm_loadu_ps( pk->end[2] ) ) );
+		t1 = _mm_sub_ps( t1, dist );
+		t2 = _mm_sub_ps( t2, dist );
+	}
+
+	lim = _mm_set1_ps( offset + 1 + PACKET_EPSILON );
+	nlim = _mm_set1_ps( -offset - 1 - PACKET_EPSILON );
+	*front = _mm_movemask_ps( _mm_and_ps( _mm_cmpge_ps( t1, lim ), _mm_cmpge_ps( t2, lim ) ) );
+	*back = _mm_movemask_ps( _mm_and_ps( _mm_cmplt_ps( t1, nlim ), _mm_cmplt_ps( t2, nlim ) ) );
+#else
+	int i;
+	float t1, t2, lim;
+
+	lim = offset + 1 + PACKET_EPSILON;
+	*front = *back = 0;
+	for ( i = 0 ; i < CM_PACKET_RAYS ; i++ ) {
+		if ( plane->type < 3 ) {
+			t1 = pk->start[plane->type][i] - plane->dist;
+			t2 = pk->end[plane->type][i] - plane->dist;
+		} else {
+			t1 = plane->normal[0] * pk->start[0][i] + plane->normal[1] * pk->start[1][i]
+				 + plane->normal[2] * pk->start[2][i] - plane->dist;
+			t2 = plane->normal[0] * pk->end[0][i] + plane->normal[1] * pk->end[1][i]
+				 + plane->normal[2] * pk->end[2][i] - plane->dist;
+		}
+		if ( t1 >= lim && t2 >= lim ) {
+			*front |= 1 << i;
+		} else if ( t1 < -lim && t2 < -lim ) {
+			*back |= 1 << i;
+		}
+	}
+#endif
+}
+
+/*
+==================
+CM_TraceThroughTreePacket
+
+active has a bit set for each ray of the packet that goes down from num
+==================
+*/
+static void CM_TraceThroughTreePacket( traceWork_t **tw, const tracePacket_t *pk, int active, int num ) {
+	cNode_t     *node;
+	cLeaf_t     *leaf;
+	float offset;
+	int front, back, rest;
+	int i;
+
+	while ( 1 ) {
+		if ( num < 0 ) {
+			leaf = &cm.leafs[-1 - num];
+			for ( i = 0 ; i < CM_PACKET_RAYS ; i++ ) {
+				if ( active & ( 1 << i ) ) {
+					CM_TraceThroughLeaf( tw[i], leaf );
+				}
+			}
+			return;
+		}
+
+		node = cm.nodes + num;
+
+		// same offsets as CM_TraceThroughTree
+		if ( node->plane->type < 3 ) {
+			offset = pk->extents[node->plane->type];
+		} else if ( pk->isPoint ) {
+			offset = 0;
+		} else {
+			offset = 2048;
+		}
+
+		CM_PacketSides( pk, node->plane, offset, &front, &back );
+		front &= active;
+		back &= active;
+
+		if ( front == active ) {
+			num = node->children[0];
+			continue;
+		}
+		if ( back == active ) {
+			num = node->children[1];
+			continue;
+		}
+		break;
+	}
+
+	// the packet comes apart here
+	rest = active & ~( front | back );
+	for ( i = 0 ; i < CM_PACKET_RAYS ; i++ ) {
+		if ( rest & ( 1 << i ) ) {
+			CM_TraceThroughTree( tw[i], num, 0, 1, tw[i]->start, tw[i]->end );
+		}
+	}
+	if ( front ) {
+		CM_TraceThroughTreePacket( tw, pk, front, node->children[0] );
+	}
+	if ( back ) {
+		CM_TraceThroughTreePacket( tw, pk, back, node->children[1] );
+	}
+}
+
+/*
+==================
+CM_BoxTraceBatch
+
+Same results as calling CM_BoxTrace against the world for each
+start / end pair, all rays use the same box.  Main thread only.
+==================
+*/
+void CM_BoxTraceBatch( trace_t *results, int count, const vec3_t *starts, const vec3_t *ends,
+					   const vec3_t mins, const vec3_t maxs, int brushmask ) {
+	traceWork_t tws[CM_PACKET_RAYS];
+	traceWork_t     *tw[CM_PACKET_RAYS];
+	int ray[CM_PACKET_RAYS];
+	tracePacket_t pk;
+	int first, numRays;
+	int i, j;
+
+	if ( !mins ) {
+		mins = vec3_origin;
+	}
+	if ( !maxs ) {
+		maxs = vec3_origin;
+	}
+
+	if ( !cm.numNodes ) {
+		for ( i = 0 ; i < count ; i++ ) {
+			CM_BoxTrace( &results[i], starts[i], ends[i], mins, maxs, 0, brushmask, qfalse );
+		}
+		return;
+	}
+
+	for ( first = 0 ; first < count ; first += CM_PACKET_RAYS ) {
+		numRays = 0;
+		for ( i = first ; i < count && i < first + CM_PACKET_RAYS ; i++ ) {
+			if ( VectorCompare( starts[i], ends[i] ) ) {
+				// position tests don't walk the tree
+				CM_BoxTrace( &results[i], starts[i], ends[i], mins, maxs, 0, brushmask, qfalse );
+				continue;
+			}
+
+			tw[numRays] = &tws[numRays];
+			memset( tw[numRays], 0, sizeof( traceWork_t ) );
+			tw[numRays]->tc = numRays ? &cm.packetContext[numRays - 1] : &cm.context;
+			tw[numRays]->trace.fraction = 1;
+			CM_TraceWorkInit( tw[numRays], starts[i], ends[i], mins, maxs, brushmask, qfalse, NULL );
+			ray[numRays++] = i;
+		}
+		if ( !numRays ) {
+			continue;
+		}
+
+		// mins and maxs are shared, so the point special case is too
+		pk.isPoint = ( tw[0]->size[0][0] == 0 && tw[0]->size[0][1] == 0 && tw[0]->size[0][2] == 0 );
+		for ( i = 0 ; i < numRays ; i++ ) {
+			tw[i]->isPoint = pk.isPoint;
+			if ( !pk.isPoint ) {
+				VectorCopy( tw[i]->size[1], tw[i]->extents );
+			}
+			tw[i]->tc->checkcount++;
+		}
+		VectorCopy( tw[0]->extents, pk.extents );
+
+		for ( i = 0 ; i < CM_PACKET_RAYS ; i++ ) {
+			// unused columns repeat the first ray, they are never looked at
+			const traceWork_t *src = tw[i < numRays ? i : 0];
+
+			for ( j = 0 ; j < 3 ; j++ ) {
+				pk.start[j][i] = src->start[j];
+				pk.end[j][i] = src->end[j];
+			}
+		}
+
+		CM_TraceThroughTreePacket( tw, &pk, ( 1 << numRays ) - 1, 0 );
+
+		for ( i = 0 ; i < numRays ; i++ ) {
+			CM_TraceWorkFinish( tw[i], &results[ray[i]], starts[ray[i]], ends[ray[i]] );
+		}
+		c_traces += numRays;
+	}
+}
+
+#ifndef BSPC
+/*
+===============================================================================
+
+TRACE STRESS TEST
+
+===============================================================================
+*/
+
+#define TRACETEST_BATCH     8192
+#define TRACETEST_JOBS      4       // per thread, the slow traces are not evenly spread
+
+typedef struct {
+	vec3_t start, end;
+	vec3_t mins, maxs;
+	vec3_t origin, angles;
+	vec3_t boxMins, boxMaxs;    // for the temp box and capsule tests
+	clipHandle_t model;         // 0 for the world, -1 for the temp box or capsule
+	int brushmask;
+	int capsule;                // sweep a capsule
+	int boxCapsule;             // the temp model is a capsule
+} traceTest_t;
+
+typedef struct {
+	trace_t trace;
+	int contents;
+} traceTestResult_t;
+
+typedef struct {
+	cmTraceContext_t    *tc;
+	const traceTest_t   *tests;
+	const traceTestResult_t *reference;
+	int first, count;
+	int mismatches;
+	int firstMismatch;
+} traceTestJob_t;
+
+/*
+==================
+CM_TraceTestRun
+
+Runs one test through the given context, the main context gives the
+single threaded reference through the regular entry points
+==================
+*/
+static void CM_TraceTestRun( cmTraceContext_t *tc, const traceTest_t *t, traceTestResult_t *r ) {
+	clipHandle_t model;
+
+	model = t->model;
+	if ( model < 0 ) {
+		if ( tc == &cm.context ) {
+			model = CM_TempBoxModel( t->boxMins, t->boxMaxs, t->boxCapsule );
+		} else {
+			model = CM_TempBoxModelContext( tc, t->boxMins, t->boxMaxs, t->boxCapsule );
+		}
+	}
+
+	if ( tc == &cm.context ) {
+		if ( model ) {
+			CM_TransformedBoxTrace( &r->trace, t->start, t->end, t->mins, t->maxs, model,
+									t->brushmask, t->origin, t->angles, t->capsule );
+			r->contents = CM_TransformedPointContents( t->end, model, t->origin, t->angles );
+		} else {
+			CM_BoxTrace( &r->trace, t->start, t->end, t->mins, t->maxs, 0, t->brushmask, t->capsule );
+			r->contents = CM_PointContents( t->end, 0 );
+		}
+	} else {
+		if ( model ) {
+			CM_TransformedBoxTraceContext( tc, &r->trace, t->start, t->end, t->mins, t->maxs, model,
+										   t->brushmask, t->origin, t->angles, t->capsule );
+			r->contents = CM_TransformedPointContentsContext( tc, t->end, model, t->origin, t->angles );
+		} else {
+			CM_BoxTraceContext( tc, &r->trace, t->start, t->end, t->mins, t->maxs, 0, t->brushmask, t->capsule );
+			r->contents = CM_TransformedPointContentsContext( tc, t->end, 0, vec3_origin, vec3_origin );
+		}
+	}
+}
+
+/*
+==================
+CM_TraceTestMatch
+
+Everything the game looks at has to be bit exact
+==================
+*/
+static qboolean CM_TraceTestMatch( const traceTestResult_t *a, const traceTestResult_t *b ) {
+	if ( a->trace.fraction != b->trace.fraction
+		 || a->trace.allsolid != b->trace.allsolid
+		 || a->trace.startsolid != b->trace.startsolid
+		 || a->trace.contents != b->trace.contents
+		 || a->trace.surfaceFlags != b->trace.surfaceFlags
+		 || a->trace.plane.dist != b->trace.plane.dist
+		 || a->contents != b->contents ) {
+		return qfalse;
+	}
+	if ( !VectorCompare( a->trace.endpos, b->trace.endpos )
+		 || !VectorCompare( a->trace.plane.normal, b->trace.plane.normal ) ) {
+		return qfalse;
+	}
+	return qtrue;
+}
+
+/*
+==================
+CM_TraceTestJob
+==================
+*/
+static void CM_TraceTestJob( void *data, int index ) {
+	traceTestJob_t      *job;
+	traceTestResult_t result;
+	int i;
+
+	job = (traceTestJob_t *)data + index;
+	for ( i = job->first ; i < job->first + job->count ; i++ ) {
+		CM_TraceTestRun( job->tc, &job->tests[i], &result );
+		if ( job->reference && !CM_TraceTestMatch( &result, &job->reference[i] ) ) {
+			if ( !job->mismatches ) {
+				job->firstMismatch = i;
+			}
+			job->mismatches++;
+		}
+	}
+}
+
+/*
+==================
+CM_TraceTestRandomPoint
+==================
+*/
+static void CM_TraceTestRandomPoint( int *seed, const vec3_t mins, const vec3_t maxs, vec3_t out ) {
+	int i;
+
+	for ( i = 0 ; i < 3 ; i++ ) {
+		out[i] = mins[i] + Q_random( seed ) * ( maxs[i] - mins[i] );
+	}
+}
+
+/*
+==================
+CM_TraceTestBuild
+
+A mix of what the game does: long shots, short player sized moves,
+position tests, and traces against entity sized boxes, capsules and
+rotated inline models
+==================
+*/
+static void CM_TraceTestBuild( int *seed, traceTest_t *t ) {
+	static const int masks[] = {
+		CONTENTS_SOLID,
+		CONTENTS_SOLID | CONTENTS_PLAYERCLIP | CONTENTS_BODY,
+		CONTENTS_SOLID | CONTENTS_BODY | CONTENTS_CORPSE,
+		-1
+	};
+	const cmodel_t  *world;
+	int kind;
+	int i;
+
+	world = &cm.cmodels[0];
+	memset( t, 0, sizeof( *t ) );
+
+	CM_TraceTestRandomPoint( seed, world->mins, world->maxs, t->start );
+
+	kind = Q_rand( seed ) & 7;
+	if ( kind < 3 ) {
+		// anywhere in the map
+		CM_TraceTestRandomPoint( seed, world->mins, world->maxs, t->end );
+	} else if ( kind < 7 ) {
+		// a short move
+		for ( i = 0 ; i < 3 ; i++ ) {
+			t->end[i] = t->start[i] + Q_crandom( seed ) * 256;
+		}
+	} else {
+		// position test
+		VectorCopy( t->start, t->end );
+	}
+
+	if ( Q_rand( seed ) & 1 ) {
+		VectorSet( t->mins, -15, -15, -24 );
+		VectorSet( t->maxs, 15, 15, 32 );
+		if ( Q_rand( seed ) & 3 ) {
+			// crouched or prone sized every now and then
+			t->maxs[2] = 16;
+		}
+		t->capsule = !( Q_rand( seed ) & 3 );
+	}
+	t->brushmask = masks[Q_rand( seed ) & 3];
+
+	switch ( Q_rand( seed ) & 3 ) {
+	case 0:
+		break;
+	case 1:
+		if ( cm.numSubModels > 1 ) {
+			t->model = 1 + ( Q_rand( seed ) & 0x7fff ) % ( cm.numSubModels - 1 );
+			for ( i = 0 ; i < 3 ; i++ ) {
+				t->origin[i] = Q_crandom( seed ) * 64;
+				t->angles[i] = ( Q_rand( seed ) & 1 ) ? Q_random( seed ) * 360 : 0;
+			}
+			break;
+		}
+		// fall through
+	default:
+		// an entity box somewhere along the trace
+		t->model = -1;
+		t->boxCapsule = !( Q_rand( seed ) & 1 );
+		VectorSet( t->boxMins, -15, -15, -24 );
+		VectorSet( t->boxMaxs, 15, 15, 32 );
+		for ( i = 0 ; i < 3 ; i++ ) {
+			t->origin[i] = t->start[i] + Q_random( seed ) * ( t->end[i] - t->start[i] ) + Q_crandom( seed ) * 16;
+		}
+		break;
+	}
+}
+
+/*
+==================
+CM_TraceTest_f
+
+tracetest [count] [threads]
+Fires random traces at the loaded map from several threads, each with
+its own trace context, and checks them against the single threaded path
+==================
+*/
+void CM_TraceTest_f( void ) {
+	traceTest_t         *tests;
+	traceTestResult_t   *reference;
+	traceTestJob_t jobs[( MAX_WORKER_THREADS + 1 ) * TRACETEST_JOBS];
+	int count, threads, numJobs, oldWorkers;
+	int done, batch, per, mismatches, seed;
+	int64_t start, serialTime, threadedTime;
+	int i;
+
+	if ( !cm.numNodes || !cm.numSubModels ) {
+		Com_Printf( "tracetest: no map loaded\n" );
+		return;
+	}
+
+	count = 1000000;
+	if ( Cmd_Argc() > 1 ) {
+		count = atoi( Cmd_Argv( 1 ) );
+	}
+	if ( count < 1 ) {
+		count = 1;
+	}
+
+	oldWorkers = Threads_NumWorkers();
+	threads = oldWorkers + 1;
+	if ( Cmd_Argc() > 2 ) {
+		threads = atoi( Cmd_Argv( 2 ) );
+	}
+	if ( threads < 1 ) {
+		threads = 1;
+	} else if ( threads > MAX_WORKER_THREADS + 1 ) {
+		threads = MAX_WORKER_THREADS + 1;
+	}
+
+	Threads_InitWorkers( threads - 1 );
+	threads = Threads_NumWorkers() + 1;
+	numJobs = threads * TRACETEST_JOBS;
+
+	tests = Z_Malloc( TRACETEST_BATCH * sizeof( *tests ) );
+	reference = Z_Malloc( TRACETEST_BATCH * sizeof( *reference ) );
+	for ( i = 0 ; i < numJobs ; i++ ) {
+		jobs[i].tc = CM_AllocTraceContext();
+		jobs[i].tests = tests;
+		jobs[i].reference = reference;
+		jobs[i].mismatches = 0;
+		jobs[i].firstMismatch = 0;
+	}
+
+	Com_Printf( "%i traces on %s, %i threads\n", count, cm.name, threads );
+
+	seed = 0x5eed;
+	mismatches = 0;
+	serialTime = threadedTime = 0;
+	for ( done = 0 ; done < count ; done += batch ) {
+		batch = count - done;
+		if ( batch > TRACETEST_BATCH ) {
+			batch = TRACETEST_BATCH;
+		}
+
+		for ( i = 0 ; i < batch ; i++ ) {
+			CM_TraceTestBuild( &seed, &tests[i] );
+		}
+
+		start = Sys_Microseconds();
+		for ( i = 0 ; i < batch ; i++ ) {
+			CM_TraceTestRun( &cm.context, &tests[i], &reference[i] );
+		}
+		serialTime += Sys_Microseconds() - start;
+
+		per = ( batch + numJobs - 1 ) / numJobs;
+		for ( i = 0 ; i < numJobs ; i++ ) {
+			jobs[i].first = i * per;
+			jobs[i].count = batch - jobs[i].first;
+			if ( jobs[i].count > per ) {
+				jobs[i].count = per;
+			} else if ( jobs[i].count < 0 ) {
+				jobs[i].count = 0;
+			}
+		}
+
+		start = Sys_Microseconds();
+		Threads_RunJobs( CM_TraceTestJob, jobs, numJobs );
+		threadedTime += Sys_Microseconds() - start;
+
+		for ( i = 0 ; i < numJobs ; i++ ) {
+			if ( !jobs[i].mismatches ) {
+				continue;
+			}
+			if ( !mismatches ) {
+				const traceTest_t *t = &tests[jobs[i].firstMismatch];
+				Com_Printf( "first mismatch: model %i mask 0x%x capsule %i (%.1f %.1f %.1f) to (%.1f %.1f %.1f)\n",
+							t->model, t->brushmask, t->capsule, t->start[0], t->start[1], t->start[2],
+							t->end[0], t->end[1], t->end[2] );
+			}
+			mismatches += jobs[i].mismatches;
+			jobs[i].mismatches = 0;
+		}
+	}
+
+	for ( i = 0 ; i < numJobs ; i++ ) {
+		CM_FreeTraceContext( jobs[i].tc );
+	}
+	Z_Free( reference );
+	Z_Free( tests );
+
+	Threads_InitWorkers( oldWorkers );
+
+	Com_Printf( "serial:   %8.3f msec, %9.0f traces/sec\n", serialTime / 1000.0,
+				serialTime ? count * 1000000.0 / serialTime : 0.0 );
+	Com_Printf( "threaded: %8.3f msec, %9.0f traces/sec  %5.2fx\n", threadedTime / 1000.0,
+				threadedTime ? count * 1000000.0 / threadedTime : 0.0,
+				threadedTime ? (double)serialTime / threadedTime : 0.0 );
+	if ( mismatches ) {
+		Com_Printf( S_COLOR_RED "%i of %i traces did not match\n", mismatches, count );
+	} else {
+		Com_Printf( "all traces match\n" );
+	}
+}
+#endif
@@ -138,6 +138,48 @@ void Cbuf_InsertText( const char *text ) {
 }
 
 
+/*
+============
+Cbuf_Stash
+
+Takes the text waiting in the buffer out, so a command that runs frames
+of its own can execute what those add without running ahead of itself.
+Returns the length, hand it back with Cbuf_Unstash
+============
+*/
+int Cbuf_Stash( char *text, int size ) {
+	int len;
+
+	len = cmd_text.cursize;
+	if ( len > size ) {
+		Com_Printf( "Cbuf_Stash: overflow\n" );
+		len = size;
+	}
+	memcpy( text, cmd_text.data, len );
+	cmd_text.cursize = 0;
+
+	return len;
+}
+
+/*
+============
+Cbuf_Unstash
+
+Puts stashed text back in front of the buffer
+============
+*/
+void Cbuf_Unstash( const char *text, int len ) {
+	if ( len + cmd_text.cursize > cmd_text.maxsize ) {
+		Com_Printf( "Cbuf_Unstash overflowed\n" );
+		return;
+	}
+
+	memmove( cmd_text.data + len, cmd_text.data, cmd_text.cursize );
+	memcpy( cmd_text.data, text, len );
+	cmd_text.cursize += len;
+}
+
+
 /*
 ============
 Cbuf_ExecuteText
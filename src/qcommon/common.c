@@ -733,10 +733,24 @@ int Com_RealTime( qtime_t *qtime ) {
 
 						ZONE MEMORY ALLOCATION
 
-There is never any space between memblocks, and there will never be two
-contiguous free memblocks.
+Blocks up to ZONE_MAX_CLASS_SIZE come from slabs, pages of ZONE_PAGE_SIZE
+cut into blocks of a single size class.  Each class keeps its slabs that
+still have a free block on a list, an allocation takes a block from the
+first of them and a free puts it back into its own slab, so neither has
+to look at any other block.  A slab that empties goes back to the pages
+any class can take.  Bigger blocks come from the C heap, one at a time.
 
-The rover can be left pointing at a non-empty block
+The pages come in chunks, the small zone one before the cvars exist,
+com_zoneMegs once they do, and more when those run out.
+
+Every block still has its header, so the tags, the trash tester and the
+ZONE_DEBUG info work as they did.  TAG_SMALL blocks come from the same
+classes, the tag only tells them apart.
+
+The class lists, the free pages and the big blocks each have a spin lock,
+so any thread can allocate and free.  Z_FreeTags, Z_CheckHeap, Z_LogHeap
+and meminfo walk all the blocks and expect nothing else in the zone
+while they do.
 
 The zone calls are pretty much only used for small strings and structures,
 all big things are allocated on the hunk.
@@ -744,7 +758,14 @@ all big things are allocated on the hunk.
 */
 
 #define ZONEID  0x1d4a11
-#define MINFRAGMENT 64
+
+#define ZONE_PAGE_SIZE          ( 64 * 1024 )   // a power of two, the chunks are aligned to it
+#define ZONE_SLAB_HEADER        64              // room for the zoneSlab_t at the start of a slab
+#define ZONE_MAX_CLASS_SIZE     8192
+#define ZONE_NUM_CLASSES        31
+#define ZONE_CLASS_LARGE        -1              // a block from the C heap
+#define ZONE_MAX_CHUNKS         64
+#define ZONE_GROW_SIZE          ( 4 * 1024 * 1024 )
 
 typedef struct zonedebug_s {
 	char *label;
@@ -754,54 +775,366 @@ typedef struct zonedebug_s {
 } zonedebug_t;
 
 typedef struct memblock_s {
-	int size;               // including the header and possibly tiny fragments
+	int size;               // including the header and the trash tester
 	int tag;                // a tag of 0 is a free block
-	struct memblock_s       *next, *prev;
+	struct memblock_s       *next, *prev;   // the slab's free blocks, or the big blocks
 	int id;                 // should be ZONEID
+	int cls;                // size class, or ZONE_CLASS_LARGE
 #ifdef ZONE_DEBUG
 	zonedebug_t d;
 #endif
 } memblock_t;
 
+typedef struct zoneSlab_s {
+	struct zoneSlab_s   *next, *prev;   // the class's slabs with free blocks, or the free pages
+	memblock_t          *freeList;
+	byte                *unused;        // no block past here has been handed out yet
+	int used;                           // blocks handed out
+	int cls;                            // -1 for a free page
+} zoneSlab_t;
+
+#define ZONE_SLAB( block )  ( (zoneSlab_t *)( (size_t)( block ) & ~(size_t)( ZONE_PAGE_SIZE - 1 ) ) )
+
+typedef struct {
+	int size;               // of every block, header included
+	int blocksPerSlab;
+	volatile int lock;
+	zoneSlab_t  *partial;   // the slabs with a free block
+	int slabs;
+	int used;               // blocks handed out
+	int peak;
+	double allocs;
+} zoneClass_t;
+
 typedef struct {
-	int size;               // total bytes malloced, including header
-	int used;               // total bytes used
-	memblock_t blocklist;   // start / end cap for linked list
-	memblock_t  *rover;
-} memzone_t;
+	void        *alloc;     // what calloc returned
+	byte        *base;      // page aligned
+	int pages;
+} zoneChunk_t;
 
-// main zone for all "dynamic" memory allocation
-memzone_t   *mainzone;
-// we also have a small zone for small allocations that would only
-// fragment the main zone (think of cvar and cmd strings)
-memzone_t   *smallzone;
+static zoneClass_t zone_classes[ZONE_NUM_CLASSES];
+static byte zone_classForSize[ZONE_MAX_CLASS_SIZE / 16 + 1];    // by size / 16
+
+static zoneChunk_t zone_chunks[ZONE_MAX_CHUNKS];
+static int zone_numChunks;
+static int zone_totalPages;
+static int zone_numFreePages;
+static zoneSlab_t   *zone_freePages;
+static volatile int zone_pageLock;
+
+static memblock_t   *zone_largeBlocks;
+static int zone_numLarge;
+static int zone_largeBytes;
+static volatile int zone_largeLock;
 
 
 void Z_CheckHeap( void );
 
+static void Z_Lock( volatile int *lock ) {
+	while ( !Threads_CompareExchange( lock, 0, 1 ) ) {
+	}
+}
+
+static void Z_Unlock( volatile int *lock ) {
+	Threads_MemoryBarrier();
+	*lock = 0;
+}
+
 /*
 ========================
-Z_ClearZone
+Z_InitClasses
+
+16 byte steps up to 128, then four steps to every power of two
 ========================
 */
-void Z_ClearZone( memzone_t *zone, int size ) {
+static void Z_InitClasses( void ) {
+	int c, i, size, step;
+
+	c = 0;
+	for ( size = 32 ; size <= 128 ; size += 16 ) {
+		zone_classes[c++].size = size;
+	}
+	for ( size = 128, step = 32 ; c < ZONE_NUM_CLASSES ; step *= 2 ) {
+		for ( i = 0 ; i < 4 ; i++ ) {
+			size += step;
+			zone_classes[c++].size = size;
+		}
+	}
+
+	for ( c = 0 ; c < ZONE_NUM_CLASSES ; c++ ) {
+		zone_classes[c].blocksPerSlab = ( ZONE_PAGE_SIZE - ZONE_SLAB_HEADER ) / zone_classes[c].size;
+	}
+	for ( i = 0, c = 0 ; i <= ZONE_MAX_CLASS_SIZE / 16 ; i++ ) {
+		while ( zone_classes[c].size < i * 16 ) {
+			c++;
+		}
+		zone_classForSize[i] = c;
+	}
+}
+
+/*
+========================
+Z_AddChunk
+
+Hands the pages of a new chunk to the free pages, the page lock has to
+be held once other threads are running
+========================
+*/
+static qboolean Z_AddChunk( int size ) {
+	zoneChunk_t *chunk;
+	zoneSlab_t  *page;
+	int i;
+
+	if ( zone_numChunks == ZONE_MAX_CHUNKS ) {
+		return qfalse;
+	}
+	chunk = &zone_chunks[zone_numChunks];
+	chunk->pages = size / ZONE_PAGE_SIZE;
+	if ( chunk->pages < 1 ) {
+		chunk->pages = 1;
+	}
+	// bk001205 - was malloc
+	chunk->alloc = calloc( chunk->pages * ZONE_PAGE_SIZE + ZONE_PAGE_SIZE - 1, 1 );
+	if ( !chunk->alloc ) {
+		return qfalse;
+	}
+	chunk->base = ( byte * )( ( (size_t)chunk->alloc + ZONE_PAGE_SIZE - 1 ) & ~(size_t)( ZONE_PAGE_SIZE - 1 ) );
+
+	// the first page goes out first
+	for ( i = chunk->pages - 1 ; i >= 0 ; i-- ) {
+		page = ( zoneSlab_t * )( chunk->base + i * ZONE_PAGE_SIZE );
+		page->cls = -1;
+		page->next = zone_freePages;
+		zone_freePages = page;
+	}
+	zone_numFreePages += chunk->pages;
+	zone_totalPages += chunk->pages;
+	zone_numChunks++;
+	return qtrue;
+}
+
+/*
+========================
+Z_GetPage / Z_PutPage
+========================
+*/
+static zoneSlab_t *Z_GetPage( void ) {
+	zoneSlab_t  *page;
+
+	Z_Lock( &zone_pageLock );
+	if ( !zone_freePages ) {
+		Z_AddChunk( ZONE_GROW_SIZE );
+	}
+	page = zone_freePages;
+	if ( page ) {
+		zone_freePages = page->next;
+		zone_numFreePages--;
+	}
+	Z_Unlock( &zone_pageLock );
+
+	return page;
+}
+
+static void Z_PutPage( zoneSlab_t *page ) {
+	Z_Lock( &zone_pageLock );
+	page->cls = -1;
+	page->next = zone_freePages;
+	zone_freePages = page;
+	zone_numFreePages++;
+	Z_Unlock( &zone_pageLock );
+}
+
+/*
+========================
+Z_SlabAlloc
+========================
+*/
+static memblock_t *Z_SlabAlloc( int c ) {
+	zoneClass_t *cls;
+	zoneSlab_t  *slab;
 	memblock_t  *block;
 
-	// set the entire zone to one free block
+	cls = &zone_classes[c];
+	Z_Lock( &cls->lock );
+	slab = cls->partial;
+	if ( !slab ) {
+		Z_Unlock( &cls->lock );
+		slab = Z_GetPage();
+		if ( !slab ) {
+			return NULL;
+		}
+		slab->cls = c;
+		slab->freeList = NULL;
+		slab->unused = (byte *)slab + ZONE_SLAB_HEADER;
+		slab->used = 0;
+
+		Z_Lock( &cls->lock );
+		slab->prev = NULL;
+		slab->next = cls->partial;
+		if ( cls->partial ) {
+			cls->partial->prev = slab;
+		}
+		cls->partial = slab;
+		cls->slabs++;
+	}
 
-	zone->blocklist.next = zone->blocklist.prev = block =
-													  ( memblock_t * )( (byte *)zone + sizeof( memzone_t ) );
-	zone->blocklist.tag = 1;    // in use block
-	zone->blocklist.id = 0;
-	zone->blocklist.size = 0;
-	zone->rover = block;
-	zone->size = size;
-	zone->used = 0;
+	if ( slab->freeList ) {
+		block = slab->freeList;
+		slab->freeList = block->next;
+	} else {
+		block = (memblock_t *)slab->unused;
+		slab->unused += cls->size;
+	}
 
-	block->prev = block->next = &zone->blocklist;
-	block->tag = 0;         // free block
-	block->id = ZONEID;
-	block->size = size - sizeof( memzone_t );
+	// full slabs are on no list
+	if ( ++slab->used == cls->blocksPerSlab ) {
+		cls->partial = slab->next;
+		if ( slab->next ) {
+			slab->next->prev = NULL;
+		}
+	}
+
+	if ( ++cls->used > cls->peak ) {
+		cls->peak = cls->used;
+	}
+	cls->allocs++;
+	Z_Unlock( &cls->lock );
+
+	block->size = cls->size;
+	block->cls = c;
+	return block;
+}
+
+/*
+========================
+Z_SlabFree
+========================
+*/
+static void Z_SlabFree( memblock_t *block ) {
+	zoneClass_t *cls;
+	zoneSlab_t  *slab;
+	qboolean release;
+
+	cls = &zone_classes[block->cls];
+	slab = ZONE_SLAB( block );
+	release = qfalse;
+
+	Z_Lock( &cls->lock );
+	block->next = slab->freeList;
+	slab->freeList = block;
+
+	if ( slab->used-- == cls->blocksPerSlab ) {
+		// was full, has a free block again
+		slab->prev = NULL;
+		slab->next = cls->partial;
+		if ( cls->partial ) {
+			cls->partial->prev = slab;
+		}
+		cls->partial = slab;
+	} else if ( !slab->used && ( slab->prev || slab->next ) ) {
+		// the last slab of a class is kept, so that a block
+		// going back and forth doesn't take a page each time
+		if ( slab->prev ) {
+			slab->prev->next = slab->next;
+		} else {
+			cls->partial = slab->next;
+		}
+		if ( slab->next ) {
+			slab->next->prev = slab->prev;
+		}
+		cls->slabs--;
+		release = qtrue;
+	}
+	cls->used--;
+	Z_Unlock( &cls->lock );
+
+	if ( release ) {
+		Z_PutPage( slab );
+	}
+}
+
+/*
+========================
+Z_LargeAlloc / Z_LargeFree
+========================
+*/
+static memblock_t *Z_LargeAlloc( int size ) {
+	memblock_t  *block;
+
+	block = malloc( size );
+	if ( !block ) {
+		return NULL;
+	}
+	block->size = size;
+	block->cls = ZONE_CLASS_LARGE;
+
+	Z_Lock( &zone_largeLock );
+	block->prev = NULL;
+	block->next = zone_largeBlocks;
+	if ( zone_largeBlocks ) {
+		zone_largeBlocks->prev = block;
+	}
+	zone_largeBlocks = block;
+	zone_numLarge++;
+	zone_largeBytes += size;
+	Z_Unlock( &zone_largeLock );
+
+	return block;
+}
+
+static void Z_LargeFree( memblock_t *block ) {
+	Z_Lock( &zone_largeLock );
+	if ( block->prev ) {
+		block->prev->next = block->next;
+	} else {
+		zone_largeBlocks = block->next;
+	}
+	if ( block->next ) {
+		block->next->prev = block->prev;
+	}
+	zone_numLarge--;
+	zone_largeBytes -= block->size;
+	Z_Unlock( &zone_largeLock );
+
+	free( block );
+}
+
+/*
+========================
+Z_ForEachBlock
+
+Calls func for every block in use, func may free the block
+========================
+*/
+typedef void ( *zoneBlockFunc_t )( memblock_t *block, void *data );
+
+static void Z_ForEachBlock( zoneBlockFunc_t func, void *data ) {
+	zoneChunk_t *chunk;
+	zoneSlab_t  *slab;
+	memblock_t  *block, *next;
+	int i, p, size;
+
+	for ( i = 0, chunk = zone_chunks ; i < zone_numChunks ; i++, chunk++ ) {
+		for ( p = 0 ; p < chunk->pages ; p++ ) {
+			slab = ( zoneSlab_t * )( chunk->base + p * ZONE_PAGE_SIZE );
+			if ( slab->cls < 0 ) {
+				continue;
+			}
+			// a slab emptied by func keeps its blocks until the page is taken again
+			size = zone_classes[slab->cls].size;
+			for ( block = ( memblock_t * )( (byte *)slab + ZONE_SLAB_HEADER ) ;
+				  (byte *)block < slab->unused ; block = ( memblock_t * )( (byte *)block + size ) ) {
+				if ( block->tag ) {
+					func( block, data );
+				}
+			}
+		}
+	}
+
+	for ( block = zone_largeBlocks ; block ; block = next ) {
+		next = block->next;
+		func( block, data );
+	}
 }
 
 
@@ -811,8 +1144,7 @@ Z_Free
 ========================
 */
 void Z_Free( void *ptr ) {
-	memblock_t  *block, *other;
-	memzone_t *zone;
+	memblock_t  *block;
 
 	if ( !ptr ) {
 		Com_Error( ERR_DROP, "Z_Free: NULL pointer" );
@@ -835,42 +1167,16 @@ void Z_Free( void *ptr ) {
 		Com_Error( ERR_FATAL, "Z_Free: memory block wrote past end" );
 	}
 
-	if ( block->tag == TAG_SMALL ) {
-		zone = smallzone;
-	} else {
-		zone = mainzone;
-	}
-
-	zone->used -= block->size;
 	// set the block to something that should cause problems
 	// if it is referenced...
 	memset( ptr, 0xaa, block->size - sizeof( *block ) );
 
 	block->tag = 0;     // mark as free
 
-	other = block->prev;
-	if ( !other->tag ) {
-		// merge with previous free block
-		other->size += block->size;
-		other->next = block->next;
-		other->next->prev = other;
-		if ( block == zone->rover ) {
-			zone->rover = other;
-		}
-		block = other;
-	}
-
-	zone->rover = block;
-
-	other = block->next;
-	if ( !other->tag ) {
-		// merge the next free block onto the end
-		block->size += other->size;
-		block->next = other->next;
-		block->next->prev = block;
-		if ( other == zone->rover ) {
-			zone->rover = block;
-		}
+	if ( block->cls == ZONE_CLASS_LARGE ) {
+		Z_LargeFree( block );
+	} else {
+		Z_SlabFree( block );
 	}
 }
 
@@ -880,24 +1186,14 @@ void Z_Free( void *ptr ) {
 Z_FreeTags
 ================
 */
-void Z_FreeTags( int tag ) {
-	memzone_t   *zone;
-
-	if ( tag == TAG_SMALL ) {
-		zone = smallzone;
-	} else {
-		zone = mainzone;
+static void Z_FreeTagged( memblock_t *block, void *data ) {
+	if ( block->tag == *(int *)data ) {
+		Z_Free( block + 1 );
 	}
-	// use the rover as our pointer, because
-	// Z_Free automatically adjusts it
-	zone->rover = zone->blocklist.next;
-	do {
-		if ( zone->rover->tag == tag ) {
-			Z_Free( ( void * )( zone->rover + 1 ) );
-			continue;
-		}
-		zone->rover = zone->rover->next;
-	} while ( zone->rover != &zone->blocklist );
+}
+
+void Z_FreeTags( int tag ) {
+	Z_ForEachBlock( Z_FreeTagged, &tag );
 }
 
 /*
@@ -913,75 +1209,37 @@ void *Z_TagMallocDebug( int size, int tag, char *label, char *file, int line ) {
 #else
 void *Z_TagMalloc( int size, int tag ) {
 #endif
-	int extra;
 #ifdef ZONE_DEBUG
 	int allocSize;
 #endif
-	memblock_t  *start, *rover, *newBlk, *base;
-	memzone_t *zone;
+	memblock_t  *base;
 
 	if ( !tag ) {
 		Com_Error( ERR_FATAL, "Z_TagMalloc: tried to use a 0 tag" );
 	}
 
-	if ( tag == TAG_SMALL ) {
-		zone = smallzone;
-	} else {
-		zone = mainzone;
-	}
 #ifdef ZONE_DEBUG
 	allocSize = size;
 #endif
-	//
-	// scan through the block list looking for the first free block
-	// of sufficient size
-	//
 	size += sizeof( memblock_t ); // account for size of block header
 	size += 4;                  // space for memory trash tester
-	size = ( size + 3 ) & ~3;     // align to 32 bit boundary
+	size = ( size + 15 ) & ~15;   // the classes are 16 byte steps
 
-	base = rover = zone->rover;
-	start = base->prev;
-
-	do {
-		if ( rover == start ) {
+	if ( size <= ZONE_MAX_CLASS_SIZE ) {
+		base = Z_SlabAlloc( zone_classForSize[size >> 4] );
+	} else {
+		base = Z_LargeAlloc( size );
+	}
+	if ( !base ) {
 #ifdef ZONE_DEBUG
-			Z_LogHeap();
+		Z_LogHeap();
 #endif
-			// scaned all the way around the list
-			Com_Error( ERR_FATAL, "Z_Malloc: failed on allocation of %i bytes from the %s zone",
-					   size, zone == smallzone ? "small" : "main" );
-			return NULL;
-		}
-		if ( rover->tag ) {
-			base = rover = rover->next;
-		} else {
-			rover = rover->next;
-		}
-	} while ( base->tag || base->size < size );
-
-	//
-	// found a block big enough
-	//
-	extra = base->size - size;
-	if ( extra > MINFRAGMENT ) {
-		// there will be a free fragment after the allocated block
-		newBlk = ( memblock_t * )( (byte *)base + size );
-		newBlk->size = extra;
-		newBlk->tag = 0;           // free block
-		newBlk->prev = base;
-		newBlk->id = ZONEID;
-		newBlk->next = base->next;
-		newBlk->next->prev = newBlk;
-		base->next = newBlk;
-		base->size = size;
+		Com_Error( ERR_FATAL, "Z_Malloc: failed on allocation of %i bytes from the %s zone",
+				   size, tag == TAG_SMALL ? "small" : "main" );
+		return NULL;
 	}
 
 	base->tag = tag;            // no longer a free block
-
-	zone->rover = base->next;   // next allocation will start looking here
-	zone->used += base->size;   //
-
 	base->id = ZONEID;
 
 #ifdef ZONE_DEBUG
@@ -1036,23 +1294,40 @@ void *S_Malloc( int size ) {
 Z_CheckHeap
 ========================
 */
+static void Z_CheckBlock( memblock_t *block, void *data ) {
+	if ( block->id != ZONEID ) {
+		Com_Error( ERR_FATAL, "Z_CheckHeap: block without ZONEID\n" );
+	}
+	if ( *( int * )( (byte *)block + block->size - 4 ) != ZONEID ) {
+		Com_Error( ERR_FATAL, "Z_CheckHeap: memory block wrote past end\n" );
+	}
+}
+
 void Z_CheckHeap( void ) {
+	zoneChunk_t *chunk;
+	zoneSlab_t  *slab;
 	memblock_t  *block;
+	int i, p, numFree, carved;
 
-	for ( block = mainzone->blocklist.next ; ; block = block->next ) {
-		if ( block->next == &mainzone->blocklist ) {
-			break;          // all blocks have been hit
-		}
-		if ( (byte *)block + block->size != (byte *)block->next ) {
-			Com_Error( ERR_FATAL, "Z_CheckHeap: block size does not touch the next block\n" );
-		}
-		if ( block->next->prev != block ) {
-			Com_Error( ERR_FATAL, "Z_CheckHeap: next block doesn't have proper back link\n" );
-		}
-		if ( !block->tag && !block->next->tag ) {
-			Com_Error( ERR_FATAL, "Z_CheckHeap: two consecutive free blocks\n" );
+	for ( i = 0, chunk = zone_chunks ; i < zone_numChunks ; i++, chunk++ ) {
+		for ( p = 0 ; p < chunk->pages ; p++ ) {
+			slab = ( zoneSlab_t * )( chunk->base + p * ZONE_PAGE_SIZE );
+			if ( slab->cls < 0 ) {
+				continue;
+			}
+			carved = ( slab->unused - ( (byte *)slab + ZONE_SLAB_HEADER ) ) / zone_classes[slab->cls].size;
+			for ( block = slab->freeList, numFree = 0 ; block ; block = block->next, numFree++ ) {
+				if ( ZONE_SLAB( block ) != slab || block->tag || numFree > carved ) {
+					Com_Error( ERR_FATAL, "Z_CheckHeap: bad free block list\n" );
+				}
+			}
+			if ( numFree + slab->used != carved ) {
+				Com_Error( ERR_FATAL, "Z_CheckHeap: slab block count is wrong\n" );
+			}
 		}
 	}
+
+	Z_ForEachBlock( Z_CheckBlock, NULL );
 }
 
 /*
@@ -1060,51 +1335,62 @@ void Z_CheckHeap( void ) {
 Z_LogZoneHeap
 ========================
 */
-void Z_LogZoneHeap( memzone_t *zone, char *name ) {
+typedef struct {
+	qboolean small;
+	int size, allocSize, numBlocks;
+} zoneLog_t;
+
+static void Z_LogBlock( memblock_t *block, void *data ) {
+	zoneLog_t   *log = data;
 #ifdef ZONE_DEBUG
 	char dump[32], *ptr;
+	char buf[4096];
 	int i, j;
 #endif
-	memblock_t  *block;
+
+	if ( ( block->tag == TAG_SMALL ) != log->small ) {
+		return;
+	}
+#ifdef ZONE_DEBUG
+	ptr = ( (char *) block ) + sizeof( memblock_t );
+	j = 0;
+	for ( i = 0; i < 20 && i < block->d.allocSize; i++ ) {
+		if ( ptr[i] >= 32 && ptr[i] < 127 ) {
+			dump[j++] = ptr[i];
+		} else {
+			dump[j++] = '_';
+		}
+	}
+	dump[j] = '\0';
+	Com_sprintf( buf, sizeof( buf ), "size = %8d: %s, line: %d (%s) [%s]\r\n", block->d.allocSize, block->d.file, block->d.line, block->d.label, dump );
+	FS_Write( buf, strlen( buf ), logfile );
+	log->allocSize += block->d.allocSize;
+#endif
+	log->size += block->size;
+	log->numBlocks++;
+}
+
+static void Z_LogZoneHeap( qboolean small, char *name ) {
+	zoneLog_t log;
 	char buf[4096];
-	int size, allocSize, numBlocks;
 
 	if ( !logfile || !FS_Initialized() ) {
 		return;
 	}
-	size = allocSize = numBlocks = 0;
+	memset( &log, 0, sizeof( log ) );
+	log.small = small;
 	Com_sprintf( buf, sizeof( buf ), "\r\n================\r\n%s log\r\n================\r\n", name );
 	FS_Write( buf, strlen( buf ), logfile );
-	for ( block = zone->blocklist.next ; block->next != &zone->blocklist; block = block->next ) {
-		if ( block->tag ) {
-#ifdef ZONE_DEBUG
-			ptr = ( (char *) block ) + sizeof( memblock_t );
-			j = 0;
-			for ( i = 0; i < 20 && i < block->d.allocSize; i++ ) {
-				if ( ptr[i] >= 32 && ptr[i] < 127 ) {
-					dump[j++] = ptr[i];
-				} else {
-					dump[j++] = '_';
-				}
-			}
-			dump[j] = '\0';
-			Com_sprintf( buf, sizeof( buf ), "size = %8d: %s, line: %d (%s) [%s]\r\n", block->d.allocSize, block->d.file, block->d.line, block->d.label, dump );
-			FS_Write( buf, strlen( buf ), logfile );
-			allocSize += block->d.allocSize;
-#endif
-			size += block->size;
-			numBlocks++;
-		}
-	}
+	Z_ForEachBlock( Z_LogBlock, &log );
 #ifdef ZONE_DEBUG
 	// subtract debug memory
-	size -= numBlocks * sizeof( zonedebug_t );
+	log.size -= log.numBlocks * sizeof( zonedebug_t );
 #else
-	allocSize = numBlocks * sizeof( memblock_t ); // + 32 bit alignment
+	log.allocSize = log.numBlocks * sizeof( memblock_t ); // + 16 byte steps
 #endif
-	Com_sprintf( buf, sizeof( buf ), "%d %s memory in %d blocks\r\n", size, name, numBlocks );
+	Com_sprintf( buf, sizeof( buf ), "%d %s memory in %d blocks\r\n", log.size, name, log.numBlocks );
 	FS_Write( buf, strlen( buf ), logfile );
-	Com_sprintf( buf, sizeof( buf ), "%d %s memory overhead\r\n", size - allocSize, name );
+	Com_sprintf( buf, sizeof( buf ), "%d %s memory overhead\r\n", log.size - log.allocSize, name );
 	FS_Write( buf, strlen( buf ), logfile );
 }
 
@@ -1114,8 +1400,8 @@ Z_LogHeap
 ========================
 */
 void Z_LogHeap( void ) {
-	Z_LogZoneHeap( mainzone, "MAIN" );
-	Z_LogZoneHeap( smallzone, "SMALL" );
+	Z_LogZoneHeap( qfalse, "MAIN" );
+	Z_LogZoneHeap( qtrue, "SMALL" );
 }
 
 // static mem blocks to reduce a lot of small zone overhead
@@ -1239,59 +1525,68 @@ static int s_smallZoneTotal;
 Com_Meminfo_f
 =================
 */
-void Com_Meminfo_f( void ) {
-	memblock_t  *block;
+typedef struct {
+	qboolean list;
 	int zoneBytes, zoneBlocks;
 	int smallZoneBytes;
 	int botlibBytes, rendererBytes;
-	int unused;
+} zoneInfo_t;
 
-	zoneBytes = 0;
-	botlibBytes = 0;
-	rendererBytes = 0;
-	zoneBlocks = 0;
-	for ( block = mainzone->blocklist.next ; ; block = block->next ) {
-		if ( Cmd_Argc() != 1 ) {
-			Com_Printf( "block:%p    size:%7i    tag:%3i\n",
-						block, block->size, block->tag );
-		}
-		if ( block->tag ) {
-			zoneBytes += block->size;
-			zoneBlocks++;
-			if ( block->tag == TAG_BOTLIB ) {
-				botlibBytes += block->size;
-			} else if ( block->tag == TAG_RENDERER ) {
-				rendererBytes += block->size;
-			}
-		}
+static void Com_MeminfoBlock( memblock_t *block, void *data ) {
+	zoneInfo_t  *info = data;
 
-		if ( block->next == &mainzone->blocklist ) {
-			break;          // all blocks have been hit
-		}
-		if ( (byte *)block + block->size != (byte *)block->next ) {
-			Com_Printf( "ERROR: block size does not touch the next block\n" );
-		}
-		if ( block->next->prev != block ) {
-			Com_Printf( "ERROR: next block doesn't have proper back link\n" );
-		}
-		if ( !block->tag && !block->next->tag ) {
-			Com_Printf( "ERROR: two consecutive free blocks\n" );
-		}
+	if ( info->list ) {
+		Com_Printf( "block:%p    size:%7i    tag:%3i\n",
+					block, block->size, block->tag );
+	}
+	if ( block->tag == TAG_SMALL ) {
+		info->smallZoneBytes += block->size;
+		return;
+	}
+	info->zoneBytes += block->size;
+	info->zoneBlocks++;
+	if ( block->tag == TAG_BOTLIB ) {
+		info->botlibBytes += block->size;
+	} else if ( block->tag == TAG_RENDERER ) {
+		info->rendererBytes += block->size;
 	}
+}
 
-	smallZoneBytes = 0;
-	for ( block = smallzone->blocklist.next ; ; block = block->next ) {
-		if ( block->tag ) {
-			smallZoneBytes += block->size;
-		}
+/*
+=================
+Com_ZoneClasses
 
-		if ( block->next == &smallzone->blocklist ) {
-			break;          // all blocks have been hit
+meminfo classes
+=================
+*/
+static void Com_ZoneClasses( void ) {
+	zoneClass_t *cls;
+	int c;
+
+	Com_Printf( " size  slabs   blocks     peak     allocs\n" );
+	for ( c = 0, cls = zone_classes ; c < ZONE_NUM_CLASSES ; c++, cls++ ) {
+		if ( cls->allocs ) {
+			Com_Printf( "%5i %6i %8i %8i %10.0f\n", cls->size, cls->slabs, cls->used, cls->peak, cls->allocs );
 		}
 	}
+	Com_Printf( "%i big blocks, %i bytes\n", zone_numLarge, zone_largeBytes );
+}
+
+void Com_Meminfo_f( void ) {
+	zoneInfo_t info;
+	int unused;
+
+	if ( !Q_stricmp( Cmd_Argv( 1 ), "classes" ) ) {
+		Com_ZoneClasses();
+		return;
+	}
+
+	memset( &info, 0, sizeof( info ) );
+	info.list = Cmd_Argc() != 1;
+	Z_ForEachBlock( Com_MeminfoBlock, &info );
 
 	Com_Printf( "%8i bytes total hunk\n", s_hunkTotal );
-	Com_Printf( "%8i bytes total zone\n", s_zoneTotal );
+	Com_Printf( "%8i bytes total zone\n", zone_totalPages * ZONE_PAGE_SIZE );
 	Com_Printf( "\n" );
 	Com_Printf( "%8i low mark\n", hunk_low.mark );
 	Com_Printf( "%8i low permanent\n", hunk_low.permanent );
@@ -1317,11 +1612,13 @@ void Com_Meminfo_f( void ) {
 	}
 	Com_Printf( "%8i unused highwater\n", unused );
 	Com_Printf( "\n" );
-	Com_Printf( "%8i bytes in %i zone blocks\n", zoneBytes, zoneBlocks    );
-	Com_Printf( "        %8i bytes in dynamic botlib\n", botlibBytes );
-	Com_Printf( "        %8i bytes in dynamic renderer\n", rendererBytes );
-	Com_Printf( "        %8i bytes in dynamic other\n", zoneBytes - ( botlibBytes + rendererBytes ) );
-	Com_Printf( "        %8i bytes in small Zone memory\n", smallZoneBytes );
+	Com_Printf( "%8i bytes in %i zone blocks\n", info.zoneBytes, info.zoneBlocks    );
+	Com_Printf( "        %8i bytes in dynamic botlib\n", info.botlibBytes );
+	Com_Printf( "        %8i bytes in dynamic renderer\n", info.rendererBytes );
+	Com_Printf( "        %8i bytes in dynamic other\n", info.zoneBytes - ( info.botlibBytes + info.rendererBytes ) );
+	Com_Printf( "        %8i bytes in small Zone memory\n", info.smallZoneBytes );
+	Com_Printf( "%8i of %i zone pages in slabs, %i bytes in %i big blocks\n",
+				zone_totalPages - zone_numFreePages, zone_totalPages, zone_largeBytes, zone_numLarge );
 }
 
 /*
@@ -1331,11 +1628,19 @@ Com_TouchMemory
 Touch all known used data to make sure it is paged in
 ===============
 */
+static void Com_TouchBlock( memblock_t *block, void *data ) {
+	int i, j;
+
+	j = block->size >> 2;
+	for ( i = 0 ; i < j ; i += 64 ) {             // only need to touch each page
+		*(int *)data += ( (int *)block )[i];
+	}
+}
+
 void Com_TouchMemory( void ) {
 	int start, end;
 	int i, j;
 	int sum;
-	memblock_t  *block;
 
 	Z_CheckHeap();
 
@@ -1354,17 +1659,7 @@ void Com_TouchMemory( void ) {
 		sum += ( (int *)s_hunkData )[i];
 	}
 
-	for ( block = mainzone->blocklist.next ; ; block = block->next ) {
-		if ( block->tag ) {
-			j = block->size >> 2;
-			for ( i = 0 ; i < j ; i += 64 ) {             // only need to touch each page
-				sum += ( (int *)block )[i];
-			}
-		}
-		if ( block->next == &mainzone->blocklist ) {
-			break;          // all blocks have been hit
-		}
-	}
+	Z_ForEachBlock( Com_TouchBlock, &sum );
 
 	end = Sys_Milliseconds();
 
@@ -1372,50 +1667,442 @@ void Com_TouchMemory( void ) {
 }
 
 
-
 /*
-=================
-Com_InitZoneMemory
-=================
+==============================================================================
+
+ZONE BENCHMARK
+
+"zonebench [days]" runs the same made up server uptime, a week by default,
+through the zone and through a copy of the first fit zone it replaced.
+Every simulated minute replaces configstrings and cvar strings, goes
+through short lived command buffers and has a client join or leave, a
+map change every half hour frees and reloads the map's blocks, and demos
+come and go.  Then as many threads as the pool has churn small blocks.
+
+==============================================================================
 */
-void Com_InitSmallZoneMemory( void ) {
-	s_smallZoneTotal = 512 * 1024;
-	// bk001205 - was malloc
-	smallzone = calloc( s_smallZoneTotal, 1 );
-	if ( !smallzone ) {
-		Com_Error( ERR_FATAL, "Small zone data failed to allocate %1.1f megs", (float)s_smallZoneTotal / ( 1024 * 1024 ) );
+
+#define ZB_STRINGS          2048    // configstrings and cvar strings
+#define ZB_TRANSIENT        128     // freed a little later
+#define ZB_CLIENTS          64
+#define ZB_CLIENT_BLOCKS    8
+#define ZB_MAP_BLOCKS       3000
+#define ZB_MAP_LARGE        10
+#define ZB_MAP_MINUTES      30
+#define ZB_DEMO_MINUTES     120
+#define ZB_MAX_DAYS         28
+#define ZB_THREAD_OPS       200000
+#define ZB_MINFRAGMENT      64
+
+// the first fit zone
+typedef struct zbBlock_s {
+	int size;
+	int tag;
+	struct zbBlock_s    *next, *prev;
+} zbBlock_t;
+
+typedef struct {
+	int size;
+	int used;
+	zbBlock_t blocklist;
+	zbBlock_t   *rover;
+} zbZone_t;
+
+typedef struct {
+	zbZone_t    *main, *small;  // NULL for the zone itself
+	qboolean failed;
+	int failedDay;              // days when it never ran out
+	double ops;
+	double usec[ZB_MAX_DAYS];
+	int worst[ZB_MAX_DAYS];     // usec of the slowest minute
+	int used[ZB_MAX_DAYS];      // free fragments, or KB in use, after each day
+	int held[ZB_MAX_DAYS];      // KB, the largest free block, or the slabs and big blocks
+} zbAllocator_t;
+
+typedef struct {
+	void    *strings[ZB_STRINGS];
+	void    *transient[ZB_TRANSIENT];
+	int transientHead;
+	void    *clients[ZB_CLIENTS][ZB_CLIENT_BLOCKS];
+	void    *map[ZB_MAP_BLOCKS + ZB_MAP_LARGE];
+	void    *demo;
+} zbState_t;
+
+static zbState_t zb_state;
+static unsigned int zb_seed;
+
+static int ZB_Rand( int n ) {
+	zb_seed = zb_seed * 1664525 + 1013904223;
+	return ( zb_seed >> 8 ) % n;
+}
+
+// spread evenly over the powers of two
+static int ZB_Size( int lo, int hi ) {
+	int size;
+
+	for ( size = lo ; size * 2 < hi && ZB_Rand( 2 ) ; size *= 2 ) {
 	}
-	Z_ClearZone( smallzone, s_smallZoneTotal );
+	return size + ZB_Rand( size );
+}
 
-	return;
+static zbZone_t *ZB_NewZone( int size ) {
+	zbZone_t    *zone;
+	zbBlock_t   *block;
+
+	zone = malloc( size );
+	if ( !zone ) {
+		return NULL;
+	}
+	zone->blocklist.next = zone->blocklist.prev = block = ( zbBlock_t * )( zone + 1 );
+	zone->blocklist.tag = 1;
+	zone->blocklist.size = 0;
+	zone->rover = block;
+	zone->size = size;
+	zone->used = 0;
+	block->prev = block->next = &zone->blocklist;
+	block->tag = 0;
+	block->size = size - sizeof( zbZone_t );
+	return zone;
 }
 
-/*
-void Com_InitZoneMemory( void ) {
-	cvar_t	*cv;
-	s_smallZoneTotal = 512 * 1024;
-	smallzone = malloc( s_smallZoneTotal );
-	if ( !smallzone ) {
-		Com_Error( ERR_FATAL, "Small zone data failed to allocate %1.1f megs", (float)s_smallZoneTotal / (1024*1024) );
+static void *ZB_ZoneAlloc( zbZone_t *zone, int size, int tag ) {
+	zbBlock_t   *start, *rover, *newBlk, *base;
+	int extra;
+
+	size += sizeof( memblock_t ) + 4;
+	size = ( size + 3 ) & ~3;
+
+	base = rover = zone->rover;
+	start = base->prev;
+	do {
+		if ( rover == start ) {
+			return NULL;
+		}
+		if ( rover->tag ) {
+			base = rover = rover->next;
+		} else {
+			rover = rover->next;
+		}
+	} while ( base->tag || base->size < size );
+
+	extra = base->size - size;
+	if ( extra > ZB_MINFRAGMENT ) {
+		newBlk = ( zbBlock_t * )( (byte *)base + size );
+		newBlk->size = extra;
+		newBlk->tag = 0;
+		newBlk->prev = base;
+		newBlk->next = base->next;
+		newBlk->next->prev = newBlk;
+		base->next = newBlk;
+		base->size = size;
 	}
-	Z_ClearZone( smallzone, s_smallZoneTotal );
+	base->tag = tag;
+	zone->rover = base->next;
+	zone->used += base->size;
+	*( int * )( (byte *)base + base->size - 4 ) = ZONEID;
 
-	// allocate the random block zone
-	cv = Cvar_Get( "com_zoneMegs", DEF_COMZONEMEGS, CVAR_LATCH | CVAR_ARCHIVE );
+	return ( byte * )base + sizeof( memblock_t );
+}
 
-	if ( cv->integer < 16 ) {
-		s_zoneTotal = 1024 * 1024 * 16;
+static void ZB_ZoneFree( zbZone_t *zone, void *ptr ) {
+	zbBlock_t   *block, *other;
+
+	block = ( zbBlock_t * )( (byte *)ptr - sizeof( memblock_t ) );
+	zone->used -= block->size;
+	memset( ptr, 0xaa, block->size - sizeof( memblock_t ) );
+	block->tag = 0;
+
+	other = block->prev;
+	if ( !other->tag ) {
+		other->size += block->size;
+		other->next = block->next;
+		other->next->prev = other;
+		block = other;
+	}
+	zone->rover = block;
+	other = block->next;
+	if ( !other->tag ) {
+		block->size += other->size;
+		block->next = other->next;
+		block->next->prev = block;
+	}
+}
+
+static void *ZB_Alloc( zbAllocator_t *a, int size, int tag ) {
+	void    *ptr;
+
+	if ( a->failed ) {
+		return NULL;
+	}
+	a->ops++;
+	if ( !a->main ) {
+		return Z_TagMalloc( size, tag );
+	}
+	ptr = ZB_ZoneAlloc( tag == TAG_SMALL ? a->small : a->main, size, tag );
+	if ( !ptr ) {
+		a->failed = qtrue;
+	}
+	return ptr;
+}
+
+static void ZB_Free( zbAllocator_t *a, void **ptr ) {
+	zbBlock_t   *block;
+
+	if ( !*ptr ) {
+		return;
+	}
+	a->ops++;
+	if ( !a->main ) {
+		Z_Free( *ptr );
 	} else {
-		s_zoneTotal = cv->integer * 1024 * 1024;
+		block = ( zbBlock_t * )( (byte *)*ptr - sizeof( memblock_t ) );
+		ZB_ZoneFree( block->tag == TAG_SMALL ? a->small : a->main, *ptr );
+	}
+	*ptr = NULL;
+}
+
+static void ZB_Minute( zbAllocator_t *a, zbState_t *s, int minute ) {
+	int i, n, slot, size;
+
+	// configstrings and cvars, mostly short
+	for ( i = 0 ; i < 60 ; i++ ) {
+		slot = ZB_Rand( ZB_STRINGS );
+		n = ZB_Rand( 100 );
+		size = n < 70 ? 4 + ZB_Rand( 28 ) : n < 95 ? 32 + ZB_Rand( 224 ) : 256 + ZB_Rand( 768 );
+		ZB_Free( a, &s->strings[slot] );
+		s->strings[slot] = ZB_Alloc( a, size, TAG_SMALL );
+	}
+
+	// command buffers and the like
+	for ( i = 0 ; i < 200 ; i++ ) {
+		slot = s->transientHead++ % ZB_TRANSIENT;
+		ZB_Free( a, &s->transient[slot] );
+		s->transient[slot] = ZB_Alloc( a, ZB_Size( 16, 2048 ), TAG_GENERAL );
+	}
+
+	// a client joins or leaves
+	slot = ZB_Rand( ZB_CLIENTS );
+	if ( s->clients[slot][0] ) {
+		for ( i = 0 ; i < ZB_CLIENT_BLOCKS ; i++ ) {
+			ZB_Free( a, &s->clients[slot][i] );
+		}
+	} else {
+		s->clients[slot][0] = ZB_Alloc( a, ZB_Size( 12 * 1024, 96 * 1024 ), TAG_GENERAL );
+		for ( i = 1 ; i < ZB_CLIENT_BLOCKS ; i++ ) {
+			s->clients[slot][i] = ZB_Alloc( a, ZB_Size( 32, 1024 ), TAG_GENERAL );
+		}
+	}
+
+	if ( minute % ZB_MAP_MINUTES == 0 ) {
+		for ( i = 0 ; i < ZB_MAP_BLOCKS + ZB_MAP_LARGE ; i++ ) {
+			ZB_Free( a, &s->map[i] );
+		}
+		n = ZB_MAP_BLOCKS / 2 + ZB_Rand( ZB_MAP_BLOCKS / 2 );
+		for ( i = 0 ; i < n ; i++ ) {
+			s->map[i] = ZB_Alloc( a, ZB_Size( 16, 16384 ), TAG_GENERAL );
+		}
+		for ( i = 0 ; i < ZB_MAP_LARGE ; i++ ) {
+			s->map[ZB_MAP_BLOCKS + i] = ZB_Alloc( a, ZB_Size( 32 * 1024, 256 * 1024 ), TAG_GENERAL );
+		}
+	}
+
+	if ( minute % ZB_DEMO_MINUTES == 0 ) {
+		s->demo = ZB_Alloc( a, ZB_Size( 256 * 1024, 1024 * 1024 ), TAG_GENERAL );
+	} else if ( minute % ZB_DEMO_MINUTES == ZB_DEMO_MINUTES / 2 ) {
+		ZB_Free( a, &s->demo );
+	}
+}
+
+static void ZB_FreeAll( zbAllocator_t *a, zbState_t *s ) {
+	int i, j;
+
+	for ( i = 0 ; i < ZB_STRINGS ; i++ ) {
+		ZB_Free( a, &s->strings[i] );
+	}
+	for ( i = 0 ; i < ZB_TRANSIENT ; i++ ) {
+		ZB_Free( a, &s->transient[i] );
+	}
+	for ( i = 0 ; i < ZB_CLIENTS ; i++ ) {
+		for ( j = 0 ; j < ZB_CLIENT_BLOCKS ; j++ ) {
+			ZB_Free( a, &s->clients[i][j] );
+		}
 	}
+	for ( i = 0 ; i < ZB_MAP_BLOCKS + ZB_MAP_LARGE ; i++ ) {
+		ZB_Free( a, &s->map[i] );
+	}
+	ZB_Free( a, &s->demo );
+}
+
+/*
+================
+ZB_Usage
+
+The free fragments of the first fit zone and KB in its largest one, or
+KB in blocks and KB of slabs and big blocks, the rest of the game's
+blocks included
+================
+*/
+static void ZB_Usage( zbAllocator_t *a, int *used, int *held ) {
+	zbBlock_t   *block;
+	zbZone_t    *zone;
+	int64_t bytes;
+	int c;
+
+	*used = *held = 0;
+	if ( !a->main ) {
+		for ( c = 0, bytes = 0 ; c < ZONE_NUM_CLASSES ; c++ ) {
+			bytes += (int64_t)zone_classes[c].used * zone_classes[c].size;
+			*held += zone_classes[c].slabs * ( ZONE_PAGE_SIZE / 1024 );
+		}
+		*used = ( bytes + zone_largeBytes ) / 1024;
+		*held += zone_largeBytes / 1024;
+		return;
+	}
+	zone = a->main;
+	for ( block = zone->blocklist.next ; block != &zone->blocklist ; block = block->next ) {
+		if ( !block->tag ) {
+			( *used )++;
+			if ( block->size / 1024 > *held ) {
+				*held = block->size / 1024;
+			}
+		}
+	}
+}
+
+static void ZB_Run( zbAllocator_t *a, int days ) {
+	int64_t start, usec;
+	int day, minute;
+
+	memset( &zb_state, 0, sizeof( zb_state ) );
+	zb_seed = 0x1d4a11;
+	a->failedDay = days;
+	for ( day = 0 ; day < days ; day++ ) {
+		for ( minute = 0 ; minute < 24 * 60 && !a->failed ; minute++ ) {
+			start = Sys_Microseconds();
+			ZB_Minute( a, &zb_state, minute );
+			usec = Sys_Microseconds() - start;
+			a->usec[day] += usec;
+			if ( usec > a->worst[day] ) {
+				a->worst[day] = usec;
+			}
+		}
+		if ( a->failed ) {
+			a->failedDay = day;
+			break;
+		}
+		ZB_Usage( a, &a->used[day], &a->held[day] );
+	}
+	a->failed = qfalse;
+	ZB_FreeAll( a, &zb_state );
+}
+
+static void ZB_ChurnJob( void *data, int index ) {
+	void    *slots[64];
+	unsigned int seed;
+	int i, s;
+
+	memset( slots, 0, sizeof( slots ) );
+	seed = 0x9e3779b9 * ( index + 1 );
+	for ( i = 0 ; i < ZB_THREAD_OPS ; i++ ) {
+		seed = seed * 1664525 + 1013904223;
+		s = seed >> 26;
+		if ( slots[s] ) {
+			Z_Free( slots[s] );
+		}
+		slots[s] = Z_TagMalloc( 16 + ( ( seed >> 8 ) & 511 ), TAG_GENERAL );
+	}
+	for ( s = 0 ; s < 64 ; s++ ) {
+		if ( slots[s] ) {
+			Z_Free( slots[s] );
+		}
+	}
+}
+
+/*
+================
+Com_ZoneBench_f
 
-	mainzone = malloc( s_zoneTotal );
-	if ( !mainzone ) {
-		Com_Error( ERR_FATAL, "Zone data failed to allocate %i megs", s_zoneTotal / (1024*1024) );
+zonebench [days]
+================
+*/
+static void Com_ZoneBench_f( void ) {
+	static zbAllocator_t firstFit, slabs;
+	int64_t start, serial, pool;
+	double total[2];
+	int days, jobs, i;
+
+	days = Cmd_Argc() > 1 ? atoi( Cmd_Argv( 1 ) ) : 7;
+	if ( days < 1 ) {
+		days = 1;
+	} else if ( days > ZB_MAX_DAYS ) {
+		days = ZB_MAX_DAYS;
+	}
+
+	memset( &firstFit, 0, sizeof( firstFit ) );
+	memset( &slabs, 0, sizeof( slabs ) );
+	firstFit.main = ZB_NewZone( s_zoneTotal );
+	firstFit.small = ZB_NewZone( s_smallZoneTotal );
+	if ( !firstFit.main || !firstFit.small ) {
+		free( firstFit.main );
+		free( firstFit.small );
+		Com_Printf( "zonebench: out of memory\n" );
+		return;
 	}
-	Z_ClearZone( mainzone, s_zoneTotal );
+
+	Com_Printf( "%i days through a %i MB first fit zone and the slabs...\n", days, s_zoneTotal / ( 1024 * 1024 ) );
+	ZB_Run( &firstFit, days );
+	free( firstFit.main );
+	free( firstFit.small );
+	firstFit.main = firstFit.small = NULL;
+
+	ZB_Run( &slabs, days );
+
+	Com_Printf( "         first fit                         slabs\n" );
+	Com_Printf( "day      ms  worst usec  frags  free KB       ms  worst usec  in use KB  held KB\n" );
+	total[0] = total[1] = 0;
+	for ( i = 0 ; i < days ; i++ ) {
+		total[0] += firstFit.usec[i];
+		total[1] += slabs.usec[i];
+		if ( i < firstFit.failedDay ) {
+			Com_Printf( "%3i %7.1f %11i %6i %8i", i + 1, firstFit.usec[i] / 1000.0, firstFit.worst[i], firstFit.used[i], firstFit.held[i] );
+		} else {
+			Com_Printf( "%3i %35s", i + 1, i == firstFit.failedDay ? "out of memory" : "" );
+		}
+		Com_Printf( " %8.1f %11i %10i %8i\n", slabs.usec[i] / 1000.0, slabs.worst[i], slabs.used[i], slabs.held[i] );
+	}
+	if ( firstFit.failedDay == days ) {
+		Com_Printf( "first fit %.0f nsec per call, ", total[0] * 1000.0 / firstFit.ops );
+	}
+	Com_Printf( "slabs %.0f nsec per call over %.0f calls\n", total[1] * 1000.0 / slabs.ops, slabs.ops );
+
+	jobs = Threads_NumWorkers() + 1;
+	start = Sys_Microseconds();
+	ZB_ChurnJob( NULL, 0 );
+	serial = Sys_Microseconds() - start;
+	start = Sys_Microseconds();
+	Threads_RunJobs( ZB_ChurnJob, NULL, jobs );
+	pool = Sys_Microseconds() - start;
+	Com_Printf( "churn: 1 thread %.1f M allocs/sec, %i threads %.1f M allocs/sec\n",
+				ZB_THREAD_OPS / (double)( serial ? serial : 1 ), jobs,
+				jobs * ZB_THREAD_OPS / (double)( pool ? pool : 1 ) );
 }
+
+
+/*
+=================
+Com_InitZoneMemory
+=================
 */
+void Com_InitSmallZoneMemory( void ) {
+	s_smallZoneTotal = 512 * 1024;
+	Z_InitClasses();
+	if ( !Z_AddChunk( s_smallZoneTotal ) ) {
+		Com_Error( ERR_FATAL, "Small zone data failed to allocate %1.1f megs", (float)s_smallZoneTotal / ( 1024 * 1024 ) );
+	}
+
+	return;
+}
+
 void Com_InitZoneMemory( void ) {
 	cvar_t  *cv;
 	// allocate the random block zone
@@ -1430,12 +2117,9 @@ void Com_InitZoneMemory( void ) {
 		s_zoneTotal = cv->integer * 1024 * 1024;
 	}
 
-	// bk001205 - was malloc
-	mainzone = calloc( s_zoneTotal, 1 );
-	if ( !mainzone ) {
+	if ( !Z_AddChunk( s_zoneTotal ) ) {
 		Com_Error( ERR_FATAL, "Zone data failed to allocate %i megs", s_zoneTotal / ( 1024 * 1024 ) );
 	}
-	Z_ClearZone( mainzone, s_zoneTotal );
 
 }
 
@@ -1575,6 +2259,7 @@ void Com_InitHunkMemory( void ) {
 	Hunk_Clear();
 
 	Cmd_AddCommand( "meminfo", Com_Meminfo_f );
+	Cmd_AddCommand( "zonebench", Com_ZoneBench_f );
 #ifdef ZONE_DEBUG
 	Cmd_AddCommand( "zonelog", Z_LogHeap );
 #endif
@@ -2079,7 +2764,7 @@ sysEvent_t  Com_GetEvent( void ) {
 Com_RunAndTimeServerPacket
 =================
 */
-void Com_RunAndTimeServerPacket( netadr_t *evFrom, msg_t *buf ) {
+void Com_RunAndTimeServerPacket( netadr_t *evFrom, msg_t *buf, int time ) {
 	int t1, t2, msec;
 
 	t1 = 0;
@@ -2088,7 +2773,7 @@ void Com_RunAndTimeServerPacket( netadr_t *evFrom, msg_t *buf ) {
 		t1 = Sys_Milliseconds();
 	}
 
-	SV_PacketEvent( *evFrom, buf );
+	SV_PacketEvent( *evFrom, buf, time );
 
 	if ( com_speeds->integer ) {
 		t2 = Sys_Milliseconds();
@@ -2127,7 +2812,7 @@ int Com_EventLoop( void ) {
 			while ( NET_GetLoopPacket( NS_SERVER, &evFrom, &buf ) ) {
 				// if the server just shut down, flush the events
 				if ( com_sv_running->integer ) {
-					Com_RunAndTimeServerPacket( &evFrom, &buf );
+					Com_RunAndTimeServerPacket( &evFrom, &buf, Sys_Milliseconds() );
 				}
 			}
 
@@ -2183,7 +2868,7 @@ int Com_EventLoop( void ) {
 			}
 			memcpy( buf.data, ( byte * )( (netadr_t *)ev.evPtr + 1 ), buf.cursize );
 			if ( com_sv_running->integer ) {
-				Com_RunAndTimeServerPacket( &evFrom, &buf );
+				Com_RunAndTimeServerPacket( &evFrom, &buf, ev.evTime );
 			} else {
 				CL_PacketEvent( evFrom, &buf );
 			}
@@ -2556,12 +3241,18 @@ void Com_Init( char *commandLine ) {
 	}
 	Cmd_AddCommand( "quit", Com_Quit_f );
 	Cmd_AddCommand( "writeconfig", Com_WriteConfig_f );
+	Cmd_AddCommand( "deltatest", MSG_DeltaTest_f );
+	Cmd_AddCommand( "bittest", MSG_BitTest_f );
+	Cmd_AddCommand( "hufftest", DynHuff_Test_f );
+	Cmd_AddCommand( "tracetest", CM_TraceTest_f );
+	Cmd_AddCommand( "cmcache", CM_PatchCache_f );
 
 	s = va( "%s %s %s", Q3_VERSION, CPUSTRING, __DATE__ );
 	com_version = Cvar_Get( "version", s, CVAR_ROM | CVAR_SERVERINFO );
 
 	Sys_Init();
 	Netchan_Init( Com_Milliseconds() & 0xffff );    // pick a port value that should be nice and random
+	MSG_InitDeltaTables();
 	VM_Init();
 	SV_Init();
 
@@ -36,9 +36,11 @@ void JSONW_BeginArray(void);
 void JSONW_BeginNamedArray(const char* name);
 void JSONW_EndArray(void);
 void JSONW_IntegerValue(const char* name, int number);
+void JSONW_NumberValue(const char* name, double number);
 void JSONW_HexValue(const char* name, uint64_t number);
 void JSONW_BooleanValue(const char* name, qbool value);
 void JSONW_StringValue(const char* name, PRINTF_FORMAT_STRING const char* format, ...);
 void JSONW_UnnamedHex(uint64_t number);
 void JSONW_UnnamedString(PRINTF_FORMAT_STRING const char* format, ...);
+void JSONW_UnnamedNumber(double number);
 
@@ -39,6 +39,7 @@ If you have questions concerning this license or the applicable additional terms
 #include "../game/q_shared.h"
 #include "qcommon.h"
 #include "unzip.h"
+#include "threads.h"
 
 /*
 =============================================================================
@@ -217,6 +218,18 @@ or configs will never get loaded from disk!
 #define MAX_ZPATH           256
 #define MAX_SEARCH_PATHS    4096
 #define MAX_FILEHASH_SIZE   1024
+#define MAX_FOUND_FILES     0x1000
+
+#define FS_NOT_FOUND        -2
+#define FS_INDEX_STALE      -3
+
+typedef struct pakMapping_s {
+	byte                    *base;
+	int size;
+	int refs;                           // FS_ReadFile buffers pointing into it
+	qboolean closed;                    // the pk3 is gone, unmapped once refs gets to 0
+	struct pakMapping_s     *next;
+} pakMapping_t;
 
 typedef struct fileInPack_s {
 	char                    *name;      // name of the file
@@ -236,6 +249,8 @@ typedef struct {
 	int hashSize;                               // hash table size (power of 2)
 	fileInPack_t*   *hashTable;                 // hash table
 	fileInPack_t*   buildBuffer;                // buffer with the filenames etc.
+	pakMapping_t    *mapping;                   // NULL until a read maps it in
+	qboolean mapFailed;
 } pack_t;
 
 typedef struct {
@@ -259,6 +274,9 @@ static cvar_t      *fs_cdpath;
 static cvar_t      *fs_copyfiles;
 static cvar_t      *fs_gamedirvar;
 static cvar_t      *fs_restrict;
+static cvar_t      *fs_index;
+static cvar_t      *fs_mapPaks;
+static cvar_t      *fs_inflate;
 static searchpath_t    *fs_searchpaths;
 static int fs_readCount;                    // total bytes read
 static int fs_loadCount;                    // total files read
@@ -286,11 +304,14 @@ typedef struct {
 	int zipFilePos;
 	qboolean zipFile;
 	qboolean streamed;
+	pack_t      *pak;
 	char name[MAX_ZPATH];
 } fileHandleData_t;
 
 static fileHandleData_t fsh[MAX_FILE_HANDLES];
 
+static void FS_IndexWrittenFile( const char *filename );
+
 // TTimo - show_bug.cgi?id=540
 // wether we did a reorder on the current search path when joining the server
 static qboolean fs_reordered;
@@ -805,6 +826,7 @@ void FS_Rename( const char *from, const char *to ) {
 		FS_CopyFile( from_ospath, to_ospath );
 		FS_Remove( from_ospath );
 	}
+	FS_IndexWrittenFile( to );
 }
 
 /*
@@ -878,6 +900,8 @@ fileHandle_t FS_FOpenFileWrite( const char *filename ) {
 	fsh[f].handleSync = qfalse;
 	if ( !fsh[f].handleFiles.file.o ) {
 		f = 0;
+	} else {
+		FS_IndexWrittenFile( filename );
 	}
 	return f;
 }
@@ -918,6 +942,8 @@ fileHandle_t FS_FOpenFileAppend( const char *filename ) {
 	fsh[f].handleSync = qfalse;
 	if ( !fsh[f].handleFiles.file.o ) {
 		f = 0;
+	} else {
+		FS_IndexWrittenFile( filename );
 	}
 	return f;
 }
@@ -994,275 +1020,949 @@ char *FS_ShiftStr( const char *string, int shift ) {
 
 /*
 ===========
-FS_FOpenFileRead
+FS_FindInPack
 
-Finds the file in the search path.
-Returns filesize and an open FILE pointer.
-Used for streaming data out of either a
-separate file or a ZIP file.
+Case and separator insensitive lookup in the pk3's own hash
 ===========
 */
-extern qboolean com_fullyInitialized;
+static fileInPack_t *FS_FindInPack( pack_t *pak, const char *filename ) {
+	fileInPack_t    *pakFile;
 
-// see FS_FOpenFileRead_Filtered
-static int fs_filter_flag = 0;
+	for ( pakFile = pak->hashTable[FS_HashFileName( filename, pak->hashSize )] ; pakFile ; pakFile = pakFile->next ) {
+		if ( !FS_FilenameCompare( pakFile->name, filename ) ) {
+			return pakFile;
+		}
+	}
+	return NULL;
+}
 
-int FS_FOpenFileRead( const char *filename, fileHandle_t *file, qboolean uniqueFILE ) {
-	searchpath_t    *search;
-	char            *netpath;
-	pack_t          *pak;
-	fileInPack_t    *pakFile;
-	directory_t     *dir;
-	long hash;
+/*
+===========
+FS_DirFileAllowed
+
+If we are running restricted, or if the filesystem is configured for pure (fs_numServerPaks)
+the only files we will allow to come from the directory are .cfg files
+===========
+*/
+static qboolean FS_DirFileAllowed( const char *filename ) {
+	char demoExt[16];
+	int l;
+
+	if ( !fs_restrict->integer && !fs_numServerPaks ) {
+		return qtrue;
+	}
+
+	Com_sprintf( demoExt, sizeof( demoExt ), ".dm_%d",PROTOCOL_VERSION );
+	l = strlen( filename );
+	if ( Q_stricmp( filename + l - 4, ".cfg" )       // for config files
+		 && Q_stricmp( filename + l - 5, ".menu" )  // menu files
+		 && Q_stricmp( filename + l - 5, ".game" )  // menu files
+		 && Q_stricmp( filename + l - strlen( demoExt ), demoExt ) // menu files
+		 && Q_stricmp( filename + l - 4, ".dat" ) ) { // for journal files
+		return qfalse;
+	}
+	return qtrue;
+}
+
+/*
+===========
+FS_OpenFileInPack
+
+Opens a file that has been found in a pk3, returns its size
+===========
+*/
+static int FS_OpenFileInPack( pack_t *pak, fileInPack_t *pakFile, const char *filename, fileHandle_t *file, qboolean uniqueFILE ) {
 	unz_s           *zfi;
 	FILE            *temp;
 	int l;
+
+	// mark the pak as having been referenced and mark specifics on cgame and ui
+	// shaders, txt, arena files  by themselves do not count as a reference as
+	// these are loaded from all pk3s
+	// from every pk3 file..
+	l = strlen( filename );
+	if ( !( pak->referenced & FS_GENERAL_REF ) ) {
+		if ( Q_stricmp( filename + l - 7, ".shader" ) != 0 &&
+			 Q_stricmp( filename + l - 4, ".txt" ) != 0 &&
+			 Q_stricmp( filename + l - 4, ".cfg" ) != 0 &&
+			 Q_stricmp( filename + l - 7, ".config" ) != 0 &&
+			 strstr( filename, "levelshots" ) == NULL &&
+			 Q_stricmp( filename + l - 4, ".bot" ) != 0 &&
+			 Q_stricmp( filename + l - 6, ".arena" ) != 0 &&
+			 Q_stricmp( filename + l - 5, ".menu" ) != 0 ) {
+			pak->referenced |= FS_GENERAL_REF;
+		}
+	}
+
+	// for OS client/server interoperability, we expect binaries for .so and .dll to be in the same pk3
+	// so that when we reference the DLL files on any platform, this covers everyone else
+
+  #if 0 // TTimo: use that stuff for shitted strings
+	Com_Printf( "SYS_DLLNAME_QAGAME + %d: '%s'\n", SYS_DLLNAME_QAGAME_SHIFT, FS_ShiftStr( "qagame_mp_x86.dll" /*"qagame.mp.i386.so"*/, SYS_DLLNAME_QAGAME_SHIFT ) );
+	Com_Printf( "SYS_DLLNAME_CGAME + %d: '%s'\n", SYS_DLLNAME_CGAME_SHIFT, FS_ShiftStr( "cgame_mp_x86.dll" /*"cgame.mp.i386.so"*/, SYS_DLLNAME_CGAME_SHIFT ) );
+	Com_Printf( "SYS_DLLNAME_UI + %d: '%s'\n", SYS_DLLNAME_UI_SHIFT, FS_ShiftStr( "ui_mp_x86.dll" /*"ui.mp.i386.so"*/, SYS_DLLNAME_UI_SHIFT ) );
+  #endif
+	// qagame dll
+	if ( !( pak->referenced & FS_QAGAME_REF ) && FS_ShiftedStrStr( filename, SYS_DLLNAME_QAGAME, -SYS_DLLNAME_QAGAME_SHIFT ) ) {
+		pak->referenced |= FS_QAGAME_REF;
+	}
+	// cgame dll
+	if ( !( pak->referenced & FS_CGAME_REF ) && FS_ShiftedStrStr( filename, SYS_DLLNAME_CGAME, -SYS_DLLNAME_CGAME_SHIFT ) ) {
+		pak->referenced |= FS_CGAME_REF;
+	}
+	// ui dll
+	if ( !( pak->referenced & FS_UI_REF ) && FS_ShiftedStrStr( filename, SYS_DLLNAME_UI, -SYS_DLLNAME_UI_SHIFT ) ) {
+		pak->referenced |= FS_UI_REF;
+	}
+
+#if !defined( PRE_RELEASE_DEMO ) && !defined( DO_LIGHT_DEDICATED )
+	// DHM -- Nerve :: Don't allow maps to be loaded from pak0 (singleplayer)
+	if ( Q_stricmp( filename + l - 4, ".bsp" ) == 0 &&
+		 Q_stricmp( pak->pakBasename, "pak0" ) == 0 ) {
+
+		*file = 0;
+		return -1;
+	}
+#endif
+
+	if ( uniqueFILE ) {
+		// open a new file on the pakfile
+		fsh[*file].handleFiles.file.z = unzReOpen( pak->pakFilename, pak->handle );
+		if ( fsh[*file].handleFiles.file.z == NULL ) {
+			Com_Error( ERR_FATAL, "Couldn't reopen %s", pak->pakFilename );
+		}
+	} else {
+		fsh[*file].handleFiles.file.z = pak->handle;
+	}
+	Q_strncpyz( fsh[*file].name, filename, sizeof( fsh[*file].name ) );
+	fsh[*file].zipFile = qtrue;
+	fsh[*file].pak = pak;
+	zfi = (unz_s *)fsh[*file].handleFiles.file.z;
+	// in case the file was new
+	temp = zfi->file;
+	// set the file position in the zip file (also sets the current file info)
+	unzSetCurrentFileInfoPosition( pak->handle, pakFile->pos );
+	// copy the file info into the unzip structure
+	Com_Memcpy( zfi, pak->handle, sizeof( unz_s ) );
+	// we copy this back into the structure
+	zfi->file = temp;
+	// open the file in the zip
+	unzOpenCurrentFile( fsh[*file].handleFiles.file.z );
+	fsh[*file].zipFilePos = pakFile->pos;
+
+	if ( fs_debug->integer ) {
+		Com_Printf( "FS_FOpenFileRead: %s (found in '%s')\n",
+					filename, pak->pakFilename );
+	}
+	return zfi->cur_file_info.uncompressed_size;
+}
+
+/*
+===========
+FS_OpenFileInDir
+
+Returns the size, or FS_NOT_FOUND if the directory doesn't have it
+===========
+*/
+static int FS_OpenFileInDir( directory_t *dir, const char *filename, fileHandle_t *file ) {
+	char            *netpath;
 	char demoExt[16];
+	int l;
 
-	hash = 0;
+	netpath = FS_BuildOSPath( dir->path, dir->gamedir, filename );
+	fsh[*file].handleFiles.file.o = fopen( netpath, "rb" );
+	if ( !fsh[*file].handleFiles.file.o ) {
+		return FS_NOT_FOUND;
+	}
 
-	if ( !fs_searchpaths ) {
-		Com_Error( ERR_FATAL, "Filesystem call made without initialization\n" );
+	Com_sprintf( demoExt, sizeof( demoExt ), ".dm_%d",PROTOCOL_VERSION );
+	l = strlen( filename );
+	if ( Q_stricmp( filename + l - 4, ".cfg" )       // for config files
+		 && Q_stricmp( filename + l - 5, ".menu" )  // menu files
+		 && Q_stricmp( filename + l - 5, ".game" )  // menu files
+		 && Q_stricmp( filename + l - strlen( demoExt ), demoExt ) // menu files
+		 && Q_stricmp( filename + l - 4, ".dat" ) ) { // for journal files
+		fs_fakeChkSum = random();
 	}
 
-	// TTimo - NOTE
-	// when checking for file existence, it's probably safer to use FS_FileExists, as I'm not
-	// sure this chunk of code is really up to date with everything
-	if ( file == NULL ) {
-		// just wants to see if file is there
-		for ( search = fs_searchpaths ; search ; search = search->next ) {
-			//
-			if ( search->pack ) {
-				hash = FS_HashFileName( filename, search->pack->hashSize );
+	Q_strncpyz( fsh[*file].name, filename, sizeof( fsh[*file].name ) );
+	fsh[*file].zipFile = qfalse;
+	if ( fs_debug->integer ) {
+		Com_Printf( "FS_FOpenFileRead: %s (found in '%s/%s')\n", filename,
+					dir->path, dir->gamedir );
+	}
+
+	// if we are getting it from the cdpath, optionally copy it
+	//  to the basepath
+	if ( fs_copyfiles->integer && !Q_stricmp( dir->path, fs_cdpath->string ) ) {
+		char    *copypath;
+
+		copypath = FS_BuildOSPath( fs_basepath->string, dir->gamedir, filename );
+		FS_CopyFile( netpath, copypath );
+	}
+
+	return FS_filelength( *file );
+}
+
+// see FS_FOpenFileRead_Filtered
+static int fs_filter_flag = 0;
+
+/*
+===========
+FS_SearchOpenFile
+
+Walks the search path one element at a time
+===========
+*/
+static int FS_SearchOpenFile( const char *filename, fileHandle_t *file, qboolean uniqueFILE ) {
+	searchpath_t    *search;
+	fileInPack_t    *pakFile;
+	int len;
+
+	for ( search = fs_searchpaths ; search ; search = search->next ) {
+		if ( search->pack ) {
+			if ( fs_filter_flag & FS_EXCLUDE_PK3 ) {
+				continue;
 			}
-			// is the element a pak file?
-			if ( search->pack && search->pack->hashTable[hash] ) {
-				if ( fs_filter_flag & FS_EXCLUDE_PK3 ) {
-					continue;
-				}
+			// disregard if it doesn't match one of the allowed pure pak files
+			if ( !FS_PakIsPure( search->pack ) ) {
+				continue;
+			}
+			pakFile = FS_FindInPack( search->pack, filename );
+			if ( pakFile ) {
+				return FS_OpenFileInPack( search->pack, pakFile, filename, file, uniqueFILE );
+			}
+		} else if ( search->dir ) {
+			if ( fs_filter_flag & FS_EXCLUDE_DIR ) {
+				continue;
+			}
+			if ( !FS_DirFileAllowed( filename ) ) {
+				continue;
+			}
+			len = FS_OpenFileInDir( search->dir, filename, file );
+			if ( len != FS_NOT_FOUND ) {
+				return len;
+			}
+		}
+	}
+	return FS_NOT_FOUND;
+}
 
-				// look through all the pak file elements
-				pak = search->pack;
-				pakFile = pak->hashTable[hash];
-				do {
-					// case and separator insensitive comparisons
-					if ( !FS_FilenameCompare( pakFile->name, filename ) ) {
-						// found it!
-						return qtrue;
-					}
-					pakFile = pakFile->next;
-				} while ( pakFile != NULL );
-			} else if ( search->dir ) {
-				if ( fs_filter_flag & FS_EXCLUDE_DIR ) {
-					continue;
-				}
+/*
+=================================================================================
 
-				dir = search->dir;
+FILE INDEX
 
-				netpath = FS_BuildOSPath( dir->path, dir->gamedir, filename );
-				temp = fopen( netpath, "rb" );
-				if ( !temp ) {
-					continue;
+Walking the search path costs a hash probe in every pk3 and an fopen in
+every directory ahead of the one that has the file, for each file opened.
+The index merges all of them into one table, built in FS_Startup, that
+says for every name which pure pk3 and which directory come first with
+it.  Directories are listed for it once, files written through FS_ go
+in as they are made.  Anything else that turns up in a directory while
+running is seen once the index is flushed, which every map change does,
+or with fs_index 0.
+
+A directory with too many files to list is still probed with fopen, so
+is one that had a file removed since the index was built.
+
+=================================================================================
+*/
+
+#define FS_INDEX_SPARE_FILES    1024        // room for files written while running
+#define FS_INDEX_SPARE_NAMES    ( FS_INDEX_SPARE_FILES * 32 )
+
+typedef struct {
+	const char      *name;
+	fileInPack_t    *pakFile;
+	short pak;                              // search order of the first pure pk3 to have it, -1 for none
+	short dir;                              // search order of the first directory to have it, -1 for none
+	int next;                               // in the hash chain, -1 ends it
+} fileIndex_t;
+
+typedef struct {
+	searchpath_t    **paths;                // by search order
+	int numPaths;
+	short           *unlisted;              // directories that couldn't be listed, by search order
+	int numUnlisted;
+
+	int             *hashTable;             // first entry of each chain
+	int hashSize;
+	fileIndex_t     *entries;
+	int numEntries;
+	int maxEntries;
+	char            *names;                 // the names of files only found in directories
+	int namesUsed;
+	int namesSize;
+
+	int bytes;
+	int buildMsec;
+} fileIndexData_t;
+
+static fileIndexData_t fs_fileIndex;
+
+/*
+================
+FS_IndexHashName
+
+Ignores case and separators like FS_FilenameCompare, the extension counts
+================
+*/
+static unsigned FS_IndexHashName( const char *fname ) {
+	unsigned hash;
+	int c;
+
+	hash = 2166136261u;
+	for ( ; *fname ; fname++ ) {
+		c = tolower( *fname );
+		if ( c == '\\' || c == PATH_SEP ) {
+			c = '/';
+		}
+		hash = ( hash ^ c ) * 16777619u;
+	}
+	return hash;
+}
+
+static fileIndex_t *FS_IndexFind( const char *filename ) {
+	fileIndex_t *entry;
+	int i;
+
+	for ( i = fs_fileIndex.hashTable[FS_IndexHashName( filename ) & ( fs_fileIndex.hashSize - 1 )] ; i >= 0 ; i = entry->next ) {
+		entry = &fs_fileIndex.entries[i];
+		if ( !FS_FilenameCompare( entry->name, filename ) ) {
+			return entry;
+		}
+	}
+	return NULL;
+}
+
+static fileIndex_t *FS_IndexAdd( const char *name ) {
+	fileIndex_t *entry;
+	int hash;
+
+	if ( fs_fileIndex.numEntries == fs_fileIndex.maxEntries ) {
+		return NULL;
+	}
+	hash = FS_IndexHashName( name ) & ( fs_fileIndex.hashSize - 1 );
+	entry = &fs_fileIndex.entries[fs_fileIndex.numEntries];
+	entry->name = name;
+	entry->pakFile = NULL;
+	entry->pak = -1;
+	entry->dir = -1;
+	entry->next = fs_fileIndex.hashTable[hash];
+	fs_fileIndex.hashTable[hash] = fs_fileIndex.numEntries++;
+	return entry;
+}
+
+/*
+================
+FS_IndexAddDirFile
+
+Notes that the directory at search order dir has the file
+================
+*/
+static qboolean FS_IndexAddDirFile( const char *name, int dir ) {
+	fileIndex_t *entry;
+	char        *copy;
+	int len;
+
+	// the directory listings start with a separator
+	while ( *name == '/' || *name == '\\' ) {
+		name++;
+	}
+	if ( !*name ) {
+		return qtrue;
+	}
+
+	entry = FS_IndexFind( name );
+	if ( !entry ) {
+		len = strlen( name ) + 1;
+		if ( fs_fileIndex.namesUsed + len > fs_fileIndex.namesSize ) {
+			return qfalse;
+		}
+		copy = fs_fileIndex.names + fs_fileIndex.namesUsed;
+		memcpy( copy, name, len );
+		entry = FS_IndexAdd( copy );
+		if ( !entry ) {
+			return qfalse;
+		}
+		fs_fileIndex.namesUsed += len;
+	}
+	if ( entry->dir < 0 || entry->dir > dir ) {
+		entry->dir = dir;
+	}
+	return qtrue;
+}
+
+/*
+================
+FS_FreeFileIndex
+
+The next FS_FOpenFileRead builds it again
+================
+*/
+static void FS_FreeFileIndex( void ) {
+	free( fs_fileIndex.paths );
+	free( fs_fileIndex.entries );
+	Com_Memset( &fs_fileIndex, 0, sizeof( fs_fileIndex ) );
+}
+
+/*
+================
+FS_BuildFileIndex
+================
+*/
+static void FS_BuildFileIndex( void ) {
+	searchpath_t    *search;
+	fileIndex_t     *entry;
+	char            **lists[MAX_SEARCH_PATHS];
+	char            *ospath;
+	int numListed[MAX_SEARCH_PATHS];
+	int i, j, numFiles, namesSize, start;
+
+	FS_FreeFileIndex();
+	start = Sys_Milliseconds();
+
+	for ( search = fs_searchpaths ; search ; search = search->next ) {
+		fs_fileIndex.numPaths++;
+	}
+	if ( fs_fileIndex.numPaths > MAX_SEARCH_PATHS ) {
+		return;
+	}
+
+	// list the directories, and count what goes in
+	numFiles = FS_INDEX_SPARE_FILES;
+	namesSize = FS_INDEX_SPARE_NAMES;
+	for ( search = fs_searchpaths, i = 0 ; search ; search = search->next, i++ ) {
+		lists[i] = NULL;
+		numListed[i] = 0;
+		if ( search->pack ) {
+			if ( FS_PakIsPure( search->pack ) ) {
+				numFiles += search->pack->numfiles;
+			}
+			continue;
+		}
+		ospath = FS_BuildOSPath( search->dir->path, search->dir->gamedir, "" );
+		ospath[ strlen( ospath ) - 1 ] = 0; // strip the trailing slash
+		lists[i] = Sys_ListFiles( ospath, NULL, "*", &numListed[i], qfalse );
+		numFiles += numListed[i];
+		for ( j = 0 ; j < numListed[i] ; j++ ) {
+			namesSize += strlen( lists[i][j] ) + 1;
+		}
+	}
+
+	for ( fs_fileIndex.hashSize = 1 ; fs_fileIndex.hashSize < numFiles ; fs_fileIndex.hashSize <<= 1 ) {
+	}
+	fs_fileIndex.maxEntries = numFiles;
+	fs_fileIndex.namesSize = namesSize;
+	fs_fileIndex.bytes = fs_fileIndex.numPaths * ( sizeof( searchpath_t * ) + sizeof( short ) ) +
+						 fs_fileIndex.hashSize * sizeof( int ) + numFiles * sizeof( fileIndex_t ) + namesSize;
+
+	// the entries, hash table and names are one block, the paths another
+	fs_fileIndex.paths = malloc( fs_fileIndex.numPaths * ( sizeof( searchpath_t * ) + sizeof( short ) ) );
+	fs_fileIndex.entries = malloc( numFiles * sizeof( fileIndex_t ) + fs_fileIndex.hashSize * sizeof( int ) + namesSize );
+	if ( !fs_fileIndex.paths || !fs_fileIndex.entries ) {
+		Com_Printf( S_COLOR_YELLOW "WARNING: no memory for a %i file index\n", numFiles );
+		FS_FreeFileIndex();
+		goto freelists;
+	}
+	fs_fileIndex.unlisted = (short *)( fs_fileIndex.paths + fs_fileIndex.numPaths );
+	fs_fileIndex.hashTable = (int *)( fs_fileIndex.entries + numFiles );
+	fs_fileIndex.names = (char *)( fs_fileIndex.hashTable + fs_fileIndex.hashSize );
+	for ( i = 0 ; i < fs_fileIndex.hashSize ; i++ ) {
+		fs_fileIndex.hashTable[i] = -1;
+	}
+
+	for ( search = fs_searchpaths, i = 0 ; search ; search = search->next, i++ ) {
+		fs_fileIndex.paths[i] = search;
+
+		if ( search->pack ) {
+			if ( !FS_PakIsPure( search->pack ) ) {
+				continue;
+			}
+			for ( j = 0 ; j < search->pack->numfiles ; j++ ) {
+				entry = FS_IndexFind( search->pack->buildBuffer[j].name );
+				if ( !entry ) {
+					entry = FS_IndexAdd( search->pack->buildBuffer[j].name );
+				}
+				if ( entry->pak < 0 ) {
+					entry->pak = i;
+					entry->pakFile = &search->pack->buildBuffer[j];
 				}
-				fclose( temp );
-				return qtrue;
 			}
+			continue;
+		}
+
+		// the listing stops short of everything in a big directory
+		if ( numListed[i] >= MAX_FOUND_FILES - 1 ) {
+			fs_fileIndex.unlisted[fs_fileIndex.numUnlisted++] = i;
+			continue;
 		}
+		for ( j = 0 ; j < numListed[i] ; j++ ) {
+			FS_IndexAddDirFile( lists[i][j], i );
+		}
+	}
+
+	fs_fileIndex.buildMsec = Sys_Milliseconds() - start;
+
+freelists:
+	for ( search = fs_searchpaths, i = 0 ; search ; search = search->next, i++ ) {
+		if ( lists[i] ) {
+			Sys_FreeFileList( lists[i] );
+		}
+	}
+}
+
+/*
+================
+FS_FileIndexReady
+================
+*/
+static qboolean FS_FileIndexReady( void ) {
+	if ( !fs_index || !fs_index->integer ) {
 		return qfalse;
 	}
+	if ( !fs_fileIndex.entries ) {
+		FS_BuildFileIndex();
+	}
+	return fs_fileIndex.entries != NULL;
+}
 
-	if ( !filename ) {
-		Com_Error( ERR_FATAL, "FS_FOpenFileRead: NULL 'filename' parameter passed\n" );
+/*
+================
+FS_IndexWrittenFile
+
+A file has been written to fs_homepath/fs_gamedir
+================
+*/
+static void FS_IndexWrittenFile( const char *filename ) {
+	directory_t *dir;
+	int i;
+
+	if ( !fs_fileIndex.entries ) {
+		return;
 	}
+	for ( i = 0 ; i < fs_fileIndex.numPaths ; i++ ) {
+		dir = fs_fileIndex.paths[i]->dir;
+		if ( dir && !Q_stricmp( dir->path, fs_homepath->string ) && !Q_stricmp( dir->gamedir, fs_gamedir ) ) {
+			break;
+		}
+	}
+	if ( i == fs_fileIndex.numPaths || !FS_IndexAddDirFile( filename, i ) ) {
+		// out of room, or written outside of the search path
+		FS_FreeFileIndex();
+	}
+}
 
-	Com_sprintf( demoExt, sizeof( demoExt ), ".dm_%d",PROTOCOL_VERSION );
-	// qpaths are not supposed to have a leading slash
-	if ( filename[0] == '/' || filename[0] == '\\' ) {
-		filename++;
+/*
+===========
+FS_IndexOpenFile
+
+Opens the file from wherever the index says it is first found, returns
+FS_INDEX_STALE when that turns out to be wrong
+===========
+*/
+static int FS_IndexOpenFile( const char *filename, fileHandle_t *file, qboolean uniqueFILE ) {
+	fileIndex_t *entry;
+	qboolean dirAllowed;
+	int i, pak, dir, len;
+
+	dirAllowed = !( fs_filter_flag & FS_EXCLUDE_DIR ) && FS_DirFileAllowed( filename );
+
+	pak = dir = fs_fileIndex.numPaths;
+	entry = FS_IndexFind( filename );
+	if ( entry ) {
+		if ( entry->pak >= 0 && !( fs_filter_flag & FS_EXCLUDE_PK3 ) ) {
+			pak = entry->pak;
+		}
+		if ( entry->dir >= 0 && dirAllowed ) {
+			dir = entry->dir;
+		}
 	}
 
-	// make absolutely sure that it can't back up the path.
-	// The searchpaths do guarantee that something will always
-	// be prepended, so we don't need to worry about "c:" or "//limbo"
-	if ( strstr( filename, ".." ) || strstr( filename, "::" ) ) {
-		*file = 0;
-		return -1;
+	if ( dirAllowed ) {
+		for ( i = 0 ; i < fs_fileIndex.numUnlisted ; i++ ) {
+			if ( fs_fileIndex.unlisted[i] > pak || fs_fileIndex.unlisted[i] > dir ) {
+				break;
+			}
+			len = FS_OpenFileInDir( fs_fileIndex.paths[fs_fileIndex.unlisted[i]]->dir, filename, file );
+			if ( len != FS_NOT_FOUND ) {
+				return len;
+			}
+		}
 	}
 
-	// make sure the q3key file is only readable by the quake3.exe at initialization
-	// any other time the key should only be accessed in memory using the provided functions
-	if ( com_fullyInitialized && strstr( filename, "rtcwkey" ) ) {
-		*file = 0;
-		return -1;
+	if ( dir < pak ) {
+		len = FS_OpenFileInDir( fs_fileIndex.paths[dir]->dir, filename, file );
+		if ( len == FS_NOT_FOUND ) {
+			return FS_INDEX_STALE;
+		}
+		return len;
+	}
+	if ( pak < fs_fileIndex.numPaths ) {
+		return FS_OpenFileInPack( fs_fileIndex.paths[pak]->pack, entry->pakFile, filename, file, uniqueFILE );
 	}
+	return FS_NOT_FOUND;
+}
 
-	//
-	// search through the path, one element at a time
-	//
+/*
+================
+FS_IndexInfo
+================
+*/
+static void FS_IndexInfo( void ) {
+	if ( !fs_fileIndex.entries ) {
+		Com_Printf( "no file index\n" );
+		return;
+	}
+	Com_Printf( "%i names in the file index, %i search paths, %i KB, built in %i msec\n",
+				fs_fileIndex.numEntries, fs_fileIndex.numPaths, fs_fileIndex.bytes / 1024, fs_fileIndex.buildMsec );
+	if ( fs_fileIndex.numUnlisted ) {
+		Com_Printf( "%i directories too big to list\n", fs_fileIndex.numUnlisted );
+	}
+}
 
-	*file = FS_HandleForFile();
-	fsh[*file].handleFiles.unique = uniqueFILE;
+/*
+=================================================================================
+
+OPEN BENCHMARK
+
+=================================================================================
+*/
+
+#define FS_BENCH_NAMES      8192
+#define FS_BENCH_ROUNDS     3
+
+static char ( *fs_benchNames )[MAX_QPATH];
+static int fs_benchNumNames;
+static qboolean fs_benchRecording;
+
+static void FS_ReadBench( void );
+static void FS_InflateBench( void );
 
+static void FS_BenchRecord( const char *filename ) {
+	if ( fs_benchRecording && fs_benchNumNames < FS_BENCH_NAMES ) {
+		Q_strncpyz( fs_benchNames[fs_benchNumNames++], filename, MAX_QPATH );
+	}
+}
+
+/*
+================
+FS_BenchSampleNames
+
+Without a recording, a spread of the files in the pure pk3s, each one
+asked for again with another image extension, like the renderer does
+================
+*/
+static void FS_BenchSampleNames( void ) {
+	searchpath_t    *search;
+	char            *name, *ext;
+	int total, step, i, n;
+
+	total = 0;
 	for ( search = fs_searchpaths ; search ; search = search->next ) {
-		//
-		if ( search->pack ) {
-			hash = FS_HashFileName( filename, search->pack->hashSize );
+		if ( search->pack && FS_PakIsPure( search->pack ) ) {
+			total += search->pack->numfiles;
 		}
-		// is the element a pak file?
-		if ( search->pack && search->pack->hashTable[hash] ) {
-			if ( fs_filter_flag & FS_EXCLUDE_PK3 ) {
+	}
+	step = total / ( FS_BENCH_NAMES / 2 ) + 1;
+
+	n = 0;
+	for ( search = fs_searchpaths ; search ; search = search->next ) {
+		if ( !search->pack || !FS_PakIsPure( search->pack ) ) {
+			continue;
+		}
+		for ( i = 0 ; i < search->pack->numfiles ; i++ ) {
+			if ( n++ % step || fs_benchNumNames + 2 > FS_BENCH_NAMES ) {
 				continue;
 			}
+			name = search->pack->buildBuffer[i].name;
+			Q_strncpyz( fs_benchNames[fs_benchNumNames++], name, MAX_QPATH );
+			Q_strncpyz( fs_benchNames[fs_benchNumNames], name, MAX_QPATH );
+			COM_StripExtension( fs_benchNames[fs_benchNumNames], fs_benchNames[fs_benchNumNames] );
+			ext = strrchr( name, '.' );
+			COM_DefaultExtension( fs_benchNames[fs_benchNumNames], MAX_QPATH,
+								  ext && !Q_stricmp( ext, ".tga" ) ? ".jpg" : ".tga" );
+			fs_benchNumNames++;
+		}
+	}
+}
 
-			// disregard if it doesn't match one of the allowed pure pak files
-			if ( !FS_PakIsPure( search->pack ) ) {
-				continue;
+static int QDECL FS_BenchCompare( const void *a, const void *b ) {
+	return *(const int *)a - *(const int *)b;
+}
+
+/*
+================
+FS_BenchOpens
+
+Opens and closes every name, the times go in usec
+================
+*/
+static void FS_BenchOpens( int *usec, int *sizes, int *found ) {
+	fileHandle_t f;
+	int64_t start;
+	int i;
+
+	*found = 0;
+	for ( i = 0 ; i < fs_benchNumNames ; i++ ) {
+		start = Sys_Microseconds();
+		sizes[i] = FS_FOpenFileRead( fs_benchNames[i], &f, qfalse );
+		if ( f ) {
+			FS_FCloseFile( f );
+			( *found )++;
+		}
+		usec[i] = Sys_Microseconds() - start;
+	}
+}
+
+static void FS_BenchReport( const char *label, int *usec, int count, int found ) {
+	int64_t total;
+	int i;
+
+	qsort( usec, count, sizeof( usec[0] ), FS_BenchCompare );
+	for ( i = 0, total = 0 ; i < count ; i++ ) {
+		total += usec[i];
+	}
+	Com_Printf( "%-12s %8.1f %8.2f %6i %6i %6i %7i\n", label, total / 1000.0 / FS_BENCH_ROUNDS,
+				(double)total / count, usec[count / 2], usec[( count * 99 ) / 100], usec[count - 1], found );
+}
+
+/*
+================
+FS_OpenBench_f
+
+fsbench [record | stop | read | inflate [workers]]
+
+Times FS_FOpenFileRead with the file index and with the search path walk.
+"fsbench record", a map load and "fsbench" gives the opens of that map
+load, without a recording a sample of the pk3 contents is used.
+"fsbench read" times FS_ReadFile of the same files instead, with and
+without mapped pk3s.  "fsbench inflate" decodes every member of the
+stock pk3s with each inflate backend.
+================
+*/
+static void FS_OpenBench_f( void ) {
+	searchpath_t    *search;
+	char indexValue[MAX_CVAR_VALUE_STRING];
+	int             *walkUsec, *indexUsec, *walkSizes, *indexSizes;
+	int             *referenced;
+	int i, r, n, walkFound, indexFound, mismatches;
+
+	if ( !fs_benchNames ) {
+		fs_benchNames = malloc( FS_BENCH_NAMES * sizeof( *fs_benchNames ) );
+		if ( !fs_benchNames ) {
+			Com_Printf( "fsbench: out of memory\n" );
+			return;
+		}
+	}
+
+	if ( !Q_stricmp( Cmd_Argv( 1 ), "record" ) ) {
+		fs_benchNumNames = 0;
+		fs_benchRecording = qtrue;
+		Com_Printf( "Recording file opens, \"fsbench\" to replay them\n" );
+		return;
+	}
+	if ( !Q_stricmp( Cmd_Argv( 1 ), "stop" ) ) {
+		fs_benchRecording = qfalse;
+		Com_Printf( "%i file opens recorded\n", fs_benchNumNames );
+		return;
+	}
+	if ( !Q_stricmp( Cmd_Argv( 1 ), "inflate" ) ) {
+		FS_InflateBench();
+		return;
+	}
+
+	fs_benchRecording = qfalse;
+	if ( !fs_benchNumNames ) {
+		FS_BenchSampleNames();
+	}
+	n = fs_benchNumNames;
+	if ( !n ) {
+		Com_Printf( "Nothing to open\n" );
+		return;
+	}
+
+	// the opens would otherwise mark every pk3 as referenced
+	for ( search = fs_searchpaths, i = 0 ; search ; search = search->next ) {
+		i++;
+	}
+	referenced = malloc( i * sizeof( int ) );
+	walkUsec = malloc( ( n * FS_BENCH_ROUNDS + n ) * 2 * sizeof( int ) );
+	if ( !walkUsec || !referenced ) {
+		free( walkUsec );
+		free( referenced );
+		Com_Printf( "fsbench: out of memory\n" );
+		return;
+	}
+	for ( search = fs_searchpaths, i = 0 ; search ; search = search->next, i++ ) {
+		referenced[i] = search->pack ? search->pack->referenced : 0;
+	}
+	indexUsec = walkUsec + n * FS_BENCH_ROUNDS;
+	walkSizes = indexUsec + n * FS_BENCH_ROUNDS;
+	indexSizes = walkSizes + n;
+
+	if ( !Q_stricmp( Cmd_Argv( 1 ), "read" ) ) {
+		FS_ReadBench();
+		goto done;
+	}
+
+	Q_strncpyz( indexValue, fs_index->string, sizeof( indexValue ) );
+	Cvar_Set( "fs_index", "1" );
+	FS_FreeFileIndex();
+	if ( !FS_FileIndexReady() ) {
+		Com_Printf( "fsbench: couldn't build the file index\n" );
+	}
+	FS_IndexInfo();
+
+	walkFound = indexFound = 0;
+	for ( r = 0 ; r < FS_BENCH_ROUNDS ; r++ ) {
+		Cvar_Set( "fs_index", "0" );
+		FS_BenchOpens( walkUsec + r * n, walkSizes, &walkFound );
+		Cvar_Set( "fs_index", "1" );
+		FS_BenchOpens( indexUsec + r * n, indexSizes, &indexFound );
+	}
+	Cvar_Set( "fs_index", indexValue );
+
+	for ( i = 0, mismatches = 0 ; i < n ; i++ ) {
+		if ( walkSizes[i] != indexSizes[i] ) {
+			if ( mismatches++ < 8 ) {
+				Com_Printf( S_COLOR_YELLOW "%s: %i bytes walking the search path, %i from the index\n",
+							fs_benchNames[i], walkSizes[i], indexSizes[i] );
 			}
+		}
+	}
 
-			// look through all the pak file elements
-			pak = search->pack;
-			pakFile = pak->hashTable[hash];
-			do {
-				// case and separator insensitive comparisons
-				if ( !FS_FilenameCompare( pakFile->name, filename ) ) {
-					// found it!
-
-					// mark the pak as having been referenced and mark specifics on cgame and ui
-					// shaders, txt, arena files  by themselves do not count as a reference as
-					// these are loaded from all pk3s
-					// from every pk3 file..
-					l = strlen( filename );
-					if ( !( pak->referenced & FS_GENERAL_REF ) ) {
-						if ( Q_stricmp( filename + l - 7, ".shader" ) != 0 &&
-							 Q_stricmp( filename + l - 4, ".txt" ) != 0 &&
-							 Q_stricmp( filename + l - 4, ".cfg" ) != 0 &&
-							 Q_stricmp( filename + l - 7, ".config" ) != 0 &&
-							 strstr( filename, "levelshots" ) == NULL &&
-							 Q_stricmp( filename + l - 4, ".bot" ) != 0 &&
-							 Q_stricmp( filename + l - 6, ".arena" ) != 0 &&
-							 Q_stricmp( filename + l - 5, ".menu" ) != 0 ) {
-							pak->referenced |= FS_GENERAL_REF;
-						}
-					}
+	Com_Printf( "%i opens, %i rounds, usec per open\n", n, FS_BENCH_ROUNDS );
+	Com_Printf( "lookup       ms/round     mean    p50    p99    max   found\n" );
+	FS_BenchReport( "search path", walkUsec, n * FS_BENCH_ROUNDS, walkFound );
+	FS_BenchReport( "file index", indexUsec, n * FS_BENCH_ROUNDS, indexFound );
+	if ( mismatches ) {
+		Com_Printf( S_COLOR_YELLOW "%i files found differently\n", mismatches );
+	}
 
-					// for OS client/server interoperability, we expect binaries for .so and .dll to be in the same pk3
-					// so that when we reference the DLL files on any platform, this covers everyone else
-
-		  #if 0 // TTimo: use that stuff for shitted strings
-					Com_Printf( "SYS_DLLNAME_QAGAME + %d: '%s'\n", SYS_DLLNAME_QAGAME_SHIFT, FS_ShiftStr( "qagame_mp_x86.dll" /*"qagame.mp.i386.so"*/, SYS_DLLNAME_QAGAME_SHIFT ) );
-					Com_Printf( "SYS_DLLNAME_CGAME + %d: '%s'\n", SYS_DLLNAME_CGAME_SHIFT, FS_ShiftStr( "cgame_mp_x86.dll" /*"cgame.mp.i386.so"*/, SYS_DLLNAME_CGAME_SHIFT ) );
-					Com_Printf( "SYS_DLLNAME_UI + %d: '%s'\n", SYS_DLLNAME_UI_SHIFT, FS_ShiftStr( "ui_mp_x86.dll" /*"ui.mp.i386.so"*/, SYS_DLLNAME_UI_SHIFT ) );
-		  #endif
-					// qagame dll
-					if ( !( pak->referenced & FS_QAGAME_REF ) && FS_ShiftedStrStr( filename, SYS_DLLNAME_QAGAME, -SYS_DLLNAME_QAGAME_SHIFT ) ) {
-						pak->referenced |= FS_QAGAME_REF;
-					}
-					// cgame dll
-					if ( !( pak->referenced & FS_CGAME_REF ) && FS_ShiftedStrStr( filename, SYS_DLLNAME_CGAME, -SYS_DLLNAME_CGAME_SHIFT ) ) {
-						pak->referenced |= FS_CGAME_REF;
-					}
-					// ui dll
-					if ( !( pak->referenced & FS_UI_REF ) && FS_ShiftedStrStr( filename, SYS_DLLNAME_UI, -SYS_DLLNAME_UI_SHIFT ) ) {
-						pak->referenced |= FS_UI_REF;
-					}
+done:
+	for ( search = fs_searchpaths, i = 0 ; search ; search = search->next, i++ ) {
+		if ( search->pack ) {
+			search->pack->referenced = referenced[i];
+		}
+	}
 
-#if !defined( PRE_RELEASE_DEMO ) && !defined( DO_LIGHT_DEDICATED )
-					// DHM -- Nerve :: Don't allow maps to be loaded from pak0 (singleplayer)
-					if ( Q_stricmp( filename + l - 4, ".bsp" ) == 0 &&
-						 Q_stricmp( pak->pakBasename, "pak0" ) == 0 ) {
+	free( walkUsec );
+	free( referenced );
+}
 
-						*file = 0;
-						return -1;
-					}
-#endif
+/*
+===========
+FS_FOpenFileRead
+
+Finds the file in the search path.
+Returns filesize and an open FILE pointer.
+Used for streaming data out of either a
+separate file or a ZIP file.
+===========
+*/
+extern qboolean com_fullyInitialized;
+
+int FS_FOpenFileRead( const char *filename, fileHandle_t *file, qboolean uniqueFILE ) {
+	searchpath_t    *search;
+	char            *netpath;
+	pack_t          *pak;
+	fileInPack_t    *pakFile;
+	directory_t     *dir;
+	long hash;
+	FILE            *temp;
+	int len;
+
+	hash = 0;
+
+	if ( !fs_searchpaths ) {
+		Com_Error( ERR_FATAL, "Filesystem call made without initialization\n" );
+	}
+
+	// TTimo - NOTE
+	// when checking for file existence, it's probably safer to use FS_FileExists, as I'm not
+	// sure this chunk of code is really up to date with everything
+	if ( file == NULL ) {
+		// just wants to see if file is there
+		for ( search = fs_searchpaths ; search ; search = search->next ) {
+			//
+			if ( search->pack ) {
+				hash = FS_HashFileName( filename, search->pack->hashSize );
+			}
+			// is the element a pak file?
+			if ( search->pack && search->pack->hashTable[hash] ) {
+				if ( fs_filter_flag & FS_EXCLUDE_PK3 ) {
+					continue;
+				}
 
-					if ( uniqueFILE ) {
-						// open a new file on the pakfile
-						fsh[*file].handleFiles.file.z = unzReOpen( pak->pakFilename, pak->handle );
-						if ( fsh[*file].handleFiles.file.z == NULL ) {
-							Com_Error( ERR_FATAL, "Couldn't reopen %s", pak->pakFilename );
-						}
-					} else {
-						fsh[*file].handleFiles.file.z = pak->handle;
-					}
-					Q_strncpyz( fsh[*file].name, filename, sizeof( fsh[*file].name ) );
-					fsh[*file].zipFile = qtrue;
-					zfi = (unz_s *)fsh[*file].handleFiles.file.z;
-					// in case the file was new
-					temp = zfi->file;
-					// set the file position in the zip file (also sets the current file info)
-					unzSetCurrentFileInfoPosition( pak->handle, pakFile->pos );
-					// copy the file info into the unzip structure
-					Com_Memcpy( zfi, pak->handle, sizeof( unz_s ) );
-					// we copy this back into the structure
-					zfi->file = temp;
-					// open the file in the zip
-					unzOpenCurrentFile( fsh[*file].handleFiles.file.z );
-					fsh[*file].zipFilePos = pakFile->pos;
-
-					if ( fs_debug->integer ) {
-						Com_Printf( "FS_FOpenFileRead: %s (found in '%s')\n",
-									filename, pak->pakFilename );
+				// look through all the pak file elements
+				pak = search->pack;
+				pakFile = pak->hashTable[hash];
+				do {
+					// case and separator insensitive comparisons
+					if ( !FS_FilenameCompare( pakFile->name, filename ) ) {
+						// found it!
+						return qtrue;
 					}
-					return zfi->cur_file_info.uncompressed_size;
+					pakFile = pakFile->next;
+				} while ( pakFile != NULL );
+			} else if ( search->dir ) {
+				if ( fs_filter_flag & FS_EXCLUDE_DIR ) {
+					continue;
 				}
-				pakFile = pakFile->next;
-			} while ( pakFile != NULL );
-		} else if ( search->dir ) {
-			if ( fs_filter_flag & FS_EXCLUDE_DIR ) {
-				continue;
-			}
-
-			// check a file in the directory tree
 
-			// if we are running restricted, or if the filesystem is configured for pure (fs_numServerPaks)
-			// the only files we will allow to come from the directory are .cfg files
-			l = strlen( filename );
-			if ( fs_restrict->integer || fs_numServerPaks ) {
+				dir = search->dir;
 
-				if ( Q_stricmp( filename + l - 4, ".cfg" )       // for config files
-					 && Q_stricmp( filename + l - 5, ".menu" )  // menu files
-					 && Q_stricmp( filename + l - 5, ".game" )  // menu files
-					 && Q_stricmp( filename + l - strlen( demoExt ), demoExt ) // menu files
-					 && Q_stricmp( filename + l - 4, ".dat" ) ) { // for journal files
+				netpath = FS_BuildOSPath( dir->path, dir->gamedir, filename );
+				temp = fopen( netpath, "rb" );
+				if ( !temp ) {
 					continue;
 				}
+				fclose( temp );
+				return qtrue;
 			}
+		}
+		return qfalse;
+	}
 
-			dir = search->dir;
+	if ( !filename ) {
+		Com_Error( ERR_FATAL, "FS_FOpenFileRead: NULL 'filename' parameter passed\n" );
+	}
 
-			netpath = FS_BuildOSPath( dir->path, dir->gamedir, filename );
-			fsh[*file].handleFiles.file.o = fopen( netpath, "rb" );
-			if ( !fsh[*file].handleFiles.file.o ) {
-				continue;
-			}
+	// qpaths are not supposed to have a leading slash
+	if ( filename[0] == '/' || filename[0] == '\\' ) {
+		filename++;
+	}
 
-			if ( Q_stricmp( filename + l - 4, ".cfg" )       // for config files
-				 && Q_stricmp( filename + l - 5, ".menu" )  // menu files
-				 && Q_stricmp( filename + l - 5, ".game" )  // menu files
-				 && Q_stricmp( filename + l - strlen( demoExt ), demoExt ) // menu files
-				 && Q_stricmp( filename + l - 4, ".dat" ) ) { // for journal files
-				fs_fakeChkSum = random();
-			}
+	// make absolutely sure that it can't back up the path.
+	// The searchpaths do guarantee that something will always
+	// be prepended, so we don't need to worry about "c:" or "//limbo"
+	if ( strstr( filename, ".." ) || strstr( filename, "::" ) ) {
+		*file = 0;
+		return -1;
+	}
 
-			Q_strncpyz( fsh[*file].name, filename, sizeof( fsh[*file].name ) );
-			fsh[*file].zipFile = qfalse;
-			if ( fs_debug->integer ) {
-				Com_Printf( "FS_FOpenFileRead: %s (found in '%s/%s')\n", filename,
-							dir->path, dir->gamedir );
-			}
+	// make sure the q3key file is only readable by the quake3.exe at initialization
+	// any other time the key should only be accessed in memory using the provided functions
+	if ( com_fullyInitialized && strstr( filename, "rtcwkey" ) ) {
+		*file = 0;
+		return -1;
+	}
 
-			// if we are getting it from the cdpath, optionally copy it
-			//  to the basepath
-			if ( fs_copyfiles->integer && !Q_stricmp( dir->path, fs_cdpath->string ) ) {
-				char    *copypath;
+	FS_BenchRecord( filename );
 
-				copypath = FS_BuildOSPath( fs_basepath->string, dir->gamedir, filename );
-				FS_CopyFile( netpath, copypath );
-			}
+	*file = FS_HandleForFile();
+	fsh[*file].handleFiles.unique = uniqueFILE;
 
-			return FS_filelength( *file );
-		}
+	len = FS_INDEX_STALE;
+	if ( FS_FileIndexReady() ) {
+		len = FS_IndexOpenFile( filename, file, uniqueFILE );
+	}
+	if ( len == FS_INDEX_STALE ) {
+		len = FS_SearchOpenFile( filename, file, uniqueFILE );
+	}
+	if ( len != FS_NOT_FOUND ) {
+		return len;
 	}
 
 	Com_DPrintf( "Can't find %s\n", filename );
@@ -1427,6 +2127,24 @@ int FS_Delete( char *filename ) {
 	return 0;
 }
 
+/*
+=================
+FS_CheckInflateBackend
+
+Picks up fs_inflate changes, before a pk3 read
+=================
+*/
+static void FS_CheckInflateBackend( void ) {
+	if ( !fs_inflate->modified ) {
+		return;
+	}
+	fs_inflate->modified = qfalse;
+	if ( !unzSetInflateBackend( fs_inflate->string ) ) {
+		Com_Printf( "fs_inflate \"%s\" isn't stream, zlib or fast, keeping %s\n",
+					fs_inflate->string, unzGetInflateBackend() );
+	}
+}
+
 
 /*
 =================
@@ -1496,6 +2214,7 @@ int FS_Read( void *buffer, int len, fileHandle_t f ) {
 		}
 		return len;
 	} else {
+		FS_CheckInflateBackend();
 		return unzReadCurrentFile( fsh[f].handleFiles.file.z, buffer, len );
 	}
 }
@@ -1691,6 +2410,401 @@ int FS_FileIsInPAK( const char *filename, int *pChecksum ) {
 	return -1;
 }
 
+/*
+=================================================================================
+
+MAPPED PK3 READS
+
+FS_ReadFile hands out .wav and .jpg files that are stored uncompressed in
+a pk3 straight from the pk3 mapped into memory, with no copy and no temp
+hunk memory.  Their readers only ever look at the data, and don't need
+the 0 that's otherwise put on the end.  The pk3 is mapped by the first
+read that can use it, and stays mapped until the filesystem shuts down
+and the last of those buffers has been through FS_FreeFile.
+
+=================================================================================
+*/
+
+// on 32 bit keep to part of the address space, the pk3s can be big
+#define FS_MAX_MAPPED_BYTES     ( sizeof( void * ) > 4 ? 0x7fffffff : ( 512 << 20 ) )
+
+static const char *fs_mappedExtensions[] = { ".wav", ".jpg", NULL };
+
+static pakMapping_t *fs_pakMappings;
+static int fs_mappedBytes;                  // all the mappings together
+
+static int fs_mappedReads;                  // FS_ReadFile calls served from a mapping
+static int64_t fs_mappedReadBytes;
+static int fs_copiedReads;                  // and those that were read into the hunk
+static int64_t fs_copiedReadBytes;
+
+/*
+================
+FS_MapPak
+================
+*/
+static pakMapping_t *FS_MapPak( pack_t *pak ) {
+	pakMapping_t    *mapping;
+	void            *base;
+	int size;
+
+	if ( pak->mapping || pak->mapFailed ) {
+		return pak->mapping;
+	}
+
+	base = Sys_MapFile( pak->pakFilename, &size );
+	if ( !base ) {
+		pak->mapFailed = qtrue;
+		return NULL;
+	}
+	if ( size > FS_MAX_MAPPED_BYTES - fs_mappedBytes ) {
+		Sys_UnmapFile( base, size );
+		pak->mapFailed = qtrue;
+		return NULL;
+	}
+
+	mapping = Z_Malloc( sizeof( *mapping ) );
+	mapping->base = base;
+	mapping->size = size;
+	mapping->refs = 0;
+	mapping->closed = qfalse;
+	mapping->next = fs_pakMappings;
+	fs_pakMappings = mapping;
+	fs_mappedBytes += size;
+
+	pak->mapping = mapping;
+	return mapping;
+}
+
+/*
+================
+FS_ReleaseMapping
+
+Unmaps once the pk3 has been closed and nothing points into it
+================
+*/
+static void FS_ReleaseMapping( pakMapping_t *mapping ) {
+	pakMapping_t    **prev;
+
+	if ( !mapping->closed || mapping->refs ) {
+		return;
+	}
+	for ( prev = &fs_pakMappings ; *prev ; prev = &( *prev )->next ) {
+		if ( *prev == mapping ) {
+			*prev = mapping->next;
+			break;
+		}
+	}
+	fs_mappedBytes -= mapping->size;
+	Sys_UnmapFile( mapping->base, mapping->size );
+	Z_Free( mapping );
+}
+
+static pakMapping_t *FS_MappingForBuffer( const void *buffer ) {
+	pakMapping_t    *mapping;
+
+	for ( mapping = fs_pakMappings ; mapping ; mapping = mapping->next ) {
+		if ( (const byte *)buffer >= mapping->base && (const byte *)buffer < mapping->base + mapping->size ) {
+			return mapping;
+		}
+	}
+	return NULL;
+}
+
+/*
+================
+FS_MappedFileData
+
+The file just opened on h, if it can be read out of the mapped pk3
+================
+*/
+static byte *FS_MappedFileData( fileHandle_t h, const char *qpath, int len ) {
+	pakMapping_t            *mapping;
+	unz_s                   *zfi;
+	file_in_zip_read_info_s *info;
+	unsigned long ofs;
+	int i, l;
+
+	if ( !fs_mapPaks->integer || !fsh[h].zipFile || !fsh[h].pak ) {
+		return NULL;
+	}
+
+	l = strlen( qpath );
+	for ( i = 0 ; fs_mappedExtensions[i] ; i++ ) {
+		if ( l > 4 && !Q_stricmp( qpath + l - 4, fs_mappedExtensions[i] ) ) {
+			break;
+		}
+	}
+	if ( !fs_mappedExtensions[i] ) {
+		return NULL;
+	}
+
+	// only stored, not deflated or encrypted
+	zfi = (unz_s *)fsh[h].handleFiles.file.z;
+	info = zfi->pfile_in_zip_read;
+	if ( !info || info->compression_method != 0 || ( zfi->cur_file_info.flag & 1 ) ||
+		 zfi->cur_file_info.compressed_size != len ) {
+		return NULL;
+	}
+
+	mapping = FS_MapPak( fsh[h].pak );
+	if ( !mapping ) {
+		return NULL;
+	}
+	ofs = info->pos_in_zipfile + info->byte_before_the_zipfile;
+	if ( ofs > mapping->size || len > mapping->size - ofs ) {
+		return NULL;
+	}
+
+	mapping->refs++;
+	fs_mappedReads++;
+	fs_mappedReadBytes += len;
+	return mapping->base + ofs;
+}
+
+/*
+================
+FS_ReadBench
+
+FS_ReadFile and FS_FreeFile of every bench file, copied and mapped
+================
+*/
+static void FS_ReadBench( void ) {
+	char mapValue[MAX_CVAR_VALUE_STRING];
+	void        *buf;
+	int64_t start, usec[2], copiedBytes[2];
+	int copied[2], mapped[2];
+	int i, r, m;
+
+	Com_Printf( "since startup %i reads mapped, %i KB, %i read into the hunk, %i KB, %i KB of pk3s mapped\n",
+				fs_mappedReads, (int)( fs_mappedReadBytes >> 10 ), fs_copiedReads, (int)( fs_copiedReadBytes >> 10 ),
+				fs_mappedBytes >> 10 );
+
+	Q_strncpyz( mapValue, fs_mapPaks->string, sizeof( mapValue ) );
+	for ( m = 0 ; m < 2 ; m++ ) {
+		Cvar_Set( "fs_mapPaks", m ? "1" : "0" );
+		copied[m] = fs_copiedReads;
+		copiedBytes[m] = fs_copiedReadBytes;
+		mapped[m] = fs_mappedReads;
+		start = Sys_Microseconds();
+		for ( r = 0 ; r < FS_BENCH_ROUNDS ; r++ ) {
+			for ( i = 0 ; i < fs_benchNumNames ; i++ ) {
+				if ( FS_ReadFile( fs_benchNames[i], &buf ) > 0 && buf ) {
+					FS_FreeFile( buf );
+				}
+			}
+		}
+		usec[m] = Sys_Microseconds() - start;
+		copied[m] = fs_copiedReads - copied[m];
+		copiedBytes[m] = fs_copiedReadBytes - copiedBytes[m];
+		mapped[m] = fs_mappedReads - mapped[m];
+	}
+	Cvar_Set( "fs_mapPaks", mapValue );
+
+	Com_Printf( "%i files, %i rounds\n", fs_benchNumNames, FS_BENCH_ROUNDS );
+	Com_Printf( "fs_mapPaks  ms/round   copied  KB copied   mapped\n" );
+	for ( m = 0 ; m < 2 ; m++ ) {
+		Com_Printf( "%-10i %9.1f %8i %10i %8i\n", m, usec[m] / 1000.0 / FS_BENCH_ROUNDS,
+					copied[m] / FS_BENCH_ROUNDS, (int)( copiedBytes[m] / FS_BENCH_ROUNDS >> 10 ), mapped[m] / FS_BENCH_ROUNDS );
+	}
+}
+
+/*
+=================================================================================
+
+INFLATE BENCHMARK
+
+=================================================================================
+*/
+
+#define FS_INFLATE_MEMBERS  4096
+#define FS_INFLATE_BYTES    ( 128 << 20 )   // compressed and inflated, a batch
+
+typedef struct {
+	const char  *name;
+	byte        *in;
+	byte        *out;
+	int inLen;
+	int outLen;
+	unsigned int crc;
+	int err;
+} fsInflateMember_t;
+
+typedef enum {
+	FSI_ZLIB,
+	FSI_FAST,
+	FSI_FAST_POOL,
+	FSI_NUM_RUNS
+} fsInflateRun_t;
+
+typedef struct {
+	int64_t usec[FSI_NUM_RUNS];
+	int bad[FSI_NUM_RUNS];
+} fsInflateTimes_t;
+
+static void FS_InflateJob( void *data, int index ) {
+	fsInflateMember_t   *m = (fsInflateMember_t *)data + index;
+	unzInflateContext   *ctx;
+
+	ctx = unzAcquireInflateContext();
+	if ( !ctx ) {
+		m->err = UNZ_INTERNALERROR;
+		return;
+	}
+	m->err = unzInflateBuffer( ctx, m->in, m->inLen, m->out, m->outLen );
+	unzReleaseInflateContext( ctx );
+}
+
+/*
+================
+FS_InflateBatch
+
+Every run inflates the whole batch, the crcs are checked after the timing
+================
+*/
+static void FS_InflateBatch( fsInflateMember_t *members, int count, fsInflateTimes_t *times ) {
+	fsInflateMember_t   *m;
+	int64_t start;
+	int r, i;
+
+	for ( r = 0 ; r < FSI_NUM_RUNS ; r++ ) {
+		unzSetInflateBackend( r == FSI_ZLIB ? "zlib" : "fast" );
+		start = Sys_Microseconds();
+		if ( r == FSI_FAST_POOL ) {
+			Threads_RunJobs( FS_InflateJob, members, count );
+		} else {
+			for ( i = 0 ; i < count ; i++ ) {
+				FS_InflateJob( members, i );
+			}
+		}
+		times->usec[r] += Sys_Microseconds() - start;
+
+		for ( i = 0, m = members ; i < count ; i++, m++ ) {
+			if ( m->err == UNZ_OK && (unsigned int)Inflate_CRC32( 0, m->out, m->outLen ) == m->crc ) {
+				continue;
+			}
+			if ( times->bad[r]++ < 4 ) {
+				Com_Printf( S_COLOR_YELLOW "%s: %s with the %s run\n", m->name,
+							m->err == UNZ_OK ? "bad crc" : "inflate error", r == FSI_ZLIB ? "zlib" : "fast" );
+			}
+		}
+	}
+}
+
+/*
+================
+FS_InflateBench
+
+fsbench inflate [workers]
+
+Inflates every deflated member of the BASEGAME pk3s with the zlib and
+fast backends, and with the fast one over the worker pool
+================
+*/
+static void FS_InflateBench( void ) {
+	static const char *runNames[FSI_NUM_RUNS] = { "zlib", "fast", "fast" };
+	fsInflateMember_t   *members, *m;
+	fsInflateTimes_t times;
+	searchpath_t        *search;
+	pack_t              *pak;
+	unz_file_info info;
+	char backend[16];
+	byte                *arena;
+	int64_t bytesIn, bytesOut;
+	int workers, threads, n, used, size, deflated, stored, failed, i, r;
+
+	members = malloc( FS_INFLATE_MEMBERS * sizeof( *members ) );
+	arena = malloc( FS_INFLATE_BYTES );
+	if ( !members || !arena ) {
+		free( members );
+		free( arena );
+		Com_Printf( "fsbench: out of memory\n" );
+		return;
+	}
+
+	workers = Threads_NumWorkers();
+	if ( Cmd_Argc() > 2 ) {
+		Threads_InitWorkers( atoi( Cmd_Argv( 2 ) ) );
+	}
+	Q_strncpyz( backend, unzGetInflateBackend(), sizeof( backend ) );
+	memset( &times, 0, sizeof( times ) );
+	bytesIn = bytesOut = 0;
+	n = used = deflated = stored = failed = 0;
+
+	for ( search = fs_searchpaths ; search ; search = search->next ) {
+		pak = search->pack;
+		if ( !pak || Q_stricmp( pak->pakGamename, BASEGAME ) ) {
+			continue;
+		}
+		for ( i = 0 ; i < pak->numfiles ; i++ ) {
+			unzSetCurrentFileInfoPosition( pak->handle, pak->buildBuffer[i].pos );
+			if ( unzGetCurrentFileInfo( pak->handle, &info, NULL, 0, NULL, 0, NULL, 0 ) != UNZ_OK ) {
+				failed++;
+				continue;
+			}
+			if ( info.compression_method != 8 ) {      // not deflated
+				stored++;
+				continue;
+			}
+			size = info.compressed_size + info.uncompressed_size;
+			if ( size > FS_INFLATE_BYTES ) {
+				failed++;
+				continue;
+			}
+			if ( n == FS_INFLATE_MEMBERS || used + size > FS_INFLATE_BYTES ) {
+				FS_InflateBatch( members, n, &times );
+				n = used = 0;
+			}
+
+			m = &members[n];
+			m->name = pak->buildBuffer[i].name;
+			m->in = arena + used;
+			m->inLen = info.compressed_size;
+			m->out = m->in + m->inLen;
+			m->outLen = info.uncompressed_size;
+			m->crc = (unsigned int)info.crc;     // sign extended with a 64 bit long
+			if ( unzOpenCurrentFile( pak->handle ) != UNZ_OK ) {
+				failed++;
+				continue;
+			}
+			r = unzReadCurrentFileCompressed( pak->handle, m->in, m->inLen );
+			unzCloseCurrentFile( pak->handle );
+			if ( r != m->inLen ) {
+				failed++;
+				continue;
+			}
+
+			n++;
+			used += size;
+			deflated++;
+			bytesIn += m->inLen;
+			bytesOut += m->outLen;
+		}
+	}
+	if ( n ) {
+		FS_InflateBatch( members, n, &times );
+	}
+
+	threads = Threads_NumWorkers() + 1;
+	unzSetInflateBackend( backend );
+	if ( Threads_NumWorkers() != workers ) {
+		Threads_InitWorkers( workers );
+	}
+	free( members );
+	free( arena );
+
+	Com_Printf( "%i deflated members in the %s pk3s, %i KB inflated to %i KB, %i stored, %i unreadable\n",
+				deflated, BASEGAME, (int)( bytesIn >> 10 ), (int)( bytesOut >> 10 ), stored, failed );
+	if ( !deflated ) {
+		return;
+	}
+	Com_Printf( "backend  threads      msec     MB/s   bad\n" );
+	for ( r = 0 ; r < FSI_NUM_RUNS ; r++ ) {
+		Com_Printf( "%-8s %7i %9.1f %8.1f %5i\n", runNames[r], r == FSI_FAST_POOL ? threads : 1,
+					times.usec[r] / 1000.0, times.usec[r] ? bytesOut / (double)times.usec[r] : 0.0, times.bad[r] );
+	}
+}
+
 /*
 ============
 FS_ReadFile
@@ -1791,10 +2905,21 @@ int FS_ReadFile( const char *qpath, void **buffer ) {
 	fs_loadCount++;
 	fs_loadStack++;
 
+	if ( !isConfig ) {
+		buf = FS_MappedFileData( h, qpath, len );
+		if ( buf ) {
+			*buffer = buf;
+			FS_FCloseFile( h );
+			return len;
+		}
+	}
+
 	buf = Hunk_AllocateTempMemory( len + 1 );
 	*buffer = buf;
 
 	FS_Read( buf, len, h );
+	fs_copiedReads++;
+	fs_copiedReadBytes += len;
 
 	// guarantee that it will have a trailing 0 for string operations
 	buf[len] = 0;
@@ -1816,6 +2941,8 @@ FS_FreeFile
 =============
 */
 void FS_FreeFile( void *buffer ) {
+	pakMapping_t    *mapping;
+
 	if ( !fs_searchpaths ) {
 		Com_Error( ERR_FATAL, "Filesystem call made without initialization\n" );
 	}
@@ -1824,7 +2951,13 @@ void FS_FreeFile( void *buffer ) {
 	}
 	fs_loadStack--;
 
-	Hunk_FreeTempMemory( buffer );
+	mapping = FS_MappingForBuffer( buffer );
+	if ( mapping ) {
+		mapping->refs--;
+		FS_ReleaseMapping( mapping );
+	} else {
+		Hunk_FreeTempMemory( buffer );
+	}
 
 	// if all of our temp files are free, clear all of our space
 	if ( fs_loadStack == 0 ) {
@@ -1992,8 +3125,6 @@ DIRECTORY SCANNING FUNCTIONS
 =================================================================================
 */
 
-#define MAX_FOUND_FILES 0x1000
-
 static int FS_ReturnPath( const char *zname, char *zpath, int *depth ) {
 	int len, at, newdep;
 
@@ -2899,11 +4030,17 @@ void FS_Shutdown( qboolean closemfp ) {
 		}
 	}
 
+	FS_FreeFileIndex();
+
 	// free everything
 	for ( p = fs_searchpaths ; p ; p = next ) {
 		next = p->next;
 
 		if ( p->pack ) {
+			if ( p->pack->mapping ) {
+				p->pack->mapping->closed = qtrue;
+				FS_ReleaseMapping( p->pack->mapping );
+			}
 			unzClose( p->pack->handle );
 			Z_Free( p->pack->buildBuffer );
 			Z_Free( p->pack );
@@ -2917,10 +4054,13 @@ void FS_Shutdown( qboolean closemfp ) {
 	// any FS_ calls will now be an error until reinitialized
 	fs_searchpaths = NULL;
 
+	unzFreeInflateContexts();
+
 	Cmd_RemoveCommand( "path" );
 	Cmd_RemoveCommand( "dir" );
 	Cmd_RemoveCommand( "fdir" );
 	Cmd_RemoveCommand( "touchFile" );
+	Cmd_RemoveCommand( "fsbench" );
 
 #ifdef FS_MISSING
 	if ( closemfp ) {
@@ -2992,6 +4132,10 @@ static void FS_Startup( const char *gameName ) {
 	fs_homepath = Cvar_Get( "fs_homepath", homePath, CVAR_INIT );
 	fs_gamedirvar = Cvar_Get( "fs_game", "wolfpro", CVAR_INIT | CVAR_SYSTEMINFO );
 	fs_restrict = Cvar_Get( "fs_restrict", "", CVAR_INIT );
+	fs_index = Cvar_Get( "fs_index", "1", CVAR_ARCHIVE );
+	fs_mapPaks = Cvar_Get( "fs_mapPaks", "1", CVAR_ARCHIVE );
+	fs_inflate = Cvar_Get( "fs_inflate", "fast", CVAR_ARCHIVE );
+	FS_CheckInflateBackend();
 
 	// add search path elements in reverse priority order
 	if ( fs_cdpath->string[0] ) {
@@ -3043,11 +4187,16 @@ static void FS_Startup( const char *gameName ) {
 	Cmd_AddCommand( "dir", FS_Dir_f );
 	Cmd_AddCommand( "fdir", FS_NewDir_f );
 	Cmd_AddCommand( "touchFile", FS_TouchFile_f );
+	Cmd_AddCommand( "fsbench", FS_OpenBench_f );
 
 	// show_bug.cgi?id=506
 	// reorder the pure pk3 files according to server order
 	FS_ReorderPurePaks();
 
+	if ( fs_index->integer ) {
+		FS_BuildFileIndex();
+	}
+
 	// print the current search paths
 	FS_Path_f();
 
@@ -3061,6 +4210,9 @@ static void FS_Startup( const char *gameName ) {
 	}
 #endif
 	Com_Printf( "%d files in pk3 files\n", fs_packFiles );
+	if ( fs_fileIndex.entries ) {
+		FS_IndexInfo();
+	}
 }
 
 
@@ -3665,6 +4817,18 @@ void FS_ClearPakReferences( int flags ) {
 			search->pack->referenced &= ~flags;
 		}
 	}
+
+	// pick up files copied into the directories since the last map
+	FS_FreeFileIndex();
+}
+
+/*
+=====================
+FS_FlushFileIndex
+=====================
+*/
+void FS_FlushFileIndex( void ) {
+	FS_FreeFileIndex();
 }
 
 
@@ -3694,6 +4858,9 @@ void FS_PureServerSetLoadedPaks( const char *pakSums, const char *pakNames ) {
 		fs_serverPaks[i] = atoi( Cmd_Argv( i ) );
 	}
 
+	// built again with the new pure list
+	FS_FreeFileIndex();
+
 	if ( fs_numServerPaks ) {
 		Com_DPrintf( "Connected to a pure server.\n" );
 	} else
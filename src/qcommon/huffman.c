@@ -38,8 +38,6 @@ If you have questions concerning this license or the applicable additional terms
 #define NYT				HMAX	/* NYT = Not Yet Transmitted */
 #define INTERNAL_NODE	(HMAX+1)
 
-static int			bloc = 0;
-
 typedef struct nodetype {
 	struct    nodetype* left, * right, * parent; /* tree structure */
 	struct    nodetype* next, * prev; /* doubly-linked list */
@@ -69,22 +67,73 @@ typedef struct {
 
 
 /* Add a bit to the output file (buffered) */
-static void add_bit( char bit, byte *fout ) {
-	if ( ( bloc & 7 ) == 0 ) {
-		fout[( bloc >> 3 )] = 0;
+static void add_bit( char bit, byte *fout, int *bloc ) {
+	if ( ( *bloc & 7 ) == 0 ) {
+		fout[( *bloc >> 3 )] = 0;
 	}
-	fout[( bloc >> 3 )] |= bit << ( bloc & 7 );
-	bloc++;
+	fout[( *bloc >> 3 )] |= bit << ( *bloc & 7 );
+	( *bloc )++;
 }
 
 /* Receive one bit from the input file (buffered) */
-static int get_bit( byte *fin ) {
+static int get_bit( byte *fin, int *bloc ) {
 	int t;
-	t = ( fin[( bloc >> 3 )] >> ( bloc & 7 ) ) & 0x1;
-	bloc++;
+	t = ( fin[( *bloc >> 3 )] >> ( *bloc & 7 ) ) & 0x1;
+	( *bloc )++;
 	return t;
 }
 
+/* Add up to 32 bits to the output file at once, first bit lowest */
+static void put_bits( unsigned value, int count, byte *fout, int *bloc ) {
+	byte        *out;
+	uint64_t acc;
+	int i, shift;
+
+	out = fout + ( *bloc >> 3 );
+	shift = *bloc & 7;
+
+	// the rest of a partly written byte is always clear
+	acc = ( out[0] & ( ( 1 << shift ) - 1 ) ) | ( (uint64_t)value << shift );
+	for ( i = 0 ; i < shift + count ; i += 8 ) {
+		*out++ = (byte)acc;
+		acc >>= 8;
+	}
+	*bloc += count;
+}
+
+/* The next 57 or more bits of the input file, first bit lowest, reading
+ * zeros past the end of the size bytes the buffer holds */
+static uint64_t get_window( const byte *fin, int size, int bloc ) {
+	const byte  *in;
+	uint64_t window;
+	int i, avail;
+
+	in = fin + ( bloc >> 3 );
+	avail = size - ( bloc >> 3 );
+	if ( avail >= 8 ) {
+		window = (uint64_t)in[0] | ( (uint64_t)in[1] << 8 ) | ( (uint64_t)in[2] << 16 ) | ( (uint64_t)in[3] << 24 ) |
+				 ( (uint64_t)in[4] << 32 ) | ( (uint64_t)in[5] << 40 ) | ( (uint64_t)in[6] << 48 ) | ( (uint64_t)in[7] << 56 );
+	} else {
+		window = 0;
+		for ( i = 0 ; i < avail ; i++ ) {
+			window |= (uint64_t)in[i] << ( i * 8 );
+		}
+	}
+	return window >> ( bloc & 7 );
+}
+
+/* The bits of a NYT symbol go out highest first */
+static unsigned reverse_byte( unsigned ch ) {
+	unsigned r;
+	int i;
+
+	r = 0;
+	for ( i = 0 ; i < 8 ; i++ ) {
+		r = ( r << 1 ) | ( ( ch >> i ) & 1 );
+	}
+	return r;
+}
+
 static node_t **get_ppnode( huff_t* huff ) {
 	node_t **tppnode;
 	if ( !huff->freelist ) {
@@ -273,9 +322,9 @@ static void Huff_addRef(huff_t* huff, byte ch) {
 }
 
 /* Get a symbol */
-static int Huff_Receive(node_t* node, int* ch, byte* fin) {
+static int Huff_Receive( node_t* node, int* ch, byte* fin, int *bloc ) {
 	while ( node && node->symbol == INTERNAL_NODE ) {
-		if ( get_bit( fin ) ) {
+		if ( get_bit( fin, bloc ) ) {
 			node = node->right;
 		} else {
 			node = node->left;
@@ -287,39 +336,119 @@ static int Huff_Receive(node_t* node, int* ch, byte* fin) {
 	return ( *ch = node->symbol );
 }
 
+/* Get a symbol, taking the bits for the walk down the tree out of a window
+ * instead of indexing the input for every one of them */
+static int Huff_ReceiveWindow( node_t* node, int* ch, byte* fin, int size, int *bloc ) {
+	uint64_t window;
+	int used;
+
+	window = get_window( fin, size, *bloc );
+	used = 0;
+	while ( node && node->symbol == INTERNAL_NODE ) {
+		if ( used == 56 ) {
+			*bloc += used;
+			window = get_window( fin, size, *bloc );
+			used = 0;
+		}
+		if ( ( window >> used ) & 1 ) {
+			node = node->right;
+		} else {
+			node = node->left;
+		}
+		used++;
+	}
+	*bloc += used;
+	if ( !node ) {
+		return 0;
+	}
+	return ( *ch = node->symbol );
+}
 
 /* Send the prefix code for this node */
-static void send( node_t *node, node_t *child, byte *fout ) {
+static void send( node_t *node, node_t *child, byte *fout, int *bloc ) {
 	if ( node->parent ) {
-		send( node->parent, node, fout );
+		send( node->parent, node, fout, bloc );
 	}
 	if ( child ) {
 		if ( node->right == child ) {
-			add_bit( 1, fout );
+			add_bit( 1, fout, bloc );
 		} else {
-			add_bit( 0, fout );
+			add_bit( 0, fout, bloc );
 		}
 	}
 }
 
+/* Send the prefix code for this node with a single write.  Walking up from
+ * the leaf and shifting each bit in leaves the root's bit lowest, which is
+ * the one that goes out first.  Returns qfalse if the path doesn't fit in a
+ * word, which the weights of a 64k message can't produce, but a damaged
+ * tree shouldn't write past the code. */
+static qboolean send_word( node_t *node, byte *fout, int *bloc ) {
+	unsigned code;
+	int length;
+
+	code = 0;
+	for ( length = 0 ; node->parent ; length++, node = node->parent ) {
+		if ( length == 32 ) {
+			return qfalse;
+		}
+		code = ( code << 1 ) | ( node->parent->right == node );
+	}
+	put_bits( code, length, fout, bloc );
+	return qtrue;
+}
 
 /* Send a symbol */
-static void Huff_transmit(huff_t* huff, int ch, byte* fout) {
+static void Huff_transmit( huff_t* huff, int ch, byte* fout, int *bloc ) {
 	int i;
 	if ( huff->loc[ch] == NULL ) {
 		/* node_t hasn't been transmitted, send a NYT, then the symbol */
-		Huff_transmit( huff, NYT, fout );
+		Huff_transmit( huff, NYT, fout, bloc );
 		for ( i = 7; i >= 0; i-- ) {
-			add_bit( (char)( ( ch >> i ) & 0x1 ), fout );
+			add_bit( (char)( ( ch >> i ) & 0x1 ), fout, bloc );
 		}
 	} else {
-		send( huff->loc[ch], NULL, fout );
+		send( huff->loc[ch], NULL, fout, bloc );
 	}
 }
 
+/* Send a symbol a code at a time */
+static void Huff_transmitWord( huff_t* huff, int ch, byte* fout, int *bloc ) {
+	if ( huff->loc[ch] == NULL ) {
+		/* node_t hasn't been transmitted, send a NYT, then the symbol */
+		Huff_transmitWord( huff, NYT, fout, bloc );
+		put_bits( reverse_byte( ch ), 8, fout, bloc );
+	} else if ( !send_word( huff->loc[ch], fout, bloc ) ) {
+		send( huff->loc[ch], NULL, fout, bloc );
+	}
+}
+
+/* Set up a tree holding only the NYT node.  Every node and node pointer is
+ * filled in as it is handed out, so only the symbol locations need clearing
+ * instead of the tens of kilobytes of the whole huff_t */
+static void Huff_Init( huff_t *huff ) {
+	huff->blocNode = 0;
+	huff->blocPtrs = 0;
+	huff->freelist = NULL;
+	Com_Memset( huff->loc, 0, sizeof( huff->loc ) );
+
+	huff->tree = huff->lhead = huff->ltail = huff->loc[NYT] = &( huff->nodeList[huff->blocNode++] );
+	huff->tree->symbol = NYT;
+	huff->tree->weight = 0;
+	huff->tree->head = NULL;
+	huff->lhead->next = huff->lhead->prev = NULL;
+	huff->tree->parent = huff->tree->left = huff->tree->right = NULL;
+}
 
-void DynHuff_Decompress(msg_t* mbuf, int offset) {
-	int ch, cch, i, j, size;
+/*
+The adaptive tree changes after every symbol, so neither direction can use
+fixed code tables like huffman_static.c.  What can be done in bulk is the bit
+I/O: codes are written a word at a time and decoding walks the tree out of a
+64-bit window.  The old bit at a time coder is kept as the reference that
+hufftest checks the output against.
+*/
+static void Huff_DecompressMessage( msg_t* mbuf, int offset, qboolean reference ) {
+	int ch, cch, i, j, size, bloc;
 	byte seq[65536];
 	byte*       buffer;
 	huff_t huff;
@@ -331,13 +460,8 @@ void DynHuff_Decompress(msg_t* mbuf, int offset) {
 		return;
 	}
 
-	Com_Memset( &huff, 0, sizeof( huff_t ) );
 	// Initialize the tree & list with the NYT node
-	huff.tree = huff.lhead = huff.ltail = huff.loc[NYT] = &( huff.nodeList[huff.blocNode++] );
-	huff.tree->symbol = NYT;
-	huff.tree->weight = 0;
-	huff.lhead->next = huff.lhead->prev = NULL;
-	huff.tree->parent = huff.tree->left = huff.tree->right = NULL;
+	Huff_Init( &huff );
 
 	cch = buffer[0] * 256 + buffer[1];
 	// don't overflow with bad messages
@@ -354,24 +478,30 @@ void DynHuff_Decompress(msg_t* mbuf, int offset) {
 			seq[j] = 0;
 			break;
 		}
-		Huff_Receive( huff.tree, &ch, buffer );               /* Get a character */
-		if ( ch == NYT ) {                              /* We got a NYT, get the symbol associated with it */
-			ch = 0;
-			for ( i = 0; i < 8; i++ ) {
-				ch = ( ch << 1 ) + get_bit( buffer );
+		if ( reference ) {
+			Huff_Receive( huff.tree, &ch, buffer, &bloc );               /* Get a character */
+			if ( ch == NYT ) {                              /* We got a NYT, get the symbol associated with it */
+				ch = 0;
+				for ( i = 0; i < 8; i++ ) {
+					ch = ( ch << 1 ) + get_bit( buffer, &bloc );
+				}
+			}
+		} else {
+			Huff_ReceiveWindow( huff.tree, &ch, buffer, mbuf->maxsize - offset, &bloc );
+			if ( ch == NYT ) {
+				ch = reverse_byte( (unsigned)get_window( buffer, mbuf->maxsize - offset, bloc ) & 0xff );
+				bloc += 8;
 			}
 		}
-
 		seq[j] = ch;                                    /* Write symbol */
-
 		Huff_addRef( &huff, (byte)ch );                               /* Increment node */
 	}
 	mbuf->cursize = cch + offset;
 	Com_Memcpy( mbuf->data + offset, seq, cch );
 }
 
-void DynHuff_Compress(msg_t* mbuf, int offset) {
-	int i, ch, size;
+static void Huff_CompressMessage( msg_t* mbuf, int offset, qboolean reference ) {
+	int i, ch, size, bloc;
 	byte seq[65536];
 	byte* buffer;
 	huff_t huff;
@@ -383,14 +513,8 @@ void DynHuff_Compress(msg_t* mbuf, int offset) {
 		return;
 	}
 
-	Com_Memset( &huff, 0, sizeof( huff_t ) );
 	// Add the NYT (not yet transmitted) node into the tree/list */
-	huff.tree = huff.lhead = huff.loc[NYT] =  &( huff.nodeList[huff.blocNode++] );
-	huff.tree->symbol = NYT;
-	huff.tree->weight = 0;
-	huff.lhead->next = huff.lhead->prev = NULL;
-	huff.tree->parent = huff.tree->left = huff.tree->right = NULL;
-	huff.loc[NYT] = huff.tree;
+	Huff_Init( &huff );
 
 	seq[0] = ( size >> 8 );
 	seq[1] = size & 0xff;
@@ -399,13 +523,143 @@ void DynHuff_Compress(msg_t* mbuf, int offset) {
 
 	for ( i = 0; i < size; i++ ) {
 		ch = buffer[i];
-		Huff_transmit( &huff, ch, seq );                      /* Transmit symbol */
+		if ( reference ) {
+			Huff_transmit( &huff, ch, seq, &bloc );                      /* Transmit symbol */
+		} else {
+			Huff_transmitWord( &huff, ch, seq, &bloc );
+		}
 		Huff_addRef( &huff, (byte)ch );                               /* Do update */
 	}
 
+	// the byte rounded up to below is only partly written, or not at all
+	// when the code ends on a byte boundary, so don't send stack garbage
+	if ( !( bloc & 7 ) ) {
+		seq[bloc >> 3] = 0;
+	}
 	bloc += 8; // next byte
 
 	mbuf->cursize = (bloc >> 3) + offset;
 	Com_Memcpy(mbuf->data + offset, seq, (bloc >> 3));
 }
 
+void DynHuff_Decompress( msg_t* mbuf, int offset ) {
+	Huff_DecompressMessage( mbuf, offset, qfalse );
+}
+
+void DynHuff_Compress( msg_t* mbuf, int offset ) {
+	Huff_CompressMessage( mbuf, offset, qfalse );
+}
+
+#define HUFFTEST_PACKETS    32
+#define HUFFTEST_SIZE       ( MAX_INFO_STRING + 64 )
+
+/*
+=============
+DynHuff_TestPacket
+
+Compresses a copy of a plain packet into buf with one of the coders
+=============
+*/
+static void DynHuff_TestPacket( msg_t *msg, byte *buf, const byte *plain, int size, qboolean reference ) {
+	MSG_InitOOB( msg, buf, HUFFTEST_SIZE );
+	Com_Memcpy( buf, plain, size );
+	msg->cursize = size;
+	Huff_CompressMessage( msg, 12, reference );
+}
+
+/*
+=============
+DynHuff_Test_f
+
+hufftest [count]
+
+Builds a corpus of connect packets with varied userinfo, checks that the
+word at a time coder writes the same bytes as the bit at a time one and
+that both read them back, then times count passes over the corpus.
+=============
+*/
+void DynHuff_Test_f( void ) {
+	static byte plain[HUFFTEST_PACKETS][HUFFTEST_SIZE];
+	static byte packed[HUFFTEST_PACKETS][HUFFTEST_SIZE];
+	static int plainSize[HUFFTEST_PACKETS], packedSize[HUFFTEST_PACKETS];
+	static byte bufA[HUFFTEST_SIZE], bufB[HUFFTEST_SIZE];
+	char info[MAX_INFO_STRING];
+	msg_t a, b;
+	int count, i, j, p, t;
+	int plainTotal, packedTotal, mismatches, badReads;
+	int times[4];
+
+	count = 1000;
+	if ( Cmd_Argc() > 1 ) {
+		count = atoi( Cmd_Argv( 1 ) );
+		if ( count < 1 ) {
+			count = 1;
+		}
+	}
+
+	srand( count );
+	plainTotal = 0;
+	packedTotal = 0;
+	mismatches = 0;
+	badReads = 0;
+
+	for ( p = 0 ; p < HUFFTEST_PACKETS ; p++ ) {
+		info[0] = 0;
+		Info_SetValueForKey( info, "cg_predictItems", "1" );
+		Info_SetValueForKey( info, "cl_anonymous", "0" );
+		Info_SetValueForKey( info, "cl_guid", va( "%08X%08X%08X%08X", rand(), rand(), rand(), rand() ) );
+		Info_SetValueForKey( info, "challenge", va( "%i", ( rand() << 16 ) ^ rand() ) );
+		Info_SetValueForKey( info, "qport", va( "%i", rand() & 0xffff ) );
+		Info_SetValueForKey( info, "protocol", va( "%i", PROTOCOL_VERSION ) );
+		Info_SetValueForKey( info, "snaps", va( "%i", 20 + rand() % 21 ) );
+		Info_SetValueForKey( info, "rate", va( "%i", 5000 * ( 1 + rand() % 5 ) ) );
+		Info_SetValueForKey( info, "name", va( "^%iPlayer^7%i", rand() % 10, rand() ) );
+		for ( i = rand() % 8 ; i > 0 ; i-- ) {
+			Info_SetValueForKey( info, va( "mod_%i", rand() % 100 ), va( "%x", rand() ) );
+		}
+		Com_sprintf( (char *)plain[p], sizeof( plain[p] ), "\xff\xff\xff\xff" "connect \"%s\"", info );
+		plainSize[p] = strlen( (char *)plain[p] );
+		plainTotal += plainSize[p];
+
+		DynHuff_TestPacket( &a, bufA, plain[p], plainSize[p], qtrue );
+		DynHuff_TestPacket( &b, bufB, plain[p], plainSize[p], qfalse );
+		packedTotal += b.cursize;
+		packedSize[p] = b.cursize;
+		Com_Memcpy( packed[p], bufB, b.cursize );
+		if ( a.cursize != b.cursize || memcmp( a.data, b.data, a.cursize ) ) {
+			mismatches++;
+			continue;
+		}
+
+		Huff_DecompressMessage( &a, 12, qtrue );
+		Huff_DecompressMessage( &b, 12, qfalse );
+		if ( b.cursize != plainSize[p] || memcmp( b.data, plain[p], plainSize[p] )
+			 || a.cursize != b.cursize || memcmp( a.data, b.data, a.cursize ) ) {
+			badReads++;
+		}
+	}
+
+	Com_Printf( "%i connect packets, %i bytes packed to %i: %i encoder mismatches, %i bad reads\n",
+				HUFFTEST_PACKETS, plainTotal, packedTotal, mismatches, badReads );
+
+	for ( j = 0 ; j < 4 ; j++ ) {
+		t = Sys_Milliseconds();
+		for ( i = 0 ; i < count ; i++ ) {
+			for ( p = 0 ; p < HUFFTEST_PACKETS ; p++ ) {
+				if ( j < 2 ) {
+					DynHuff_TestPacket( &a, bufA, plain[p], plainSize[p], j == 0 );
+				} else {
+					MSG_InitOOB( &a, bufA, HUFFTEST_SIZE );
+					Com_Memcpy( bufA, packed[p], packedSize[p] );
+					a.cursize = packedSize[p];
+					Huff_DecompressMessage( &a, 12, j == 2 );
+				}
+			}
+		}
+		times[j] = Sys_Milliseconds() - t;
+	}
+
+	Com_Printf( "%i passes over the corpus\n", count );
+	Com_Printf( "compress:   %5i msec bit at a time, %5i msec word at a time\n", times[0], times[1] );
+	Com_Printf( "decompress: %5i msec bit at a time, %5i msec word at a time\n", times[2], times[3] );
+}
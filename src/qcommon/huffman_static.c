@@ -220,3 +220,87 @@ int StatHuff_WriteSymbol( int symbol, byte* buffer, int bitIndex )
 	return bitCount;
 }
 
+
+
+// the encoding of a 32-bit value is at most 7 raw bits and 4 codes of 11 bits,
+// so it always fits in a 64-bit accumulator along with the 7 bits of a partial byte
+int StatHuff_WriteBits( uint32_t value, int bits, byte* buffer, int bufferSize, int bitIndex )
+{
+	const int rawBits = bits & 7;
+	const int shift = bitIndex & 7;
+	byte* out = buffer + (bitIndex >> 3);
+	uint64_t acc;
+	int count, bytes;
+
+	// the bits past the end of the stream are always clear,
+	// so only the ones already written to this byte are kept
+	acc = (uint64_t)(out[0] & ((1 << shift) - 1));
+	acc |= (uint64_t)(value & ((1u << rawBits) - 1)) << shift;
+	count = shift + rawBits;
+	value >>= rawBits;
+
+	for (int i = rawBits; i < bits; i += 8) {
+		const uint16_t entry = huff_encodeTable[value & 0xFF];
+		acc |= (uint64_t)((entry >> 4) & 0x7FF) << count;
+		count += (int)(entry & 15);
+		value >>= 8;
+	}
+
+	bytes = (count + 7) >> 3;
+	if (bytes > bufferSize - (bitIndex >> 3)) {
+		bytes = bufferSize - (bitIndex >> 3);
+	}
+	for (int i = 0; i < bytes; i++) {
+		out[i] = (byte)(acc >> (i * 8));
+	}
+
+	return count - shift;
+}
+
+
+int StatHuff_ReadBits( int* value, int bits, const byte* buffer, int bufferSize, int bitIndex )
+{
+	const int rawBits = bits & 7;
+	const byte* in = buffer + (bitIndex >> 3);
+	const int avail = bufferSize - (bitIndex >> 3);
+	uint64_t window;
+	uint32_t result;
+	int count, i;
+
+	if (bits < 8) {
+		// raw bits only, which never span more than two bytes
+		uint32_t word = in[0];
+		if ((bitIndex & 7) + bits > 8 && avail > 1) {
+			word |= (uint32_t)in[1] << 8;
+		}
+		*value = (int)((word >> (bitIndex & 7)) & ((1u << bits) - 1));
+		return bits;
+	}
+
+	if (avail >= 8) {
+		// compilers turn this into a single load on little-endian targets
+		window = (uint64_t)in[0] | ((uint64_t)in[1] << 8) | ((uint64_t)in[2] << 16) | ((uint64_t)in[3] << 24) |
+			((uint64_t)in[4] << 32) | ((uint64_t)in[5] << 40) | ((uint64_t)in[6] << 48) | ((uint64_t)in[7] << 56);
+	} else {
+		window = 0;
+		for (i = 0; i < avail; i++) {
+			window |= (uint64_t)in[i] << (i * 8);
+		}
+	}
+	window >>= bitIndex & 7;
+
+	result = (uint32_t)window & ((1u << rawBits) - 1);
+	count = rawBits;
+
+	// one lookup per symbol, straight out of the window: pairing symbols up
+	// in a bigger table was tried and lost more to branch misses than it saved
+	for (i = rawBits; i < bits; i += 8) {
+		const uint16_t entry = huff_decodeTable[(uint32_t)(window >> count) & 0x7FF];
+		result |= (uint32_t)(entry & 0xFF) << i;
+		count += (int)(entry >> 8);
+	}
+
+	*value = (int)result;
+
+	return count;
+}
@@ -0,0 +1,639 @@
+/*
+===========================================================================
+
+Return to Castle Wolfenstein multiplayer GPL Source Code
+Copyright (C) 1999-2010 id Software LLC, a ZeniMax Media company. 
+
+This file is part of the Return to Castle Wolfenstein multiplayer GPL Source Code (RTCW MP Source Code).  
+
+RTCW MP Source Code is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+RTCW MP Source Code is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with RTCW MP Source Code.  If not, see <http://www.gnu.org/licenses/>.
+
+In addition, the RTCW MP Source Code is also subject to certain additional terms. You should have received a copy of these additional terms immediately following the terms and conditions of the GNU General Public License which accompanied the RTCW MP Source Code.  If not, please request a copy in writing from id Software at the address below.
+
+If you have questions concerning this license or the applicable additional terms, you may contact in writing id Software LLC, c/o ZeniMax Media Inc., Suite 120, Rockville, Maryland 20850 USA.
+
+===========================================================================
+*/
+
+
+// inflate.c -- whole buffer deflate decoder for pk3 members
+
+#include "../game/q_shared.h"
+#include "qcommon.h"
+#include "unzip.h"
+
+/*
+=============================================================================
+
+A deflate decoder for when all of the compressed data is in memory and
+the uncompressed size is known, which is the case for a pk3 member read
+whole.  Bits come out of a 64 bit buffer that is refilled a word at a
+time, codes are decoded with one table lookup on the next bits (two for
+the long ones), and matches that don't overlap are copied eight bytes
+at a time.  Nothing is kept between calls but the tables, so threads
+can decode at the same time with a set of tables each.
+
+=============================================================================
+*/
+
+#if defined( __i386__ ) || defined( __x86_64__ ) || defined( _M_IX86 ) || defined( _M_X64 )
+#define INF_WORD_REFILL     1       // unaligned little endian loads
+#else
+#define INF_WORD_REFILL     0
+#endif
+
+#define INF_MAX_CODE_BITS   15
+#define INF_LIT_BITS        10      // bits of the primary tables
+#define INF_DIST_BITS       8
+#define INF_CODELEN_BITS    7
+
+// the primary table and room for the subtables, complete codes need far less
+#define INF_LIT_TABLE       ( ( 1 << INF_LIT_BITS ) + 2048 )
+#define INF_DIST_TABLE      ( ( 1 << INF_DIST_BITS ) + 512 )
+
+// infEntry_t op
+#define INF_OP_BASE         0x10    // | extra bits, a length or distance base in value
+#define INF_OP_LITERAL      0x20
+#define INF_OP_END          0x40
+#define INF_OP_INVALID      0x60
+#define INF_OP_SUBTABLE     0x80    // | subtable bits, the subtable offset in value
+
+typedef enum {
+	INF_LITLEN,
+	INF_DISTANCE,
+	INF_CODELEN
+} infCodeKind_t;
+
+typedef struct {
+	unsigned short value;
+	byte bits;                      // length of the code
+	byte op;
+} infEntry_t;
+
+struct inflateTables_s {
+	infEntry_t lit[INF_LIT_TABLE];
+	infEntry_t dist[INF_DIST_TABLE];
+	infEntry_t codeLen[1 << INF_CODELEN_BITS];
+	infEntry_t fixedLit[INF_LIT_TABLE];
+	infEntry_t fixedDist[INF_DIST_TABLE];
+	qboolean fixedBuilt;
+};
+
+typedef struct {
+	const byte  *in, *inEnd;
+	uint64_t bitBuf;
+	int bitCount;
+	int overrun;                    // zero bytes fed in past the end of the input
+	byte        *out, *outStart, *outEnd;
+} infStream_t;
+
+static const unsigned short inf_lengthBase[29] = {
+	3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+	35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static const byte inf_lengthExtra[29] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+	3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+static const unsigned short inf_distBase[30] = {
+	1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+	257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+static const byte inf_distExtra[30] = {
+	0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+	7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+static const byte inf_codeLenOrder[19] = {
+	16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+};
+
+// the bit buffer lives in locals, loaded from and saved to an infStream_t
+#define INF_LOAD( s ) \
+	in = ( s )->in; inEnd = ( s )->inEnd; bitBuf = ( s )->bitBuf; bitCount = ( s )->bitCount; overrun = ( s )->overrun
+#define INF_SAVE( s ) \
+	( s )->in = in; ( s )->bitBuf = bitBuf; ( s )->bitCount = bitCount; ( s )->overrun = overrun
+
+// leaves at least 56 bits in the buffer, anything above bitCount is either
+// zero or the bits that come next
+#define INF_REFILL() \
+	if ( INF_WORD_REFILL && inEnd - in >= 8 ) { \
+		uint64_t word; \
+		memcpy( &word, in, 8 ); \
+		bitBuf |= word << bitCount; \
+		in += ( 63 - bitCount ) >> 3; \
+		bitCount |= 56; \
+	} else { \
+		while ( bitCount <= 56 ) { \
+			if ( in < inEnd ) { \
+				bitBuf |= (uint64_t)*in++ << bitCount; \
+			} else { \
+				overrun++; \
+			} \
+			bitCount += 8; \
+		} \
+	}
+
+#define INF_BITS( n )   ( (int)bitBuf & ( ( 1 << ( n ) ) - 1 ) )
+#define INF_DROP( n )   ( bitBuf >>= ( n ), bitCount -= ( n ) )
+
+/*
+================
+Inf_SymbolEntry
+================
+*/
+static infEntry_t Inf_SymbolEntry( infCodeKind_t kind, int sym ) {
+	infEntry_t e;
+
+	e.bits = 0;
+	e.value = 0;
+	e.op = INF_OP_INVALID;
+	if ( kind == INF_LITLEN ) {
+		if ( sym < 256 ) {
+			e.op = INF_OP_LITERAL;
+			e.value = sym;
+		} else if ( sym == 256 ) {
+			e.op = INF_OP_END;
+		} else if ( sym < 286 ) {
+			e.op = INF_OP_BASE | inf_lengthExtra[sym - 257];
+			e.value = inf_lengthBase[sym - 257];
+		}
+	} else if ( kind == INF_DISTANCE ) {
+		if ( sym < 30 ) {
+			e.op = INF_OP_BASE | inf_distExtra[sym];
+			e.value = inf_distBase[sym];
+		}
+	} else {
+		e.op = INF_OP_LITERAL;
+		e.value = sym;
+	}
+	return e;
+}
+
+static int Inf_Reverse( int code, int len ) {
+	int rev;
+
+	for ( rev = 0 ; len ; len-- ) {
+		rev = ( rev << 1 ) | ( code & 1 );
+		code >>= 1;
+	}
+	return rev;
+}
+
+/*
+================
+Inf_BuildTable
+
+Fills the decode table for the canonical code with the given lengths.
+Codes longer than rootBits go to a subtable per primary entry, sized
+for the longest code that shares it.  Codes that aren't complete are
+only allowed with at most one code in them, as deflate does for a block
+without matches.
+================
+*/
+static qboolean Inf_BuildTable( infEntry_t *table, int tableSize, int rootBits,
+								const byte *lengths, int num, infCodeKind_t kind ) {
+	int count[INF_MAX_CODE_BITS + 1];
+	int first[INF_MAX_CODE_BITS + 1];
+	int next[INF_MAX_CODE_BITS + 1];
+	byte subBits[1 << INF_LIT_BITS];
+	infEntry_t e, invalid;
+	int sym, len, code, rev, left, codes, used, prefix, step, i;
+
+	memset( count, 0, sizeof( count ) );
+	for ( sym = 0 ; sym < num ; sym++ ) {
+		count[lengths[sym]]++;
+	}
+	count[0] = 0;
+
+	left = 1;
+	codes = 0;
+	for ( len = 1 ; len <= INF_MAX_CODE_BITS ; len++ ) {
+		left <<= 1;
+		left -= count[len];
+		if ( left < 0 ) {
+			return qfalse;      // over subscribed
+		}
+		codes += count[len];
+	}
+	if ( left > 0 && codes > 1 ) {
+		return qfalse;          // incomplete
+	}
+
+	code = 0;
+	for ( len = 1 ; len <= INF_MAX_CODE_BITS ; len++ ) {
+		code = ( code + count[len - 1] ) << 1;
+		first[len] = code;
+	}
+
+	invalid.value = 0;
+	invalid.bits = 1;
+	invalid.op = INF_OP_INVALID;
+	for ( i = 0 ; i < ( 1 << rootBits ) ; i++ ) {
+		table[i] = invalid;
+	}
+
+	// size the subtables
+	memset( subBits, 0, 1 << rootBits );
+	memcpy( next, first, sizeof( next ) );
+	for ( sym = 0 ; sym < num ; sym++ ) {
+		len = lengths[sym];
+		if ( !len ) {
+			continue;
+		}
+		code = next[len]++;
+		if ( len > rootBits ) {
+			prefix = Inf_Reverse( code, len ) & ( ( 1 << rootBits ) - 1 );
+			if ( len - rootBits > subBits[prefix] ) {
+				subBits[prefix] = len - rootBits;
+			}
+		}
+	}
+	used = 1 << rootBits;
+	for ( prefix = 0 ; prefix < ( 1 << rootBits ) ; prefix++ ) {
+		if ( !subBits[prefix] ) {
+			continue;
+		}
+		if ( used + ( 1 << subBits[prefix] ) > tableSize ) {
+			return qfalse;
+		}
+		table[prefix].value = used;
+		table[prefix].bits = rootBits;
+		table[prefix].op = INF_OP_SUBTABLE | subBits[prefix];
+		for ( i = 0 ; i < ( 1 << subBits[prefix] ) ; i++ ) {
+			table[used + i] = invalid;
+		}
+		used += 1 << subBits[prefix];
+	}
+
+	// fill in every entry each code matches
+	memcpy( next, first, sizeof( next ) );
+	for ( sym = 0 ; sym < num ; sym++ ) {
+		len = lengths[sym];
+		if ( !len ) {
+			continue;
+		}
+		rev = Inf_Reverse( next[len]++, len );
+		e = Inf_SymbolEntry( kind, sym );
+		e.bits = len;
+		if ( len <= rootBits ) {
+			for ( i = rev ; i < ( 1 << rootBits ) ; i += 1 << len ) {
+				table[i] = e;
+			}
+		} else {
+			prefix = rev & ( ( 1 << rootBits ) - 1 );
+			step = 1 << ( len - rootBits );
+			for ( i = rev >> rootBits ; i < ( 1 << ( table[prefix].op & 15 ) ) ; i += step ) {
+				table[table[prefix].value + i] = e;
+			}
+		}
+	}
+
+	return qtrue;
+}
+
+static void Inf_BuildFixed( inflateTables_t *t ) {
+	byte lengths[288];
+	int i;
+
+	for ( i = 0 ; i < 288 ; i++ ) {
+		lengths[i] = i < 144 ? 8 : i < 256 ? 9 : i < 280 ? 7 : 8;
+	}
+	Inf_BuildTable( t->fixedLit, INF_LIT_TABLE, INF_LIT_BITS, lengths, 288, INF_LITLEN );
+	for ( i = 0 ; i < 32 ; i++ ) {
+		lengths[i] = 5;
+	}
+	Inf_BuildTable( t->fixedDist, INF_DIST_TABLE, INF_DIST_BITS, lengths, 32, INF_DISTANCE );
+	t->fixedBuilt = qtrue;
+}
+
+/*
+================
+Inf_ReadDynamic
+
+The code lengths at the start of a dynamic block
+================
+*/
+static qboolean Inf_ReadDynamic( infStream_t *s, inflateTables_t *t ) {
+	const byte  *in, *inEnd;
+	uint64_t bitBuf;
+	int bitCount, overrun;
+	byte lengths[286 + 30];
+	byte codeLens[19];
+	infEntry_t e;
+	int numLit, numDist, numCodes, total, repeat, value, i;
+
+	INF_LOAD( s );
+
+	INF_REFILL();
+	numLit = INF_BITS( 5 ) + 257;
+	INF_DROP( 5 );
+	numDist = INF_BITS( 5 ) + 1;
+	INF_DROP( 5 );
+	numCodes = INF_BITS( 4 ) + 4;
+	INF_DROP( 4 );
+	if ( numLit > 286 || numDist > 30 ) {
+		return qfalse;
+	}
+
+	memset( codeLens, 0, sizeof( codeLens ) );
+	for ( i = 0 ; i < numCodes ; i++ ) {
+		INF_REFILL();
+		codeLens[inf_codeLenOrder[i]] = INF_BITS( 3 );
+		INF_DROP( 3 );
+	}
+	if ( !Inf_BuildTable( t->codeLen, 1 << INF_CODELEN_BITS, INF_CODELEN_BITS, codeLens, 19, INF_CODELEN ) ) {
+		return qfalse;
+	}
+
+	total = numLit + numDist;
+	for ( i = 0 ; i < total ; ) {
+		INF_REFILL();
+		e = t->codeLen[INF_BITS( INF_CODELEN_BITS )];
+		if ( e.op != INF_OP_LITERAL ) {
+			return qfalse;
+		}
+		INF_DROP( e.bits );
+
+		if ( e.value < 16 ) {
+			lengths[i++] = e.value;
+			continue;
+		}
+		if ( e.value == 16 ) {
+			if ( !i ) {
+				return qfalse;
+			}
+			value = lengths[i - 1];
+			repeat = 3 + INF_BITS( 2 );
+			INF_DROP( 2 );
+		} else if ( e.value == 17 ) {
+			value = 0;
+			repeat = 3 + INF_BITS( 3 );
+			INF_DROP( 3 );
+		} else {
+			value = 0;
+			repeat = 11 + INF_BITS( 7 );
+			INF_DROP( 7 );
+		}
+		if ( i + repeat > total ) {
+			return qfalse;
+		}
+		while ( repeat-- ) {
+			lengths[i++] = value;
+		}
+	}
+
+	// a block has to be able to end
+	if ( !lengths[256] ) {
+		return qfalse;
+	}
+	if ( !Inf_BuildTable( t->lit, INF_LIT_TABLE, INF_LIT_BITS, lengths, numLit, INF_LITLEN ) ||
+		 !Inf_BuildTable( t->dist, INF_DIST_TABLE, INF_DIST_BITS, lengths + numLit, numDist, INF_DISTANCE ) ) {
+		return qfalse;
+	}
+
+	INF_SAVE( s );
+	return qtrue;
+}
+
+/*
+================
+Inf_DecodeBlock
+
+The literals and matches of a fixed or dynamic block, up to its end code.
+Between refills a length and a distance take at most 48 bits.
+================
+*/
+static qboolean Inf_DecodeBlock( infStream_t *s, const infEntry_t *lit, const infEntry_t *dist ) {
+	const byte  *in, *inEnd;
+	uint64_t bitBuf;
+	int bitCount, overrun;
+	byte        *out, *outStart, *outEnd, *end;
+	const byte  *src;
+	infEntry_t e;
+	int length, distance;
+
+	INF_LOAD( s );
+	out = s->out;
+	outStart = s->outStart;
+	outEnd = s->outEnd;
+
+	for ( ;; ) {
+		INF_REFILL();
+		e = lit[INF_BITS( INF_LIT_BITS )];
+		if ( e.op & INF_OP_SUBTABLE ) {
+			e = lit[e.value + ( (int)( bitBuf >> INF_LIT_BITS ) & ( ( 1 << ( e.op & 15 ) ) - 1 ) )];
+		}
+		INF_DROP( e.bits );
+
+		if ( e.op == INF_OP_LITERAL ) {
+			if ( out == outEnd ) {
+				return qfalse;
+			}
+			*out++ = e.value;
+			continue;
+		}
+		if ( !( e.op & INF_OP_BASE ) ) {
+			if ( e.op == INF_OP_END ) {
+				break;
+			}
+			return qfalse;
+		}
+
+		length = e.value + INF_BITS( e.op & 15 );
+		INF_DROP( e.op & 15 );
+
+		e = dist[INF_BITS( INF_DIST_BITS )];
+		if ( e.op & INF_OP_SUBTABLE ) {
+			e = dist[e.value + ( (int)( bitBuf >> INF_DIST_BITS ) & ( ( 1 << ( e.op & 15 ) ) - 1 ) )];
+		}
+		INF_DROP( e.bits );
+		if ( !( e.op & INF_OP_BASE ) ) {
+			return qfalse;
+		}
+		distance = e.value + INF_BITS( e.op & 15 );
+		INF_DROP( e.op & 15 );
+
+		if ( distance > out - outStart || length > outEnd - out ) {
+			return qfalse;
+		}
+		src = out - distance;
+		end = out + length;
+		if ( distance >= 8 && outEnd - end >= 8 ) {
+			// may write up to 7 bytes past the end, that the next ones overwrite
+			do {
+				memcpy( out, src, 8 );
+				out += 8;
+				src += 8;
+			} while ( out < end );
+			out = end;
+		} else if ( distance == 1 ) {
+			memset( out, *src, length );
+			out = end;
+		} else {
+			while ( out < end ) {
+				*out++ = *src++;
+			}
+		}
+	}
+
+	INF_SAVE( s );
+	s->out = out;
+	return qtrue;
+}
+
+/*
+================
+Inf_CopyStored
+================
+*/
+static qboolean Inf_CopyStored( infStream_t *s ) {
+	const byte  *in, *inEnd;
+	uint64_t bitBuf;
+	int bitCount, overrun, length, buffered;
+
+	INF_LOAD( s );
+
+	INF_DROP( bitCount & 7 );
+	INF_REFILL();
+	length = INF_BITS( 16 );
+	INF_DROP( 16 );
+	if ( length != ( ~INF_BITS( 16 ) & 0xffff ) ) {
+		return qfalse;
+	}
+	INF_DROP( 16 );
+
+	// give the whole bytes left in the bit buffer back to the input
+	buffered = ( bitCount >> 3 ) - overrun;
+	if ( buffered < 0 ) {
+		return qfalse;
+	}
+	in -= buffered;
+	bitBuf = 0;
+	bitCount = 0;
+	overrun = 0;
+
+	if ( length > inEnd - in || length > s->outEnd - s->out ) {
+		return qfalse;
+	}
+	memcpy( s->out, in, length );
+	s->out += length;
+	in += length;
+
+	INF_SAVE( s );
+	return qtrue;
+}
+
+/*
+================
+Inflate_Whole
+
+Decodes a raw deflate stream that has to come out at exactly outLen
+bytes.  Returns qfalse for anything that isn't a valid stream of that
+size, the output is undefined then.
+================
+*/
+int Inflate_Whole( inflateTables_t *t, const byte *in, int inLen, byte *out, int outLen ) {
+	infStream_t s;
+	uint64_t bitBuf;
+	int bitCount, overrun, final, type;
+	const byte  *inEnd;
+
+	s.in = in;
+	s.inEnd = in + inLen;
+	s.bitBuf = 0;
+	s.bitCount = 0;
+	s.overrun = 0;
+	s.out = s.outStart = out;
+	s.outEnd = out + outLen;
+
+	do {
+		INF_LOAD( &s );
+		INF_REFILL();
+		if ( overrun > 8 ) {
+			return qfalse;      // well past the end of the input
+		}
+		final = INF_BITS( 1 );
+		INF_DROP( 1 );
+		type = INF_BITS( 2 );
+		INF_DROP( 2 );
+		INF_SAVE( &s );
+
+		if ( type == 0 ) {
+			if ( !Inf_CopyStored( &s ) ) {
+				return qfalse;
+			}
+		} else if ( type == 1 ) {
+			if ( !t->fixedBuilt ) {
+				Inf_BuildFixed( t );
+			}
+			if ( !Inf_DecodeBlock( &s, t->fixedLit, t->fixedDist ) ) {
+				return qfalse;
+			}
+		} else if ( type == 2 ) {
+			if ( !Inf_ReadDynamic( &s, t ) || !Inf_DecodeBlock( &s, t->lit, t->dist ) ) {
+				return qfalse;
+			}
+		} else {
+			return qfalse;
+		}
+	} while ( !final );
+
+	// every byte there, and no bits used from past the end
+	return s.out == s.outEnd && s.bitCount >= s.overrun * 8;
+}
+
+/*
+================
+Inflate_AllocTables
+================
+*/
+inflateTables_t *Inflate_AllocTables( void ) {
+	return calloc( 1, sizeof( inflateTables_t ) );
+}
+
+void Inflate_FreeTables( inflateTables_t *t ) {
+	free( t );
+}
+
+/*
+================
+Inflate_CRC32
+
+The zip crc, to check what came out.  Only from the main thread, the
+table is made on the first call.
+================
+*/
+unsigned long Inflate_CRC32( unsigned long crc, const byte *buf, int len ) {
+	static unsigned int table[256];
+	static qboolean built;
+	unsigned int c;
+	int i, k;
+
+	if ( !built ) {
+		for ( i = 0 ; i < 256 ; i++ ) {
+			c = i;
+			for ( k = 0 ; k < 8 ; k++ ) {
+				c = c & 1 ? 0xedb88320u ^ ( c >> 1 ) : c >> 1;
+			}
+			table[i] = c;
+		}
+		built = qtrue;
+	}
+
+	c = (unsigned int)crc ^ 0xffffffffu;
+	for ( i = 0 ; i < len ; i++ ) {
+		c = table[( c ^ buf[i] ) & 0xff] ^ ( c >> 8 );
+	}
+	return c ^ 0xffffffffu;
+}
@@ -322,6 +322,23 @@ void JSONW_IntegerValue(const char* name, int number)
 	JSONW_StringValue(name, "%d", number);
 }
 
+// written without quotes, unlike the values above
+void JSONW_NumberValue(const char* name, double number)
+{
+	if (!name)
+		return;
+
+	if (writer.itemIndices[writer.level] > 0)
+		JSONW_Write(", ");
+
+	JSONW_WriteNewLine();
+	JSONW_Write("\"");
+	JSONW_Write(name);
+	JSONW_Write("\": ");
+	JSONW_Write(va("%.10g", number));
+	++writer.itemIndices[writer.level];
+}
+
 void JSONW_HexValue(const char* name, uint64_t number)
 {
 	if (!name)
@@ -385,3 +402,13 @@ void JSONW_UnnamedString(PRINTF_FORMAT_STRING const char* format, ...)
 	JSONW_Write("\"");
 	++writer.itemIndices[writer.level];
 }
+
+void JSONW_UnnamedNumber(double number)
+{
+	if (writer.itemIndices[writer.level] > 0)
+		JSONW_Write(", ");
+
+	JSONW_WriteNewLine();
+	JSONW_Write(va("%.10g", number));
+	++writer.itemIndices[writer.level];
+}
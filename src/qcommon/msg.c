@@ -95,9 +95,6 @@ bit functions
 
 // negative bit values include signs
 void MSG_WriteBits( msg_t *msg, int value, int bits ) {
-	int i, bitIndex;
-
-
 	msg->uncompsize += bits;            // NERVE - SMF - net debugging
 
 	// this isn't an exact overflow check, but close enough
@@ -133,35 +130,56 @@ void MSG_WriteBits( msg_t *msg, int value, int bits ) {
 		}
 	} else {
 		value &= ( 0xffffffff >> ( 32 - bits ) );
-		if ( bits & 7 ) {
-			int nbits;
-			nbits = bits & 7;
-			bitIndex = msg->bit;
-			for ( i = 0; i < nbits; i++ ) {
-				StatHuff_WriteBit((value & 1), msg->data, bitIndex);
-				value = ( value >> 1 );
-				bitIndex++;
-			}
-			msg->bit = bitIndex;
-			bits = bits - nbits;
-		}
-		if ( bits ) {
-			bitIndex = msg->bit;
-			for ( i = 0; i < bits; i += 8 ) {
-				bitIndex += StatHuff_WriteSymbol((value & 0xff), msg->data, bitIndex);
-				value = ( value >> 8 );
-			}
-			msg->bit = bitIndex;
-		}
+		msg->bit += StatHuff_WriteBits( value, bits, msg->data, msg->maxsize, msg->bit );
 		msg->cursize = ( msg->bit >> 3 ) + 1;
 	}
 }
 
+/*
+============
+MSG_WriteBitString
+
+Appends bits that were already written to another bitstream message,
+so an encoding can be reused without running the huffman coder again.
+The bits in data past numBits must be clear, and uncompBits is the
+uncompsize of the source for net debugging.
+============
+*/
+void MSG_WriteBitString( msg_t *msg, const byte *data, int numBits, int uncompBits ) {
+	int i, bytes, shift;
+	byte    *out;
+
+	if ( msg->oob ) {
+		Com_Error( ERR_DROP, "MSG_WriteBitString: oob message" );
+	}
+
+	msg->uncompsize += uncompBits;
+
+	bytes = ( numBits + 7 ) >> 3;
+	if ( msg->maxsize - ( ( msg->bit + numBits ) >> 3 ) - 1 < 4 ) {
+		msg->overflowed = qtrue;
+		return;
+	}
+
+	out = msg->data + ( msg->bit >> 3 );
+	shift = msg->bit & 7;
+	if ( !shift ) {
+		Com_Memcpy( out, data, bytes );
+	} else {
+		// the free bits of a partially written byte are always clear
+		for ( i = 0 ; i < bytes ; i++ ) {
+			out[i] |= data[i] << shift;
+			out[i + 1] = data[i] >> ( 8 - shift );
+		}
+	}
+
+	msg->bit += numBits;
+	msg->cursize = ( msg->bit >> 3 ) + 1;
+}
+
 int MSG_ReadBits( msg_t *msg, int bits ) {
 	int value;
-	int get;
 	qboolean sgn;
-	int i, nbits, bitIndex;
 
 	value = 0;
 
@@ -191,28 +209,10 @@ int MSG_ReadBits( msg_t *msg, int bits ) {
 			Com_Error( ERR_DROP, "can't read %d bits\n", bits );
 		}
 	} else {
-		nbits = 0;
-		if ( bits & 7 ) {
-			nbits = bits & 7;
-			bitIndex = msg->bit;
-			for ( i = 0; i < nbits; i++ ) {
-				value |= StatHuff_ReadBit(msg->data, bitIndex) << i;
-				bitIndex++;
-			}
-			msg->bit = bitIndex;
-			bits = bits - nbits;
-		}
-		if ( bits ) {
-			bitIndex = msg->bit;
-			for ( i = 0; i < bits; i += 8 ) {
-				bitIndex += StatHuff_ReadSymbol(&get, msg->data, bitIndex);
-				value |= ( get << ( i + nbits ) );
-			}
-			msg->bit = bitIndex;
-		}
+		msg->bit += StatHuff_ReadBits( &value, bits, msg->data, msg->maxsize, msg->bit );
 		msg->readcount = ( msg->bit >> 3 ) + 1;
 	}
-	if ( sgn ) {
+	if ( sgn && bits < 32 ) {
 		if ( value & ( 1 << ( bits - 1 ) ) ) {
 			value |= -1 ^ ( ( 1 << bits ) - 1 );
 		}
@@ -221,6 +221,79 @@ int MSG_ReadBits( msg_t *msg, int bits ) {
 	return value;
 }
 
+/*
+============
+MSG_WriteBitsReference
+
+The bit at a time huffman writer MSG_WriteBits replaced, kept so
+bittest can check the two produce the same stream
+============
+*/
+static void MSG_WriteBitsReference( msg_t *msg, int value, int bits ) {
+	int i, nbits, bitIndex;
+
+	if ( bits < 0 ) {
+		bits = -bits;
+	}
+	value &= ( 0xffffffff >> ( 32 - bits ) );
+	if ( bits & 7 ) {
+		nbits = bits & 7;
+		bitIndex = msg->bit;
+		for ( i = 0; i < nbits; i++ ) {
+			StatHuff_WriteBit( ( value & 1 ), msg->data, bitIndex );
+			value = ( value >> 1 );
+			bitIndex++;
+		}
+		msg->bit = bitIndex;
+		bits = bits - nbits;
+	}
+	if ( bits ) {
+		bitIndex = msg->bit;
+		for ( i = 0; i < bits; i += 8 ) {
+			bitIndex += StatHuff_WriteSymbol( ( value & 0xff ), msg->data, bitIndex );
+			value = ( value >> 8 );
+		}
+		msg->bit = bitIndex;
+	}
+	msg->cursize = ( msg->bit >> 3 ) + 1;
+}
+
+/*
+============
+MSG_ReadBitsReference
+
+Unsigned counterpart of MSG_WriteBitsReference
+============
+*/
+static int MSG_ReadBitsReference( msg_t *msg, int bits ) {
+	int i, nbits, bitIndex;
+	int value, get;
+
+	value = 0;
+	nbits = 0;
+	if ( bits & 7 ) {
+		nbits = bits & 7;
+		bitIndex = msg->bit;
+		for ( i = 0; i < nbits; i++ ) {
+			value |= StatHuff_ReadBit( msg->data, bitIndex ) << i;
+			bitIndex++;
+		}
+		msg->bit = bitIndex;
+		bits = bits - nbits;
+	}
+	if ( bits ) {
+		bitIndex = msg->bit;
+		for ( i = 0; i < bits; i += 8 ) {
+			bitIndex += StatHuff_ReadSymbol( &get, msg->data, bitIndex );
+			value |= ( get << ( i + nbits ) );
+		}
+		msg->bit = bitIndex;
+	}
+	msg->readcount = ( msg->bit >> 3 ) + 1;
+
+	return value;
+}
+
 
 
 //================================================================================
@@ -757,17 +830,14 @@ netField_t entityStateFields[] =
 
 /*
 ==================
-MSG_WriteDeltaEntity
+MSG_WriteDeltaEntityReference
 
-Writes part of a packetentities message, including the entity number.
-Can delta from either a baseline or a previous packet_entity
-If to is NULL, a remove entity update will be sent
-If force is not set, then nothing at all will be generated if the entity is
-identical, under the assumption that the in-order delta code will catch it.
+The original field by field encoder.  MSG_WriteDeltaEntityTable must
+produce exactly the same bits, which deltatest checks against this.
 ==================
 */
-void MSG_WriteDeltaEntity( msg_t *msg, struct entityState_s *from, struct entityState_s *to,
-						   qboolean force ) {
+static void MSG_WriteDeltaEntityReference( msg_t *msg, struct entityState_s *from, struct entityState_s *to,
+										   qboolean force ) {
 	int i, lc;
 	int numFields;
 	netField_t  *field;
@@ -1118,271 +1188,456 @@ netField_t playerStateFields[] =
 };
 
 /*
-=============
-MSG_WriteDeltaPlayerstate
+=============================================================================
 
-=============
-*/
-void MSG_WriteDeltaPlayerstate( msg_t *msg, struct playerState_s *from, struct playerState_s *to ) {
-	int i, j, lc;
-	playerState_t dummy;
-	int statsbits;
-	int persistantbits;
-	int ammobits[4];                //----(SA)	modified
-	int clipbits;                   //----(SA)	added
-	int powerupbits;
-	int holdablebits;
-	int numFields;
-	int c;
-	netField_t      *field;
-	int             *fromF, *toF;
-	float fullFloat;
-	int trunc;
-	int startBit, endBit;
-	int print;
+DELTA CODEC
 
-	if ( !from ) {
-		from = &dummy;
-		memset( &dummy, 0, sizeof( dummy ) );
-	}
+Instead of testing every netField in turn, the two structs are compared
+a whole SSE2 register at a time into a bit per changed 32 bit word.  The
+changed words are mapped back to field numbers through a table built by
+MSG_InitDeltaTables, and only the fields that changed go through their
+writer.  The stats, persistant, holdable, powerups, ammo and ammoclip
+masks of a playerState_t fall out of the same compare.
 
-	if ( msg->bit == 0 ) {
-		startBit = msg->cursize * 8 - GENTITYNUM_BITS;
-	} else {
-		startBit = ( msg->cursize - 1 ) * 8 + msg->bit - GENTITYNUM_BITS;
-	}
+The output is bit for bit what the field by field encoders produce.
+Without SSE2 the word compare loses to just walking the fields, most of
+all on playerstates, so there MSG_WriteDeltaEntity and
+MSG_WriteDeltaPlayerstate stay on the field by field encoders and the
+tables are only run by deltatest.
 
-	// shownet 2/3 will interleave with other printed info, -2 will
-	// just print the delta records
-	if ( cl_shownet && ( cl_shownet->integer >= 2 || cl_shownet->integer == -2 ) ) {
-		print = 1;
-		Com_Printf( "W|%3i: playerstate ", msg->cursize );
-	} else {
-		print = 0;
-	}
+=============================================================================
+*/
 
-	c = msg->cursize;
+#if defined( __SSE2__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 )
+#define MSG_SSE2    1
+#include <emmintrin.h>
+#else
+#define MSG_SSE2    0
+#endif
 
-	numFields = sizeof( playerStateFields ) / sizeof( playerStateFields[0] );
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
 
-	lc = 0;
-	for ( i = 0, field = playerStateFields ; i < numFields ; i++, field++ ) {
-		fromF = ( int * )( (byte *)from + field->offset );
-		toF = ( int * )( (byte *)to + field->offset );
-		if ( *fromF != *toF ) {
-			lc = i + 1;
-		}
-	}
+#define ENTITY_WORDS    ( sizeof( entityState_t ) / 4 )
+#define PLAYER_WORDS    ( sizeof( playerState_t ) / 4 )
+#define MAX_NET_FIELDS  128
 
-	MSG_WriteByte( msg, lc );   // # of changes
+typedef struct netFieldCodec_s netFieldCodec_t;
 
+typedef void ( *netFieldWriter_t )( msg_t *msg, const netFieldCodec_t *codec, int value, qboolean print );
 
-	for ( i = 0, field = playerStateFields ; i < lc ; i++, field++ ) {
-		fromF = ( int * )( (byte *)from + field->offset );
-		toF = ( int * )( (byte *)to + field->offset );
+struct netFieldCodec_s {
+	const char          *name;
+	int word;                   // offset / 4
+	int bits;
+	netFieldWriter_t write;
+};
 
-		if ( *fromF == *toF ) {
-			MSG_WriteBits( msg, 0, 1 ); // no change
-			continue;
-		}
+typedef struct {
+	int stats;
+	int persistant;
+	int holdable;
+	int powerups;
+	int ammo[4];
+	int ammoclip[4];
+} playerArrayBits_t;
 
-		MSG_WriteBits( msg, 1, 1 ); // changed
-//		pcount[i]++;
+static netFieldCodec_t entityCodec[MAX_NET_FIELDS];
+static netFieldCodec_t playerCodec[MAX_NET_FIELDS];
 
-		if ( field->bits == 0 ) {
-			// float
-			fullFloat = *(float *)toF;
-			trunc = (int)fullFloat;
+// field number for each word of the struct, -1 if it isn't sent as a field
+static short entityWordField[ENTITY_WORDS];
+static short playerWordField[PLAYER_WORDS];
 
-			if ( trunc == fullFloat && trunc + FLOAT_INT_BIAS >= 0 &&
-				 trunc + FLOAT_INT_BIAS < ( 1 << FLOAT_INT_BITS ) ) {
-				// send as small integer
-				MSG_WriteBits( msg, 0, 1 );
-				MSG_WriteBits( msg, trunc + FLOAT_INT_BIAS, FLOAT_INT_BITS );
-				if ( print ) {
-					Com_Printf( "%s:%i ", field->name, trunc );
-				}
-			} else {
-				// send as full floating point value
-				MSG_WriteBits( msg, 1, 1 );
-				MSG_WriteBits( msg, *toF, 32 );
-				if ( print ) {
-					Com_Printf( "%s:%f ", field->name, *(float *)toF );
-				}
-			}
-		} else {
-			// integer
-			MSG_WriteBits( msg, *toF, field->bits );
-			if ( print ) {
-				Com_Printf( "%s:%i ", field->name, *toF );
-			}
-		}
-	}
-	c = msg->cursize - c;
+/*
+==================
+MSG_WriteEntityFloat
+==================
+*/
+static void MSG_WriteEntityFloat( msg_t *msg, const netFieldCodec_t *codec, int value, qboolean print ) {
+	float fullFloat;
+	int trunc;
 
+	fullFloat = *(float *)&value;
+	trunc = (int)fullFloat;
 
-	//
-	// send the arrays
-	//
-	statsbits = 0;
-	for ( i = 0 ; i < 16 ; i++ ) {
-		if ( to->stats[i] != from->stats[i] ) {
-			statsbits |= 1 << i;
+	if ( fullFloat == 0.0f ) {
+		MSG_WriteBits( msg, 0, 1 );
+	} else {
+		MSG_WriteBits( msg, 1, 1 );
+		if ( trunc == fullFloat && trunc + FLOAT_INT_BIAS >= 0 &&
+			 trunc + FLOAT_INT_BIAS < ( 1 << FLOAT_INT_BITS ) ) {
+			// send as small integer
+			MSG_WriteBits( msg, 0, 1 );
+			MSG_WriteBits( msg, trunc + FLOAT_INT_BIAS, FLOAT_INT_BITS );
+		} else {
+			// send as full floating point value
+			MSG_WriteBits( msg, 1, 1 );
+			MSG_WriteBits( msg, value, 32 );
 		}
 	}
-	persistantbits = 0;
-	for ( i = 0 ; i < 16 ; i++ ) {
-		if ( to->persistant[i] != from->persistant[i] ) {
-			persistantbits |= 1 << i;
-		}
+}
+
+/*
+==================
+MSG_WriteEntityInt
+==================
+*/
+static void MSG_WriteEntityInt( msg_t *msg, const netFieldCodec_t *codec, int value, qboolean print ) {
+	if ( value == 0 ) {
+		MSG_WriteBits( msg, 0, 1 );
+	} else {
+		MSG_WriteBits( msg, 1, 1 );
+		MSG_WriteBits( msg, value, codec->bits );
 	}
-	holdablebits = 0;
-	for ( i = 0 ; i < 16 ; i++ ) {
-		if ( to->holdable[i] != from->holdable[i] ) {
-			holdablebits |= 1 << i;
+}
+
+/*
+==================
+MSG_WritePlayerFloat
+==================
+*/
+static void MSG_WritePlayerFloat( msg_t *msg, const netFieldCodec_t *codec, int value, qboolean print ) {
+	float fullFloat;
+	int trunc;
+
+	fullFloat = *(float *)&value;
+	trunc = (int)fullFloat;
+
+	if ( trunc == fullFloat && trunc + FLOAT_INT_BIAS >= 0 &&
+		 trunc + FLOAT_INT_BIAS < ( 1 << FLOAT_INT_BITS ) ) {
+		// send as small integer
+		MSG_WriteBits( msg, 0, 1 );
+		MSG_WriteBits( msg, trunc + FLOAT_INT_BIAS, FLOAT_INT_BITS );
+		if ( print ) {
+			Com_Printf( "%s:%i ", codec->name, trunc );
 		}
-	}
-	powerupbits = 0;
-	for ( i = 0 ; i < 16 ; i++ ) {
-		if ( to->powerups[i] != from->powerups[i] ) {
-			powerupbits |= 1 << i;
+	} else {
+		// send as full floating point value
+		MSG_WriteBits( msg, 1, 1 );
+		MSG_WriteBits( msg, value, 32 );
+		if ( print ) {
+			Com_Printf( "%s:%f ", codec->name, fullFloat );
 		}
 	}
+}
 
+/*
+==================
+MSG_WritePlayerInt
+==================
+*/
+static void MSG_WritePlayerInt( msg_t *msg, const netFieldCodec_t *codec, int value, qboolean print ) {
+	MSG_WriteBits( msg, value, codec->bits );
+	if ( print ) {
+		Com_Printf( "%s:%i ", codec->name, value );
+	}
+}
 
-	if ( statsbits || persistantbits || holdablebits || powerupbits ) {
-
-		MSG_WriteBits( msg, 1, 1 ); // something changed
+/*
+==================
+MSG_BuildCodec
+==================
+*/
+static void MSG_BuildCodec( netField_t *fields, int numFields, netFieldCodec_t *codec, short *wordField, int numWords,
+						   netFieldWriter_t writeFloat, netFieldWriter_t writeInt ) {
+	int i;
 
-		if ( statsbits ) {
-			MSG_WriteBits( msg, 1, 1 ); // changed
-			MSG_WriteShort( msg, statsbits );
-			for ( i = 0 ; i < 16 ; i++ )
-				if ( statsbits & ( 1 << i ) ) {
-					// RF, changed to long to allow more flexibility
-//					MSG_WriteLong (msg, to->stats[i]);
-					MSG_WriteShort( msg, to->stats[i] );  //----(SA)	back to short since weapon bits are handled elsewhere now
-				}
-		} else {
-			MSG_WriteBits( msg, 0, 1 ); // no change to stats
-		}
+	if ( numFields > MAX_NET_FIELDS ) {
+		Com_Error( ERR_FATAL, "MSG_InitDeltaTables: %i fields", numFields );
+	}
 
+	for ( i = 0 ; i < numWords ; i++ ) {
+		wordField[i] = -1;
+	}
 
-		if ( persistantbits ) {
-			MSG_WriteBits( msg, 1, 1 ); // changed
-			MSG_WriteShort( msg, persistantbits );
-			for ( i = 0 ; i < 16 ; i++ )
-				if ( persistantbits & ( 1 << i ) ) {
-					MSG_WriteShort( msg, to->persistant[i] );
-				}
-		} else {
-			MSG_WriteBits( msg, 0, 1 ); // no change to persistant
-		}
+	for ( i = 0 ; i < numFields ; i++ ) {
+		codec[i].name = fields[i].name;
+		codec[i].word = fields[i].offset / 4;
+		codec[i].bits = fields[i].bits;
+		codec[i].write = fields[i].bits == 0 ? writeFloat : writeInt;
+		wordField[codec[i].word] = i;
+	}
+}
 
+/*
+==================
+MSG_InitDeltaTables
 
-		if ( holdablebits ) {
-			MSG_WriteBits( msg, 1, 1 ); // changed
-			MSG_WriteShort( msg, holdablebits );
-			for ( i = 0 ; i < 16 ; i++ )
-				if ( holdablebits & ( 1 << i ) ) {
-					MSG_WriteShort( msg, to->holdable[i] );
-				}
-		} else {
-			MSG_WriteBits( msg, 0, 1 ); // no change to holdables
-		}
+Must be called before any deltas are written, the snapshot workers
+only ever read these tables
+==================
+*/
+void MSG_InitDeltaTables( void ) {
+	int numFields;
 
+	numFields = sizeof( entityStateFields ) / sizeof( entityStateFields[0] );
 
-		if ( powerupbits ) {
-			MSG_WriteBits( msg, 1, 1 ); // changed
-			MSG_WriteShort( msg, powerupbits );
-			for ( i = 0 ; i < 16 ; i++ )
-				if ( powerupbits & ( 1 << i ) ) {
-					MSG_WriteLong( msg, to->powerups[i] );
-				}
-		} else {
-			MSG_WriteBits( msg, 0, 1 ); // no change to powerups
-		}
-	} else {
-		MSG_WriteBits( msg, 0, 1 ); // no change to any
+	// all fields should be 32 bits to avoid any compiler packing issues
+	// the "number" field is not part of the field list
+	// if this fails, someone added a field to the entityState_t
+	// struct without updating the message fields
+	if ( numFields + 1 != ENTITY_WORDS ) {
+		Com_Error( ERR_FATAL, "MSG_InitDeltaTables: entityStateFields doesn't cover entityState_t" );
 	}
 
+	MSG_BuildCodec( entityStateFields, numFields, entityCodec, entityWordField, ENTITY_WORDS,
+					MSG_WriteEntityFloat, MSG_WriteEntityInt );
 
-#if 0
-// RF, optimization
-//		Send a single bit to signify whether or not the ammo/clip info changed.
-//		If it did, send individual segments specifying offset values for each item.
-	{
-		int ammo_ofs;
-		int clip_ofs;
+	numFields = sizeof( playerStateFields ) / sizeof( playerStateFields[0] );
+	MSG_BuildCodec( playerStateFields, numFields, playerCodec, playerWordField, PLAYER_WORDS,
+					MSG_WritePlayerFloat, MSG_WritePlayerInt );
+}
 
-		ammobits = 0;
+/*
+==================
+MSG_LowestBit
+==================
+*/
+static int MSG_LowestBit( unsigned bits ) {
+#ifdef _MSC_VER
+	unsigned long index;
 
-		// ammo
-		for ( i = 0 ; i < 32 ; i++ ) {
-			if ( to->ammo[i] != from->ammo[i] ) {
-				ammobits |= 1 << i;
-			}
+	_BitScanForward( &index, bits );
+	return index;
+#else
+	return __builtin_ctz( bits );
+#endif
+}
+
+/*
+==================
+MSG_ChangedWords
+
+Sets a bit in changed for every 32 bit word that differs between a and b
+==================
+*/
+static void MSG_ChangedWords( const int *a, const int *b, int numWords, unsigned *changed ) {
+	int i;
+
+	memset( changed, 0, ( ( numWords + 31 ) >> 5 ) * sizeof( *changed ) );
+
+	i = 0;
+#if MSG_SSE2
+	for ( ; i + 4 <= numWords ; i += 4 ) {
+		__m128i va, vb;
+		int same;
+
+		va = _mm_loadu_si128( (const __m128i *)( a + i ) );
+		vb = _mm_loadu_si128( (const __m128i *)( b + i ) );
+		same = _mm_movemask_ps( _mm_castsi128_ps( _mm_cmpeq_epi32( va, vb ) ) );
+		changed[i >> 5] |= (unsigned)( same ^ 15 ) << ( i & 31 );
+	}
+#endif
+	for ( ; i < numWords ; i++ ) {
+		if ( a[i] != b[i] ) {
+			changed[i >> 5] |= 1u << ( i & 31 );
 		}
-		// ammoclip (just add these changes to the ammo changes. if either changes, we should send both, since they are likely to both change at once anyway)
-		for ( i = 0 ; i < 32 ; i++ ) {
-			if ( to->ammoclip[i] != from->ammoclip[i] ) {
-				ammobits |= 1 << i;
+	}
+}
+
+/*
+==================
+MSG_ChangedFields
+
+Turns the changed words into changed field bits, returns the number
+of the last changed field + 1
+==================
+*/
+static int MSG_ChangedFields( const unsigned *changedWords, int numWords, const short *wordField, unsigned *changedFields ) {
+	int i, bit, field, lc;
+	unsigned bits;
+
+	memset( changedFields, 0, ( MAX_NET_FIELDS / 32 ) * sizeof( *changedFields ) );
+
+	lc = 0;
+	for ( i = 0 ; i < ( numWords + 31 ) >> 5 ; i++ ) {
+		bits = changedWords[i];
+		while ( bits ) {
+			bit = MSG_LowestBit( bits );
+			bits &= bits - 1;
+			field = wordField[( i << 5 ) + bit];
+			if ( field < 0 ) {
+				continue;
+			}
+			changedFields[field >> 5] |= 1u << ( field & 31 );
+			if ( field + 1 > lc ) {
+				lc = field + 1;
 			}
 		}
+	}
+
+	return lc;
+}
+
+/*
+==================
+MSG_WordBits
+
+Pulls count (up to 16) bits for consecutive words out of the changed mask
+==================
+*/
+static int MSG_WordBits( const unsigned *changedWords, int first, int count ) {
+	unsigned bits;
+
+	bits = changedWords[first >> 5] >> ( first & 31 );
+	if ( ( first & 31 ) + count > 32 ) {
+		bits |= changedWords[( first >> 5 ) + 1] << ( 32 - ( first & 31 ) );
+	}
+	return bits & ( ( 1 << count ) - 1 );
+}
+
+/*
+==================
+MSG_WriteDeltaEntityTable
+
+The table driven MSG_WriteDeltaEntity
+==================
+*/
+static void MSG_WriteDeltaEntityTable( msg_t *msg, struct entityState_s *from, struct entityState_s *to,
+									   qboolean force ) {
+	int i, lc;
+	unsigned changedWords[( ENTITY_WORDS + 31 ) / 32];
+	unsigned changedFields[MAX_NET_FIELDS / 32];
+	const netFieldCodec_t   *codec;
+
+	// a NULL to is a delta remove message
+	if ( to == NULL ) {
+		if ( from == NULL ) {
+			return;
+		}
+		if ( cl_shownet && ( cl_shownet->integer >= 2 || cl_shownet->integer == -1 ) ) {
+			Com_Printf( "W|%3i: #%-3i remove\n", msg->cursize, from->number );
+		}
+		MSG_WriteBits( msg, from->number, GENTITYNUM_BITS );
+		MSG_WriteBits( msg, 1, 1 );
+		return;
+	}
+
+	if ( to->number < 0 || to->number >= MAX_GENTITIES ) {
+		Com_Error( ERR_FATAL, "MSG_WriteDeltaEntity: Bad entity number: %i", to->number );
+	}
+
+	MSG_ChangedWords( (int *)from, (int *)to, ENTITY_WORDS, changedWords );
+	lc = MSG_ChangedFields( changedWords, ENTITY_WORDS, entityWordField, changedFields );
+
+	if ( lc == 0 ) {
+		// nothing at all changed
+		if ( !force ) {
+			return;     // nothing at all
+		}
+		// write two bits for no change
+		MSG_WriteBits( msg, to->number, GENTITYNUM_BITS );
+		MSG_WriteBits( msg, 0, 1 );     // not removed
+		MSG_WriteBits( msg, 0, 1 );     // no delta
+		return;
+	}
+
+	MSG_WriteBits( msg, to->number, GENTITYNUM_BITS );
+	MSG_WriteBits( msg, 0, 1 );         // not removed
+	MSG_WriteBits( msg, 1, 1 );         // we have a delta
+
+	MSG_WriteByte( msg, lc );   // # of changes
+
+	for ( i = 0, codec = entityCodec ; i < lc ; i++, codec++ ) {
+		if ( !( changedFields[i >> 5] & ( 1u << ( i & 31 ) ) ) ) {
+			MSG_WriteBits( msg, 0, 1 ); // no change
+			continue;
+		}
+
+		MSG_WriteBits( msg, 1, 1 ); // changed
+		codec->write( msg, codec, ( (int *)to )[codec->word], qfalse );
+	}
+}
+
+/*
+==================
+MSG_WriteDeltaEntity
+
+Writes part of a packetentities message, including the entity number.
+Can delta from either a baseline or a previous packet_entity
+If to is NULL, a remove entity update will be sent
+If force is not set, then nothing at all will be generated if the entity is
+identical, under the assumption that the in-order delta code will catch it.
+==================
+*/
+void MSG_WriteDeltaEntity( msg_t *msg, struct entityState_s *from, struct entityState_s *to,
+						   qboolean force ) {
+#if MSG_SSE2
+	MSG_WriteDeltaEntityTable( msg, from, to, force );
+#else
+	MSG_WriteDeltaEntityReference( msg, from, to, force );
+#endif
+}
+
+/*
+=============
+MSG_WritePlayerstateArrays
+
+Sends the stats, persistant, holdable, powerups, ammo and ammoclip
+entries that bits says have changed
+=============
+*/
+static void MSG_WritePlayerstateArrays( msg_t *msg, struct playerState_s *to, const playerArrayBits_t *bits ) {
+	int i, j;
+
+	if ( bits->stats || bits->persistant || bits->holdable || bits->powerups ) {
+
+		MSG_WriteBits( msg, 1, 1 ); // something changed
+
+		if ( bits->stats ) {
+			MSG_WriteBits( msg, 1, 1 ); // changed
+			MSG_WriteShort( msg, bits->stats );
+			for ( i = 0 ; i < 16 ; i++ )
+				if ( bits->stats & ( 1 << i ) ) {
+					// RF, changed to long to allow more flexibility
+//					MSG_WriteLong (msg, to->stats[i]);
+					MSG_WriteShort( msg, to->stats[i] );  //----(SA)	back to short since weapon bits are handled elsewhere now
+				}
+		} else {
+			MSG_WriteBits( msg, 0, 1 ); // no change to stats
+		}
 
-		if ( ammobits ) {
+
+		if ( bits->persistant ) {
 			MSG_WriteBits( msg, 1, 1 ); // changed
+			MSG_WriteShort( msg, bits->persistant );
+			for ( i = 0 ; i < 16 ; i++ )
+				if ( bits->persistant & ( 1 << i ) ) {
+					MSG_WriteShort( msg, to->persistant[i] );
+				}
+		} else {
+			MSG_WriteBits( msg, 0, 1 ); // no change to persistant
+		}
 
-			// send each changed item
-			for ( i = 0 ; i < 32 ; i++ ) {
-				if ( ammobits & ( 1 << i ) ) {
-					ammo_ofs = to->ammo[i] - from->ammo[i];
-					clip_ofs = to->ammoclip[i] - from->ammoclip[i];
-
-					while ( ammo_ofs || clip_ofs ) {
-						MSG_WriteBits( msg, 1, 1 );  // signify that another index is present
-						MSG_WriteBits( msg, i, 5 );  // index number
-
-						// ammo
-						if ( abs( ammo_ofs ) > 127 ) {
-							if ( ammo_ofs > 0 ) {
-								MSG_WriteChar( msg, 127 );
-								ammo_ofs -= 127;
-							} else {
-								MSG_WriteChar( msg, -127 );
-								ammo_ofs += 127;
-							}
-						} else {
-							MSG_WriteChar( msg, ammo_ofs );
-							ammo_ofs = 0;
-						}
 
-						// clip
-						if ( abs( clip_ofs ) > 127 ) {
-							if ( clip_ofs > 0 ) {
-								MSG_WriteChar( msg, 127 );
-								clip_ofs -= 127;
-							} else {
-								MSG_WriteChar( msg, -127 );
-								clip_ofs += 127;
-							}
-						} else {
-							MSG_WriteChar( msg, clip_ofs );
-							clip_ofs = 0;
-						}
-					}
+		if ( bits->holdable ) {
+			MSG_WriteBits( msg, 1, 1 ); // changed
+			MSG_WriteShort( msg, bits->holdable );
+			for ( i = 0 ; i < 16 ; i++ )
+				if ( bits->holdable & ( 1 << i ) ) {
+					MSG_WriteShort( msg, to->holdable[i] );
 				}
-			}
+		} else {
+			MSG_WriteBits( msg, 0, 1 ); // no change to holdables
+		}
 
-			// signify the end of changes
-			MSG_WriteBits( msg, 0, 1 );
 
+		if ( bits->powerups ) {
+			MSG_WriteBits( msg, 1, 1 ); // changed
+			MSG_WriteShort( msg, bits->powerups );
+			for ( i = 0 ; i < 16 ; i++ )
+				if ( bits->powerups & ( 1 << i ) ) {
+					MSG_WriteLong( msg, to->powerups[i] );
+				}
 		} else {
-			MSG_WriteBits( msg, 0, 1 ); // no change
+			MSG_WriteBits( msg, 0, 1 ); // no change to powerups
 		}
+	} else {
+		MSG_WriteBits( msg, 0, 1 ); // no change to any
 	}
 
-#else
 //----(SA)	I split this into two groups using shorts so it wouldn't have
 //			to use a long every time ammo changed for any weap.
 //			this seemed like a much friendlier option than making it
@@ -1393,26 +1648,16 @@ void MSG_WriteDeltaPlayerstate( msg_t *msg, struct playerState_s *from, struct p
 	// j == 2 : weaps 32-47	//----(SA)	now up to 64 (but still pretty net-friendly)
 	// j == 3 : weaps 48-63
 
-	// ammo stored
-	for ( j = 0; j < 4; j++ ) {  //----(SA)	modified for 64 weaps
-		ammobits[j] = 0;
-		for ( i = 0 ; i < 16 ; i++ ) {
-			if ( to->ammo[i + ( j * 16 )] != from->ammo[i + ( j * 16 )] ) {
-				ammobits[j] |= 1 << i;
-			}
-		}
-	}
-
 //----(SA)	also encapsulated ammo changes into one check.  clip values will change frequently,
 	// but ammo will not.  (only when you get ammo/reload rather than each shot)
-	if ( ammobits[0] || ammobits[1] || ammobits[2] || ammobits[3] ) {  // if any were set...
+	if ( bits->ammo[0] || bits->ammo[1] || bits->ammo[2] || bits->ammo[3] ) {  // if any were set...
 		MSG_WriteBits( msg, 1, 1 ); // changed
 		for ( j = 0; j < 4; j++ ) {
-			if ( ammobits[j] ) {
+			if ( bits->ammo[j] ) {
 				MSG_WriteBits( msg, 1, 1 ); // changed
-				MSG_WriteShort( msg, ammobits[j] );
+				MSG_WriteShort( msg, bits->ammo[j] );
 				for ( i = 0 ; i < 16 ; i++ )
-					if ( ammobits[j] & ( 1 << i ) ) {
+					if ( bits->ammo[j] & ( 1 << i ) ) {
 						MSG_WriteShort( msg, to->ammo[i + ( j * 16 )] );
 					}
 			} else {
@@ -1425,25 +1670,193 @@ void MSG_WriteDeltaPlayerstate( msg_t *msg, struct playerState_s *from, struct p
 
 	// ammo in clip
 	for ( j = 0; j < 4; j++ ) {  //----(SA)	modified for 64 weaps
-		clipbits = 0;
-		for ( i = 0 ; i < 16 ; i++ ) {
-			if ( to->ammoclip[i + ( j * 16 )] != from->ammoclip[i + ( j * 16 )] ) {
-				clipbits |= 1 << i;
-			}
-		}
-		if ( clipbits ) {
+		if ( bits->ammoclip[j] ) {
 			MSG_WriteBits( msg, 1, 1 ); // changed
-			MSG_WriteShort( msg, clipbits );
+			MSG_WriteShort( msg, bits->ammoclip[j] );
 			for ( i = 0 ; i < 16 ; i++ )
-				if ( clipbits & ( 1 << i ) ) {
+				if ( bits->ammoclip[j] & ( 1 << i ) ) {
 					MSG_WriteShort( msg, to->ammoclip[i + ( j * 16 )] );
 				}
 		} else {
 			MSG_WriteBits( msg, 0, 1 ); // no change
 		}
 	}
-#endif
+}
+
+/*
+=============
+MSG_WriteDeltaPlayerstateReference
+
+The original field by field encoder, see MSG_WriteDeltaEntityReference
+=============
+*/
+static void MSG_WriteDeltaPlayerstateReference( msg_t *msg, struct playerState_s *from, struct playerState_s *to ) {
+	int i, j, lc;
+	playerState_t dummy;
+	playerArrayBits_t bits;
+	int numFields;
+	netField_t      *field;
+	int             *fromF, *toF;
+	float fullFloat;
+	int trunc;
+
+	if ( !from ) {
+		from = &dummy;
+		memset( &dummy, 0, sizeof( dummy ) );
+	}
 
+	numFields = sizeof( playerStateFields ) / sizeof( playerStateFields[0] );
+
+	lc = 0;
+	for ( i = 0, field = playerStateFields ; i < numFields ; i++, field++ ) {
+		fromF = ( int * )( (byte *)from + field->offset );
+		toF = ( int * )( (byte *)to + field->offset );
+		if ( *fromF != *toF ) {
+			lc = i + 1;
+		}
+	}
+
+	MSG_WriteByte( msg, lc );   // # of changes
+
+
+	for ( i = 0, field = playerStateFields ; i < lc ; i++, field++ ) {
+		fromF = ( int * )( (byte *)from + field->offset );
+		toF = ( int * )( (byte *)to + field->offset );
+
+		if ( *fromF == *toF ) {
+			MSG_WriteBits( msg, 0, 1 ); // no change
+			continue;
+		}
+
+		MSG_WriteBits( msg, 1, 1 ); // changed
+
+		if ( field->bits == 0 ) {
+			// float
+			fullFloat = *(float *)toF;
+			trunc = (int)fullFloat;
+
+			if ( trunc == fullFloat && trunc + FLOAT_INT_BIAS >= 0 &&
+				 trunc + FLOAT_INT_BIAS < ( 1 << FLOAT_INT_BITS ) ) {
+				// send as small integer
+				MSG_WriteBits( msg, 0, 1 );
+				MSG_WriteBits( msg, trunc + FLOAT_INT_BIAS, FLOAT_INT_BITS );
+			} else {
+				// send as full floating point value
+				MSG_WriteBits( msg, 1, 1 );
+				MSG_WriteBits( msg, *toF, 32 );
+			}
+		} else {
+			// integer
+			MSG_WriteBits( msg, *toF, field->bits );
+		}
+	}
+
+
+	//
+	// send the arrays
+	//
+	memset( &bits, 0, sizeof( bits ) );
+	for ( i = 0 ; i < 16 ; i++ ) {
+		if ( to->stats[i] != from->stats[i] ) {
+			bits.stats |= 1 << i;
+		}
+	}
+	for ( i = 0 ; i < 16 ; i++ ) {
+		if ( to->persistant[i] != from->persistant[i] ) {
+			bits.persistant |= 1 << i;
+		}
+	}
+	for ( i = 0 ; i < 16 ; i++ ) {
+		if ( to->holdable[i] != from->holdable[i] ) {
+			bits.holdable |= 1 << i;
+		}
+	}
+	for ( i = 0 ; i < 16 ; i++ ) {
+		if ( to->powerups[i] != from->powerups[i] ) {
+			bits.powerups |= 1 << i;
+		}
+	}
+	for ( j = 0; j < 4; j++ ) {
+		for ( i = 0 ; i < 16 ; i++ ) {
+			if ( to->ammo[i + ( j * 16 )] != from->ammo[i + ( j * 16 )] ) {
+				bits.ammo[j] |= 1 << i;
+			}
+			if ( to->ammoclip[i + ( j * 16 )] != from->ammoclip[i + ( j * 16 )] ) {
+				bits.ammoclip[j] |= 1 << i;
+			}
+		}
+	}
+
+	MSG_WritePlayerstateArrays( msg, to, &bits );
+}
+
+/*
+=============
+MSG_WriteDeltaPlayerstateTable
+
+The table driven MSG_WriteDeltaPlayerstate
+=============
+*/
+#define PSW( x )    ( (int)&( (playerState_t*)0 )->x / 4 )
+
+static void MSG_WriteDeltaPlayerstateTable( msg_t *msg, struct playerState_s *from, struct playerState_s *to ) {
+	int i, j, lc;
+	playerState_t dummy;
+	playerArrayBits_t bits;
+	unsigned changedWords[( PLAYER_WORDS + 31 ) / 32];
+	unsigned changedFields[MAX_NET_FIELDS / 32];
+	const netFieldCodec_t   *codec;
+	int startBit, endBit;
+	int print;
+
+	if ( !from ) {
+		from = &dummy;
+		memset( &dummy, 0, sizeof( dummy ) );
+	}
+
+	if ( msg->bit == 0 ) {
+		startBit = msg->cursize * 8 - GENTITYNUM_BITS;
+	} else {
+		startBit = ( msg->cursize - 1 ) * 8 + msg->bit - GENTITYNUM_BITS;
+	}
+
+	// shownet 2/3 will interleave with other printed info, -2 will
+	// just print the delta records
+	if ( cl_shownet && ( cl_shownet->integer >= 2 || cl_shownet->integer == -2 ) ) {
+		print = 1;
+		Com_Printf( "W|%3i: playerstate ", msg->cursize );
+	} else {
+		print = 0;
+	}
+
+	MSG_ChangedWords( (int *)from, (int *)to, PLAYER_WORDS, changedWords );
+	lc = MSG_ChangedFields( changedWords, PLAYER_WORDS, playerWordField, changedFields );
+
+	MSG_WriteByte( msg, lc );   // # of changes
+
+	for ( i = 0, codec = playerCodec ; i < lc ; i++, codec++ ) {
+		if ( !( changedFields[i >> 5] & ( 1u << ( i & 31 ) ) ) ) {
+			MSG_WriteBits( msg, 0, 1 ); // no change
+			continue;
+		}
+
+		MSG_WriteBits( msg, 1, 1 ); // changed
+		codec->write( msg, codec, ( (int *)to )[codec->word], print );
+	}
+
+	//
+	// send the arrays
+	//
+	bits.stats = MSG_WordBits( changedWords, PSW( stats ), 16 );
+	bits.persistant = MSG_WordBits( changedWords, PSW( persistant ), 16 );
+	bits.holdable = MSG_WordBits( changedWords, PSW( holdable ), 16 );
+	bits.powerups = MSG_WordBits( changedWords, PSW( powerups ), 16 );
+	for ( j = 0; j < 4; j++ ) {
+		bits.ammo[j] = MSG_WordBits( changedWords, PSW( ammo ) + j * 16, 16 );
+		bits.ammoclip[j] = MSG_WordBits( changedWords, PSW( ammoclip ) + j * 16, 16 );
+	}
+
+	MSG_WritePlayerstateArrays( msg, to, &bits );
 
 	if ( print ) {
 		if ( msg->bit == 0 ) {
@@ -1453,9 +1866,380 @@ void MSG_WriteDeltaPlayerstate( msg_t *msg, struct playerState_s *from, struct p
 		}
 		Com_Printf( " (%i bits)\n", endBit - startBit  );
 	}
+}
 
+/*
+=============
+MSG_WriteDeltaPlayerstate
+
+=============
+*/
+void MSG_WriteDeltaPlayerstate( msg_t *msg, struct playerState_s *from, struct playerState_s *to ) {
+#if MSG_SSE2
+	MSG_WriteDeltaPlayerstateTable( msg, from, to );
+#else
+	MSG_WriteDeltaPlayerstateReference( msg, from, to );
+#endif
 }
 
+/*
+=============
+MSG_TestRand
+
+0 to 0xffff from the tests' own seed.  The low bits of Q_rand repeat
+after a few calls, so these are the high ones.
+=============
+*/
+static int MSG_TestRand( int *seed ) {
+	return ( (unsigned)Q_rand( seed ) >> 16 ) & 0xffff;
+}
+
+/*
+=============
+MSG_RandomDeltaWord
+
+A value for one word of a test state: mostly small integers, with
+zeros, whole and fractional floats, -0 and random bits mixed in
+=============
+*/
+static int MSG_RandomDeltaWord( int *seed ) {
+	float f;
+	int r;
+
+	switch ( MSG_TestRand( seed ) % 8 ) {
+	case 0:
+		return 0;
+	case 1:
+		return MSG_TestRand( seed ) & 0xff;
+	case 2:
+		f = (float)( MSG_TestRand( seed ) % 8192 - 4096 );
+		return *(int *)&f;
+	case 3:
+		f = ( MSG_TestRand( seed ) - 0x8000 ) * 0.37f;
+		return *(int *)&f;
+	case 4:
+		return 0x80000000;      // -0.0f
+	case 5:
+		return -( MSG_TestRand( seed ) & 0xffff );
+	default:
+		r = ( MSG_TestRand( seed ) << 16 ) ^ MSG_TestRand( seed );
+		return r;
+	}
+}
+
+/*
+=============
+MSG_MutateDeltaState
+
+Copies from into to and changes a few random words, only where mask
+is set so that every value survives the trip through the field widths
+=============
+*/
+static void MSG_MutateDeltaState( int *seed, const int *from, int *to, int numWords, const short *wordField,
+								  const netFieldCodec_t *codec, int changes ) {
+	int i, w, value, bits;
+
+	memcpy( to, from, numWords * 4 );
+	for ( i = 0 ; i < changes ; i++ ) {
+		w = MSG_TestRand( seed ) % numWords;
+		if ( wordField[w] < 0 ) {
+			continue;
+		}
+		value = MSG_RandomDeltaWord( seed );
+		bits = codec[wordField[w]].bits;
+		if ( bits > 0 && bits < 32 ) {
+			value &= ( 1 << bits ) - 1;
+		} else if ( bits < 0 ) {
+			value = ( value << ( 32 + bits ) ) >> ( 32 + bits );
+		}
+		to[w] = value;
+	}
+}
+
+/*
+=============
+MSG_SameDeltaState
+
+-0 is sent as 0, so those two compare equal
+=============
+*/
+static qboolean MSG_SameDeltaState( const int *a, const int *b, int numWords ) {
+	int i;
+
+	for ( i = 0 ; i < numWords ; i++ ) {
+		if ( a[i] != b[i] && ( a[i] | b[i] ) != (int)0x80000000 ) {
+			return qfalse;
+		}
+	}
+	return qtrue;
+}
+
+/*
+=============
+MSG_DeltaTest_f
+
+deltatest [count]
+
+Encodes count random entityState_t and playerState_t pairs with both
+the field by field and the table driven encoders, checks that the bits
+are identical and decode back to the input, then times both encoders.
+=============
+*/
+void MSG_DeltaTest_f( void ) {
+	static entityState_t ents[3];
+	static playerState_t players[3];
+	static byte bufA[MAX_MSGLEN], bufB[MAX_MSGLEN];
+	msg_t a, b;
+	static byte benchBuf[1024];
+	int count, i, j, t, changes, seed;
+	int mismatches, badReads;
+	int times[6];
+	unsigned arrays;
+
+	count = 10000;
+	if ( Cmd_Argc() > 1 ) {
+		count = atoi( Cmd_Argv( 1 ) );
+		if ( count < 1 ) {
+			count = 1;
+		}
+	}
+
+	seed = count;
+	mismatches = 0;
+	badReads = 0;
+
+	for ( i = 0 ; i < count ; i++ ) {
+		changes = MSG_TestRand( &seed ) % ( i & 2 ? 8 : 128 );
+
+		// entityState_t
+		memset( &ents[0], 0, sizeof( ents[0] ) );
+		MSG_MutateDeltaState( &seed, (int *)&ents[0], (int *)&ents[0], ENTITY_WORDS, entityWordField, entityCodec, 128 );
+		MSG_MutateDeltaState( &seed, (int *)&ents[0], (int *)&ents[1], ENTITY_WORDS, entityWordField, entityCodec, changes );
+		ents[0].number = ents[1].number = MSG_TestRand( &seed ) % MAX_GENTITIES;
+
+		MSG_Init( &a, bufA, sizeof( bufA ) );
+		MSG_Init( &b, bufB, sizeof( bufB ) );
+		MSG_WriteDeltaEntityReference( &a, &ents[0], &ents[1], qtrue );
+		MSG_WriteDeltaEntityTable( &b, &ents[0], &ents[1], qtrue );
+		if ( a.cursize != b.cursize || a.bit != b.bit || memcmp( a.data, b.data, a.cursize ) ) {
+			mismatches++;
+			continue;
+		}
+
+		MSG_BeginReading( &b );
+		MSG_ReadDeltaEntity( &b, &ents[0], &ents[2], MSG_ReadBits( &b, GENTITYNUM_BITS ) );
+		if ( !MSG_SameDeltaState( (int *)&ents[1], (int *)&ents[2], ENTITY_WORDS ) ) {
+			badReads++;
+		}
+
+		// playerState_t, with the arrays outside the field list
+		memset( &players[0], 0, sizeof( players[0] ) );
+		MSG_MutateDeltaState( &seed, (int *)&players[0], (int *)&players[0], PLAYER_WORDS, playerWordField, playerCodec, 128 );
+		MSG_MutateDeltaState( &seed, (int *)&players[0], (int *)&players[1], PLAYER_WORDS, playerWordField, playerCodec, changes );
+		arrays = ( MSG_TestRand( &seed ) << 16 ) ^ MSG_TestRand( &seed );
+		for ( j = 0 ; j < 16 ; j++ ) {
+			if ( arrays & ( 1 << j ) ) {
+				players[1].stats[MSG_TestRand( &seed ) % MAX_STATS] = (short)MSG_TestRand( &seed );
+				players[1].ammoclip[MSG_TestRand( &seed ) % MAX_WEAPONS] = (short)MSG_TestRand( &seed );
+			}
+			if ( arrays & ( 1 << ( j + 16 ) ) ) {
+				players[1].powerups[MSG_TestRand( &seed ) % MAX_POWERUPS] = MSG_RandomDeltaWord( &seed );
+				players[1].ammo[MSG_TestRand( &seed ) % MAX_WEAPONS] = (short)MSG_TestRand( &seed );
+				players[1].persistant[MSG_TestRand( &seed ) % MAX_PERSISTANT] = (short)MSG_TestRand( &seed );
+				players[1].holdable[MSG_TestRand( &seed ) % 16] = (short)MSG_TestRand( &seed );
+			}
+		}
+
+		MSG_Init( &a, bufA, sizeof( bufA ) );
+		MSG_Init( &b, bufB, sizeof( bufB ) );
+		MSG_WriteDeltaPlayerstateReference( &a, i & 4 ? NULL : &players[0], &players[1] );
+		MSG_WriteDeltaPlayerstateTable( &b, i & 4 ? NULL : &players[0], &players[1] );
+		if ( a.cursize != b.cursize || a.bit != b.bit || memcmp( a.data, b.data, a.cursize ) ) {
+			mismatches++;
+			continue;
+		}
+
+		MSG_BeginReading( &b );
+		MSG_ReadDeltaPlayerstate( &b, i & 4 ? NULL : &players[0], &players[2] );
+		if ( !MSG_SameDeltaState( (int *)&players[1], (int *)&players[2], PLAYER_WORDS ) ) {
+			badReads++;
+		}
+	}
+
+	Com_Printf( "%i pairs: %i encoder mismatches, %i bad round trips\n", count, mismatches, badReads );
+
+	// time both encoders on a typical frame's worth of small changes,
+	// and on the unchanged entities that make up most of a snapshot
+	MSG_MutateDeltaState( &seed, (int *)&ents[0], (int *)&ents[1], ENTITY_WORDS, entityWordField, entityCodec, 4 );
+	ents[2] = ents[0];
+	MSG_MutateDeltaState( &seed, (int *)&players[0], (int *)&players[1], PLAYER_WORDS, playerWordField, playerCodec, 6 );
+	for ( j = 0 ; j < 6 ; j++ ) {
+		t = Sys_Milliseconds();
+		for ( i = 0 ; i < count * 10 ; i++ ) {
+			MSG_Init( &a, benchBuf, sizeof( benchBuf ) );
+			switch ( j ) {
+			case 0: MSG_WriteDeltaEntityReference( &a, &ents[0], &ents[1], qfalse ); break;
+			case 1: MSG_WriteDeltaEntityTable( &a, &ents[0], &ents[1], qfalse ); break;
+			case 2: MSG_WriteDeltaEntityReference( &a, &ents[0], &ents[2], qfalse ); break;
+			case 3: MSG_WriteDeltaEntityTable( &a, &ents[0], &ents[2], qfalse ); break;
+			case 4: MSG_WriteDeltaPlayerstateReference( &a, &players[0], &players[1] ); break;
+			case 5: MSG_WriteDeltaPlayerstateTable( &a, &players[0], &players[1] ); break;
+			}
+		}
+		times[j] = Sys_Milliseconds() - t;
+	}
+
+	Com_Printf( "%i encodes each, %s change detection\n", count * 10, MSG_SSE2 ? "sse2" : "scalar" );
+	Com_Printf( "changed entity:   %5i msec field by field, %5i msec table\n", times[0], times[1] );
+	Com_Printf( "unchanged entity: %5i msec field by field, %5i msec table\n", times[2], times[3] );
+	Com_Printf( "playerstate:      %5i msec field by field, %5i msec table\n", times[4], times[5] );
+}
+
+#define BITTEST_PACKETS     64
+#define BITTEST_WRITES      384
+
+/*
+=============
+MSG_BitTestPacket
+
+Fills one packet of the bittest corpus with the mix of writes a snapshot
+makes: mostly change flags, then entity and playerstate fields at their
+own widths, and a few bytes.  Returns the number of writes.
+=============
+*/
+static int MSG_BitTestPacket( int *seed, int *values, int *bits ) {
+	const netFieldCodec_t *codec;
+	int i, count, b;
+
+	count = BITTEST_WRITES / 2 + MSG_TestRand( seed ) % ( BITTEST_WRITES / 2 );
+	for ( i = 0 ; i < count ; i++ ) {
+		switch ( MSG_TestRand( seed ) % 8 ) {
+		case 0: case 1: case 2: case 3:
+			b = 1;
+			break;
+		case 4:
+			b = 8;
+			break;
+		case 5:
+			codec = &playerCodec[MSG_TestRand( seed ) % ( sizeof( playerStateFields ) / sizeof( playerStateFields[0] ) )];
+			b = codec->bits ? codec->bits : 32;
+			break;
+		default:
+			codec = &entityCodec[MSG_TestRand( seed ) % ( sizeof( entityStateFields ) / sizeof( entityStateFields[0] ) )];
+			b = codec->bits ? codec->bits : 32;
+			break;
+		}
+		if ( b < 0 ) {
+			b = -b;
+		}
+		values[i] = MSG_RandomDeltaWord( seed );
+		if ( b < 32 ) {
+			values[i] &= ( 1 << b ) - 1;
+		}
+		bits[i] = b;
+	}
+	return count;
+}
+
+/*
+=============
+MSG_BitTest_f
+
+bittest [count]
+
+Builds a corpus of packets shaped like snapshots, checks that the word at
+a time huffman writer and reader produce and accept the same stream as
+the bit at a time ones, then times encoding and decoding the corpus
+count times with each.
+=============
+*/
+void MSG_BitTest_f( void ) {
+	static int values[BITTEST_PACKETS][BITTEST_WRITES];
+	static int bits[BITTEST_PACKETS][BITTEST_WRITES];
+	static int writes[BITTEST_PACKETS];
+	static byte corpus[BITTEST_PACKETS][BITTEST_WRITES * 8];
+	static byte bufA[BITTEST_WRITES * 8];
+	msg_t a, b;
+	int count, i, j, k, p, t, v, seed;
+	int mismatches, badReads, totalBytes;
+	int times[4];
+
+	count = 1000;
+	if ( Cmd_Argc() > 1 ) {
+		count = atoi( Cmd_Argv( 1 ) );
+		if ( count < 1 ) {
+			count = 1;
+		}
+	}
+
+	seed = count;
+	mismatches = 0;
+	badReads = 0;
+	totalBytes = 0;
+
+	for ( p = 0 ; p < BITTEST_PACKETS ; p++ ) {
+		writes[p] = MSG_BitTestPacket( &seed, values[p], bits[p] );
+
+		MSG_Init( &a, bufA, sizeof( bufA ) );
+		MSG_Init( &b, corpus[p], sizeof( corpus[p] ) );
+		for ( i = 0 ; i < writes[p] ; i++ ) {
+			MSG_WriteBitsReference( &a, values[p][i], bits[p][i] );
+			MSG_WriteBits( &b, values[p][i], bits[p][i] );
+		}
+		totalBytes += b.cursize;
+		// the bit at a time writer leaves whatever was in the
+		// buffer past the last bit, so only compare up to there
+		if ( a.bit != b.bit || memcmp( a.data, b.data, a.bit >> 3 )
+			 || ( ( a.data[a.bit >> 3] ^ b.data[b.bit >> 3] ) & ( ( 1 << ( a.bit & 7 ) ) - 1 ) ) ) {
+			mismatches++;
+			continue;
+		}
+
+		MSG_BeginReading( &a );
+		MSG_BeginReading( &b );
+		for ( i = 0 ; i < writes[p] ; i++ ) {
+			v = MSG_ReadBits( &b, bits[p][i] );
+			if ( v != values[p][i] || MSG_ReadBitsReference( &a, bits[p][i] ) != v ) {
+				badReads++;
+				break;
+			}
+		}
+	}
+
+	Com_Printf( "%i packets, %i bytes: %i encoder mismatches, %i bad reads\n",
+				BITTEST_PACKETS, totalBytes, mismatches, badReads );
+
+	for ( j = 0 ; j < 4 ; j++ ) {
+		t = Sys_Milliseconds();
+		for ( i = 0 ; i < count ; i++ ) {
+			for ( p = 0 ; p < BITTEST_PACKETS ; p++ ) {
+				// set the message up by hand, MSG_Init would spend
+				// more time clearing the buffer than the coder takes
+				memset( &a, 0, sizeof( a ) );
+				if ( j < 2 ) {
+					a.data = bufA;
+					a.maxsize = sizeof( bufA );
+				} else {
+					a.data = corpus[p];
+					a.maxsize = sizeof( corpus[p] );
+				}
+				for ( k = 0 ; k < writes[p] ; k++ ) {
+					switch ( j ) {
+					case 0: MSG_WriteBitsReference( &a, values[p][k], bits[p][k] ); break;
+					case 1: MSG_WriteBits( &a, values[p][k], bits[p][k] ); break;
+					case 2: MSG_ReadBitsReference( &a, bits[p][k] ); break;
+					case 3: MSG_ReadBits( &a, bits[p][k] ); break;
+					}
+				}
+			}
+		}
+		times[j] = Sys_Milliseconds() - t;
+	}
+
+	Com_Printf( "%i passes over the corpus\n", count );
+	Com_Printf( "encode: %5i msec bit at a time, %5i msec word at a time\n", times[0], times[1] );
+	Com_Printf( "decode: %5i msec bit at a time, %5i msec word at a time\n", times[2], times[3] );
+}
 
 /*
 ===================
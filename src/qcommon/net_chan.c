@@ -54,9 +54,6 @@ to the new value before sending out any replies.
 */
 
 
-#define MAX_PACKETLEN           1400        // max size of a network packet
-
-#define FRAGMENT_SIZE           ( MAX_PACKETLEN - 100 )
 #define PACKET_HEADER           10          // two ints and a short
 
 #define FRAGMENT_BIT    ( 1 << 31 )
@@ -64,6 +61,7 @@ to the new value before sending out any replies.
 cvar_t      *showpackets;
 cvar_t      *showdrop;
 cvar_t      *qport;
+cvar_t      *net_loopDropsim;       // 0.0 to 1.0, simulated drops of sequenced loopback packets
 
 static char *netsrcString[2] = {
 	"client",
@@ -81,6 +79,7 @@ void Netchan_Init( int port ) {
 	showpackets = Cvar_Get( "showpackets", "0", CVAR_TEMP );
 	showdrop = Cvar_Get( "showdrop", "0", CVAR_TEMP );
 	qport = Cvar_Get( "net_qport", va( "%i", port ), CVAR_INIT );
+	net_loopDropsim = Cvar_Get( "net_loopDropsim", "0", CVAR_CHEAT );
 }
 
 /*
@@ -119,7 +118,7 @@ void Netchan_TransmitNextFragment( netchan_t *chan ) {
 
 	// send the qport if we are a client
 	if ( chan->sock == NS_CLIENT ) {
-		MSG_WriteShort( &send, qport->integer );
+		MSG_WriteShort( &send, chan->qport );
 	}
 
 	// copy the reliable message to the packet first
@@ -193,7 +192,7 @@ void Netchan_Transmit( netchan_t *chan, int length, const byte *data ) {
 
 	// send the qport if we are a client
 	if ( chan->sock == NS_CLIENT ) {
-		MSG_WriteShort( &send, qport->integer );
+		MSG_WriteShort( &send, chan->qport );
 	}
 
 	MSG_WriteData( &send, data, length );
@@ -402,14 +401,61 @@ qboolean    NET_CompareBaseAdr( netadr_t a, netadr_t b ) {
 		return qfalse;
 	}
 
+	if ( a.type == NA_IP6 ) {
+		if ( !memcmp( a.ip6, b.ip6, sizeof( a.ip6 ) ) && a.scope_id == b.scope_id ) {
+			return qtrue;
+		}
+		return qfalse;
+	}
 
 
 	Com_Printf( "NET_CompareBaseAdr: bad address type\n" );
 	return qfalse;
 }
 
+/*
+===================
+NET_Ip6ToString
+
+Writes the shortest form, with the longest run of zero groups as ::
+===================
+*/
+static void NET_Ip6ToString( const byte *ip6, char *out, int size ) {
+	int i, run, best, bestLen;
+	char group[8];
+
+	best = -1;
+	bestLen = 1;
+	for ( i = 0 ; i < 8 ; i++ ) {
+		for ( run = 0 ; i + run < 8 && !ip6[( i + run ) * 2] && !ip6[( i + run ) * 2 + 1] ; run++ ) {
+		}
+		if ( run > bestLen ) {
+			best = i;
+			bestLen = run;
+		}
+		if ( run ) {
+			i += run - 1;
+		}
+	}
+
+	out[0] = 0;
+	for ( i = 0 ; i < 8 ; i++ ) {
+		if ( i == best ) {
+			Q_strcat( out, size, "::" );
+			i += bestLen - 1;
+			continue;
+		}
+		if ( i && i != best + bestLen ) {
+			Q_strcat( out, size, ":" );
+		}
+		Com_sprintf( group, sizeof( group ), "%x", ( ip6[i * 2] << 8 ) | ip6[i * 2 + 1] );
+		Q_strcat( out, size, group );
+	}
+}
+
 const char  *NET_AdrToString( netadr_t a ) {
 	static char s[64];
+	char ip6[48];
 
 	if ( a.type == NA_LOOPBACK ) {
 		Com_sprintf( s, sizeof( s ), "loopback" );
@@ -418,6 +464,9 @@ const char  *NET_AdrToString( netadr_t a ) {
 	} else if ( a.type == NA_IP ) {
 		Com_sprintf( s, sizeof( s ), "%i.%i.%i.%i:%hu",
 					 a.ip[0], a.ip[1], a.ip[2], a.ip[3], BigShort( a.port ) );
+	} else if ( a.type == NA_IP6 ) {
+		NET_Ip6ToString( a.ip6, ip6, sizeof( ip6 ) );
+		Com_sprintf( s, sizeof( s ), "[%s]:%hu", ip6, BigShort( a.port ) );
 	}
 
 	return s;
@@ -440,6 +489,13 @@ qboolean    NET_CompareAdr( netadr_t a, netadr_t b ) {
 		return qfalse;
 	}
 
+	if ( a.type == NA_IP6 ) {
+		if ( !memcmp( a.ip6, b.ip6, sizeof( a.ip6 ) ) && a.scope_id == b.scope_id && a.port == b.port ) {
+			return qtrue;
+		}
+		return qfalse;
+	}
+
 
 	Com_Printf( "NET_CompareAdr: bad address type\n" );
 	return qfalse;
@@ -461,12 +517,15 @@ LOOPBACK BUFFERS FOR LOCAL PLAYER
 */
 
 // there needs to be enough loopback messages to hold a complete
-// gamestate of maximum size
-#define MAX_LOOPBACK    16
+// gamestate of maximum size, or a snapshot for every client of svbench
+#define MAX_LOOPBACK    128
 
+// the port tells the svbench clients apart, it is the same in both
+// directions and 0 for the local player
 typedef struct {
 	byte data[MAX_PACKETLEN];
 	int datalen;
+	unsigned short port;
 } loopmsg_t;
 
 typedef struct {
@@ -498,6 +557,7 @@ qboolean    NET_GetLoopPacket( netsrc_t sock, netadr_t *net_from, msg_t *net_mes
 	net_message->cursize = loop->msgs[i].datalen;
 	memset( net_from, 0, sizeof( *net_from ) );
 	net_from->type = NA_LOOPBACK;
+	net_from->port = loop->msgs[i].port;
 	return qtrue;
 
 }
@@ -507,6 +567,16 @@ void NET_SendLoopPacket( netsrc_t sock, int length, const void *data, netadr_t t
 	int i;
 	loopback_t  *loop;
 
+	// com_dropsim never sees the loopback, out of band packets
+	// always go so connecting isn't affected
+	if ( net_loopDropsim->value > 0 && length >= 4 && *(int *)data != -1 ) {
+		static int seed;
+
+		if ( Q_random( &seed ) < net_loopDropsim->value ) {
+			return;
+		}
+	}
+
 	loop = &loopbacks[sock ^ 1];
 
 	i = loop->send & ( MAX_LOOPBACK - 1 );
@@ -514,6 +584,7 @@ void NET_SendLoopPacket( netsrc_t sock, int length, const void *data, netadr_t t
 
 	memcpy( loop->msgs[i].data, data, length );
 	loop->msgs[i].datalen = length;
+	loop->msgs[i].port = to.port;
 }
 
 //=============================================================================
@@ -601,12 +672,14 @@ void QDECL NET_OutOfBandData( netsrc_t sock, netadr_t adr, byte *format, int len
 =============
 NET_StringToAdr
 
-Traps "localhost" for loopback, passes everything else to system
+Traps "localhost" for loopback, passes everything else to system.
+IPv6 addresses with a port go in brackets, [::1]:27960
 =============
 */
 qboolean    NET_StringToAdr( const char *s, netadr_t *a ) {
 	qboolean r;
 	char base[MAX_STRING_CHARS];
+	char    *addr;
 	char    *port;
 
 	if ( !strcmp( s, "localhost" ) ) {
@@ -617,13 +690,31 @@ qboolean    NET_StringToAdr( const char *s, netadr_t *a ) {
 
 	// look for a port number
 	Q_strncpyz( base, s, sizeof( base ) );
-	port = strstr( base, ":" );
-	if ( port ) {
-		*port = 0;
-		port++;
+	addr = base;
+	if ( base[0] == '[' ) {
+		addr = base + 1;
+		port = strchr( addr, ']' );
+		if ( !port ) {
+			a->type = NA_BAD;
+			return qfalse;
+		}
+		*port++ = 0;
+		if ( *port == ':' ) {
+			port++;
+		} else {
+			port = NULL;
+		}
+	} else {
+		port = strstr( base, ":" );
+		if ( port && strstr( port + 1, ":" ) ) {
+			port = NULL;    // a bare IPv6 address
+		} else if ( port ) {
+			*port = 0;
+			port++;
+		}
 	}
 
-	r = Sys_StringToAdr( base, a );
+	r = Sys_StringToAdr( addr, a );
 
 	if ( !r ) {
 		a->type = NA_BAD;
@@ -631,7 +722,7 @@ qboolean    NET_StringToAdr( const char *s, netadr_t *a ) {
 	}
 
 	// inet_addr returns this if out of range
-	if ( a->ip[0] == 255 && a->ip[1] == 255 && a->ip[2] == 255 && a->ip[3] == 255 ) {
+	if ( a->type == NA_IP && a->ip[0] == 255 && a->ip[1] == 255 && a->ip[2] == 255 && a->ip[3] == 255 ) {
 		a->type = NA_BAD;
 		return qfalse;
 	}
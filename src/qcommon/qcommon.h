@@ -120,6 +120,7 @@ struct entityState_s;
 struct playerState_s;
 
 void MSG_WriteBits( msg_t *msg, int value, int bits );
+void MSG_WriteBitString( msg_t *msg, const byte *data, int numBits, int uncompBits );
 
 void MSG_WriteChar( msg_t *sb, int c );
 void MSG_WriteByte( msg_t *sb, int c );
@@ -159,6 +160,9 @@ void MSG_ReadDeltaEntity( msg_t *msg, entityState_t *from, entityState_t *to,
 						  int number );
 
 void MSG_WriteDeltaPlayerstate( msg_t *msg, struct playerState_s *from, struct playerState_s *to );
+void MSG_InitDeltaTables( void );
+void MSG_DeltaTest_f( void );
+void MSG_BitTest_f( void );
 void MSG_ReadDeltaPlayerstate( msg_t *msg, struct playerState_s *from, struct playerState_s *to );
 
 
@@ -186,6 +190,15 @@ NET
 							// server for delta comrpession and ping estimation
 #define PACKET_MASK     ( PACKET_BACKUP - 1 )
 
+#define MAX_SNAPSHOT_PARTS  8   // svc_snapshotPart messages a snapshot can be split into
+
+// the client's parseEntities ring must hold the entities of every frame a
+// delta compressed message can still come from, and each svc_snapshotPart
+// takes a whole entity list of its own, so it is sized for eight snapshots
+// of MAX_ENTITIES_IN_SNAPSHOT split as far as they go.  The server bench
+// checks against it.  Has to stay a power of two.
+#define MAX_PARSE_ENTITIES  ( MAX_SNAPSHOT_PARTS * 256 * 8 )
+
 #define MAX_PACKET_USERCMDS     32      // max number of usercmd_t in a packet
 
 #define PORT_ANY            -1
@@ -202,7 +215,8 @@ typedef enum {
 	NA_BAD,                 // an address lookup failed
 	NA_LOOPBACK,
 	NA_BROADCAST,
-	NA_IP
+	NA_IP,
+	NA_IP6
 } netadrtype_t;
 
 typedef enum {
@@ -214,8 +228,10 @@ typedef struct {
 	netadrtype_t type;
 
 	byte ip[4];
-	
+	byte ip6[16];
+
 	unsigned short port;
+	unsigned long scope_id;     // interface of a link local IPv6 address
 } netadr_t;
 
 void        NET_Init( void );
@@ -248,6 +264,10 @@ void        NET_Sleep( int msec );
 Netchan handles packet fragmentation and out of order / duplicate suppression
 */
 
+#define MAX_PACKETLEN           1400        // max size of a network packet
+
+#define FRAGMENT_SIZE           ( MAX_PACKETLEN - 100 )     // messages this long or longer are fragmented
+
 typedef struct {
 	netsrc_t sock;
 
@@ -354,7 +374,8 @@ enum svc_ops_e {
 	svc_serverCommand,          // [string] to be executed by client game module
 	svc_download,               // [short] size [size bytes]
 	svc_snapshot,
-	svc_EOF
+	svc_EOF,
+	svc_snapshotPart            // one of the packets a snapshot was split into, only to cl_snapshotParts clients
 };
 
 
@@ -447,6 +468,10 @@ void Cbuf_AddText( const char *text );
 void Cbuf_ExecuteText( int exec_when, const char *text );
 // this can be used in place of either Cbuf_AddText or Cbuf_InsertText
 
+int Cbuf_Stash( char *text, int size );
+void Cbuf_Unstash( const char *text, int len );
+// sets the waiting text aside while a command runs frames of its own
+
 void Cbuf_Execute( void );
 // Pulls off \n terminated lines of text from the command buffer and sends
 // them through Cmd_ExecuteString.  Stops when the buffer is empty.
@@ -680,6 +705,8 @@ int     FS_ReadFile( const char *qpath, void **buffer );
 // A 0 byte will always be appended at the end, so string ops are safe.
 // the buffer should be considered read-only, because it may be cached
 // for other uses.
+// .wav and .jpg files stored uncompressed in a pk3 come straight out of
+// the mapped pk3, read only for real and without the 0 at the end.
 
 void    FS_ForceFlush( fileHandle_t f );
 // forces flush on files we're writing to.
@@ -729,7 +756,11 @@ const char *FS_ReferencedPakPureChecksums( void );
 // back from clients for pure validation
 
 void FS_ClearPakReferences( int flags );
-// clears referenced booleans on loaded pk3s
+// clears referenced booleans on loaded pk3s, and flushes the file index
+
+void FS_FlushFileIndex( void );
+// the file index is built again on the next open, to see files that were
+// put in the directories while running
 
 void FS_PureServerSetReferencedPaks( const char *pakSums, const char *pakNames );
 void FS_PureServerSetLoadedPaks( const char *pakSums, const char *pakNames );
@@ -901,6 +932,7 @@ void *Z_Malloc( int size );         // returns 0 filled memory
 void *S_Malloc( int size );         // NOT 0 filled memory only for small allocations
 #endif
 void Z_Free( void *ptr );
+// any thread can allocate and free, but nothing else may be in the zone during these
 void Z_FreeTags( int tag );
 void Z_LogHeap( void );
 
@@ -1004,7 +1036,7 @@ void S_ClearSoundBuffer( void );
 void SV_Init( void );
 void SV_Shutdown( char *finalmsg );
 void SV_Frame( int msec );
-void SV_PacketEvent( netadr_t from, msg_t *msg );
+void SV_PacketEvent( netadr_t from, msg_t *msg, int time );
 qboolean SV_GameCommand( void );
 int SV_FrameSleepMS(void);
 
@@ -1110,6 +1142,10 @@ void    Sys_ShowConsole( int level, qboolean quitOnClose );
 void    Sys_SetErrorText( const char *text );
 
 void    Sys_SendPacket( int length, const void *data, netadr_t to );
+qboolean    Sys_GetPacket( netadr_t *net_from, msg_t *net_message );
+void    Sys_BeginPacketBatch( void );
+void    Sys_FlushPacketBatch( void );
+// Sys_SendPacket may only queue packets between the two
 
 qboolean    Sys_StringToAdr( const char *s, netadr_t *a );
 //Does NOT parse port numbers, only base addresses.
@@ -1131,6 +1167,9 @@ void Sys_DebugPrintf( PRINTF_FORMAT_STRING const char* fmt, ... );
 char **Sys_ListFiles( const char *directory, const char *extension, char *filter, int *numfiles, qboolean wantsubs );
 void    Sys_FreeFileList( char **list );
 
+void    *Sys_MapFile( const char *ospath, int *size );
+void    Sys_UnmapFile( void *base, int size );
+
 void    Sys_BeginProfiling( void );
 void    Sys_EndProfiling( void );
 
@@ -1153,6 +1192,7 @@ void Sys_Chmod( char *file, int mode );
 // used for out-of-band (OOB) datagrams with dynamically created trees
 void DynHuff_Compress(msg_t* buf, int offset);
 void DynHuff_Decompress(msg_t* buf, int offset);
+void DynHuff_Test_f(void);
 
 // huffman_static.cpp - new CNQ3 code
 // used for every other case with a predefined static tree
@@ -1160,6 +1200,8 @@ int StatHuff_ReadBit(byte* buffer, int bitIndex);                 // returns the
 void StatHuff_WriteBit(int bit, byte* buffer, int bitIndex);
 int StatHuff_ReadSymbol(int* symbol, byte* buffer, int bitIndex); // returns the number of bits read
 int StatHuff_WriteSymbol(int symbol, byte* buffer, int bitIndex); // returns the number of bits written
+int StatHuff_WriteBits(uint32_t value, int bits, byte* buffer, int bufferSize, int bitIndex);   // returns the number of bits written
+int StatHuff_ReadBits(int* value, int bits, const byte* buffer, int bufferSize, int bitIndex);  // returns the number of bits read
 
 #define SV_ENCODE_START     4
 #define SV_DECODE_START     12
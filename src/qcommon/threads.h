@@ -35,8 +35,10 @@ If you have questions concerning this license or the applicable additional terms
 	#include <gnu/lib-names.h>
 	#include <pthread.h>
 	#include <dlfcn.h>
+typedef pthread_t threadHandle_t;
 #else //WIN32
 	#include <process.h>
+typedef uintptr_t threadHandle_t;
 //#elif defined( __MACOS__ )
 //	#define LIBPTHREAD_SO "/usr/lib/libpthread.dylib"
 //#elif defined( __APPLE__ )
@@ -49,4 +51,37 @@ If you have questions concerning this license or the applicable additional terms
 void Threads_Init(void);
 int Threads_Create(void* (*thread_function)(void*), void* arguments);
 
+int Threads_CreateJoinable(threadHandle_t* thread, void* (*thread_function)(void*), void* arguments);
+// returns 0 once the thread is running, which has to be waited for with Threads_Join
+
+void Threads_Join(threadHandle_t thread);
+
+//
+// worker pool for independent per-frame work (snapshot building, etc)
+// the calling thread always takes part, so 0 workers means run serially
+//
+#define MAX_WORKER_THREADS 32
+
+typedef void (*threadJob_t)(void* data, int index);
+
+void Threads_InitWorkers(int numWorkers);
+// starts or resizes the pool, 0 stops every worker
+
+int Threads_NumWorkers(void);
+
+void Threads_RunJobs(threadJob_t job, void* data, int count);
+// calls job( data, i ) for every i in [0, count) spread over the pool
+// and returns once all of them have completed
+
+//
+// atomics for data shared between jobs, all of them act as full barriers
+//
+int Threads_AtomicAdd(volatile int* value, int amount);
+// returns the value from before the add
+
+qboolean Threads_CompareExchange(volatile int* value, int expected, int desired);
+// stores desired only if value still holds expected
+
+void Threads_MemoryBarrier(void);
+
 #endif // ~!__THREADS_H
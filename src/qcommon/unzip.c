@@ -36,6 +36,7 @@ If you have questions concerning this license or the applicable additional terms
 
 #include "../client/client.h"
 #include "unzip.h"
+#include "threads.h"
 
 /* unzip.h -- IO for uncompress .zip files using zlib 
    Version 0.15 beta, Mar 19th, 1998,
@@ -1988,6 +1989,218 @@ extern int unzOpenCurrentFile (unzFile file)
 }
 
 
+/***************************************************************************/
+/* Whole member inflate backends */
+
+#define UNZ_MAX_CONTEXTS (MAX_WORKER_THREADS + 1)
+
+struct unzInflateContext_s
+{
+	inflateTables_t *tables;        /* for the fast backend, made on first use */
+	unsigned char *input;           /* the compressed member */
+	uLong inputSize;
+};
+
+typedef struct
+{
+	const char *name;
+	int whole;                      /* read whole members with inflateBuffer */
+	int (*inflateBuffer) (unzInflateContext *ctx, const unsigned char *in, uLong inLen,
+                          unsigned char *out, uLong outLen);
+} unz_inflate_backend;
+
+static unzInflateContext unz_contexts[UNZ_MAX_CONTEXTS];
+static volatile int unz_contextUsed[UNZ_MAX_CONTEXTS];
+
+/* the zone isn't thread safe, these streams get the C heap */
+static void *unz_zmalloc (void *opaque, unsigned items, unsigned size)
+{
+	return malloc(items * size);
+}
+
+static void unz_zfree (void *opaque, void *ptr)
+{
+	free(ptr);
+}
+
+static int unz_InflateZlib (unzInflateContext *ctx, const unsigned char *in, uLong inLen,
+                            unsigned char *out, uLong outLen)
+{
+	z_stream stream;
+	int err;
+
+	if (outLen == 0)
+		return Z_OK;
+
+	Com_Memset(&stream, 0, sizeof(stream));
+	stream.zalloc = unz_zmalloc;
+	stream.zfree = unz_zfree;
+	if (inflateInit2(&stream, -MAX_WBITS) != Z_OK)
+		return Z_MEM_ERROR;
+
+	stream.next_in = (Byte*)in;
+	stream.avail_in = (uInt)inLen;
+	stream.next_out = out;
+	stream.avail_out = (uInt)outLen;
+	do
+	{
+		err = inflate(&stream, Z_SYNC_FLUSH);
+	} while (err == Z_OK && stream.avail_out > 0);
+	inflateEnd(&stream);
+
+	if ((err != Z_OK && err != Z_STREAM_END) || stream.total_out != outLen)
+		return Z_DATA_ERROR;
+	return Z_OK;
+}
+
+static int unz_InflateFast (unzInflateContext *ctx, const unsigned char *in, uLong inLen,
+                            unsigned char *out, uLong outLen)
+{
+	if (ctx->tables == NULL)
+	{
+		ctx->tables = Inflate_AllocTables();
+		if (ctx->tables == NULL)
+			return Z_MEM_ERROR;
+	}
+	if (!Inflate_Whole(ctx->tables, in, (int)inLen, out, (int)outLen))
+		return Z_DATA_ERROR;
+	return Z_OK;
+}
+
+static const unz_inflate_backend unz_backends[] =
+{
+	{ "stream", 0, unz_InflateZlib },
+	{ "zlib", 1, unz_InflateZlib },
+	{ "fast", 1, unz_InflateFast },
+	{ NULL, 0, NULL }
+};
+
+static const unz_inflate_backend *unz_backend = &unz_backends[0];
+
+extern int unzSetInflateBackend (const char *name)
+{
+	const unz_inflate_backend *backend;
+
+	for (backend = unz_backends; backend->name != NULL; backend++)
+	{
+		if (!Q_stricmp(backend->name, name))
+		{
+			unz_backend = backend;
+			return 1;
+		}
+	}
+	return 0;
+}
+
+extern const char *unzGetInflateBackend (void)
+{
+	return unz_backend->name;
+}
+
+extern unzInflateContext *unzAcquireInflateContext (void)
+{
+	int i;
+
+	for (i = 0; i < UNZ_MAX_CONTEXTS; i++)
+	{
+		if (!unz_contextUsed[i] && Threads_CompareExchange(&unz_contextUsed[i], 0, 1))
+			return &unz_contexts[i];
+	}
+	return NULL;
+}
+
+extern void unzReleaseInflateContext (unzInflateContext *ctx)
+{
+	Threads_MemoryBarrier();
+	unz_contextUsed[ctx - unz_contexts] = 0;
+}
+
+extern void unzFreeInflateContexts (void)
+{
+	int i;
+
+	for (i = 0; i < UNZ_MAX_CONTEXTS; i++)
+	{
+		Inflate_FreeTables(unz_contexts[i].tables);
+		free(unz_contexts[i].input);
+		Com_Memset(&unz_contexts[i], 0, sizeof(unz_contexts[i]));
+	}
+}
+
+extern int unzInflateBuffer (unzInflateContext *ctx, const void *in, uLong inLen, void *out, uLong outLen)
+{
+	return unz_backend->inflateBuffer(ctx, (const unsigned char*)in, inLen, (unsigned char*)out, outLen);
+}
+
+/*
+  Read the compressed data of the current file at once, nothing read yet
+*/
+static int unzlocal_ReadCompressed (file_in_zip_read_info_s* pfile_in_zip_read_info, void *buf)
+{
+	uLong size = pfile_in_zip_read_info->rest_read_compressed;
+
+	if (fseek(pfile_in_zip_read_info->file,
+			  pfile_in_zip_read_info->pos_in_zipfile +
+				 pfile_in_zip_read_info->byte_before_the_zipfile,SEEK_SET)!=0)
+		return UNZ_ERRNO;
+	if (size > 0 && fread(buf,size,1,pfile_in_zip_read_info->file)!=1)
+		return UNZ_ERRNO;
+	pfile_in_zip_read_info->pos_in_zipfile += size;
+	pfile_in_zip_read_info->rest_read_compressed = 0;
+	return (int)size;
+}
+
+/*
+  Inflate all of the current file into buf with the backend
+*/
+static int unzlocal_ReadWhole (unzInflateContext *ctx,
+                               file_in_zip_read_info_s* pfile_in_zip_read_info, void *buf)
+{
+	uLong size = pfile_in_zip_read_info->rest_read_uncompressed;
+	int err;
+
+	if (ctx->inputSize < pfile_in_zip_read_info->rest_read_compressed)
+	{
+		free(ctx->input);
+		ctx->inputSize = pfile_in_zip_read_info->rest_read_compressed;
+		ctx->input = (unsigned char*)malloc(ctx->inputSize);
+		if (ctx->input == NULL)
+		{
+			ctx->inputSize = 0;
+			return UNZ_INTERNALERROR;
+		}
+	}
+
+	err = unzlocal_ReadCompressed(pfile_in_zip_read_info, ctx->input);
+	if (err < 0)
+		return err;
+	err = unz_backend->inflateBuffer(ctx, ctx->input, (uLong)err, (unsigned char*)buf, size);
+	if (err != Z_OK)
+		return err;
+
+	pfile_in_zip_read_info->rest_read_uncompressed = 0;
+	pfile_in_zip_read_info->stream.total_out = size;
+	return (int)size;
+}
+
+extern int unzReadCurrentFileCompressed (unzFile file, void *buf, unsigned len)
+{
+	unz_s* s;
+	file_in_zip_read_info_s* pfile_in_zip_read_info;
+	if (file==NULL)
+		return UNZ_PARAMERROR;
+	s=(unz_s*)file;
+    pfile_in_zip_read_info=s->pfile_in_zip_read;
+
+	if (pfile_in_zip_read_info==NULL)
+		return UNZ_PARAMERROR;
+	if (pfile_in_zip_read_info->rest_read_compressed != s->cur_file_info.compressed_size ||
+		len < pfile_in_zip_read_info->rest_read_compressed)
+		return UNZ_PARAMERROR;
+
+	return unzlocal_ReadCompressed(pfile_in_zip_read_info, buf);
+}
+
 /*
   Read bytes from the current file.
   buf contain buffer where data must be copied
@@ -2018,6 +2231,20 @@ extern int unzReadCurrentFile  (unzFile file, void *buf, unsigned len)
 	if (len==0)
 		return 0;
 
+	/* all of a deflated file at once */
+	if ((pfile_in_zip_read_info->compression_method==Z_DEFLATED) && unz_backend->whole &&
+		(pfile_in_zip_read_info->rest_read_compressed == s->cur_file_info.compressed_size) &&
+		(len >= pfile_in_zip_read_info->rest_read_uncompressed))
+	{
+		unzInflateContext *ctx = unzAcquireInflateContext();
+		if (ctx != NULL)
+		{
+			err = unzlocal_ReadWhole(ctx, pfile_in_zip_read_info, buf);
+			unzReleaseInflateContext(ctx);
+			return err;
+		}
+	}
+
 	pfile_in_zip_read_info->stream.next_out = (Byte*)buf;
 
 	pfile_in_zip_read_info->stream.avail_out = (uInt)len;
@@ -339,3 +339,60 @@ extern int unzGetLocalExtrafield( unzFile file, void* buf, unsigned len );
   the return value is the number of unsigned chars copied in buf, or (if <0)
 	the error code
 */
+
+/***************************************************************************/
+/* Whole member inflate.  A read that asks for all of a deflated member at
+   once gets the compressed data read in one go and decoded by the inflate
+   backend straight into the buffer.  A context holds what a backend needs
+   for that, and is only ever used by one thread at a time, so members can
+   be inflated on several threads at once.
+   */
+
+typedef struct unzInflateContext_s unzInflateContext;
+
+extern int unzSetInflateBackend( const char *name );
+
+/*
+  "stream" keeps the old 64k at a time inflate, "zlib" decodes whole members
+  with it, and "fast" with the decoder in inflate.c.
+  Return 0 for a name that isn't one of those.
+*/
+
+extern const char *unzGetInflateBackend( void );
+
+extern unzInflateContext *unzAcquireInflateContext( void );
+
+/*
+  A context no other thread is using, NULL if they all are
+*/
+
+extern void unzReleaseInflateContext( unzInflateContext *ctx );
+
+extern void unzFreeInflateContexts( void );
+
+/*
+  Frees the memory the contexts hold, with none of them in use
+*/
+
+extern int unzInflateBuffer( unzInflateContext *ctx, const void *in, unsigned long inLen, void *out, unsigned long outLen );
+
+/*
+  Inflates a raw deflate stream of exactly outLen bytes with the backend.
+  Return UNZ_OK, or <0 with a zLib error code.
+*/
+
+extern int unzReadCurrentFileCompressed( unzFile file, void *buf, unsigned len );
+
+/*
+  Read the data of the current file (opened by unzOpenCurrentFile) as it is
+  stored in the zipfile, before anything else was read from it.
+  return the number of unsigned chars copied, or <0 with an error code
+*/
+
+// inflate.c
+typedef struct inflateTables_s inflateTables_t;
+
+inflateTables_t *Inflate_AllocTables( void );
+void Inflate_FreeTables( inflateTables_t *t );
+int Inflate_Whole( inflateTables_t *t, const unsigned char *in, int inLen, unsigned char *out, int outLen );
+unsigned long Inflate_CRC32( unsigned long crc, const unsigned char *buf, int len );
@@ -2138,6 +2138,49 @@ qboolean R_GetEntityToken( char *buffer, int size ) {
 	}
 }
 
+/*
+=================
+R_PrefetchWorldImages
+
+Queues the images of the fog and surface shaders, in the order the
+loaders ask for them, for the lumps of a swapped header
+=================
+*/
+void R_PrefetchWorldImages( const byte *base, const dheader_t *header ) {
+	const dshader_t     *shaders;
+	const dfog_t        *fogs;
+	const dsurface_t    *surfs;
+	byte                *seen;
+	int numShaders, numFogs, numSurfs;
+	int i, n;
+
+	shaders = ( const dshader_t * )( base + header->lumps[LUMP_SHADERS].fileofs );
+	numShaders = header->lumps[LUMP_SHADERS].filelen / sizeof( *shaders );
+	fogs = ( const dfog_t * )( base + header->lumps[LUMP_FOGS].fileofs );
+	numFogs = header->lumps[LUMP_FOGS].filelen / sizeof( *fogs );
+	surfs = ( const dsurface_t * )( base + header->lumps[LUMP_SURFACES].fileofs );
+	numSurfs = header->lumps[LUMP_SURFACES].filelen / sizeof( *surfs );
+
+	for ( i = 0 ; i < numFogs ; i++ ) {
+		R_PrefetchShaderImages( fogs[i].shader );
+	}
+
+	if ( !numShaders ) {
+		return;
+	}
+	seen = ri.Hunk_AllocateTempMemory( numShaders );
+	memset( seen, 0, numShaders );
+	for ( i = 0 ; i < numSurfs ; i++ ) {
+		n = LittleLong( surfs[i].shaderNum );
+		if ( n < 0 || n >= numShaders || seen[n] ) {
+			continue;
+		}
+		seen[n] = 1;
+		R_PrefetchShaderImages( shaders[n].shader );
+	}
+	ri.Hunk_FreeTempMemory( seen );
+}
+
 /*
 =================
 RE_LoadWorldMap
@@ -2150,7 +2193,9 @@ void RE_LoadWorldMap( const char *name ) {
 	dheader_t   *header;
 	byte        *buffer;
 	byte        *startMarker;
+	int64_t start;
 
+	start = ri.Microseconds();
 	skyboxportal = 0;
 
 	if ( tr.worldMapLoaded ) {
@@ -2215,6 +2260,13 @@ void RE_LoadWorldMap( const char *name ) {
 		( (int *)header )[i] = LittleLong( ( (int *)header )[i] );
 	}
 
+	// the worker pool decodes the images a few at a time
+	// as the shaders of the surfaces get to them
+	if ( r_prefetchImages->integer ) {
+		R_BeginImagePrefetch( qtrue );
+		R_PrefetchWorldImages( buffer, header );
+	}
+
 	// load into heap
 	ri.Cmd_ExecuteText( EXEC_NOW, "updatescreen\n" );
 	R_LoadShaders( &header->lumps[LUMP_SHADERS] );
@@ -2254,6 +2306,9 @@ void RE_LoadWorldMap( const char *name ) {
 	}
 
 //----(SA)	end
+	R_EndImagePrefetch();
 	ri.FS_FreeFile( buffer );
+
+	R_LoadTimeAdd( LOAD_WORLD, ri.Microseconds() - start, 1 );
 }
 
@@ -1095,29 +1095,59 @@ TARGA LOADING
 
 /*
 =============
-LoadTGA
+R_DecodeBuffer
+
+The serial loaders decode into the shared image buffer, decodes
+on a worker get memory of their own
 =============
 */
-void LoadTGA( const char *name, byte **pic, int *width, int *height ) {
+static byte *R_DecodeBuffer( imageDecode_t *d, int size ) {
+	if ( d->threaded ) {
+		return malloc( size );
+	}
+	return R_GetImageBuffer( size, BUFFER_IMAGE );
+}
+
+/*
+=============
+R_DecodeError
+
+Decoders may run on a worker, so they leave the ri.Error to their caller
+=============
+*/
+static qboolean R_DecodeError( imageDecode_t *d, const char *fmt, ... ) {
+	va_list argptr;
+
+	va_start( argptr, fmt );
+	Q_vsnprintf( d->error, sizeof( d->error ), fmt, argptr );
+	va_end( argptr );
+	d->error[sizeof( d->error ) - 1] = 0;
+
+	if ( d->threaded ) {
+		free( d->pic );
+	}
+	d->pic = NULL;
+	return qfalse;
+}
+
+/*
+=============
+R_DecodeTGA
+=============
+*/
+qboolean R_DecodeTGA( imageDecode_t *d ) {
 	int columns, rows, numPixels;
 	byte    *pixbuf;
 	int row, column;
-	byte    *buf_p;
-	byte    *buffer;
+	const byte  *buf_p;
+	const char  *name = d->name;
 	TargaHeader targa_header;
 	byte        *targa_rgba;
 
-	*pic = NULL;
+	d->pic = NULL;
+	d->error[0] = 0;
 
-	//
-	// load the file
-	//
-	ri.FS_ReadFile( ( char * ) name, (void **)&buffer );
-	if ( !buffer ) {
-		return;
-	}
-
-	buf_p = buffer;
+	buf_p = d->buffer;
 
 	targa_header.id_length = *buf_p++;
 	targa_header.colormap_type = *buf_p++;
@@ -1142,30 +1172,29 @@ void LoadTGA( const char *name, byte **pic, int *width, int *height ) {
 	if ( targa_header.image_type != 2
 		 && targa_header.image_type != 10
 		 && targa_header.image_type != 3 ) {
-		ri.Error( ERR_DROP, "LoadTGA: Only type 2 (RGB), 3 (gray), and 10 (RGB) TGA images supported\n" );
+		return R_DecodeError( d, "LoadTGA: Only type 2 (RGB), 3 (gray), and 10 (RGB) TGA images supported\n" );
 	}
 
 	if ( targa_header.colormap_type != 0 ) {
-		ri.Error( ERR_DROP, "LoadTGA: colormaps not supported\n" );
+		return R_DecodeError( d, "LoadTGA: colormaps not supported\n" );
 	}
 
 	if ( ( targa_header.pixel_size != 32 && targa_header.pixel_size != 24 ) && targa_header.image_type != 3 ) {
-		ri.Error( ERR_DROP, "LoadTGA: Only 32 or 24 bit images supported (no colormaps)\n" );
+		return R_DecodeError( d, "LoadTGA: Only 32 or 24 bit images supported (no colormaps)\n" );
 	}
 
 	columns = targa_header.width;
 	rows = targa_header.height;
 	numPixels = columns * rows;
 
-	if ( width ) {
-		*width = columns;
-	}
-	if ( height ) {
-		*height = rows;
-	}
+	d->width = columns;
+	d->height = rows;
 
-	targa_rgba = R_GetImageBuffer( numPixels * 4, BUFFER_IMAGE );
-	*pic = targa_rgba;
+	targa_rgba = R_DecodeBuffer( d, numPixels * 4 );
+	if ( !targa_rgba ) {
+		return R_DecodeError( d, "LoadTGA: out of memory for '%s'\n", name );
+	}
+	d->pic = targa_rgba;
 
 	if ( targa_header.id_length != 0 ) {
 		buf_p += targa_header.id_length;  // skip TARGA image comment
@@ -1212,8 +1241,7 @@ void LoadTGA( const char *name, byte **pic, int *width, int *height ) {
 					*pixbuf++ = alphabyte;
 					break;
 				default:
-					ri.Error( ERR_DROP, "LoadTGA: illegal pixel_size '%d' in file '%s'\n", targa_header.pixel_size, name );
-					break;
+					return R_DecodeError( d, "LoadTGA: illegal pixel_size '%d' in file '%s'\n", targa_header.pixel_size, name );
 				}
 			}
 		}
@@ -1245,8 +1273,7 @@ void LoadTGA( const char *name, byte **pic, int *width, int *height ) {
 						alphabyte = *buf_p++;
 						break;
 					default:
-						ri.Error( ERR_DROP, "LoadTGA: illegal pixel_size '%d' in file '%s'\n", targa_header.pixel_size, name );
-						break;
+						return R_DecodeError( d, "LoadTGA: illegal pixel_size '%d' in file '%s'\n", targa_header.pixel_size, name );
 					}
 
 					for ( j = 0; j < packetSize; j++ ) {
@@ -1288,8 +1315,7 @@ void LoadTGA( const char *name, byte **pic, int *width, int *height ) {
 							*pixbuf++ = alphabyte;
 							break;
 						default:
-							ri.Error( ERR_DROP, "LoadTGA: illegal pixel_size '%d' in file '%s'\n", targa_header.pixel_size, name );
-							break;
+							return R_DecodeError( d, "LoadTGA: illegal pixel_size '%d' in file '%s'\n", targa_header.pixel_size, name );
 						}
 						column++;
 						if ( column == columns ) { // pixel packet run spans across rows
@@ -1308,10 +1334,55 @@ breakOut:;
 		}
 	}
 
+	return qtrue;
+}
+
+/*
+=============
+LoadTGA
+=============
+*/
+void LoadTGA( const char *name, byte **pic, int *width, int *height ) {
+	imageDecode_t d;
+	byte    *buffer;
+	int length;
+
+	*pic = NULL;
+
+	//
+	// load the file
+	//
+	length = ri.FS_ReadFile( ( char * ) name, (void **)&buffer );
+	if ( !buffer ) {
+		return;
+	}
+
+	d.name = name;
+	d.buffer = buffer;
+	d.length = length;
+	d.threaded = qfalse;
+	if ( !R_DecodeTGA( &d ) ) {
+		ri.FS_FreeFile( buffer );
+		ri.Error( ERR_DROP, "%s", d.error );
+	}
 	ri.FS_FreeFile( buffer );
+
+	*pic = d.pic;
+	if ( width ) {
+		*width = d.width;
+	}
+	if ( height ) {
+		*height = d.height;
+	}
 }
 
-static void LoadJPG( const char *filename, unsigned char **pic, int *width, int *height ) {
+
+/*
+=============
+R_DecodeJPG
+=============
+*/
+qboolean R_DecodeJPG( imageDecode_t *d ) {
 	/* This struct contains the JPEG decompression parameters and pointers to
 	 * working space (which is allocated as needed by the JPEG library).
 	 */
@@ -1333,19 +1404,10 @@ static void LoadJPG( const char *filename, unsigned char **pic, int *width, int
 	JSAMPARRAY buffer;      /* Output row buffer */
 	int row_stride;     /* physical row width in output buffer */
 	unsigned char *out;
-	byte  *fbuffer;
 	byte  *bbuf;
 
-	/* In this example we want to open the input file before doing anything else,
-	 * so that the setjmp() error recovery below can assume the file is open.
-	 * VERY IMPORTANT: use "b" option to fopen() if you are on a machine that
-	 * requires it in order to read binary files.
-	 */
-
-	int len = ri.FS_ReadFile((char*)filename, (void**)&fbuffer);
- 	if (!fbuffer) {
- 		return;
- 	}
+	d->pic = NULL;
+	d->error[0] = 0;
 
 	/* Step 1: allocate and initialize JPEG decompression object */
 
@@ -1361,7 +1423,7 @@ static void LoadJPG( const char *filename, unsigned char **pic, int *width, int
 
 	/* Step 2: specify data source (eg, a file) */
 
-	jpeg_mem_src(&cinfo, fbuffer, len);
+	jpeg_mem_src(&cinfo, (unsigned char *)d->buffer, d->length);
 
 	/* Step 3: read file parameters with jpeg_read_header() */
 
@@ -1404,11 +1466,15 @@ static void LoadJPG( const char *filename, unsigned char **pic, int *width, int
 
 	row_stride = cinfo.output_width * 4;
 
-	out = R_GetImageBuffer( cinfo.output_width * cinfo.output_height * cinfo.output_components, BUFFER_IMAGE );
+	out = R_DecodeBuffer( d, cinfo.output_width * cinfo.output_height * cinfo.output_components );
+	if ( !out ) {
+		jpeg_destroy_decompress( &cinfo );
+		return R_DecodeError( d, "LoadJPG: out of memory for '%s'\n", d->name );
+	}
 
-	*pic = out;
-	*width = cinfo.output_width;
-	*height = cinfo.output_height;
+	d->pic = out;
+	d->width = cinfo.output_width;
+	d->height = cinfo.output_height;
 
 	/* Step 6: while (scan lines remain to be read) */
 	/*           jpeg_read_scanlines(...); */
@@ -1439,18 +1505,42 @@ static void LoadJPG( const char *filename, unsigned char **pic, int *width, int
 	/* This is an important step since it will release a good deal of memory. */
 	jpeg_destroy_decompress( &cinfo );
 
-	/* After finish_decompress, we can close the input file.
-	 * Here we postpone it until after no more JPEG errors are possible,
-	 * so as to simplify the setjmp error logic above.  (Actually, I don't
-	 * think that jpeg_destroy can do an error exit, but why assume anything...)
-	 */
-	ri.FS_FreeFile( fbuffer );
-
 	/* At this point you may want to check to see whether any corrupt-data
 	 * warnings occurred (test whether jerr.pub.num_warnings is nonzero).
 	 */
 
 	/* And we're done! */
+	return qtrue;
+}
+
+/*
+=============
+LoadJPG
+=============
+*/
+static void LoadJPG( const char *filename, unsigned char **pic, int *width, int *height ) {
+	imageDecode_t d;
+	byte    *fbuffer;
+	int len;
+
+	len = ri.FS_ReadFile( (char*)filename, (void**)&fbuffer );
+	if ( !fbuffer ) {
+		return;
+	}
+
+	d.name = filename;
+	d.buffer = fbuffer;
+	d.length = len;
+	d.threaded = qfalse;
+	if ( !R_DecodeJPG( &d ) ) {
+		ri.FS_FreeFile( fbuffer );
+		ri.Error( ERR_DROP, "%s", d.error );
+	}
+	ri.FS_FreeFile( fbuffer );
+
+	*pic = d.pic;
+	*width = d.width;
+	*height = d.height;
 }
 
 
@@ -1715,6 +1805,8 @@ image_t *R_FindImageFile( const char *name, qboolean mipmap, qboolean allowPicmi
 	int width, height;
 	byte    *pic;
 	long hash;
+	int64_t start;
+	qboolean prefetched;
 
 	if ( !name ) {
 		return NULL;
@@ -1743,12 +1835,16 @@ image_t *R_FindImageFile( const char *name, qboolean mipmap, qboolean allowPicmi
 		}
 	}
 
-	
-
 	//
-	// load the pic from disk
+	// load the pic from disk, unless the worker pool already decoded it
 	//
-	R_LoadImage( name, &pic, &width, &height );
+	start = ri.Microseconds();
+	pic = R_TakePrefetchedImage( name, &width, &height );
+	prefetched = ( pic != NULL );
+	if ( !prefetched ) {
+		R_LoadImage( name, &pic, &width, &height );
+		R_LoadTimeAdd( LOAD_IMAGE_SERIAL, ri.Microseconds() - start, 1 );
+	}
 	if ( pic == NULL ) {                                    // if we dont get a successful load
 // TTimo: Duane changed to _DEBUG in all cases
 // I'd still want that code in the release builds on linux
@@ -1774,11 +1870,32 @@ image_t *R_FindImageFile( const char *name, qboolean mipmap, qboolean allowPicmi
 #endif
 	}
 
+	start = ri.Microseconds();
 	image = R_CreateImage( ( char * ) name, pic, width, height, mipmap, allowPicmip, glWrapClampMode );
+	R_LoadTimeAdd( LOAD_IMAGE_UPLOAD, ri.Microseconds() - start, 1 );
 	//ri.Free( pic );
+	if ( prefetched ) {
+		free( pic );
+	}
 	return image;
 }
 
+/*
+===============
+R_ImageLoaded
+===============
+*/
+qboolean R_ImageLoaded( const char *name ) {
+	image_t *image;
+
+	for ( image = hashTable[generateHashValue( name )]; image; image = image->next ) {
+		if ( !strcmp( name, image->imgName ) ) {
+			return qtrue;
+		}
+	}
+	return qfalse;
+}
+
 
 /*
 ================
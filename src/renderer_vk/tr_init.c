@@ -142,6 +142,7 @@ cvar_t  *r_directedScale;
 cvar_t  *r_debugLight;
 cvar_t  *r_debugSort;
 cvar_t  *r_printShaders;
+cvar_t  *r_prefetchImages;
 cvar_t  *r_saveFontData;
 
 // Ridah
@@ -793,6 +794,7 @@ void R_Register( void ) {
 	r_debugLight = ri.Cvar_Get( "r_debuglight", "0", CVAR_TEMP );
 	r_debugSort = ri.Cvar_Get( "r_debugSort", "0", CVAR_CHEAT );
 	r_printShaders = ri.Cvar_Get( "r_printShaders", "0", 0 );
+	r_prefetchImages = ri.Cvar_Get( "r_prefetchImages", "1", CVAR_ARCHIVE );
 	r_saveFontData = ri.Cvar_Get( "r_saveFontData", "0", 0 );
 
 
@@ -867,6 +869,8 @@ void R_Register( void ) {
 	ri.Cmd_AddCommand( "taginfo", R_TagInfo_f );
 	ri.Cmd_AddCommand("printpools", RHI_PrintPools);
 	ri.Cmd_AddCommand("gpulist", R_Gpulist_f);
+	ri.Cmd_AddCommand( "loadtimes", R_LoadTimes_f );
+	ri.Cmd_AddCommand( "imagetest", R_ImageTest_f );
 
 	// Ridah
 	{
@@ -1005,11 +1009,15 @@ void RE_Shutdown( qboolean destroyWindow ) {
 	ri.Cmd_RemoveCommand( "modelist" );
 	ri.Cmd_RemoveCommand( "shaderstate" );
 	ri.Cmd_RemoveCommand( "taginfo" );
+	ri.Cmd_RemoveCommand( "loadtimes" );
+	ri.Cmd_RemoveCommand( "imagetest" );
 
 	// Ridah
 	ri.Cmd_RemoveCommand( "cropimages" );
 	// done.
 
+	R_EndImagePrefetch();
+
 	if ( tr.registered ) {
 		R_DeleteTextures();
 	}
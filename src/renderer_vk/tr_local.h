@@ -1226,6 +1226,7 @@ extern cvar_t  *r_simpleMipMaps;
 extern cvar_t  *r_debugSort;
 
 extern cvar_t  *r_printShaders;
+extern cvar_t  *r_prefetchImages;       // decode the images of a level on the worker pool
 extern cvar_t  *r_saveFontData;
 
 
@@ -1371,6 +1372,22 @@ void    R_SkinList_f( void );
 void    R_ScreenShot_f( void );
 void    R_ScreenShotJPEG_f( void );
 
+qboolean    R_ImageLoaded( const char *name );
+void        R_LoadImage( const char *name, byte **pic, int *width, int *height );
+
+typedef struct {
+	const char  *name;
+	const byte  *buffer;            // the file
+	int length;
+	qboolean threaded;              // on a worker, the pic is malloced and there is no ri.Error
+	byte        *pic;
+	int width, height;
+	char error[256];                // when the decode failed
+} imageDecode_t;
+
+qboolean    R_DecodeTGA( imageDecode_t *d );
+qboolean    R_DecodeJPG( imageDecode_t *d );
+
 void    R_InitFogTable( void );
 float   R_FogFactor( float s, float t );
 void    R_InitImages( void );
@@ -1395,6 +1412,35 @@ shader_t *R_FindShaderByName( const char *name );
 void        R_InitShaders( void );
 void        R_ShaderList_f( void );
 void    R_RemapShader( const char *oldShader, const char *newShader, const char *timeOffset );
+void        R_PrefetchShaderImages( const char *name );
+
+//
+// tr_bsp.c
+//
+void        R_PrefetchWorldImages( const byte *base, const dheader_t *header );
+
+//
+// tr_prefetch.c
+//
+typedef enum {
+	LOAD_WORLD,                     // includes the shaders and images of the world
+	LOAD_MODELS,                    // includes the shaders and images of the models
+	LOAD_IMAGE_SERIAL,              // read and decoded on the main thread
+	LOAD_IMAGE_READ,                // read for the worker pool
+	LOAD_IMAGE_DECODE,              // decoded on the worker pool, wall clock
+	LOAD_IMAGE_UPLOAD,
+	LOAD_NUM_CLASSES
+} loadClass_t;
+
+void        R_LoadTimeAdd( loadClass_t loadClass, int64_t usec, int count );
+void        R_ClearLoadTimes( void );
+void        R_LoadTimes_f( void );
+void        R_ImageTest_f( void );
+
+void        R_BeginImagePrefetch( qboolean skipLoaded );
+void        R_QueueImagePrefetch( const char *name );
+byte        *R_TakePrefetchedImage( const char *name, int *width, int *height );
+void        R_EndImagePrefetch( void );
 
 /*
 ====================================================================
@@ -40,6 +40,7 @@ static qboolean R_LoadMDC( model_t *mod, int lod, void *buffer, const char *mod_
 // done.
 static qboolean R_LoadMD3( model_t *mod, int lod, void *buffer, const char *name );
 static qboolean R_LoadMDS( model_t *mod, void *buffer, const char *name );
+static qhandle_t R_RegisterModelFile( const char *name );
 
 model_t *loadmodel;
 
@@ -96,6 +97,25 @@ asked for again.
 ====================
 */
 qhandle_t RE_RegisterModel( const char *name ) {
+	qhandle_t hModel;
+	int64_t start;
+	int numModels;
+
+	start = ri.Microseconds();
+	numModels = tr.numModels;
+	hModel = R_RegisterModelFile( name );
+	if ( tr.numModels != numModels ) {
+		R_LoadTimeAdd( LOAD_MODELS, ri.Microseconds() - start, 1 );
+	}
+	return hModel;
+}
+
+/*
+====================
+R_RegisterModelFile
+====================
+*/
+static qhandle_t R_RegisterModelFile( const char *name ) {
 	model_t     *mod;
 	unsigned    *buf;
 	int lod;
@@ -1301,6 +1321,7 @@ void RE_BeginRegistration( glconfig_t *glconfigOut ) {
 	tr.viewCluster = -1;        // force markleafs to regenerate
 	R_ClearFlares();
 	RE_ClearScene();
+	R_ClearLoadTimes();
 
 	tr.registered = qtrue;
 
@@ -0,0 +1,572 @@
+/*
+===========================================================================
+
+Return to Castle Wolfenstein multiplayer GPL Source Code
+Copyright (C) 1999-2010 id Software LLC, a ZeniMax Media company. 
+
+This file is part of the Return to Castle Wolfenstein multiplayer GPL Source Code (RTCW MP Source Code).  
+
+RTCW MP Source Code is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+RTCW MP Source Code is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with RTCW MP Source Code.  If not, see <http://www.gnu.org/licenses/>.
+
+In addition, the RTCW MP Source Code is also subject to certain additional terms. You should have received a copy of these additional terms immediately following the terms and conditions of the GNU General Public License which accompanied the RTCW MP Source Code.  If not, please request a copy in writing from id Software at the address below.
+
+If you have questions concerning this license or the applicable additional terms, you may contact in writing id Software LLC, c/o ZeniMax Media Inc., Suite 120, Rockville, Maryland 20850 USA.
+
+===========================================================================
+*/
+
+
+// tr_prefetch.c -- decodes the images of a level on the worker pool
+
+#include "tr_local.h"
+
+/*
+=============================================================================
+
+IMAGE PREFETCH
+
+While the world loads, the images its shaders use are queued up front,
+in the order the loaders will ask for them.  When R_FindImageFile gets
+to one that hasn't been decoded yet, it and the next few are read on
+the main thread and decoded together over the worker pool, which leaves
+the main thread with creating the images.  Anything the queue gets
+wrong just loads the usual way.
+
+=============================================================================
+*/
+
+#define MAX_PREFETCH_IMAGES         MAX_DRAWIMAGES
+#define MAX_PREFETCH_BATCH          128
+#define PREFETCH_HASH_SIZE          1024
+#define PREFETCH_JOBS_PER_THREAD    4
+#define PREFETCH_BATCH_BYTES        ( 16 * 1024 * 1024 )    // files read before they are decoded
+
+typedef enum {
+	IPF_QUEUED,
+	IPF_DECODED,
+	IPF_FAILED,                     // not there or broken, R_LoadImage will say why
+	IPF_TAKEN
+} prefetchState_t;
+
+typedef struct imagePrefetch_s {
+	char name[MAX_QPATH];
+	char fileName[MAX_QPATH];       // the .jpg when there is no .tga
+	prefetchState_t state;
+	imageDecode_t decode;
+	int usec;                       // spent decoding, on its thread
+	struct imagePrefetch_s  *hashNext;
+} imagePrefetch_t;
+
+typedef struct {
+	imagePrefetch_t *images;
+	imagePrefetch_t *hashTable[PREFETCH_HASH_SIZE];
+	int numImages;
+	qboolean active;
+	qboolean skipLoaded;
+
+	// for loadtimes, since the last R_BeginImagePrefetch
+	int queued;
+	int decoded;
+	int taken;
+	int batches;
+	int threads;
+	int64_t threadUsec;
+} prefetchData_t;
+
+static prefetchData_t pf;
+
+typedef struct {
+	int64_t usec[LOAD_NUM_CLASSES];
+	int count[LOAD_NUM_CLASSES];
+} loadTimes_t;
+
+static loadTimes_t loadTimes;
+
+static const char *loadClassNames[LOAD_NUM_CLASSES] = {
+	"world",
+	"models",
+	"images, serial",
+	"images, read",
+	"images, decode",
+	"images, upload",
+};
+
+void R_LoadTimeAdd( loadClass_t loadClass, int64_t usec, int count ) {
+	loadTimes.usec[loadClass] += usec;
+	loadTimes.count[loadClass] += count;
+}
+
+void R_ClearLoadTimes( void ) {
+	memset( &loadTimes, 0, sizeof( loadTimes ) );
+}
+
+static int R_PrefetchHash( const char *name ) {
+	unsigned hash;
+
+	for ( hash = 0 ; *name ; name++ ) {
+		hash = hash * 31 + ( unsigned char )*name;
+	}
+	return hash & ( PREFETCH_HASH_SIZE - 1 );
+}
+
+static imagePrefetch_t *R_FindPrefetch( const char *name ) {
+	imagePrefetch_t *ip;
+
+	for ( ip = pf.hashTable[R_PrefetchHash( name )] ; ip ; ip = ip->hashNext ) {
+		if ( !strcmp( ip->name, name ) ) {
+			return ip;
+		}
+	}
+	return NULL;
+}
+
+/*
+===============
+R_BeginImagePrefetch
+
+Images that are already loaded are left out with skipLoaded
+===============
+*/
+void R_BeginImagePrefetch( qboolean skipLoaded ) {
+	R_EndImagePrefetch();
+
+	pf.images = malloc( MAX_PREFETCH_IMAGES * sizeof( *pf.images ) );
+	if ( !pf.images ) {
+		return;
+	}
+	memset( pf.hashTable, 0, sizeof( pf.hashTable ) );
+	pf.numImages = 0;
+	pf.active = qtrue;
+	pf.skipLoaded = skipLoaded;
+
+	pf.queued = 0;
+	pf.decoded = 0;
+	pf.taken = 0;
+	pf.batches = 0;
+	pf.threads = 0;
+	pf.threadUsec = 0;
+}
+
+/*
+===============
+R_QueueImagePrefetch
+===============
+*/
+void R_QueueImagePrefetch( const char *name ) {
+	imagePrefetch_t *ip;
+	int len, hash;
+
+	if ( !pf.active || pf.numImages == MAX_PREFETCH_IMAGES ) {
+		return;
+	}
+
+	// the formats with decoders that can run on a worker
+	len = strlen( name );
+	if ( len < 5 || len >= MAX_QPATH ) {
+		return;
+	}
+	if ( Q_stricmp( name + len - 4, ".tga" ) && Q_stricmp( name + len - 4, ".jpg" ) ) {
+		return;
+	}
+
+	if ( ( pf.skipLoaded && R_ImageLoaded( name ) ) || R_FindPrefetch( name ) ) {
+		return;
+	}
+
+	ip = &pf.images[pf.numImages++];
+	memset( ip, 0, sizeof( *ip ) );
+	Q_strncpyz( ip->name, name, sizeof( ip->name ) );
+	ip->state = IPF_QUEUED;
+
+	hash = R_PrefetchHash( name );
+	ip->hashNext = pf.hashTable[hash];
+	pf.hashTable[hash] = ip;
+	pf.queued++;
+}
+
+/*
+===============
+R_PrefetchRead
+
+Copies the file, the file system buffers can't be handed to the workers
+===============
+*/
+static qboolean R_PrefetchRead( imagePrefetch_t *ip ) {
+	byte    *buffer, *copy;
+	int length, len;
+
+	Q_strncpyz( ip->fileName, ip->name, sizeof( ip->fileName ) );
+	length = ri.FS_ReadFile( ip->fileName, (void **)&buffer );
+	if ( !buffer ) {
+		// R_LoadImage tries the jpg in place of a tga
+		len = strlen( ip->fileName );
+		if ( Q_stricmp( ip->fileName + len - 4, ".tga" ) ) {
+			return qfalse;
+		}
+		strcpy( ip->fileName + len - 3, "jpg" );
+		length = ri.FS_ReadFile( ip->fileName, (void **)&buffer );
+		if ( !buffer ) {
+			return qfalse;
+		}
+	}
+
+	copy = malloc( length );
+	if ( copy ) {
+		memcpy( copy, buffer, length );
+	}
+	ri.FS_FreeFile( buffer );
+	if ( !copy ) {
+		return qfalse;
+	}
+
+	ip->decode.name = ip->fileName;
+	ip->decode.buffer = copy;
+	ip->decode.length = length;
+	ip->decode.threaded = qtrue;
+	return qtrue;
+}
+
+static void R_PrefetchJob( void *data, int index ) {
+	imagePrefetch_t *ip = ( (imagePrefetch_t **)data )[index];
+	int64_t start;
+	qboolean ok;
+
+	start = ri.Microseconds();
+	if ( !Q_stricmp( ip->fileName + strlen( ip->fileName ) - 4, ".jpg" ) ) {
+		ok = R_DecodeJPG( &ip->decode );
+	} else {
+		ok = R_DecodeTGA( &ip->decode );
+	}
+	ip->state = ok ? IPF_DECODED : IPF_FAILED;
+	ip->usec = ri.Microseconds() - start;
+}
+
+/*
+===============
+R_DecodePrefetchBatch
+
+Reads first and the queued images after it, and decodes them
+===============
+*/
+static void R_DecodePrefetchBatch( imagePrefetch_t *first ) {
+	imagePrefetch_t *batch[MAX_PREFETCH_BATCH];
+	imagePrefetch_t *ip;
+	int64_t start;
+	int maxJobs, n, i, bytes;
+
+	maxJobs = ( ri.NumWorkers() + 1 ) * PREFETCH_JOBS_PER_THREAD;
+	if ( maxJobs > MAX_PREFETCH_BATCH ) {
+		maxJobs = MAX_PREFETCH_BATCH;
+	}
+
+	start = ri.Microseconds();
+	n = 0;
+	bytes = 0;
+	for ( ip = first ; ip < pf.images + pf.numImages && n < maxJobs && bytes < PREFETCH_BATCH_BYTES ; ip++ ) {
+		if ( ip->state != IPF_QUEUED ) {
+			continue;
+		}
+		if ( !R_PrefetchRead( ip ) ) {
+			ip->state = IPF_FAILED;
+			continue;
+		}
+		bytes += ip->decode.length;
+		batch[n++] = ip;
+	}
+	R_LoadTimeAdd( LOAD_IMAGE_READ, ri.Microseconds() - start, n );
+
+	start = ri.Microseconds();
+	ri.RunJobs( R_PrefetchJob, batch, n );
+	R_LoadTimeAdd( LOAD_IMAGE_DECODE, ri.Microseconds() - start, n );
+
+	for ( i = 0 ; i < n ; i++ ) {
+		ip = batch[i];
+		free( (void *)ip->decode.buffer );
+		ip->decode.buffer = NULL;
+		pf.threadUsec += ip->usec;
+		if ( ip->state == IPF_DECODED ) {
+			pf.decoded++;
+		}
+	}
+	pf.batches++;
+	if ( ri.NumWorkers() + 1 > pf.threads ) {
+		pf.threads = ri.NumWorkers() + 1;
+	}
+}
+
+/*
+===============
+R_TakePrefetchedImage
+
+The pixels of a queued image, NULL if it has to be loaded the usual way.
+They belong to the caller now, to free()
+===============
+*/
+byte *R_TakePrefetchedImage( const char *name, int *width, int *height ) {
+	imagePrefetch_t *ip;
+
+	if ( !pf.active ) {
+		return NULL;
+	}
+	ip = R_FindPrefetch( name );
+	if ( !ip ) {
+		return NULL;
+	}
+	if ( ip->state == IPF_QUEUED ) {
+		R_DecodePrefetchBatch( ip );
+	}
+	if ( ip->state != IPF_DECODED ) {
+		return NULL;
+	}
+
+	ip->state = IPF_TAKEN;
+	pf.taken++;
+	*width = ip->decode.width;
+	*height = ip->decode.height;
+	return ip->decode.pic;
+}
+
+/*
+===============
+R_EndImagePrefetch
+
+Throws away what nobody asked for
+===============
+*/
+void R_EndImagePrefetch( void ) {
+	int i;
+
+	if ( !pf.images ) {
+		return;
+	}
+	for ( i = 0 ; i < pf.numImages ; i++ ) {
+		if ( pf.images[i].state == IPF_DECODED ) {
+			free( pf.images[i].decode.pic );
+		}
+	}
+	free( pf.images );
+	pf.images = NULL;
+	pf.numImages = 0;
+	pf.active = qfalse;
+}
+
+/*
+===============
+R_LoadTimes_f
+===============
+*/
+void R_LoadTimes_f( void ) {
+	int i;
+
+	ri.Printf( PRINT_ALL, "class                msec  count\n" );
+	for ( i = 0 ; i < LOAD_NUM_CLASSES ; i++ ) {
+		ri.Printf( PRINT_ALL, "%-16s %8.1f %6i\n", loadClassNames[i], loadTimes.usec[i] / 1000.0, loadTimes.count[i] );
+	}
+	ri.Printf( PRINT_ALL, "world and models include the images of their shaders\n" );
+
+	if ( pf.queued ) {
+		ri.Printf( PRINT_ALL, "%i images queued, %i decoded in %i batches on %i threads, %i used\n",
+				   pf.queued, pf.decoded, pf.batches, pf.threads, pf.taken );
+		ri.Printf( PRINT_ALL, "%.1f msec of decoding in %.1f msec\n",
+				   pf.threadUsec / 1000.0, loadTimes.usec[LOAD_IMAGE_DECODE] / 1000.0 );
+	}
+}
+
+/*
+=============================================================================
+
+IMAGE TEST
+
+"imagetest [map]" decodes the images of every map, or of the one given,
+through the worker pool and then with R_LoadImage, and compares the
+pixels.  Nothing is created, so it doesn't need a level or a window.
+The serial pass goes second, with the files already in the OS cache.
+
+=============================================================================
+*/
+
+typedef struct {
+	unsigned checksum;
+	int width, height;
+} imageTestResult_t;
+
+typedef struct {
+	int maps;
+	int images;
+	int missing;
+	int mismatches;
+	int64_t pipelineUsec;
+	int64_t serialUsec;
+} imageTestTotals_t;
+
+static void R_ImageTestResult( imageTestResult_t *r, const byte *pic, int width, int height ) {
+	unsigned sum;
+	int i, size;
+
+	memset( r, 0, sizeof( *r ) );
+	if ( !pic ) {
+		return;
+	}
+
+	sum = 2166136261u;
+	size = width * height * 4;
+	for ( i = 0 ; i < size ; i++ ) {
+		sum = ( sum ^ pic[i] ) * 16777619u;
+	}
+	r->checksum = sum;
+	r->width = width;
+	r->height = height;
+}
+
+static void R_ImageTestMap( const char *mapName, imageTestTotals_t *totals ) {
+	imageTestResult_t   *results, *serial;
+	dheader_t header;
+	byte                *buffer, *pic;
+	int64_t start, pipelineUsec, serialUsec;
+	int length, i, n, width, height, missing, mismatches;
+
+	length = ri.FS_ReadFile( mapName, (void **)&buffer );
+	if ( !buffer ) {
+		ri.Printf( PRINT_ALL, "%s not found\n", mapName );
+		return;
+	}
+	if ( length < sizeof( header ) ) {
+		ri.Printf( PRINT_ALL, "%s is too short\n", mapName );
+		ri.FS_FreeFile( buffer );
+		return;
+	}
+	memcpy( &header, buffer, sizeof( header ) );
+	for ( i = 0 ; i < sizeof( dheader_t ) / 4 ; i++ ) {
+		( (int *)&header )[i] = LittleLong( ( (int *)&header )[i] );
+	}
+	if ( header.version != BSP_VERSION ) {
+		ri.Printf( PRINT_ALL, "%s has wrong version number (%i should be %i)\n", mapName, header.version, BSP_VERSION );
+		ri.FS_FreeFile( buffer );
+		return;
+	}
+	for ( i = 0 ; i < HEADER_LUMPS ; i++ ) {
+		if ( header.lumps[i].fileofs < 0 || header.lumps[i].filelen < 0
+			 || header.lumps[i].fileofs + header.lumps[i].filelen > length ) {
+			ri.Printf( PRINT_ALL, "%s has a bad lump\n", mapName );
+			ri.FS_FreeFile( buffer );
+			return;
+		}
+	}
+
+	R_BeginImagePrefetch( qfalse );
+	R_PrefetchWorldImages( buffer, &header );
+	ri.FS_FreeFile( buffer );
+
+	n = pf.numImages;
+	results = malloc( n * 2 * sizeof( *results ) + 1 );
+	if ( !results ) {
+		ri.Printf( PRINT_ALL, "imagetest: out of memory\n" );
+		R_EndImagePrefetch();
+		return;
+	}
+	serial = results + n;
+
+	start = ri.Microseconds();
+	for ( i = 0 ; i < n ; i++ ) {
+		pic = R_TakePrefetchedImage( pf.images[i].name, &width, &height );
+		R_ImageTestResult( &results[i], pic, width, height );
+		free( pic );
+	}
+	pipelineUsec = ri.Microseconds() - start;
+
+	start = ri.Microseconds();
+	for ( i = 0 ; i < n ; i++ ) {
+		R_LoadImage( pf.images[i].name, &pic, &width, &height );
+		R_ImageTestResult( &serial[i], pic, width, height );
+	}
+	serialUsec = ri.Microseconds() - start;
+
+	missing = mismatches = 0;
+	for ( i = 0 ; i < n ; i++ ) {
+		if ( !serial[i].width && !results[i].width ) {
+			missing++;
+		} else if ( memcmp( &serial[i], &results[i], sizeof( serial[i] ) ) ) {
+			if ( mismatches++ < 4 ) {
+				ri.Printf( PRINT_ALL, S_COLOR_YELLOW "%s: %ix%i %08x serially, %ix%i %08x on the workers\n", pf.images[i].name,
+						   serial[i].width, serial[i].height, serial[i].checksum,
+						   results[i].width, results[i].height, results[i].checksum );
+			}
+		}
+	}
+
+	ri.Printf( PRINT_ALL, "%-32s %5i images %4i missing  serial %8.1f ms  %i threads %8.1f ms%s\n",
+			   mapName, n, missing, serialUsec / 1000.0, pf.threads ? pf.threads : 1, pipelineUsec / 1000.0,
+			   mismatches ? S_COLOR_YELLOW "  MISMATCH" : "" );
+
+	totals->maps++;
+	totals->images += n;
+	totals->missing += missing;
+	totals->mismatches += mismatches;
+	totals->pipelineUsec += pipelineUsec;
+	totals->serialUsec += serialUsec;
+
+	free( results );
+	R_EndImagePrefetch();
+}
+
+/*
+===============
+R_ImageTest_f
+
+imagetest [map]
+===============
+*/
+void R_ImageTest_f( void ) {
+	imageTestTotals_t totals;
+	prefetchData_t saved;
+	loadTimes_t savedTimes;
+	char mapName[MAX_QPATH];
+	char        **maps;
+	int numMaps, workers, i;
+
+	// keep loadtimes about the last level
+	R_EndImagePrefetch();
+	saved = pf;
+	savedTimes = loadTimes;
+
+	memset( &totals, 0, sizeof( totals ) );
+	workers = ri.LoadWorkersBegin();
+
+	if ( ri.Cmd_Argc() > 1 ) {
+		Com_sprintf( mapName, sizeof( mapName ), "maps/%s.bsp", ri.Cmd_Argv( 1 ) );
+		R_ImageTestMap( mapName, &totals );
+	} else {
+		maps = ri.FS_ListFiles( "maps", ".bsp", &numMaps );
+		for ( i = 0 ; i < numMaps ; i++ ) {
+			Com_sprintf( mapName, sizeof( mapName ), "maps/%s", maps[i] );
+			R_ImageTestMap( mapName, &totals );
+		}
+		ri.FS_FreeFileList( maps );
+	}
+
+	ri.LoadWorkersEnd( workers );
+	pf = saved;
+	loadTimes = savedTimes;
+
+	if ( !totals.maps ) {
+		return;
+	}
+	ri.Printf( PRINT_ALL, "%i maps, %i images, %i missing, serial %.1f ms, worker pool %.1f ms\n",
+			   totals.maps, totals.images, totals.missing, totals.serialUsec / 1000.0, totals.pipelineUsec / 1000.0 );
+	if ( totals.mismatches ) {
+		ri.Printf( PRINT_ALL, S_COLOR_RED "imagetest: %i images decoded differently\n", totals.mismatches );
+	} else {
+		ri.Printf( PRINT_ALL, "imagetest: all checksums match\n" );
+	}
+}
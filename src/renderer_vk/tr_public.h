@@ -195,6 +195,13 @@ typedef struct {
 	void (*CL_ImGUI_Update)(void);
 	void (*CL_CG_ImGUI_Update)(void);
 
+	// the worker pool, for decoding while loading
+	int64_t ( *Microseconds )( void );
+	int ( *NumWorkers )( void );
+	void ( *RunJobs )( void ( *job )( void *data, int index ), void *data, int count );
+	int ( *LoadWorkersBegin )( void );
+	void ( *LoadWorkersEnd )( int workers );
+
 	
 
 } refimport_t;
@@ -2443,6 +2443,87 @@ static char *FindShaderInShaderText( const char *shadername ) {
 	return NULL;
 }
 
+/*
+====================
+R_PrefetchSkyBox
+====================
+*/
+static void R_PrefetchSkyBox( const char *box ) {
+	static char *suf[6] = {"rt", "bk", "lf", "ft", "up", "dn"};
+	char pathname[MAX_QPATH];
+	int i;
+
+	if ( !box[0] || !strcmp( box, "-" ) ) {
+		return;
+	}
+	for ( i = 0 ; i < 6 ; i++ ) {
+		Com_sprintf( pathname, sizeof( pathname ), "%s_%s.tga", box, suf[i] );
+		R_QueueImagePrefetch( pathname );
+	}
+}
+
+/*
+====================
+R_PrefetchShaderImages
+
+Queues the images R_FindShader would load for the shader, from a quick
+look through its text rather than a real parse
+====================
+*/
+void R_PrefetchShaderImages( const char *name ) {
+	char strippedName[MAX_QPATH];
+	char fileName[MAX_QPATH];
+	char        *text, *token;
+	int depth;
+
+	if ( !name[0] ) {
+		return;
+	}
+
+	COM_StripExtension2( name, strippedName, sizeof( strippedName ) );
+	text = FindShaderInShaderText( strippedName );
+	if ( !text ) {
+		// a single image, like R_FindShader
+		Q_strncpyz( fileName, name, sizeof( fileName ) );
+		COM_DefaultExtension( fileName, sizeof( fileName ), ".tga" );
+		R_QueueImagePrefetch( fileName );
+		return;
+	}
+
+	depth = 0;
+	while ( 1 ) {
+		token = COM_ParseExt( &text, qtrue );
+		if ( !token[0] ) {
+			break;
+		}
+		if ( token[0] == '{' ) {
+			depth++;
+		} else if ( token[0] == '}' ) {
+			if ( --depth <= 0 ) {
+				break;
+			}
+		} else if ( !Q_stricmp( token, "map" ) || !Q_stricmp( token, "clampmap" ) ) {
+			token = COM_ParseExt( &text, qfalse );
+			if ( token[0] != '$' && token[0] != '*' ) {
+				R_QueueImagePrefetch( token );
+			}
+		} else if ( !Q_stricmp( token, "animMap" ) ) {
+			COM_ParseExt( &text, qfalse );      // frequency
+			while ( 1 ) {
+				token = COM_ParseExt( &text, qfalse );
+				if ( !token[0] ) {
+					break;
+				}
+				R_QueueImagePrefetch( token );
+			}
+		} else if ( !Q_stricmp( token, "skyParms" ) ) {
+			R_PrefetchSkyBox( COM_ParseExt( &text, qfalse ) );
+			COM_ParseExt( &text, qfalse );      // cloudheight
+			R_PrefetchSkyBox( COM_ParseExt( &text, qfalse ) );
+		}
+	}
+}
+
 /*
 ==================
 R_FindShaderByName
@@ -53,7 +53,6 @@ typedef struct svEntity_s {
 	int clusternums[MAX_ENT_CLUSTERS];
 	int lastCluster;                // if all the clusters don't fit in clusternums
 	int areanum, areanum2;
-	int snapshotCounter;            // used to prevent double adding from portal views
 } svEntity_t;
 
 typedef enum {
@@ -63,7 +62,32 @@ typedef enum {
 } serverState_t;
 
 
-#define MERGE_CMDS 16
+// entities visible from a viewer cluster and area, shared by every
+// client standing there, see sv_snapshot.c
+#define MAX_VIS_CACHE   64
+
+typedef struct {
+	int cluster;
+	int area;
+	int numEntities;                    // sv.num_entities when last brought up to date
+	int lastUsed;                       // svs.time of the last lookup, for replacement
+	qboolean stale;                     // entities have relinked since the last update
+	byte tested[MAX_GENTITIES / 8];
+	byte visible[MAX_GENTITIES / 8];
+} visCacheEntry_t;
+
+typedef struct {
+	int numEntries;
+	visCacheEntry_t entries[MAX_VIS_CACHE];
+
+	int hits;
+	int misses;
+	int retests;                        // single entities tested again after relinking
+	int flushes;
+	int full;                           // every entry was in use this frame, tested one by one
+} visCache_t;
+
+#define MERGE_CMDS MAX_PACKET_USERCMDS
 typedef struct mergedUserCmd_s {
 	usercmd_t userCmds[MERGE_CMDS];
 	usercmd_t merged;
@@ -80,7 +104,6 @@ typedef struct {
 	// show_bug.cgi?id=475
 	// the serverId associated with the current checksumFeed (always <= serverId)
 	int checksumFeedServerId;
-	int snapshotCounter;                // incremented for each snapshot built
 	int timeResidual;                   // <= 1000 / sv_frame->value
 	int nextFrameTime;                  // when time > nextFrameTime, process world
 	struct cmodel_s *models[MAX_MODELS];
@@ -114,6 +137,8 @@ typedef struct {
 	// -NERVE - SMF
 	mergedUserCmd_t mergedUserCmd[MAX_CLIENTS];
 	int mergeInterval;
+
+	visCache_t visCache;
 } server_t;
 
 
@@ -131,6 +156,8 @@ typedef struct {
 	int messageSent;                    // time the message was transmitted
 	int messageAcked;                   // time the message was acked
 	int messageSize;                    // used to rate drop packets
+	int part;                           // went out as this svc_snapshotPart, -1 for a whole message
+	int deltaMessage;                   // message it was delta compressed from, -1 for none
 } clientSnapshot_t;
 
 typedef enum {
@@ -147,6 +174,17 @@ typedef struct netchan_buffer_s {
 	struct netchan_buffer_s *next;
 } netchan_buffer_t;
 
+typedef struct {
+	int time;                           // svs.time the counts started, 0 for the connect
+	int messages;
+	int fragmented;                     // too long for a single packet
+	int64_t bytes;
+	int updates;                        // entity updates and adds sent
+	int deferred;                       // held back for a later snapshot
+	int split;                          // snapshots sent as svc_snapshotPart
+	int parts;
+} snapshotStats_t;
+
 typedef struct client_s {
 	clientState_t state;
 	char userinfo[MAX_INFO_STRING];                 // name, etc
@@ -191,6 +229,7 @@ typedef struct client_s {
 	int ping;
 	int rate;                           // bytes / second
 	int snapshotMsec;                   // requests a snapshot every snapshotMsec unless rate choked
+	qboolean snapshotParts;             // takes svc_snapshotPart, from cl_snapshotParts in the userinfo
 	int pureAuthentic;
 	qboolean gotCP;  // TTimo - additional flag to distinguish between a bad pure checksum, and no cp command at all
 	netchan_t netchan;
@@ -200,6 +239,10 @@ typedef struct client_s {
 	// buffer them into this queue, and hand them out to netchan as needed
 	netchan_buffer_t *netchan_start_queue;
 	netchan_buffer_t **netchan_end_queue;
+
+	// sv_snapshotPriority
+	int entityHeldSince[MAX_GENTITIES];     // svs.time an update was first held back, 0 if the client is current
+	snapshotStats_t snapshotStats;
 } client_t;
 
 //=============================================================================
@@ -212,6 +255,10 @@ typedef struct client_s {
 
 #define AUTHORIZE_TIMEOUT   5000
 
+// the authorize server only tracks IPv4, so IPv6 bans are kept here
+// for as long as the server runs, one /64 per entry
+#define MAX_IPV6_BANS   256
+
 typedef struct {
 	netadr_t adr;
 	int challenge;
@@ -231,6 +278,7 @@ typedef struct {
 	qboolean initialized;                   // sv_init has completed
 
 	int time;                               // will be strictly increasing across level changes
+	int packetTime;                         // Sys_Milliseconds when the packet being read arrived
 
 	int snapFlagServerBit;                  // ^= SNAPFLAG_SERVERCOUNT every SV_SpawnServer()
 
@@ -243,6 +291,9 @@ typedef struct {
 	netadr_t redirectAddress;               // for rcon return messages
 
 	netadr_t authorizeAddress;              // for rcon return messages
+
+	netadr_t ipv6Bans[MAX_IPV6_BANS];
+	int numIPv6Bans;
 } serverStatic_t;
 
 //================
@@ -290,6 +341,17 @@ extern cvar_t  *sv_master[MAX_MASTER_SERVERS];
 extern cvar_t  *sv_reconnectlimit;
 extern cvar_t  *sv_showloss;
 extern cvar_t  *sv_padPackets;
+extern cvar_t  *sv_snapshotWorkers;
+extern cvar_t  *sv_visCache;
+extern cvar_t  *sv_deltaCache;
+extern cvar_t  *sv_snapshotPriority;
+extern cvar_t  *sv_snapshotMTU;
+extern cvar_t  *sv_snapshotMaxDefer;
+extern cvar_t  *sv_snapshotParts;
+extern cvar_t  *sv_worldGrid;
+extern cvar_t  *sv_queryRate;
+extern cvar_t  *sv_queryRateTotal;
+extern cvar_t  *sv_queryCacheTime;
 extern cvar_t  *sv_killserver;
 extern cvar_t  *sv_mapname;
 extern cvar_t  *sv_mapChecksum;
@@ -305,6 +367,9 @@ extern cvar_t  *sv_lanForceRate;
 extern cvar_t  *sv_onlyVisibleClients;
 
 extern cvar_t  *sv_minUserCmdInterval;
+extern cvar_t  *sv_userCmdQueue;
+extern cvar_t  *sv_maxFrameUserCmds;
+extern cvar_t  *sv_userCmdBudget;
 
 extern cvar_t  *sv_showAverageBPS;          // NERVE - SMF - net debugging
 
@@ -334,6 +399,10 @@ void SV_MasterShutdown( void );
 
 void SV_MasterGameCompleteStatus();     // NERVE - SMF
 
+void SV_ClearQueryLimits( void );
+void SV_InvalidateQueryCache( void );
+void SV_QueryStats_f( void );
+
 
 
 //
@@ -359,6 +428,8 @@ void SV_DirectConnect( netadr_t from );
 
 void SV_AuthorizeIpPacket( netadr_t from );
 
+qboolean SV_IsIPv6Banned( netadr_t adr );
+
 void SV_ExecuteClientMessage( client_t *cl, msg_t *msg );
 void SV_UserinfoChanged( client_t *cl );
 
@@ -367,6 +438,8 @@ void SV_DropClient( client_t *drop, const char *reason );
 
 void SV_ExecuteClientCommand( client_t *cl, const char *s, qboolean clientOK );
 void SV_ClientThink( client_t *cl, usercmd_t *cmd );
+void SV_RunQueuedUserCmds( void );
+void SV_UserCmdStats_f( void );
 
 void SV_WriteDownloadToClient( client_t *cl, msg_t *msg );
 
@@ -384,6 +457,14 @@ void SV_WriteFrameToClient( client_t *client, msg_t *msg );
 void SV_SendMessageToClient( msg_t *msg, client_t *client );
 void SV_SendClientMessages( void );
 void SV_SendClientSnapshot( client_t *client );
+void SV_FreeSnapshotJobs( void );
+void SV_SnapshotBench_f( void );
+void SV_FreeDeltaCache( void );
+void SV_DeltaBench_f( void );
+void SV_VisCacheFlush( void );
+void SV_VisCacheRelink( int num );
+void SV_VisCache_f( void );
+void SV_SnapshotStats_f( void );
 
 //
 // sv_game.c
@@ -439,6 +520,7 @@ clipHandle_t SV_ClipHandleForEntity( const sharedEntity_t *ent );
 
 
 void SV_SectorList_f( void );
+void SV_AreaBench_f( void );
 
 
 int SV_AreaEntities( const vec3_t mins, const vec3_t maxs, int *entityList, int maxcount );
@@ -466,9 +548,45 @@ void SV_Trace( trace_t *results, const vec3_t start, const vec3_t mins, const ve
 // passEntityNum is explicitly excluded from clipping checks (normally ENTITYNUM_NONE)
 
 
+void SV_TraceBatch( trace_t *results, int count, const vec3_t *starts, const vec3_t mins, const vec3_t maxs,
+					const vec3_t *ends, int passEntityNum, int contentmask );
+// the same results as an SV_Trace for each start / end pair, cheaper for
+// bursts of rays that start close together
+
+void SV_TraceBench_f( void );
+
+
 void SV_ClipToEntity( trace_t *trace, const vec3_t start, const vec3_t mins, const vec3_t maxs, const vec3_t end, int entityNum, int contentmask, int capsule );
 // clip to a specific entity
 
+//
+// sv_profile.c
+//
+typedef enum {
+	SVP_PACKETS,
+	SVP_CLIENT_THINK,
+	SVP_CLIENT_COMMAND,
+	SVP_FRAME,
+	SVP_BOTS,
+	SVP_QUEUED_CMDS,
+	SVP_GAME_FRAME,
+	SVP_SNAPSHOTS,
+	SVP_SENDS,
+	SVP_GAME_TRACES,
+	SVP_NUM_PHASES
+} svProfPhase_t;
+
+int64_t SV_ProfileBegin( void );
+void SV_ProfileEnd( svProfPhase_t phase, int64_t start );
+void SV_ProfileFrame( void );
+void SV_ProfileReset( void );
+void SV_Profile_f( void );
+
+//
+// sv_bench.c
+//
+void SV_Bench_f( void );
+
 //
 // sv_net_chan.c
 //
@@ -0,0 +1,875 @@
+/*
+===========================================================================
+
+Return to Castle Wolfenstein multiplayer GPL Source Code
+Copyright (C) 1999-2010 id Software LLC, a ZeniMax Media company.
+
+This file is part of the Return to Castle Wolfenstein multiplayer GPL Source Code (RTCW MP Source Code).
+
+RTCW MP Source Code is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+RTCW MP Source Code is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with RTCW MP Source Code.  If not, see <http://www.gnu.org/licenses/>.
+
+In addition, the RTCW MP Source Code is also subject to certain additional terms. You should have received a copy of these additional terms immediately following the terms and conditions of the GNU General Public License which accompanied the RTCW MP Source Code.  If not, please request a copy in writing from id Software at the address below.
+
+If you have questions concerning this license or the applicable additional terms, you may contact in writing id Software LLC, c/o ZeniMax Media Inc., Suite 120, Rockville, Maryland 20850 USA.
+
+===========================================================================
+*/
+
+// sv_bench.c -- headless server benchmark with synthetic clients
+
+#include "server.h"
+
+/*
+=============================================================================
+
+svbench loads a map and connects synthetic clients to it over the
+loopback, each with its own netchan and its own port on the loopback.
+They go through connect, gamestate and begin like a real client would,
+join a team and then send a packet of scripted usercmds every server
+frame.  The frames are run back to back at exactly 1000 / sv_fps msec
+each, with the random seed fixed, so the same command line gives the
+same game.
+
+A real client learns the serverId, the checksum feed and the server
+commands by parsing what the server sends.  The synthetic ones read
+them from the server instead, they only run the server messages through
+their netchan to keep the sequences and acknowledges honest.  Pure
+checks are skipped for them.
+
+Only the server side of a frame is timed, the packets the clients sent
+and SV_Frame.  sv_profile is reset when the measured frames start, so
+it has the per phase numbers for the run afterwards.
+
+The clients take svc_snapshotPart and acknowledge the parts the way
+CL_MergeSnapshotPart does.  With net_loopDropsim set, the loopback
+loses packets in both directions, and the report has how many of the
+messages the server sent got through whole.  They also keep track of
+where each message would be in a client's parseEntities, and count the
+ones whose delta frame would have fallen out of it.  sv_snapshotMTU 1
+splits every snapshot into MAX_SNAPSHOT_PARTS, the most a client has to
+hold.
+
+Given an address, say ::1 or 127.0.0.1, the first client goes over the
+network instead, to the server's own socket at that address.  It asks
+for a challenge and connects like a real client would, and its snapshots
+come off the socket.  The server and the client share the socket, so it
+is read at set points: as many packets as the client sent before the
+server handles them, everything else after the frame, when it is all
+for the client.  The report says whether it got in and how many
+snapshots it was sent and got.
+
+=============================================================================
+*/
+
+#define SVB_PORT            1       // port of the first client, 0 is the local player
+#define SVB_CMD_MSEC        8       // usercmd rate of the clients, 125 fps
+#define SVB_CONNECT_MSEC    3000    // connect resend
+#define SVB_WARMUP_MSEC     60000   // give up if the clients aren't in by then
+#define SVB_SIZE_SHIFT      4       // snapshot size histogram bucket, 16 bytes
+#define SVB_MAX_FRAMES      100000
+#define SVB_STASH_SIZE      32768   // MAX_CMD_BUFFER in cmd.c
+
+typedef struct {
+	netadr_t adr;                   // loopback, told apart by the port, or the server's own socket
+	netchan_t netchan;
+	int qport;
+	int clientNum;                  // -1 until connected
+	int lastConnect;
+	int challenge;                  // from challengeResponse, 0 to ask for one
+	int netPending;                 // sent to the socket, not read by the server yet
+
+	qboolean gamestate;             // got one for the current level
+	qboolean deltaOk;               // got a snapshot since
+	int serverCommandSequence;
+	int reliableSequence;           // only the team command is ever sent
+
+	// the script
+	int seed;
+	int nextChange;
+	float yaw, pitch, yawSpeed;
+	int forward, right, up;
+	int buttons;
+
+	// svc_snapshotPart, the parts of a snapshot have consecutive sequences
+	int partGroup;                  // sequence of the first part
+	int partNext;                   // -1 once one was lost
+	int partGood;                   // last one with none lost before it, -1 for none
+	int ack;                        // to acknowledge instead of the last message, -1 for none
+
+	// where each message would start in the client's parseEntities
+	int parseEntitiesNum;
+	int parseEntitiesStart[PACKET_BACKUP];
+
+	int bytesDown, bytesUp;         // measured frames only
+	int snapshots;                  // measured frames only
+	snapshotStats_t statsStart;     // the server's side, when the measured frames began
+} svBenchClient_t;
+
+typedef struct {
+	int numClients;
+	svBenchClient_t clients[MAX_CLIENTS];
+	svBenchClient_t *net;           // the one on the network, NULL for none
+
+	qboolean measuring;
+	int snapshots;
+	int snapshotMax;
+	int64_t snapshotBytes;
+	int snapshotSizes[( MAX_MSGLEN >> SVB_SIZE_SHIFT ) + 1];
+	int gamestateMax;
+	int partsLost;                  // parts that came after a lost one
+	int parseEntitiesMax;           // furthest a delta frame was back in parseEntities
+	int parseEntitiesTooOld;        // messages a client would have thrown away for it
+} svBench_t;
+
+static svBench_t svb;
+
+/*
+==================
+SVB_ClientForPort
+==================
+*/
+static svBenchClient_t *SVB_ClientForPort( int port ) {
+	port -= SVB_PORT;
+	if ( port < 0 || port >= svb.numClients || svb.clients[port].adr.type != NA_LOOPBACK ) {
+		return NULL;
+	}
+	return &svb.clients[port];
+}
+
+/*
+==================
+SVB_IsServerClient
+==================
+*/
+static qboolean SVB_IsServerClient( svBenchClient_t *bc, client_t *cl ) {
+	if ( bc->adr.type == NA_LOOPBACK ) {
+		return cl->netchan.remoteAddress.type == NA_LOOPBACK && cl->netchan.remoteAddress.port == bc->adr.port;
+	}
+	return NET_CompareAdr( cl->netchan.remoteAddress, bc->adr );
+}
+
+/*
+==================
+SVB_ServerClient
+
+The server's side of a bench client, NULL when it was dropped
+==================
+*/
+static client_t *SVB_ServerClient( svBenchClient_t *bc ) {
+	client_t    *cl;
+
+	if ( bc->clientNum < 0 ) {
+		return NULL;
+	}
+	cl = &svs.clients[bc->clientNum];
+	if ( cl->state == CS_FREE || !SVB_IsServerClient( bc, cl ) ) {
+		return NULL;
+	}
+	return cl;
+}
+
+/*
+==================
+SVB_Connect
+
+The network client asks for a challenge first, and uses it up on the
+connect that follows
+==================
+*/
+static void SVB_Connect( svBenchClient_t *bc ) {
+	char userinfo[MAX_INFO_STRING];
+	char data[MAX_INFO_STRING + 16];
+
+	bc->lastConnect = svs.time;
+
+	if ( bc == svb.net && !bc->challenge ) {
+		NET_OutOfBandPrint( NS_CLIENT, bc->adr, "getchallenge" );
+		bc->netPending++;
+		return;
+	}
+
+	userinfo[0] = 0;
+	Info_SetValueForKey( userinfo, "name", va( "bench%02i", bc->qport - SVB_PORT ) );
+	Info_SetValueForKey( userinfo, "rate", "25000" );
+	Info_SetValueForKey( userinfo, "snaps", "20" );
+	Info_SetValueForKey( userinfo, "cl_snapshotParts", "1" );
+	Info_SetValueForKey( userinfo, "protocol", va( "%i", PROTOCOL_VERSION ) );
+	Info_SetValueForKey( userinfo, "qport", va( "%i", bc->qport ) );
+	Info_SetValueForKey( userinfo, "challenge", va( "%i", bc->challenge ) );
+
+	Com_sprintf( data, sizeof( data ), "connect \"%s\"", userinfo );
+	NET_OutOfBandData( NS_CLIENT, bc->adr, (byte *)data, strlen( data ) );
+	if ( bc == svb.net ) {
+		bc->netPending++;
+		bc->challenge = 0;
+	}
+}
+
+/*
+==================
+SVB_Netchan_Encode
+
+Same as the client does it, see CL_Netchan_Encode
+==================
+*/
+static void SVB_Netchan_Encode( svBenchClient_t *bc, client_t *cl, msg_t *msg, int serverId, int ack ) {
+	int i, index;
+	byte key, *string;
+
+	if ( msg->cursize <= CL_ENCODE_START ) {
+		return;
+	}
+
+	string = (byte *)cl->reliableCommands[ bc->serverCommandSequence & ( MAX_RELIABLE_COMMANDS - 1 ) ];
+	index = 0;
+	key = cl->challenge ^ serverId ^ ack;
+	for ( i = CL_ENCODE_START; i < msg->cursize; i++ ) {
+		if ( !string[index] ) {
+			index = 0;
+		}
+		if ( string[index] > 127 || string[index] == '%' ) {
+			key ^= '.' << ( i & 1 );
+		} else {
+			key ^= string[index] << ( i & 1 );
+		}
+		index++;
+		*( msg->data + i ) = *( msg->data + i ) ^ key;
+	}
+}
+
+/*
+==================
+SVB_ScriptCmd
+
+Runs about, turning and shooting in bursts
+==================
+*/
+static void SVB_ScriptCmd( svBenchClient_t *bc, int serverTime, usercmd_t *cmd ) {
+	playerState_t   *ps;
+	float r;
+
+	if ( serverTime >= bc->nextChange ) {
+		bc->nextChange = serverTime + 250 + ( Q_rand( &bc->seed ) & 1023 );
+		bc->forward = ( ( Q_rand( &bc->seed ) & 0x7fff ) % 3 - 1 ) * 127;
+		bc->right = ( ( Q_rand( &bc->seed ) & 0x7fff ) % 3 - 1 ) * 127;
+		bc->yawSpeed = Q_crandom( &bc->seed ) * 180;
+		bc->pitch = Q_crandom( &bc->seed ) * 20;
+		bc->buttons = Q_random( &bc->seed ) < 0.3f ? BUTTON_ATTACK : 0;
+		r = Q_random( &bc->seed );
+		bc->up = r < 0.05f ? 127 : r < 0.1f ? -127 : 0;
+	}
+	bc->yaw = AngleNormalize360( bc->yaw + bc->yawSpeed * SVB_CMD_MSEC * 0.001f );
+
+	ps = SV_GameClientNum( bc->clientNum );
+
+	memset( cmd, 0, sizeof( *cmd ) );
+	cmd->serverTime = serverTime;
+	cmd->angles[PITCH] = ANGLE2SHORT( bc->pitch );
+	cmd->angles[YAW] = ANGLE2SHORT( bc->yaw );
+	cmd->forwardmove = bc->forward;
+	cmd->rightmove = bc->right;
+	cmd->upmove = bc->up;
+	cmd->buttons = bc->buttons;
+	cmd->weapon = ps->weapon;
+}
+
+/*
+==================
+SVB_ClientFrame
+
+Builds and sends the packet of one client, see CL_WritePacket
+==================
+*/
+static void SVB_ClientFrame( svBenchClient_t *bc, int frameMsec ) {
+	client_t    *cl;
+	msg_t msg;
+	byte data[MAX_MSGLEN];
+	usercmd_t cmds[MAX_PACKET_USERCMDS];
+	usercmd_t nullcmd, *oldcmd;
+	int serverId, count, key, time, ack;
+	int i, sent;
+
+	cl = SVB_ServerClient( bc );
+	if ( !cl ) {
+		if ( svs.time - bc->lastConnect >= SVB_CONNECT_MSEC ) {
+			bc->clientNum = -1;
+			SVB_Connect( bc );
+		}
+		return;
+	}
+
+	// a new level, the server sends a gamestate when it hears from us
+	if ( cl->state == CS_CONNECTED ) {
+		bc->gamestate = qfalse;
+	}
+	if ( bc->gamestate ) {
+		serverId = sv.serverId;
+		// no cp from us
+		cl->pureAuthentic = 1;
+		cl->gotCP = qtrue;
+	} else {
+		serverId = 0;
+	}
+
+	MSG_Init( &msg, data, sizeof( data ) );
+	MSG_Bitstream( &msg );
+
+	ack = bc->ack > 0 ? bc->ack : bc->netchan.incomingSequence;
+
+	MSG_WriteLong( &msg, serverId );
+	MSG_WriteLong( &msg, ack );
+	MSG_WriteLong( &msg, bc->serverCommandSequence );
+
+	// join a team once in, until the server has it
+	if ( cl->state == CS_ACTIVE && !bc->reliableSequence ) {
+		bc->reliableSequence = 1;
+	}
+	if ( bc->reliableSequence > cl->lastClientCommand ) {
+		MSG_WriteByte( &msg, clc_clientCommand );
+		MSG_WriteLong( &msg, bc->reliableSequence );
+		MSG_WriteString( &msg, ( bc->qport & 1 ) ? "team red 0 3 0 0" : "team blue 0 4 0 0" );
+	}
+
+	if ( bc->gamestate ) {
+		count = frameMsec / SVB_CMD_MSEC;
+		if ( count < 1 ) {
+			count = 1;
+		} else if ( count > MAX_PACKET_USERCMDS ) {
+			count = MAX_PACKET_USERCMDS;
+		}
+
+		MSG_WriteByte( &msg, bc->deltaOk && bc->ack >= 0 ? clc_move : clc_moveNoDelta );
+		MSG_WriteByte( &msg, count );
+
+		key = sv.checksumFeed;
+		key ^= ack;
+		key ^= Com_HashKey( cl->reliableCommands[ bc->serverCommandSequence & ( MAX_RELIABLE_COMMANDS - 1 ) ], 32 );
+
+		memset( &nullcmd, 0, sizeof( nullcmd ) );
+		oldcmd = &nullcmd;
+		for ( i = 0 ; i < count ; i++ ) {
+			// spread over the frame the server is about to run
+			time = svs.time + ( frameMsec * ( i + 1 ) ) / count;
+			SVB_ScriptCmd( bc, time, &cmds[i] );
+			MSG_WriteDeltaUsercmdKey( &msg, key, oldcmd, &cmds[i] );
+			oldcmd = &cmds[i];
+		}
+	}
+
+	MSG_WriteByte( &msg, clc_EOF );
+	SVB_Netchan_Encode( bc, cl, &msg, serverId, ack );
+	Netchan_Transmit( &bc->netchan, msg.cursize, msg.data );
+	sent = 1;
+	while ( bc->netchan.unsentFragments ) {
+		Netchan_TransmitNextFragment( &bc->netchan );
+		sent++;
+	}
+	if ( bc == svb.net ) {
+		bc->netPending += sent;
+	}
+}
+
+/*
+==================
+SVB_ServerPackets
+
+What Com_EventLoop does for the loopback
+==================
+*/
+static void SVB_ServerPackets( void ) {
+	svBenchClient_t *bc;
+	netadr_t from;
+	msg_t msg;
+	byte data[MAX_MSGLEN];
+
+	MSG_Init( &msg, data, sizeof( data ) );
+	while ( NET_GetLoopPacket( NS_SERVER, &from, &msg ) ) {
+		bc = SVB_ClientForPort( from.port );
+		if ( bc && svb.measuring ) {
+			bc->bytesUp += msg.cursize;
+		}
+		if ( com_sv_running->integer ) {
+			SV_PacketEvent( from, &msg, Sys_Milliseconds() );
+		}
+	}
+
+	// only what the network client sent, the answers to it queue up behind
+	bc = svb.net;
+	while ( bc && bc->netPending > 0 ) {
+		bc->netPending--;
+		if ( !Sys_GetPacket( &from, &msg ) ) {
+			bc->netPending = 0;
+			break;
+		}
+		if ( svb.measuring ) {
+			bc->bytesUp += msg.cursize;
+		}
+		if ( com_sv_running->integer ) {
+			SV_PacketEvent( from, &msg, Sys_Milliseconds() );
+		}
+	}
+}
+
+/*
+==================
+SVB_ParseEntities
+
+What CL_ParseSnapshot does with parseEntities: each message takes as
+many as its frame has, parts included, and one whose delta frame is
+further back than MAX_PARSE_ENTITIES - 128 is thrown away
+==================
+*/
+static void SVB_ParseEntities( svBenchClient_t *bc, client_t *cl ) {
+	clientSnapshot_t    *frame;
+	int seq, back;
+
+	seq = bc->netchan.incomingSequence;
+	frame = &cl->frames[seq & PACKET_MASK];
+
+	if ( frame->deltaMessage > 0 && seq - frame->deltaMessage < PACKET_BACKUP ) {
+		back = bc->parseEntitiesNum - bc->parseEntitiesStart[frame->deltaMessage & PACKET_MASK];
+		if ( svb.measuring ) {
+			if ( back > svb.parseEntitiesMax ) {
+				svb.parseEntitiesMax = back;
+			}
+			if ( back > MAX_PARSE_ENTITIES - 128 ) {
+				svb.parseEntitiesTooOld++;
+			}
+		}
+	}
+
+	bc->parseEntitiesStart[seq & PACKET_MASK] = bc->parseEntitiesNum;
+	bc->parseEntitiesNum += frame->num_entities;
+}
+
+/*
+==================
+SVB_SnapshotPart
+
+What CL_MergeSnapshotPart does with the acknowledge.  The part number
+comes from the server's record of what it sent, and unlike the client
+the bench doesn't know the delta frame, so a lost first part means a
+full snapshot next.
+==================
+*/
+static void SVB_SnapshotPart( svBenchClient_t *bc, client_t *cl ) {
+	int seq, part;
+
+	seq = bc->netchan.incomingSequence;
+	part = cl->frames[seq & PACKET_MASK].part;
+	if ( part < 0 ) {
+		bc->ack = 0;
+		return;
+	}
+
+	if ( seq - part != bc->partGroup ) {
+		bc->partGroup = seq - part;
+		bc->partNext = 0;
+		bc->partGood = -1;
+	}
+	if ( part == bc->partNext ) {
+		bc->partNext++;
+		bc->partGood = seq;
+		bc->ack = 0;
+	} else {
+		bc->partNext = -1;
+		bc->ack = bc->partGood;
+		if ( svb.measuring ) {
+			svb.partsLost++;
+		}
+	}
+}
+
+/*
+==================
+SVB_ClientPacket
+
+Takes a packet the server sent to a client
+==================
+*/
+static void SVB_ClientPacket( svBenchClient_t *bc, msg_t *msg ) {
+	client_t        *cl;
+	const char      *s;
+	int i;
+
+	if ( svb.measuring ) {
+		bc->bytesDown += msg->cursize;
+	}
+
+	if ( msg->cursize >= 4 && *(int *)msg->data == -1 ) {
+		MSG_BeginReadingOOB( msg );
+		MSG_ReadLong( msg );
+		s = MSG_ReadStringLine( msg );
+		if ( !Q_strncmp( s, "challengeResponse", 17 ) ) {
+			// connect on the next frame, nothing is sent from here
+			bc->challenge = atoi( s + 17 );
+			bc->lastConnect = svs.time - SVB_CONNECT_MSEC;
+		} else if ( !Q_strncmp( s, "connectResponse", 15 ) ) {
+			for ( i = 0, cl = svs.clients ; i < sv_maxclients->integer ; i++, cl++ ) {
+				if ( cl->state >= CS_CONNECTED && SVB_IsServerClient( bc, cl ) ) {
+					break;
+				}
+			}
+			if ( i == sv_maxclients->integer ) {
+				return;
+			}
+			bc->clientNum = i;
+			bc->gamestate = qfalse;
+			bc->deltaOk = qfalse;
+			bc->serverCommandSequence = 0;
+			bc->reliableSequence = 0;
+			bc->ack = 0;
+			bc->partGroup = 0;
+			Netchan_Setup( NS_CLIENT, &bc->netchan, bc->adr, bc->qport );
+		} else if ( !Q_strncmp( s, "print", 5 ) ) {
+			Com_Printf( "bench%02i: %s", bc->qport - SVB_PORT, MSG_ReadString( msg ) );
+		}
+		return;
+	}
+
+	cl = SVB_ServerClient( bc );
+	if ( !cl || !Netchan_Process( &bc->netchan, msg ) ) {
+		return;
+	}
+
+	// the server hasn't written anything since it sent this
+	bc->serverCommandSequence = cl->reliableSequence;
+
+	if ( bc->netchan.incomingSequence == cl->gamestateMessageNum ) {
+		bc->gamestate = qtrue;
+		bc->deltaOk = qfalse;
+		bc->ack = 0;
+		if ( msg->cursize > svb.gamestateMax ) {
+			svb.gamestateMax = msg->cursize;
+		}
+	} else if ( bc->gamestate ) {
+		bc->deltaOk = qtrue;
+		SVB_ParseEntities( bc, cl );
+		SVB_SnapshotPart( bc, cl );
+		if ( svb.measuring ) {
+			bc->snapshots++;
+			svb.snapshots++;
+			svb.snapshotBytes += msg->cursize;
+			svb.snapshotSizes[msg->cursize >> SVB_SIZE_SHIFT]++;
+			if ( msg->cursize > svb.snapshotMax ) {
+				svb.snapshotMax = msg->cursize;
+			}
+		}
+	}
+}
+
+/*
+==================
+SVB_ClientPackets
+
+Hands the packets the server sent to the client they are for.  The
+network client doesn't send anything while they are read, so all of
+what is on the socket now came from the server.
+==================
+*/
+static void SVB_ClientPackets( void ) {
+	svBenchClient_t *bc;
+	netadr_t from;
+	msg_t msg;
+	byte data[MAX_MSGLEN];
+
+	MSG_Init( &msg, data, sizeof( data ) );
+	while ( NET_GetLoopPacket( NS_CLIENT, &from, &msg ) ) {
+		bc = SVB_ClientForPort( from.port );
+		if ( bc ) {
+			SVB_ClientPacket( bc, &msg );
+		}
+	}
+
+	while ( svb.net && Sys_GetPacket( &from, &msg ) ) {
+		if ( NET_CompareAdr( from, svb.net->adr ) ) {
+			SVB_ClientPacket( svb.net, &msg );
+		}
+	}
+}
+
+/*
+==================
+SVB_SnapshotPercentile
+==================
+*/
+static int SVB_SnapshotPercentile( int percent ) {
+	int i, count, target;
+
+	target = ( (int64_t)svb.snapshots * percent ) / 100;
+	for ( i = 0, count = 0 ; i < ARRAY_LEN( svb.snapshotSizes ) ; i++ ) {
+		count += svb.snapshotSizes[i];
+		if ( count > target ) {
+			break;
+		}
+	}
+	return ( i + 1 ) << SVB_SIZE_SHIFT;
+}
+
+static int SVB_CompareTimes( const void *a, const void *b ) {
+	int64_t d = *(const int64_t *)a - *(const int64_t *)b;
+
+	return d < 0 ? -1 : d > 0;
+}
+
+/*
+==================
+SVB_Report
+==================
+*/
+static void SVB_Report( int64_t *times, int frames, int frameMsec ) {
+	svBenchClient_t *bc;
+	client_t        *cl;
+	int64_t down, up, total;
+	double seconds;
+	int i, sent, fragmented, split, parts;
+
+	qsort( times, frames, sizeof( times[0] ), SVB_CompareTimes );
+	for ( i = 0, total = 0 ; i < frames ; i++ ) {
+		total += times[i];
+	}
+	Com_Printf( "frame usec: p50 %i  p90 %i  p99 %i  max %i  mean %.0f\n",
+				(int)times[frames / 2], (int)times[( frames * 90 ) / 100], (int)times[( frames * 99 ) / 100],
+				(int)times[frames - 1], (double)total / frames );
+
+	for ( i = 0, bc = svb.clients, down = up = 0 ; i < svb.numClients ; i++, bc++ ) {
+		down += bc->bytesDown;
+		up += bc->bytesUp;
+	}
+	seconds = frames * frameMsec * 0.001;
+	Com_Printf( "per client: %.0f bytes/sec sent, %.0f bytes/sec received\n",
+				down / seconds / svb.numClients, up / seconds / svb.numClients );
+
+	if ( svb.snapshots ) {
+		Com_Printf( "snapshots: %i, bytes p50 %i  p99 %i  max %i  mean %.0f\n", svb.snapshots,
+					SVB_SnapshotPercentile( 50 ), SVB_SnapshotPercentile( 99 ), svb.snapshotMax,
+					(double)svb.snapshotBytes / svb.snapshots );
+	}
+	Com_Printf( "gamestate: %i bytes\n", svb.gamestateMax );
+
+	sent = fragmented = split = parts = 0;
+	for ( i = 0, bc = svb.clients ; i < svb.numClients ; i++, bc++ ) {
+		cl = SVB_ServerClient( bc );
+		if ( !cl ) {
+			continue;
+		}
+		sent += cl->snapshotStats.messages - bc->statsStart.messages;
+		fragmented += cl->snapshotStats.fragmented - bc->statsStart.fragmented;
+		split += cl->snapshotStats.split - bc->statsStart.split;
+		parts += cl->snapshotStats.parts - bc->statsStart.parts;
+	}
+	Com_Printf( "messages: %i sent, %i fragmented, %i got through (%.1f%%), net_loopDropsim %g\n",
+				sent, fragmented, svb.snapshots, sent ? 100.0 * svb.snapshots / sent : 0.0,
+				Cvar_VariableValue( "net_loopDropsim" ) );
+	Com_Printf( "parts: %i snapshots split into %i, %i came after a lost one\n", split, parts, svb.partsLost );
+	Com_Printf( "parseEntities: delta frames up to %i back of %i, %i messages too old\n",
+				svb.parseEntitiesMax, MAX_PARSE_ENTITIES - 128, svb.parseEntitiesTooOld );
+}
+
+/*
+==================
+SVB_NetReport
+
+How the network client did, which is a pass or a fail for the address
+==================
+*/
+static void SVB_NetReport( void ) {
+	svBenchClient_t *bc = svb.net;
+	client_t        *cl;
+
+	cl = SVB_ServerClient( bc );
+	if ( !cl || cl->state != CS_ACTIVE ) {
+		Com_Printf( "network client: FAILED, never got in over %s\n", NET_AdrToString( bc->adr ) );
+		return;
+	}
+	if ( !bc->snapshots ) {
+		Com_Printf( "network client: FAILED, no snapshots over %s\n", NET_AdrToString( bc->adr ) );
+		return;
+	}
+	Com_Printf( "network client: client %i over %s, %i of %i snapshots got through\n", bc->clientNum,
+				NET_AdrToString( cl->netchan.remoteAddress ), bc->snapshots,
+				cl->snapshotStats.messages - bc->statsStart.messages );
+}
+
+/*
+==================
+SV_Bench_f
+
+svbench <map> [clients] [frames] [seed] [address]
+==================
+*/
+void SV_Bench_f( void ) {
+	static char stash[SVB_STASH_SIZE];
+	char map[MAX_QPATH];
+	svBenchClient_t *bc;
+	client_t        *cl;
+	int64_t         *times, start;
+	int numClients, frames, seed, frameMsec;
+	int i, measured, warmup, stashLen, recvThread;
+	qboolean active;
+	netadr_t netAdr;
+
+	if ( Cmd_Argc() < 2 ) {
+		Com_Printf( "usage: svbench <map> [clients] [frames] [seed] [address]\n" );
+		return;
+	}
+	if ( !com_dedicated->integer ) {
+		Com_Printf( "svbench needs a dedicated server.\n" );
+		return;
+	}
+
+	Q_strncpyz( map, Cmd_Argv( 1 ), sizeof( map ) );
+	numClients = Cmd_Argc() > 2 ? atoi( Cmd_Argv( 2 ) ) : 16;
+	frames = Cmd_Argc() > 3 ? atoi( Cmd_Argv( 3 ) ) : 1000;
+	seed = Cmd_Argc() > 4 ? atoi( Cmd_Argv( 4 ) ) : 1;
+	numClients = Com_ClampInt( 1, MAX_CLIENTS, numClients );
+	frames = Com_ClampInt( 1, SVB_MAX_FRAMES, frames );
+
+	// the first client goes to our own socket at this address
+	netAdr.type = NA_BAD;
+	if ( Cmd_Argc() > 5 ) {
+		if ( !NET_StringToAdr( Cmd_Argv( 5 ), &netAdr ) || ( netAdr.type != NA_IP && netAdr.type != NA_IP6 ) ) {
+			Com_Printf( "svbench: bad address %s\n", Cmd_Argv( 5 ) );
+			return;
+		}
+		netAdr.port = BigShort( Cvar_VariableIntegerValue( "net_port" ) );
+	}
+
+	// the clients don't get private slots
+	if ( sv_maxclients->integer < numClients + sv_privateClients->integer ) {
+		Cvar_Set( "sv_maxclients", va( "%i", numClients + sv_privateClients->integer ) );
+	}
+
+	srand( seed );
+	Cbuf_ExecuteText( EXEC_NOW, va( "map %s", map ) );
+	if ( !com_sv_running->integer || Q_stricmp( sv_mapname->string, map ) ) {
+		Com_Printf( "svbench: couldn't load %s\n", map );
+		return;
+	}
+	if ( numClients > sv_maxclients->integer - sv_privateClients->integer ) {
+		numClients = sv_maxclients->integer - sv_privateClients->integer;
+	}
+
+	memset( &svb, 0, sizeof( svb ) );
+	svb.numClients = numClients;
+	for ( i = 0, bc = svb.clients ; i < numClients ; i++, bc++ ) {
+		bc->adr.type = NA_LOOPBACK;
+		bc->adr.port = SVB_PORT + i;
+		bc->qport = SVB_PORT + i;
+		bc->clientNum = -1;
+		bc->lastConnect = svs.time - SVB_CONNECT_MSEC;
+		bc->seed = seed * MAX_CLIENTS + i;
+	}
+
+	// the socket is read at set points, the receive thread would
+	// hand the packets over late
+	recvThread = 0;
+	if ( netAdr.type != NA_BAD ) {
+		svb.net = &svb.clients[0];
+		svb.net->adr = netAdr;
+		recvThread = Cvar_VariableIntegerValue( "net_recvThread" );
+		if ( recvThread ) {
+			Cvar_Set( "net_recvThread", "0" );
+		}
+	}
+
+	times = Z_Malloc( frames * sizeof( *times ) );
+
+	// whatever comes after svbench waits for it, what the game
+	// adds while it runs is executed as usual
+	stashLen = Cbuf_Stash( stash, sizeof( stash ) );
+
+	Com_Printf( "svbench: %s, %i clients, %i frames, seed %i\n", map, numClients, frames, seed );
+	if ( svb.net ) {
+		Com_Printf( "svbench: bench00 connects over %s\n", NET_AdrToString( svb.net->adr ) );
+	}
+
+	measured = 0;
+	frameMsec = 1000 / sv_fps->integer;
+	for ( warmup = 0 ; measured < frames ; ) {
+		Cbuf_Execute();
+		if ( !com_sv_running->integer ) {
+			Com_Printf( "svbench: the server went down\n" );
+			break;
+		}
+
+		if ( sv_fps->integer < 1 ) {
+			Cvar_Set( "sv_fps", "10" );
+		}
+		frameMsec = 1000 / sv_fps->integer;
+
+		for ( i = 0 ; i < numClients ; i++ ) {
+			SVB_ClientFrame( &svb.clients[i], frameMsec );
+		}
+
+		start = Sys_Microseconds();
+		SVB_ServerPackets();
+		SV_Frame( frameMsec );
+		if ( svb.measuring ) {
+			times[measured++] = Sys_Microseconds() - start;
+		}
+
+		SVB_ClientPackets();
+
+		if ( svb.measuring ) {
+			continue;
+		}
+
+		// start measuring once everyone is in the game
+		for ( i = 0, active = qtrue ; i < numClients && active ; i++ ) {
+			cl = SVB_ServerClient( &svb.clients[i] );
+			active = cl && cl->state == CS_ACTIVE;
+		}
+		if ( active ) {
+			Com_Printf( "svbench: all clients in after %i frames\n", warmup );
+			svb.measuring = qtrue;
+			SV_ProfileReset();
+			for ( i = 0 ; i < numClients ; i++ ) {
+				svb.clients[i].statsStart = SVB_ServerClient( &svb.clients[i] )->snapshotStats;
+			}
+			continue;
+		}
+
+		warmup++;
+		if ( warmup * frameMsec > SVB_WARMUP_MSEC ) {
+			Com_Printf( "svbench: the clients didn't get in\n" );
+			break;
+		}
+	}
+
+	if ( measured ) {
+		SVB_Report( times, measured, frameMsec );
+	}
+	if ( svb.net ) {
+		SVB_NetReport();
+	}
+	Z_Free( times );
+
+	// let them go, the level keeps running
+	for ( i = 0, bc = svb.clients ; i < numClients ; i++, bc++ ) {
+		cl = SVB_ServerClient( bc );
+		if ( cl ) {
+			SV_DropClient( cl, "benchmark finished" );
+		}
+	}
+	SVB_ClientPackets();
+	svb.numClients = 0;
+	svb.net = NULL;
+
+	if ( recvThread ) {
+		Cvar_Set( "net_recvThread", va( "%i", recvThread ) );
+	}
+
+	Cbuf_Unstash( stash, stashLen );
+}
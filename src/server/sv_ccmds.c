@@ -157,7 +157,9 @@ static void SV_Map_f( void ) {
 	}
 
 	// make sure the level exists before trying to change, so that
-	// a typo at the server console won't end the game
+	// a typo at the server console won't end the game, and look
+	// for it again in case it was just copied in
+	FS_FlushFileIndex();
 	Com_sprintf( expanded, sizeof( expanded ), "maps/%s.bsp", map );
 	if ( FS_ReadFile( expanded, NULL ) == -1 ) {
 		Com_Printf( "Can't find map %s\n", expanded );
@@ -553,12 +555,74 @@ static void SV_Kick_f( void ) {
 	cl->lastPacketTime = svs.time;  // in case there is a funny zombie
 }
 
+/*
+==================
+SV_BanIPv6
+
+Adds the client's /64 to the local ban list, the oldest entry goes
+when it is full
+==================
+*/
+static void SV_BanIPv6( client_t *cl ) {
+	if ( SV_IsIPv6Banned( cl->netchan.remoteAddress ) ) {
+		Com_Printf( "%s is already banned\n", NET_AdrToString( cl->netchan.remoteAddress ) );
+		return;
+	}
+
+	if ( svs.numIPv6Bans == MAX_IPV6_BANS ) {
+		memmove( &svs.ipv6Bans[0], &svs.ipv6Bans[1], ( MAX_IPV6_BANS - 1 ) * sizeof( svs.ipv6Bans[0] ) );
+		svs.numIPv6Bans--;
+	}
+	svs.ipv6Bans[svs.numIPv6Bans++] = cl->netchan.remoteAddress;
+	Com_Printf( "%s was banned from coming back\n", cl->name );
+}
+
+/*
+==================
+SV_UnbanIPv6_f
+==================
+*/
+static void SV_UnbanIPv6_f( void ) {
+	netadr_t adr;
+	int i, removed;
+
+	if ( Cmd_Argc() != 2 ) {
+		Com_Printf( "Usage: unbanIPv6 <address | all>\n" );
+		for ( i = 0 ; i < svs.numIPv6Bans ; i++ ) {
+			Com_Printf( "%3i: %s\n", i, NET_AdrToString( svs.ipv6Bans[i] ) );
+		}
+		return;
+	}
+
+	if ( !Q_stricmp( Cmd_Argv( 1 ), "all" ) ) {
+		Com_Printf( "%i IPv6 bans removed\n", svs.numIPv6Bans );
+		svs.numIPv6Bans = 0;
+		return;
+	}
+
+	if ( !NET_StringToAdr( Cmd_Argv( 1 ), &adr ) || adr.type != NA_IP6 ) {
+		Com_Printf( "Bad IPv6 address %s\n", Cmd_Argv( 1 ) );
+		return;
+	}
+
+	removed = 0;
+	for ( i = 0 ; i < svs.numIPv6Bans ; ) {
+		if ( !memcmp( adr.ip6, svs.ipv6Bans[i].ip6, 8 ) ) {
+			svs.ipv6Bans[i] = svs.ipv6Bans[--svs.numIPv6Bans];
+			removed++;
+		} else {
+			i++;
+		}
+	}
+	Com_Printf( "%i IPv6 bans removed\n", removed );
+}
+
 /*
 ==================
 SV_Ban_f
 
 Ban a user from being able to play on this server through the auth
-server
+server, or locally for an IPv6 address
 ==================
 */
 static void SV_Ban_f( void ) {
@@ -586,6 +650,12 @@ static void SV_Ban_f( void ) {
 		return;
 	}
 
+	// the authorize server only tracks IPv4 addresses
+	if ( cl->netchan.remoteAddress.type == NA_IP6 ) {
+		SV_BanIPv6( cl );
+		return;
+	}
+
 	// look up the authorize server's IP
 	if ( !svs.authorizeAddress.ip[0] && svs.authorizeAddress.type != NA_BAD ) {
 		Com_Printf( "Resolving %s\n", AUTHORIZE_SERVER_NAME );
@@ -614,7 +684,7 @@ static void SV_Ban_f( void ) {
 SV_BanNum_f
 
 Ban a user from being able to play on this server through the auth
-server
+server, or locally for an IPv6 address
 ==================
 */
 static void SV_BanNum_f( void ) {
@@ -640,6 +710,12 @@ static void SV_BanNum_f( void ) {
 		return;
 	}
 
+	// the authorize server only tracks IPv4 addresses
+	if ( cl->netchan.remoteAddress.type == NA_IP6 ) {
+		SV_BanIPv6( cl );
+		return;
+	}
+
 	// look up the authorize server's IP
 	if ( !svs.authorizeAddress.ip[0] && svs.authorizeAddress.type != NA_BAD ) {
 		Com_Printf( "Resolving %s\n", AUTHORIZE_SERVER_NAME );
@@ -902,6 +978,7 @@ void SV_AddOperatorCommands( void ) {
 	Cmd_AddCommand( "kick", SV_Kick_f );
 	Cmd_AddCommand( "banUser", SV_Ban_f );
 	Cmd_AddCommand( "banClient", SV_BanNum_f );
+	Cmd_AddCommand( "unbanIPv6", SV_UnbanIPv6_f );
 	Cmd_AddCommand( "clientkick", SV_KickNum_f );
 	Cmd_AddCommand( "status", SV_Status_f );
 	Cmd_AddCommand( "serverinfo", SV_Serverinfo_f );
@@ -909,6 +986,16 @@ void SV_AddOperatorCommands( void ) {
 	Cmd_AddCommand( "dumpuser", SV_DumpUser_f );
 	Cmd_AddCommand( "map_restart", SV_MapRestart_f );
 	Cmd_AddCommand( "sectorlist", SV_SectorList_f );
+	Cmd_AddCommand( "snapshotbench", SV_SnapshotBench_f );
+	Cmd_AddCommand( "viscache", SV_VisCache_f );
+	Cmd_AddCommand( "deltabench", SV_DeltaBench_f );
+	Cmd_AddCommand( "snapstats", SV_SnapshotStats_f );
+	Cmd_AddCommand( "querystats", SV_QueryStats_f );
+	Cmd_AddCommand( "tracebench", SV_TraceBench_f );
+	Cmd_AddCommand( "areabench", SV_AreaBench_f );
+	Cmd_AddCommand( "sv_profile", SV_Profile_f );
+	Cmd_AddCommand( "svbench", SV_Bench_f );
+	Cmd_AddCommand( "cmdstats", SV_UserCmdStats_f );
 	Cmd_AddCommand( "map", SV_Map_f );
 	Cmd_AddCommand( "gameCompleteStatus", SV_GameCompleteStatus_f );      // NERVE - SMF
 #ifndef PRE_RELEASE_DEMO
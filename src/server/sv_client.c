@@ -48,6 +48,10 @@ to be sent to the authorize server.
 
 When an authorizeip is returned, a challenge response will be
 sent to that ip.
+
+The authorize server can't be asked about IPv6 addresses, so those
+are checked against the local ban list and then wait out
+AUTHORIZE_TIMEOUT like any client whose authorization never arrives.
 =================
 */
 void SV_GetChallenge( netadr_t from ) {
@@ -56,6 +60,11 @@ void SV_GetChallenge( netadr_t from ) {
 	int oldestTime;
 	challenge_t *challenge;
 
+	if ( SV_IsIPv6Banned( from ) ) {
+		NET_OutOfBandPrint( NS_SERVER, from, "print\nYou are banned from this server.\n" );
+		return;
+	}
+
 	oldest = 0;
 	oldestTime = 0x7fffffff;
 
@@ -128,7 +137,7 @@ void SV_GetChallenge( netadr_t from ) {
 	}
 
 	// otherwise send their ip to the authorize server
-	if ( svs.authorizeAddress.type != NA_BAD ) {
+	if ( svs.authorizeAddress.type != NA_BAD && from.type == NA_IP ) {
 		cvar_t  *fs;
 		char game[1024];
 
@@ -147,6 +156,27 @@ void SV_GetChallenge( netadr_t from ) {
 	}
 }
 
+/*
+====================
+SV_IsIPv6Banned
+
+Matches on the /64, a client usually picks its own address inside it
+====================
+*/
+qboolean SV_IsIPv6Banned( netadr_t adr ) {
+	int i;
+
+	if ( adr.type != NA_IP6 ) {
+		return qfalse;
+	}
+	for ( i = 0 ; i < svs.numIPv6Bans ; i++ ) {
+		if ( !memcmp( adr.ip6, svs.ipv6Bans[i].ip6, 8 ) ) {
+			return qtrue;
+		}
+	}
+	return qfalse;
+}
+
 /*
 ====================
 SV_AuthorizeIpPacket
@@ -263,6 +293,12 @@ void SV_DirectConnect( netadr_t from ) {
 
 	Com_DPrintf( "SVC_DirectConnect ()\n" );
 
+	// a challenge handed out before the ban doesn't get them in
+	if ( SV_IsIPv6Banned( from ) ) {
+		NET_OutOfBandPrint( NS_SERVER, from, "print\nYou are banned from this server.\n" );
+		return;
+	}
+
 	Q_strncpyz( userinfo, Cmd_Argv( 1 ), sizeof( userinfo ) );
 
 	// DHM - Nerve :: Update Server allows any protocol to connect
@@ -499,6 +535,8 @@ void SV_DropClient( client_t *drop, const char *reason ) {
 		return;     // already dropped
 	}
 
+	SV_InvalidateQueryCache();
+
 	if ( !drop->gentity || !( drop->gentity->r.svFlags & SVF_BOT ) ) {
 		// see if we already have a challenge for this ip
 		challenge = &svs.challenges[0];
@@ -1190,6 +1228,8 @@ void SV_UserinfoChanged( client_t *cl ) {
 	char    *val;
 	int i;
 
+	SV_InvalidateQueryCache();
+
 	// name for C code
 	
 	char *username = Info_ValueForKey( cl->userinfo, "username" );
@@ -1243,6 +1283,10 @@ void SV_UserinfoChanged( client_t *cl ) {
 		cl->snapshotMsec = 50;
 	}
 
+	// clients that can put a snapshot back together from svc_snapshotPart
+	// say so, everyone else keeps getting whole, fragmented ones
+	cl->snapshotParts = atoi( Info_ValueForKey( cl->userinfo, "cl_snapshotParts" ) ) > 0;
+
 	// TTimo
 	// maintain the IP information
 	// this is set in SV_DirectConnect (directly on the server, not transmitted), may be lost when client updates it's userinfo
@@ -1317,7 +1361,9 @@ void SV_ExecuteClientCommand( client_t *cl, const char *s, qboolean clientOK ) {
 	if ( clientOK ) {
 		// pass unknown strings to the game
 		if ( !u->name && sv.state == SS_GAME ) {
+			int64_t prof = SV_ProfileBegin();
 			VM_Call( gvm, GAME_CLIENT_COMMAND, cl - svs.clients );
+			SV_ProfileEnd( SVP_CLIENT_COMMAND, prof );
 		}
 	} else if ( !bProcessed )     {
 		Com_DPrintf( "client text ignored for %s: %s\n", cl->name, Cmd_Argv( 0 ) );
@@ -1392,27 +1438,66 @@ static qboolean SV_ClientCommand( client_t *cl, msg_t *msg ) {
 
 //==================================================================================
 
+typedef struct {
+	int received;               // got to SV_ClientThink
+	int executed;               // thinks, on a command of their own or a merged one
+	int merged;                 // folded into another instead of a think of their own
+	int overCap;                // a client over sv_maxFrameUserCmds in a frame
+	int overBudget;             // a client merged down once sv_userCmdBudget ran out
+	int maxQueued;
+} userCmdStats_t;
+
+static userCmdStats_t cmdStats;
+
+static void SV_MergeCmds( const usercmd_t *cmds, int count, usercmd_t *dest );
+
+/*
+==================
+SV_FoldUserCmds
+
+Merges the oldest count queued commands into one, the newer ones stay
+==================
+*/
+static void SV_FoldUserCmds( mergedUserCmd_t *merge, int count ) {
+	if ( count < 2 ) {
+		return;
+	}
+	SV_MergeCmds( merge->userCmds, count, &merge->merged );
+	merge->userCmds[0] = merge->merged;
+	memmove( merge->userCmds + 1, merge->userCmds + count, ( merge->count - count ) * sizeof( usercmd_t ) );
+	merge->count -= count - 1;
+	cmdStats.merged += count - 1;
+}
+
 void PushUserCmd(client_t *cl, usercmd_t *cmd){
 	mergedUserCmd_t *merge = &sv.mergedUserCmd[cl - svs.clients];
-	if(merge->count < ARRAY_LEN(merge->userCmds)){
-		merge->userCmds[merge->count++] = *cmd;
+	if(merge->count == ARRAY_LEN(merge->userCmds)){
+		// rather than losing the input
+		SV_FoldUserCmds(merge, merge->count);
+	}
+	merge->userCmds[merge->count++] = *cmd;
+	if(merge->count > cmdStats.maxQueued){
+		cmdStats.maxQueued = merge->count;
 	}
 }
 
 void MergeUserCmds(client_t *cl){
-	
 	mergedUserCmd_t *merge = &sv.mergedUserCmd[cl - svs.clients];
 	Q_assert(merge->count >= 1);
-	usercmd_t *dest = &merge->merged;
-	usercmd_t *last = &merge->userCmds[merge->count - 1];
+	SV_MergeCmds(merge->userCmds, merge->count, &merge->merged);
+	cmdStats.merged += merge->count - 1;
+}
+
+static void SV_MergeCmds( const usercmd_t *cmds, int count, usercmd_t *dest ){
+	const usercmd_t *last = &cmds[count - 1];
 	*dest = (usercmd_t){0};
 	int32_t fwd = 0;
 	int32_t right = 0;
 	int32_t up = 0;
 	int32_t kick = 0;
 
-	for(int i = 0; i < merge->count; i++){
-		usercmd_t *cur = &merge->userCmds[i];
+	for(int i = 0; i < count; i++){
+		const usercmd_t *cur = &cmds[i];
 		dest->buttons |= cur->buttons;
 		dest->wbuttons |= cur->wbuttons;
 		fwd += cur->forwardmove;
@@ -1427,13 +1512,97 @@ void MergeUserCmds(client_t *cl){
 	dest->mpSetup = last->mpSetup;
 	dest->holdable = last->holdable;
 
-	dest->forwardmove = fwd / merge->count;
-	dest->rightmove = right / merge->count;
-	dest->upmove = up / merge->count;
-	dest->wolfkick = kick / merge->count;
+	dest->forwardmove = fwd / count;
+	dest->rightmove = right / count;
+	dest->upmove = up / count;
+	dest->wolfkick = kick / count;
 	dest->weapon = last->weapon;
 }
 
+/*
+==================
+SV_RunQueuedUserCmds
+
+With sv_userCmdQueue the usercmds that arrived since the last frame are
+thought here, each on its own with its own serverTime, up to
+sv_maxFrameUserCmds a client.  Once the thinks of a frame have taken
+sv_userCmdBudget usec, the clients still waiting get a single merged
+think.  Who goes first turns round, so that hits everyone alike.
+==================
+*/
+void SV_RunQueuedUserCmds( void ) {
+	static int first;
+	mergedUserCmd_t *merge;
+	client_t        *cl;
+	int64_t budgetEnd, prof;
+	int i, j, n, cap;
+
+	cap = sv_maxFrameUserCmds->integer;
+	if ( cap < 1 ) {
+		cap = 1;
+	}
+	budgetEnd = 0;
+	if ( sv_userCmdBudget->integer > 0 ) {
+		budgetEnd = Sys_Microseconds() + sv_userCmdBudget->integer;
+	}
+
+	prof = SV_ProfileBegin();
+
+	first = ( first + 1 ) % sv_maxclients->integer;
+	for ( n = 0 ; n < sv_maxclients->integer ; n++ ) {
+		i = ( first + n ) % sv_maxclients->integer;
+		cl = &svs.clients[i];
+		merge = &sv.mergedUserCmd[i];
+		if ( !merge->count ) {
+			continue;
+		}
+		if ( cl->state != CS_ACTIVE ) {
+			merge->count = 0;
+			continue;
+		}
+
+		if ( budgetEnd && Sys_Microseconds() >= budgetEnd ) {
+			if ( merge->count > 1 ) {
+				cmdStats.overBudget++;
+				SV_FoldUserCmds( merge, merge->count );
+			}
+		} else if ( merge->count > cap ) {
+			cmdStats.overCap++;
+			SV_FoldUserCmds( merge, merge->count - cap + 1 );
+		}
+
+		// the last one is also the newest the client sent
+		for ( j = 0 ; j < merge->count && cl->state == CS_ACTIVE ; j++ ) {
+			cl->lastUsercmd = merge->userCmds[j];
+			VM_Call( gvm, GAME_CLIENT_THINK, i );
+			cmdStats.executed++;
+		}
+		merge->count = 0;
+	}
+
+	SV_ProfileEnd( SVP_QUEUED_CMDS, prof );
+}
+
+/*
+==================
+SV_UserCmdStats_f
+
+cmdstats [reset]
+==================
+*/
+void SV_UserCmdStats_f( void ) {
+	if ( Cmd_Argc() > 1 && !Q_stricmp( Cmd_Argv( 1 ), "reset" ) ) {
+		memset( &cmdStats, 0, sizeof( cmdStats ) );
+		Com_Printf( "usercmd stats reset\n" );
+		return;
+	}
+
+	Com_Printf( "%i usercmds received, %i thinks, %i merged into another\n",
+				cmdStats.received, cmdStats.executed, cmdStats.merged );
+	Com_Printf( "%i times over sv_maxFrameUserCmds, %i over sv_userCmdBudget, %i queued at most\n",
+				cmdStats.overCap, cmdStats.overBudget, cmdStats.maxQueued );
+}
+
 /*
 ==================
 SV_ClientThink
@@ -1443,18 +1612,31 @@ Also called by bot code
 */
 
 void SV_ClientThink( client_t *cl, usercmd_t *cmd ) {
+	int64_t prof;
+
 	cl->lastUsercmd = *cmd;
 
 	if ( cl->state != CS_ACTIVE ) {
 		return;     // may have been kicked during the last usercmd
 	}
 
+	cmdStats.received++;
+
+	// thought at the next server frame
+	if ( sv_userCmdQueue->integer ) {
+		PushUserCmd( cl, cmd );
+		return;
+	}
+
+	prof = SV_ProfileBegin();
+
 	//nothing to do
 	//use the merged cmd
 	//use the current cmd
 
 	if(sv_minUserCmdInterval->integer <= 0) {
 		VM_Call( gvm, GAME_CLIENT_THINK, cl - svs.clients );
+		cmdStats.executed++;
 	}else{
 		mergedUserCmd_t *merge = &sv.mergedUserCmd[cl - svs.clients];
 		PushUserCmd(cl, cmd);
@@ -1465,7 +1647,9 @@ void SV_ClientThink( client_t *cl, usercmd_t *cmd ) {
 			cl->lastUsercmd = merge->merged;
 			cl->lastUsercmd.serverTime = cmd->serverTime;
 			VM_Call(gvm, GAME_CLIENT_THINK, cl - svs.clients);
+			cmdStats.executed++;
 			merge->count = 0;
+			SV_ProfileEnd( SVP_CLIENT_THINK, prof );
 			return;
 		}
 
@@ -1475,12 +1659,14 @@ void SV_ClientThink( client_t *cl, usercmd_t *cmd ) {
 			merge->nextClientThinkTime += sv_minUserCmdInterval->integer;
 			if(merge->count == 1){
 				VM_Call( gvm, GAME_CLIENT_THINK, cl - svs.clients );
+				cmdStats.executed++;
 				merge->count = 0;
 			}else if(merge->count > 1){
 				MergeUserCmds(cl);
 				merge->merged.serverTime = merge->nextClientThinkTime - sv_minUserCmdInterval->integer;
 				cl->lastUsercmd = merge->merged;
 				VM_Call( gvm, GAME_CLIENT_THINK, cl - svs.clients );
+				cmdStats.executed++;
 				merge->count = 0;
 			}
 		}
@@ -1489,7 +1675,7 @@ void SV_ClientThink( client_t *cl, usercmd_t *cmd ) {
 
 	cl->lastUsercmd.serverTime = cmd->serverTime;
 
-	
+	SV_ProfileEnd( SVP_CLIENT_THINK, prof );
 }
 
 
@@ -1547,8 +1733,9 @@ static void SV_UserMove( client_t *cl, msg_t *msg, qboolean delta ) {
 		oldcmd = cmd;
 	}
 
-	// save time for ping calculation
-	cl->frames[ cl->messageAcknowledge & PACKET_MASK ].messageAcked = svs.time;
+	// save time for ping calculation, from when the packet arrived rather
+	// than when we got around to reading it
+	cl->frames[ cl->messageAcknowledge & PACKET_MASK ].messageAcked = svs.packetTime;
 
 	// TTimo
 	// catch the no-cp-yet situation before SV_ClientEnterWorld
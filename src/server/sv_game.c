@@ -224,6 +224,9 @@ void SV_AdjustAreaPortalState( sharedEntity_t *ent, qboolean open ) {
 		return;
 	}
 	CM_AdjustAreaPortalState( svEnt->areanum, svEnt->areanum2, open );
+
+	// area connectivity changed, cached visibility is no good anymore
+	SV_VisCacheFlush();
 }
 
 
@@ -319,6 +322,8 @@ The module is making a system call
 #define VMF( x )  ( (float *)args )[x]
 
 int SV_GameSystemCalls( int *args ) {
+	int64_t prof;
+
 	switch ( args[0] ) {
 	case G_PRINT:
 		Com_Printf( "%s", VMA( 1 ) );
@@ -389,10 +394,14 @@ int SV_GameSystemCalls( int *args ) {
 	case G_ENTITY_CONTACTCAPSULE:
 		return SV_EntityContact( VMA( 1 ), VMA( 2 ), VMA( 3 ), /* int capsule */ qtrue );
 	case G_TRACE:
+		prof = SV_ProfileBegin();
 		SV_Trace( VMA( 1 ), VMA( 2 ), VMA( 3 ), VMA( 4 ), VMA( 5 ), args[6], args[7], /* int capsule */ qfalse );
+		SV_ProfileEnd( SVP_GAME_TRACES, prof );
 		return 0;
 	case G_TRACECAPSULE:
+		prof = SV_ProfileBegin();
 		SV_Trace( VMA( 1 ), VMA( 2 ), VMA( 3 ), VMA( 4 ), VMA( 5 ), args[6], args[7], /* int capsule */ qtrue );
+		SV_ProfileEnd( SVP_GAME_TRACES, prof );
 		return 0;
 	case G_POINT_CONTENTS:
 		return SV_PointContents( VMA( 1 ), args[2] );
@@ -889,6 +898,12 @@ int SV_GameSystemCalls( int *args ) {
 	case G_CMD_ARGSFROM:
 		Cmd_ArgsFromBuffer(args[1], VMA(2), args[3]);
 		return 0;
+
+	case G_TRACEBATCH:
+		prof = SV_ProfileBegin();
+		SV_TraceBatch( VMA( 1 ), args[2], VMA( 3 ), VMA( 4 ), VMA( 5 ), VMA( 6 ), args[7], args[8] );
+		SV_ProfileEnd( SVP_GAME_TRACES, prof );
+		return 0;
 		
 	default:
 		Com_Error( ERR_DROP, "Bad game system trap: %i", args[0] );
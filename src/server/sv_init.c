@@ -62,6 +62,7 @@ void SV_SetConfigstring( int index, const char *val ) {
 	// change the string in sv
 	Z_Free( sv.configstrings[index] );
 	sv.configstrings[index] = CopyString( val );
+	SV_InvalidateQueryCache();
 
 	// send it to all the clients if we aren't
 	// spawning a new server
@@ -829,6 +830,18 @@ void SV_Init( void ) {
 	sv_reconnectlimit = Cvar_Get( "sv_reconnectlimit", "3", 0 );
 	sv_showloss = Cvar_Get( "sv_showloss", "0", 0 );
 	sv_padPackets = Cvar_Get( "sv_padPackets", "0", 0 );
+	sv_snapshotWorkers = Cvar_Get( "sv_snapshotWorkers", "0", CVAR_ARCHIVE );
+	sv_visCache = Cvar_Get( "sv_visCache", "1", 0 );
+	sv_deltaCache = Cvar_Get( "sv_deltaCache", "1", 0 );
+	sv_snapshotPriority = Cvar_Get( "sv_snapshotPriority", "0", CVAR_ARCHIVE );
+	sv_snapshotMTU = Cvar_Get( "sv_snapshotMTU", "1200", CVAR_ARCHIVE );
+	sv_snapshotMaxDefer = Cvar_Get( "sv_snapshotMaxDefer", "200", CVAR_ARCHIVE );
+	sv_snapshotParts = Cvar_Get( "sv_snapshotParts", "1", CVAR_ARCHIVE );
+	sv_worldGrid = Cvar_Get( "sv_worldGrid", "0", CVAR_ARCHIVE );
+	sv_queryRate = Cvar_Get( "sv_queryRate", "4", CVAR_ARCHIVE );
+	sv_queryRateTotal = Cvar_Get( "sv_queryRateTotal", "200", CVAR_ARCHIVE );
+	sv_queryCacheTime = Cvar_Get( "sv_queryCacheTime", "1000", 0 );
+	SV_ClearQueryLimits();
 	sv_killserver = Cvar_Get( "sv_killserver", "0", 0 );
 	sv_mapChecksum = Cvar_Get( "sv_mapChecksum", "", CVAR_ROM );
 	sv_lanForceRate = Cvar_Get( "sv_lanForceRate", "1", CVAR_ARCHIVE );
@@ -838,6 +851,9 @@ void SV_Init( void ) {
 	sv_showAverageBPS = Cvar_Get( "sv_showAverageBPS", "0", 0 );           // NERVE - SMF - net debugging
 
 	sv_minUserCmdInterval = Cvar_Get( "sv_minUserCmdInterval", "8", CVAR_ARCHIVE );
+	sv_userCmdQueue = Cvar_Get( "sv_userCmdQueue", "0", CVAR_ARCHIVE );
+	sv_maxFrameUserCmds = Cvar_Get( "sv_maxFrameUserCmds", "12", CVAR_ARCHIVE );
+	sv_userCmdBudget = Cvar_Get( "sv_userCmdBudget", "0", CVAR_ARCHIVE );
 
 	// NERVE - SMF - create user set cvars
 	Cvar_Get( "g_userTimeLimit", "0", 0 );
@@ -968,6 +984,8 @@ void SV_Shutdown( char *finalmsg ) {
 		//Z_Free( svs.clients );
 		free( svs.clients );    // RF, avoid trying to allocate large chunk on a fragmented zone
 	}
+	SV_FreeSnapshotJobs();
+	SV_FreeDeltaCache();
 	memset( &svs, 0, sizeof( svs ) );
 
 	Cvar_Set( "sv_running", "0" );
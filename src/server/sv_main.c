@@ -52,6 +52,17 @@ cvar_t  *sv_master[MAX_MASTER_SERVERS];     // master server ip address
 cvar_t  *sv_reconnectlimit;     // minimum seconds between connect messages
 cvar_t  *sv_showloss;           // report when usercmds are lost
 cvar_t  *sv_padPackets;         // add nop bytes to messages
+cvar_t  *sv_snapshotWorkers;    // extra threads for building client snapshots
+cvar_t  *sv_visCache;           // share entity visibility between clients in the same cluster
+cvar_t  *sv_deltaCache;         // encode identical entity deltas only once per frame
+cvar_t  *sv_snapshotPriority;   // fit entity updates into a budget, the rest wait for later snapshots
+cvar_t  *sv_snapshotMTU;        // largest snapshot message sv_snapshotPriority aims for
+cvar_t  *sv_snapshotMaxDefer;   // msec an entity update can be held back at most
+cvar_t  *sv_snapshotParts;      // split snapshots over sv_snapshotMTU for clients that can take it
+cvar_t  *sv_worldGrid;          // link entities in a loose grid instead of the sector tree
+cvar_t  *sv_queryRate;          // getstatus/getinfo/getchallenge per second from one address
+cvar_t  *sv_queryRateTotal;     // same, summed over all addresses
+cvar_t  *sv_queryCacheTime;     // msec a rendered status/info reply can be reused
 cvar_t  *sv_killserver;         // menu system can set to 1 to shut server down
 cvar_t  *sv_mapname;
 cvar_t  *sv_mapChecksum;
@@ -70,6 +81,9 @@ cvar_t  *sv_maxlives;           // NERVE - SMF
 cvar_t  *sv_tourney;            // NERVE - SMF
 
 cvar_t  *sv_minUserCmdInterval;
+cvar_t  *sv_userCmdQueue;       // think usercmds one by one at the server frame
+cvar_t  *sv_maxFrameUserCmds;   // usercmds a client gets to think a frame, the rest are merged
+cvar_t  *sv_userCmdBudget;      // usec of queued thinks a frame, 0 for no limit
 
 cvar_t *sv_dl_maxRate;
 
@@ -355,6 +369,247 @@ void SV_MasterShutdown( void ) {
 }
 
 
+/*
+==============================================================================
+
+QUERY LIMITING
+
+Server browsers and reflection floods can send getstatus/getinfo at a
+rate that costs real frame time.  Each source address gets a token
+bucket in a small hash table, and a second bucket caps the total so a
+flood from spoofed addresses can't get through by never repeating one.
+The replies themselves are rendered once and reused until a userinfo or
+configstring changes, or sv_queryCacheTime runs out.
+
+==============================================================================
+*/
+
+#define QUERY_HASH_SIZE     1024
+#define QUERY_HASH_PROBES   8
+
+typedef struct {
+	netadr_t adr;
+	int lastTime;
+	int tokens;             // 1000 per query
+} queryBucket_t;
+
+typedef struct {
+	int served;
+	int cached;             // served from an already rendered reply
+	int rebuilt;
+	int droppedAddress;     // over sv_queryRate
+	int droppedTotal;       // over sv_queryRateTotal
+} queryStats_t;
+
+typedef struct {
+	qboolean valid;
+	int time;
+	char info[MAX_INFO_STRING];     // without the challenge
+} queryCache_t;
+
+static queryBucket_t queryBuckets[QUERY_HASH_SIZE];
+static queryBucket_t queryTotal;
+static queryStats_t queryStats;
+
+static queryCache_t statusCache;
+static char statusPlayers[MAX_MSGLEN];
+static queryCache_t infoCache;
+
+/*
+================
+SV_HashQueryAddress
+================
+*/
+static unsigned SV_HashQueryAddress( netadr_t *adr ) {
+	const byte  *b;
+	int i, len;
+	unsigned hash;
+
+	if ( adr->type == NA_IP6 ) {
+		b = adr->ip6;
+		len = sizeof( adr->ip6 );
+	} else {
+		b = adr->ip;
+		len = sizeof( adr->ip );
+	}
+
+	hash = adr->type;
+	for ( i = 0 ; i < len ; i++ ) {
+		hash = hash * 31 + b[i];
+	}
+	return hash ^ ( hash >> 16 );
+}
+
+/*
+================
+SV_TakeQueryToken
+
+Refills the bucket for the time since it was last used and takes one
+query out of it.  A full bucket holds a second's worth of queries.
+================
+*/
+static qboolean SV_TakeQueryToken( queryBucket_t *bucket, int rate ) {
+	int elapsed;
+
+	elapsed = svs.time - bucket->lastTime;
+	if ( elapsed < 0 || elapsed > 1000 ) {
+		elapsed = 1000;     // svs.time was reset, or the bucket is full anyway
+	}
+	bucket->lastTime = svs.time;
+	bucket->tokens += elapsed * rate;
+	if ( bucket->tokens > rate * 1000 ) {
+		bucket->tokens = rate * 1000;
+	}
+
+	if ( bucket->tokens < 1000 ) {
+		return qfalse;
+	}
+	bucket->tokens -= 1000;
+	return qtrue;
+}
+
+/*
+================
+SV_ClearQueryLimits
+
+Empties the address slots, which are told apart by an NA_BAD address
+================
+*/
+void SV_ClearQueryLimits( void ) {
+	int i;
+
+	memset( queryBuckets, 0, sizeof( queryBuckets ) );
+	for ( i = 0 ; i < QUERY_HASH_SIZE ; i++ ) {
+		queryBuckets[i].adr.type = NA_BAD;
+	}
+	memset( &queryTotal, 0, sizeof( queryTotal ) );
+}
+
+/*
+================
+SV_AllowQuery
+
+Returns qfalse if a query from this address should be ignored.
+LAN addresses are never limited.
+================
+*/
+static qboolean SV_AllowQuery( netadr_t from ) {
+	queryBucket_t   *bucket, *oldest;
+	unsigned hash;
+	int i;
+
+	if ( Sys_IsLANAddress( from ) ) {
+		queryStats.served++;
+		return qtrue;
+	}
+
+	if ( sv_queryRate->integer > 0 ) {
+		hash = SV_HashQueryAddress( &from );
+		bucket = NULL;
+		oldest = NULL;
+		for ( i = 0 ; i < QUERY_HASH_PROBES ; i++ ) {
+			bucket = &queryBuckets[( hash + i ) & ( QUERY_HASH_SIZE - 1 )];
+			if ( bucket->adr.type != NA_BAD && NET_CompareBaseAdr( bucket->adr, from ) ) {
+				break;
+			}
+			if ( !oldest || bucket->adr.type == NA_BAD ||
+				 ( oldest->adr.type != NA_BAD && svs.time - bucket->lastTime > svs.time - oldest->lastTime ) ) {
+				oldest = bucket;
+			}
+			bucket = NULL;
+		}
+
+		if ( !bucket ) {
+			// take over the stalest slot, starting with a full bucket
+			bucket = oldest;
+			bucket->adr = from;
+			bucket->lastTime = svs.time;
+			bucket->tokens = sv_queryRate->integer * 1000;
+		}
+
+		if ( !SV_TakeQueryToken( bucket, sv_queryRate->integer ) ) {
+			queryStats.droppedAddress++;
+			return qfalse;
+		}
+	}
+
+	if ( sv_queryRateTotal->integer > 0 ) {
+		if ( !SV_TakeQueryToken( &queryTotal, sv_queryRateTotal->integer ) ) {
+			queryStats.droppedTotal++;
+			return qfalse;
+		}
+	}
+
+	queryStats.served++;
+	return qtrue;
+}
+
+/*
+================
+SV_InvalidateQueryCache
+
+Called whenever something that shows up in a status or info reply
+changes, so the next query renders it again.
+================
+*/
+void SV_InvalidateQueryCache( void ) {
+	statusCache.valid = qfalse;
+	infoCache.valid = qfalse;
+}
+
+/*
+================
+SV_QueryCacheCurrent
+================
+*/
+static qboolean SV_QueryCacheCurrent( queryCache_t *cache ) {
+	if ( !cache->valid || sv_queryCacheTime->integer <= 0 ) {
+		return qfalse;
+	}
+	if ( svs.time - cache->time < 0 || svs.time - cache->time >= sv_queryCacheTime->integer ) {
+		return qfalse;
+	}
+	queryStats.cached++;
+	return qtrue;
+}
+
+/*
+================
+SV_QueryStats_f
+
+Prints the query limiter and reply cache counters.
+================
+*/
+void SV_QueryStats_f( void ) {
+	int i, used;
+
+	if ( !com_sv_running->integer ) {
+		Com_Printf( "Server is not running.\n" );
+		return;
+	}
+
+	if ( Cmd_Argc() > 1 && !Q_stricmp( Cmd_Argv( 1 ), "reset" ) ) {
+		memset( &queryStats, 0, sizeof( queryStats ) );
+		SV_ClearQueryLimits();
+		SV_InvalidateQueryCache();
+		Com_Printf( "query stats reset\n" );
+		return;
+	}
+
+	used = 0;
+	for ( i = 0 ; i < QUERY_HASH_SIZE ; i++ ) {
+		if ( queryBuckets[i].adr.type != NA_BAD ) {
+			used++;
+		}
+	}
+
+	Com_Printf( "%i queries served, %i from cache, %i replies rendered\n",
+				queryStats.served, queryStats.cached, queryStats.rebuilt );
+	Com_Printf( "%i dropped over sv_queryRate, %i over sv_queryRateTotal\n",
+				queryStats.droppedAddress, queryStats.droppedTotal );
+	Com_Printf( "%i of %i address slots in use\n", used, QUERY_HASH_SIZE );
+}
+
 /*
 ==============================================================================
 
@@ -365,33 +620,22 @@ CONNECTIONLESS COMMANDS
 
 /*
 ================
-SVC_Status
+SV_RenderStatus
 
-Responds with all the info that qplug or qspy can see about the server
-and all connected players.  Used for getting detailed information after
-the simple info query.
+Builds the serverinfo and player list that SVC_Status sends.
 ================
 */
-void SVC_Status( netadr_t from ) {
+static void SV_RenderStatus( void ) {
 	char player[1024];
-	char status[MAX_MSGLEN];
 	int i;
 	client_t    *cl;
 	playerState_t   *ps;
 	int statusLength;
 	int playerLength;
-	char infostring[MAX_INFO_STRING];
-
-	// DHM - Nerve
-#ifdef UPDATE_SERVER
-	return;
-#endif
+	char    *infostring;
 
-	strcpy( infostring, Cvar_InfoString( CVAR_SERVERINFO ) );
-
-	// echo back the parameter to status. so master servers can use it as a challenge
-	// to prevent timed spoofed reply packets that add ghost servers
-	Info_SetValueForKey( infostring, "challenge", Cmd_Argv( 1 ) );
+	infostring = statusCache.info;
+	Q_strncpyz( infostring, Cvar_InfoString( CVAR_SERVERINFO ), sizeof( statusCache.info ) );
 
 	// add "demo" to the sv_keywords if restricted
 	if ( Cvar_VariableValue( "fs_restrict" ) ) {
@@ -402,7 +646,7 @@ void SVC_Status( netadr_t from ) {
 		Info_SetValueForKey( infostring, "sv_keywords", keywords );
 	}
 
-	status[0] = 0;
+	statusPlayers[0] = 0;
 	statusLength = 0;
 
 	for ( i = 0 ; i < sv_maxclients->integer ; i++ ) {
@@ -412,15 +656,51 @@ void SVC_Status( netadr_t from ) {
 			Com_sprintf( player, sizeof( player ), "%i %i \"%s\"\n",
 						 ps->persistant[PERS_SCORE], cl->ping, cl->name );
 			playerLength = strlen( player );
-			if ( statusLength + playerLength >= sizeof( status ) ) {
+			if ( statusLength + playerLength >= sizeof( statusPlayers ) ) {
 				break;      // can't hold any more
 			}
-			strcpy( status + statusLength, player );
+			strcpy( statusPlayers + statusLength, player );
 			statusLength += playerLength;
 		}
 	}
 
-	NET_OutOfBandPrint( NS_SERVER, from, "statusResponse\n%s\n%s", infostring, status );
+	statusCache.valid = qtrue;
+	statusCache.time = svs.time;
+	queryStats.rebuilt++;
+}
+
+/*
+================
+SVC_Status
+
+Responds with all the info that qplug or qspy can see about the server
+and all connected players.  Used for getting detailed information after
+the simple info query.
+================
+*/
+void SVC_Status( netadr_t from ) {
+	char infostring[MAX_INFO_STRING];
+
+	// DHM - Nerve
+#ifdef UPDATE_SERVER
+	return;
+#endif
+
+	if ( !SV_AllowQuery( from ) ) {
+		return;
+	}
+
+	if ( !SV_QueryCacheCurrent( &statusCache ) ) {
+		SV_RenderStatus();
+	}
+
+	Q_strncpyz( infostring, statusCache.info, sizeof( infostring ) );
+
+	// echo back the parameter to status. so master servers can use it as a challenge
+	// to prevent timed spoofed reply packets that add ghost servers
+	Info_SetValueForKey( infostring, "challenge", Cmd_Argv( 1 ) );
+
+	NET_OutOfBandPrint( NS_SERVER, from, "statusResponse\n%s\n%s", infostring, statusPlayers );
 }
 
 /*
@@ -480,24 +760,17 @@ void SVC_GameCompleteStatus( netadr_t from ) {
 
 /*
 ================
-SVC_Info
+SV_RenderInfo
 
-Responds with a short info message that should be enough to determine
-if a user is interested in a server to do a full status
+Builds the info string that SVC_Info sends.
 ================
 */
-void SVC_Info( netadr_t from ) {
+static void SV_RenderInfo( void ) {
 	int i, count;
 	char    *gamedir;
-	char infostring[MAX_INFO_STRING];
+	char    *infostring;
 	char    *antilag;
 
-	// DHM - Nerve
-#ifdef UPDATE_SERVER
-	return;
-#endif
-
-
 	// don't count privateclients
 	count = 0;
 	for ( i = sv_privateClients->integer ; i < sv_maxclients->integer ; i++ ) {
@@ -506,12 +779,9 @@ void SVC_Info( netadr_t from ) {
 		}
 	}
 
+	infostring = infoCache.info;
 	infostring[0] = 0;
 
-	// echo back the parameter to status. so servers can use it as a challenge
-	// to prevent timed spoofed reply packets that add ghost servers
-	Info_SetValueForKey( infostring, "challenge", Cmd_Argv( 1 ) );
-
 	Info_SetValueForKey( infostring, "protocol", va( "%i", PROTOCOL_VERSION ) );
 	Info_SetValueForKey( infostring, "hostname", sv_hostname->string );
 	Info_SetValueForKey( infostring, "mapname", sv_mapname->string );
@@ -548,6 +818,41 @@ void SVC_Info( netadr_t from ) {
 		Info_SetValueForKey( infostring, "g_antilag", antilag );
 	}
 
+	infoCache.valid = qtrue;
+	infoCache.time = svs.time;
+	queryStats.rebuilt++;
+}
+
+/*
+================
+SVC_Info
+
+Responds with a short info message that should be enough to determine
+if a user is interested in a server to do a full status
+================
+*/
+void SVC_Info( netadr_t from ) {
+	char infostring[MAX_INFO_STRING];
+
+	// DHM - Nerve
+#ifdef UPDATE_SERVER
+	return;
+#endif
+
+	if ( !SV_AllowQuery( from ) ) {
+		return;
+	}
+
+	if ( !SV_QueryCacheCurrent( &infoCache ) ) {
+		SV_RenderInfo();
+	}
+
+	Q_strncpyz( infostring, infoCache.info, sizeof( infostring ) );
+
+	// echo back the parameter to status. so servers can use it as a challenge
+	// to prevent timed spoofed reply packets that add ghost servers
+	Info_SetValueForKey( infostring, "challenge", Cmd_Argv( 1 ) );
+
 	NET_OutOfBandPrint( NS_SERVER, from, "infoResponse\n%s", infostring );
 }
 
@@ -719,7 +1024,9 @@ void SV_ConnectionlessPacket( netadr_t from, msg_t *msg ) {
 	} else if ( !Q_stricmp( c,"getinfo" ) ) {
 		SVC_Info( from );
 	} else if ( !Q_stricmp( c,"getchallenge" ) ) {
-		SV_GetChallenge( from );
+		if ( SV_AllowQuery( from ) ) {
+			SV_GetChallenge( from );
+		}
 	} else if ( !Q_stricmp( c,"connect" ) ) {
 		SV_DirectConnect( from );
 	} else if ( !Q_stricmp( c,"ipAuthorize" ) ) {
@@ -747,16 +1054,24 @@ void SV_ConnectionlessPacket( netadr_t from, msg_t *msg ) {
 /*
 =================
 SV_ReadPackets
+
+time is the Sys_Milliseconds the packet arrived at, which can be well
+before now if it was queued by the network receive thread
 =================
 */
-void SV_PacketEvent( netadr_t from, msg_t *msg ) {
+void SV_PacketEvent( netadr_t from, msg_t *msg, int time ) {
 	int i;
 	client_t    *cl;
 	int qport;
+	int64_t prof;
+
+	svs.packetTime = time;
 
 	// check for connectionless packet (0xffffffff) first
 	if ( msg->cursize >= 4 && *(int *)msg->data == -1 ) {
+		prof = SV_ProfileBegin();
 		SV_ConnectionlessPacket( from, msg );
+		SV_ProfileEnd( SVP_PACKETS, prof );
 		return;
 	}
 
@@ -789,6 +1104,7 @@ void SV_PacketEvent( netadr_t from, msg_t *msg ) {
 		}
 
 		// make sure it is a valid, in sequence packet
+		prof = SV_ProfileBegin();
 		if ( SV_Netchan_Process( cl, msg ) ) {
 			// zombie clients still need to do the Netchan_Process
 			// to make sure they don't need to retransmit the final
@@ -798,6 +1114,7 @@ void SV_PacketEvent( netadr_t from, msg_t *msg ) {
 				SV_ExecuteClientMessage( cl, msg );
 			}
 		}
+		SV_ProfileEnd( SVP_PACKETS, prof );
 		return;
 	}
 
@@ -966,6 +1283,7 @@ void SV_Frame( int msec ) {
 	int frameMsec;
 	int startTime;
 	char mapname[MAX_QPATH];
+	int64_t frameProf, prof;
 
 	// the menu kills the server with this cvar
 	if ( sv_killserver->integer ) {
@@ -992,7 +1310,9 @@ void SV_Frame( int msec ) {
 	sv.timeResidual += msec;
 
 	if ( !com_dedicated->integer ) {
+		prof = SV_ProfileBegin();
 		SV_BotFrame( svs.time + sv.timeResidual );
+		SV_ProfileEnd( SVP_BOTS, prof );
 	}
 
 	if ( com_dedicated->integer && sv.timeResidual < frameMsec ) {
@@ -1053,11 +1373,19 @@ void SV_Frame( int msec ) {
 		startTime = 0;  // quite a compiler warning
 	}
 
+	frameProf = SV_ProfileBegin();
+
 	// update ping based on the all received frames
 	SV_CalcPings();
 
 	if ( com_dedicated->integer ) {
+		prof = SV_ProfileBegin();
 		SV_BotFrame( svs.time );
+		SV_ProfileEnd( SVP_BOTS, prof );
+	}
+
+	if ( sv_userCmdQueue->integer && sv.timeResidual >= frameMsec ) {
+		SV_RunQueuedUserCmds();
 	}
 
 	// run the game simulation in chunks
@@ -1067,7 +1395,9 @@ void SV_Frame( int msec ) {
 
 		// let everything in the world think and move
 #ifndef UPDATE_SERVER
+		prof = SV_ProfileBegin();
 		VM_Call( gvm, GAME_RUN_FRAME, svs.time );
+		SV_ProfileEnd( SVP_GAME_FRAME, prof );
 #endif
 	}
 
@@ -1079,10 +1409,15 @@ void SV_Frame( int msec ) {
 	SV_CheckTimeouts();
 
 	// send messages back to the clients
+	prof = SV_ProfileBegin();
 	SV_SendClientMessages();
+	SV_ProfileEnd( SVP_SNAPSHOTS, prof );
 
 	// send a heartbeat to the master if needed
 	SV_MasterHeartbeat( HEARTBEAT_GAME );
+
+	SV_ProfileEnd( SVP_FRAME, frameProf );
+	SV_ProfileFrame();
 }
 
 
@@ -0,0 +1,347 @@
+/*
+===========================================================================
+
+Return to Castle Wolfenstein multiplayer GPL Source Code
+Copyright (C) 1999-2010 id Software LLC, a ZeniMax Media company.
+
+This file is part of the Return to Castle Wolfenstein multiplayer GPL Source Code (RTCW MP Source Code).
+
+RTCW MP Source Code is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+RTCW MP Source Code is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with RTCW MP Source Code.  If not, see <http://www.gnu.org/licenses/>.
+
+In addition, the RTCW MP Source Code is also subject to certain additional terms. You should have received a copy of these additional terms immediately following the terms and conditions of the GNU General Public License which accompanied the RTCW MP Source Code.  If not, please request a copy in writing from id Software at the address below.
+
+If you have questions concerning this license or the applicable additional terms, you may contact in writing id Software LLC, c/o ZeniMax Media Inc., Suite 120, Rockville, Maryland 20850 USA.
+
+===========================================================================
+*/
+
+// sv_profile.c -- per phase server frame timing
+
+#include "server.h"
+#include "../qcommon/crash.h"
+
+/*
+=============================================================================
+
+The phases of a server frame are timed with the cpu timestamp counter
+where there is one, and the time spent in each is added up until the
+frame has run.  The per frame totals go into a ring of the last
+SVP_WINDOW frames, which the percentiles are taken from.
+
+Phases nest, "frame" includes "snapshots" which includes "sends".  The
+traces the game asks for are counted on their own, they happen inside
+both "game frame" and "client think".  Packets and the client thinks
+they trigger arrive between frames and count towards the next one.
+
+=============================================================================
+*/
+
+#if defined( _MSC_VER ) && ( defined( _M_IX86 ) || defined( _M_X64 ) )
+#include <intrin.h>
+#define SV_ProfileTicks()   ( (int64_t)__rdtsc() )
+#elif defined( __GNUC__ ) && ( defined( __i386__ ) || defined( __x86_64__ ) )
+#define SV_ProfileTicks()   ( (int64_t)__builtin_ia32_rdtsc() )
+#else
+#define SV_ProfileTicks()   Sys_Microseconds()
+#endif
+
+#define SVP_WINDOW          1024    // frames, a power of two
+#define SVP_BUCKETS         24      // powers of two microseconds
+
+typedef struct {
+	const char  *name;
+	int parent;                     // -1 for the top level
+
+	int64_t frameTicks;             // this frame so far
+	int frameCalls;
+
+	int64_t window[SVP_WINDOW];     // ticks per frame
+	int64_t maxTicks;               // since the last reset
+	int64_t totalTicks;
+	int64_t totalCalls;
+} svProfData_t;
+
+static svProfData_t svp_phases[SVP_NUM_PHASES] = {
+	{ "packets", -1 },
+	{ "client think", SVP_PACKETS },
+	{ "client command", SVP_PACKETS },
+	{ "frame", -1 },
+	{ "bots", SVP_FRAME },
+	{ "queued usercmds", SVP_FRAME },
+	{ "game frame", SVP_FRAME },
+	{ "snapshots", SVP_FRAME },
+	{ "sends", SVP_SNAPSHOTS },
+	{ "game traces", -1 },
+};
+
+static int svp_frames;              // frames since the last reset
+static int64_t svp_startTicks;
+static int64_t svp_startUsec;
+
+/*
+==================
+SV_ProfileBegin / SV_ProfileEnd
+
+Wrap a phase with these, Begin returns the start time
+==================
+*/
+int64_t SV_ProfileBegin( void ) {
+	return SV_ProfileTicks();
+}
+
+void SV_ProfileEnd( svProfPhase_t phase, int64_t start ) {
+	svp_phases[phase].frameTicks += SV_ProfileTicks() - start;
+	svp_phases[phase].frameCalls++;
+}
+
+/*
+==================
+SV_ProfileFrame
+
+Closes the frame, called once a server frame has been run
+==================
+*/
+void SV_ProfileFrame( void ) {
+	svProfData_t   *p;
+	int i;
+
+	if ( !svp_startUsec ) {
+		svp_startTicks = SV_ProfileTicks();
+		svp_startUsec = Sys_Microseconds();
+	}
+
+	for ( i = 0, p = svp_phases ; i < SVP_NUM_PHASES ; i++, p++ ) {
+		p->window[svp_frames & ( SVP_WINDOW - 1 )] = p->frameTicks;
+		if ( p->frameTicks > p->maxTicks ) {
+			p->maxTicks = p->frameTicks;
+		}
+		p->totalTicks += p->frameTicks;
+		p->totalCalls += p->frameCalls;
+		p->frameTicks = 0;
+		p->frameCalls = 0;
+	}
+	svp_frames++;
+}
+
+void SV_ProfileReset( void ) {
+	svProfData_t   *p;
+	int i;
+
+	for ( i = 0, p = svp_phases ; i < SVP_NUM_PHASES ; i++, p++ ) {
+		p->maxTicks = 0;
+		p->totalTicks = 0;
+		p->totalCalls = 0;
+	}
+	svp_frames = 0;
+}
+
+/*
+==================
+SV_ProfileUsecPerTick
+
+The counter rate is measured against the system clock over everything
+that has run since the first frame
+==================
+*/
+static double SV_ProfileUsecPerTick( void ) {
+	int64_t ticks, usec;
+
+	ticks = SV_ProfileTicks() - svp_startTicks;
+	usec = Sys_Microseconds() - svp_startUsec;
+	if ( ticks <= 0 || usec <= 0 ) {
+		return 1.0;
+	}
+	return (double)usec / (double)ticks;
+}
+
+static int SV_ProfileCompare( const void *a, const void *b ) {
+	int64_t d = *(const int64_t *)a - *(const int64_t *)b;
+
+	return d < 0 ? -1 : d > 0;
+}
+
+typedef struct {
+	int frames;
+	double p50, p99, max;           // over the window, in usec
+	double mean, worst;             // since the last reset
+	double callsPerFrame;
+	int buckets[SVP_BUCKETS];
+} svProfStats_t;
+
+static void SV_ProfileStats( const svProfData_t *p, double usecPerTick, svProfStats_t *st ) {
+	static int64_t sorted[SVP_WINDOW];
+	int i, b, n;
+	double usec;
+
+	memset( st, 0, sizeof( *st ) );
+	n = svp_frames < SVP_WINDOW ? svp_frames : SVP_WINDOW;
+	st->frames = n;
+	if ( !n ) {
+		return;
+	}
+
+	memcpy( sorted, p->window, n * sizeof( sorted[0] ) );
+	qsort( sorted, n, sizeof( sorted[0] ), SV_ProfileCompare );
+
+	st->p50 = sorted[n / 2] * usecPerTick;
+	st->p99 = sorted[( n * 99 ) / 100] * usecPerTick;
+	st->max = sorted[n - 1] * usecPerTick;
+	st->mean = (double)p->totalTicks / svp_frames * usecPerTick;
+	st->worst = p->maxTicks * usecPerTick;
+	st->callsPerFrame = (double)p->totalCalls / svp_frames;
+
+	for ( i = 0 ; i < n ; i++ ) {
+		usec = sorted[i] * usecPerTick;
+		for ( b = 0 ; b < SVP_BUCKETS - 1 && usec >= ( 1 << b ) ; b++ ) {
+		}
+		st->buckets[b]++;
+	}
+}
+
+static int SV_ProfileDepth( int phase ) {
+	int depth;
+
+	for ( depth = 0 ; svp_phases[phase].parent >= 0 ; depth++ ) {
+		phase = svp_phases[phase].parent;
+	}
+	return depth;
+}
+
+/*
+==================
+SV_ProfileClientCount
+==================
+*/
+static int SV_ProfileClientCount( void ) {
+	int i, count;
+
+	if ( !svs.clients ) {
+		return 0;
+	}
+	for ( i = 0, count = 0 ; i < sv_maxclients->integer ; i++ ) {
+		if ( svs.clients[i].state >= CS_CONNECTED ) {
+			count++;
+		}
+	}
+	return count;
+}
+
+/*
+==================
+SV_ProfileWriteJSON
+==================
+*/
+static void SV_ProfileWriteJSON( const char *filename, double usecPerTick ) {
+	svProfStats_t st;
+	const char  *gamedir;
+	char        *ospath;
+	FILE        *f;
+	int i, b;
+
+	// make absolutely sure that it can't back up the path
+	if ( strstr( filename, ".." ) || strstr( filename, "::" ) ) {
+		Com_Printf( "WARNING: refusing to create relative path \"%s\"\n", filename );
+		return;
+	}
+
+	gamedir = Cvar_VariableString( "fs_game" );
+	ospath = FS_BuildOSPath( Cvar_VariableString( "fs_homepath" ), gamedir[0] ? gamedir : BASEGAME, filename );
+	f = fopen( ospath, "w" );
+	if ( !f ) {
+		Com_Printf( "Couldn't write %s\n", ospath );
+		return;
+	}
+
+	JSONW_BeginFile( f );
+	JSONW_StringValue( "version", "%s", Cvar_VariableString( "version" ) );
+	JSONW_StringValue( "map", "%s", sv_mapname->string );
+	JSONW_NumberValue( "sv_fps", sv_fps->integer );
+	JSONW_NumberValue( "clients", SV_ProfileClientCount() );
+	JSONW_NumberValue( "frames", svp_frames );
+	JSONW_BeginNamedArray( "phases" );
+	for ( i = 0 ; i < SVP_NUM_PHASES ; i++ ) {
+		SV_ProfileStats( &svp_phases[i], usecPerTick, &st );
+		JSONW_BeginObject();
+		JSONW_StringValue( "name", "%s", svp_phases[i].name );
+		if ( svp_phases[i].parent >= 0 ) {
+			JSONW_StringValue( "parent", "%s", svp_phases[svp_phases[i].parent].name );
+		}
+		JSONW_NumberValue( "p50_usec", st.p50 );
+		JSONW_NumberValue( "p99_usec", st.p99 );
+		JSONW_NumberValue( "max_usec", st.max );
+		JSONW_NumberValue( "mean_usec", st.mean );
+		JSONW_NumberValue( "worst_usec", st.worst );
+		JSONW_NumberValue( "calls_per_frame", st.callsPerFrame );
+		// bucket b counts frames under 2^b usec, above the previous one
+		JSONW_BeginNamedArray( "histogram" );
+		for ( b = 0 ; b < SVP_BUCKETS ; b++ ) {
+			JSONW_UnnamedNumber( st.buckets[b] );
+		}
+		JSONW_EndArray();
+		JSONW_EndObject();
+	}
+	JSONW_EndArray();
+	JSONW_EndFile();
+
+	fclose( f );
+	Com_Printf( "Wrote %s\n", ospath );
+}
+
+/*
+==================
+SV_Profile_f
+
+sv_profile [reset | json [filename]]
+==================
+*/
+void SV_Profile_f( void ) {
+	svProfStats_t st;
+	double usecPerTick;
+	char filename[MAX_QPATH];
+	int i;
+
+	if ( !Q_stricmp( Cmd_Argv( 1 ), "reset" ) ) {
+		SV_ProfileReset();
+		Com_Printf( "Server profile reset.\n" );
+		return;
+	}
+
+	if ( !svp_frames ) {
+		Com_Printf( "No server frames profiled.\n" );
+		return;
+	}
+
+	usecPerTick = SV_ProfileUsecPerTick();
+
+	if ( !Q_stricmp( Cmd_Argv( 1 ), "json" ) ) {
+		if ( Cmd_Argc() > 2 ) {
+			Q_strncpyz( filename, Cmd_Argv( 2 ), sizeof( filename ) );
+			COM_DefaultExtension( filename, sizeof( filename ), ".json" );
+		} else {
+			Q_strncpyz( filename, "sv_profile.json", sizeof( filename ) );
+		}
+		SV_ProfileWriteJSON( filename, usecPerTick );
+		return;
+	}
+
+	Com_Printf( "%i frames, last %i, %i clients, usec per frame\n",
+				svp_frames, svp_frames < SVP_WINDOW ? svp_frames : SVP_WINDOW, SV_ProfileClientCount() );
+	Com_Printf( "phase                  p50      p99      max     mean    calls\n" );
+	for ( i = 0 ; i < SVP_NUM_PHASES ; i++ ) {
+		SV_ProfileStats( &svp_phases[i], usecPerTick, &st );
+		Com_Printf( "%*s%-*s %8.0f %8.0f %8.0f %8.0f %8.1f\n",
+					SV_ProfileDepth( i ) * 2, "", 18 - SV_ProfileDepth( i ) * 2, svp_phases[i].name,
+					st.p50, st.p99, st.max, st.mean, st.callsPerFrame );
+	}
+}
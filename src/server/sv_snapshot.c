@@ -28,6 +28,7 @@ If you have questions concerning this license or the applicable additional terms
 
 
 #include "server.h"
+#include "../qcommon/threads.h"
 
 
 /*
@@ -52,6 +53,196 @@ A normal server packet will look like:
 =============================================================================
 */
 
+/*
+=============================================================================
+
+Delta cache
+
+Clients that get the same entity delta compressed from the same state
+would all get the same bits, so during SV_SendClientMessages every
+encoding is kept and copied into the next message that needs it instead
+of comparing the fields and running the huffman coder again.  The new
+states are mostly the same for everyone within a frame, but an entity
+held back for a client keeps the state that client already has, so an
+entry is keyed on the entity number and both states, and lives for one
+frame only.
+
+Snapshot workers share the cache, an entry is claimed with a compare and
+exchange on its stamp and published once it is complete.
+
+=============================================================================
+*/
+
+#define DELTA_CACHE_WAYS    4                   // different from states per entity
+#define DELTA_CACHE_DATA    ( 1024 * 1024 )     // encoded bytes per frame
+#define MAX_DELTA_BYTES     1024                // anything bigger isn't cached
+
+typedef struct {
+	volatile int stamp;                 // ( frame << 1 ) | 1 once the entry can be used
+	unsigned hash;
+	qboolean force;
+	int offset;                         // into deltaCache.data
+	int numBits;
+	int uncompBits;
+	entityState_t from;
+	entityState_t to;
+} deltaCacheEntry_t;
+
+typedef struct {
+	qboolean active;                    // only while sending the frame's snapshots
+	int frame;
+	volatile int used;                  // bytes of data handed out this frame
+	deltaCacheEntry_t   *entries;       // MAX_GENTITIES * DELTA_CACHE_WAYS
+	byte                *data;
+} deltaCache_t;
+
+static deltaCache_t deltaCache;
+
+/*
+=======================
+SV_BeginDeltaCache
+=======================
+*/
+static void SV_BeginDeltaCache( qboolean enable ) {
+	deltaCache.active = qfalse;
+	if ( !enable ) {
+		return;
+	}
+
+	if ( !deltaCache.entries ) {
+		// like svs.clients, keep these large blocks out of the zone
+		deltaCache.entries = calloc( MAX_GENTITIES * DELTA_CACHE_WAYS, sizeof( deltaCacheEntry_t ) );
+		deltaCache.data = malloc( DELTA_CACHE_DATA );
+		if ( !deltaCache.entries || !deltaCache.data ) {
+			Com_Error( ERR_FATAL, "SV_BeginDeltaCache: couldn't allocate the delta cache" );
+		}
+	}
+
+	// stale entries never match the new frame, 0 is left for released entries
+	deltaCache.frame = ( deltaCache.frame + 1 ) & 0x3fffffff;
+	if ( !deltaCache.frame ) {
+		deltaCache.frame = 1;
+	}
+	deltaCache.used = 0;
+	deltaCache.active = qtrue;
+}
+
+/*
+=======================
+SV_EndDeltaCache
+=======================
+*/
+static void SV_EndDeltaCache( void ) {
+	deltaCache.active = qfalse;
+}
+
+/*
+=======================
+SV_FreeDeltaCache
+=======================
+*/
+void SV_FreeDeltaCache( void ) {
+	if ( deltaCache.entries ) {
+		free( deltaCache.entries );
+	}
+	if ( deltaCache.data ) {
+		free( deltaCache.data );
+	}
+	Com_Memset( &deltaCache, 0, sizeof( deltaCache ) );
+}
+
+/*
+=======================
+SV_HashEntityState
+=======================
+*/
+static unsigned SV_HashEntityState( const entityState_t *s ) {
+	const int   *p;
+	unsigned hash;
+	int i;
+
+	p = (const int *)s;
+	hash = 0;
+	for ( i = 0 ; i < sizeof( *s ) / sizeof( int ) ; i++ ) {
+		hash = ( hash ^ p[i] ) * 16777619;
+	}
+
+	return hash;
+}
+
+/*
+=======================
+SV_WriteDeltaEntity
+
+MSG_WriteDeltaEntity through the delta cache
+=======================
+*/
+static void SV_WriteDeltaEntity( msg_t *msg, entityState_t *from, entityState_t *to, qboolean force ) {
+	deltaCacheEntry_t   *entry;
+	unsigned hash;
+	int stamp, ready;
+	int offset, bytes;
+	msg_t scratch;
+	byte scratchBuf[MAX_DELTA_BYTES];
+
+	// removals are only a few bits anyway
+	if ( !deltaCache.active || !from || !to ) {
+		MSG_WriteDeltaEntity( msg, from, to, force );
+		return;
+	}
+
+	hash = SV_HashEntityState( from ) ^ ( SV_HashEntityState( to ) * 0x9e3779b1 );
+	entry = &deltaCache.entries[to->number * DELTA_CACHE_WAYS + ( hash & ( DELTA_CACHE_WAYS - 1 ) )];
+	ready = ( deltaCache.frame << 1 ) | 1;
+
+	stamp = entry->stamp;
+	if ( stamp == ready ) {
+		Threads_MemoryBarrier();
+		if ( entry->hash == hash && entry->force == force && !memcmp( &entry->from, from, sizeof( *from ) )
+			 && !memcmp( &entry->to, to, sizeof( *to ) ) ) {
+			MSG_WriteBitString( msg, deltaCache.data + entry->offset, entry->numBits, entry->uncompBits );
+			return;
+		}
+	}
+
+	// still being written, or the slot is taken by different states
+	if ( ( stamp >> 1 ) == deltaCache.frame
+		 || !Threads_CompareExchange( &entry->stamp, stamp, deltaCache.frame << 1 ) ) {
+		MSG_WriteDeltaEntity( msg, from, to, force );
+		return;
+	}
+
+	MSG_Init( &scratch, scratchBuf, sizeof( scratchBuf ) );
+	scratch.allowoverflow = qtrue;
+	MSG_WriteDeltaEntity( &scratch, from, to, force );
+
+	bytes = ( scratch.bit + 7 ) >> 3;
+	if ( scratch.overflowed ) {
+		entry->stamp = 0;
+		MSG_WriteDeltaEntity( msg, from, to, force );
+		return;
+	}
+
+	offset = Threads_AtomicAdd( &deltaCache.used, bytes );
+	if ( offset + bytes <= DELTA_CACHE_DATA ) {
+		Com_Memcpy( deltaCache.data + offset, scratchBuf, bytes );
+		entry->hash = hash;
+		entry->force = force;
+		entry->offset = offset;
+		entry->numBits = scratch.bit;
+		entry->uncompBits = scratch.uncompsize;
+		entry->from = *from;
+		entry->to = *to;
+		Threads_MemoryBarrier();
+		entry->stamp = ready;
+	} else {
+		entry->stamp = 0;
+	}
+
+	MSG_WriteBitString( msg, scratchBuf, scratch.bit, scratch.uncompsize );
+}
+
+
 /*
 =============
 SV_EmitPacketEntities
@@ -95,7 +286,7 @@ static void SV_EmitPacketEntities( clientSnapshot_t *from, clientSnapshot_t *to,
 			// delta update from old position
 			// because the force parm is qfalse, this will not result
 			// in any bytes being emited if the entity has not changed at all
-			MSG_WriteDeltaEntity( msg, oldent, newent, qfalse );
+			SV_WriteDeltaEntity( msg, oldent, newent, qfalse );
 			oldindex++;
 			newindex++;
 			continue;
@@ -103,14 +294,14 @@ static void SV_EmitPacketEntities( clientSnapshot_t *from, clientSnapshot_t *to,
 
 		if ( newnum < oldnum ) {
 			// this is a new entity, send it from the baseline
-			MSG_WriteDeltaEntity( msg, &sv.svEntities[newnum].baseline, newent, qtrue );
+			SV_WriteDeltaEntity( msg, &sv.svEntities[newnum].baseline, newent, qtrue );
 			newindex++;
 			continue;
 		}
 
 		if ( newnum > oldnum ) {
 			// the old entity isn't present in the new message
-			MSG_WriteDeltaEntity( msg, oldent, NULL, qtrue );
+			SV_WriteDeltaEntity( msg, oldent, NULL, qtrue );
 			oldindex++;
 			continue;
 		}
@@ -120,46 +311,363 @@ static void SV_EmitPacketEntities( clientSnapshot_t *from, clientSnapshot_t *to,
 }
 
 
+/*
+=============================================================================
+
+Snapshot scheduling
+
+With sv_snapshotPriority set, the entity updates of a snapshot have to fit
+a byte budget: sv_snapshotMTU, or less if that is more than the client's
+rate allows at its snapshot rate, so snapshots neither fragment nor get
+rate delayed.  An update that doesn't fit is held back by putting the
+state the client already has into the frame, which deltas to nothing,
+and it goes out with a later snapshot.  New entities can wait the same
+way, they are left out of the frame.
+
+Updates are picked by distance from the viewer, whether they are in front
+of it, and how long the client has been waiting on them.  Removals, events
+and anything held back for sv_snapshotMaxDefer msec always go out, even
+over the budget.
+
+=============================================================================
+*/
+
+#define SNAP_TAIL_BYTES     8           // end of entities, svc_EOF and slack
+#define SNAP_DIST_SCALE     512.0f      // distance at which priority halves
+#define SNAP_STALE_SCALE    50.0f       // msec of waiting that doubles priority
+
+static void SV_ClientViewOrigin( const playerState_t *ps, vec3_t org );
+
+typedef struct {
+	entityState_t   *ent;               // in the new frame
+	entityState_t   *oldent;            // NULL if the client doesn't have it yet
+	int bits;
+	float priority;
+} snapshotCandidate_t;
+
+#define HEADER_RATE_BYTES   48      // include our header, IP header, and some overhead
+
+/*
+=======================
+SV_ClientRate
+
+The rate the client gets, without the low watermark SV_RateMsec enforces
+=======================
+*/
+static int SV_ClientRate( client_t *client ) {
+	int rate;
+	int maxRate;
+
+	rate = client->rate;
+	// work on the appropriate max rate (client or download)
+	if ( !*client->downloadName ) {
+		maxRate = sv_maxRate->integer;
+	} else
+	{
+		maxRate = sv_dl_maxRate->integer;
+	}
+	if ( maxRate ) {
+		if ( maxRate < rate ) {
+			rate = maxRate;
+		}
+	}
+	return rate;
+}
+
+/*
+=======================
+SV_ClientUnrated
+
+Local clients get snapshots every frame, whatever their rate
+=======================
+*/
+static qboolean SV_ClientUnrated( client_t *client ) {
+	// TTimo - show_bug.cgi?id=491
+	// added sv_lanForceRate check
+	return client->netchan.remoteAddress.type == NA_LOOPBACK
+		   || ( sv_lanForceRate->integer && Sys_IsLANAddress( client->netchan.remoteAddress ) );
+}
+
+/*
+=======================
+SV_SnapshotMTU
+
+The longest snapshot message that is sent unfragmented
+=======================
+*/
+static int SV_SnapshotMTU( void ) {
+	if ( sv_snapshotMTU->integer <= 0 || sv_snapshotMTU->integer >= FRAGMENT_SIZE ) {
+		return FRAGMENT_SIZE - 1;
+	}
+	return sv_snapshotMTU->integer;
+}
+
+/*
+=======================
+SV_SnapshotBudget
+
+Bits the entities of a snapshot get after what is already in the message
+=======================
+*/
+static int SV_SnapshotBudget( client_t *client, msg_t *msg ) {
+	int bytes, rateBytes;
+
+	bytes = SV_SnapshotMTU();
+
+	if ( !SV_ClientUnrated( client ) && client->snapshotMsec > 0 ) {
+		rateBytes = SV_ClientRate( client ) * client->snapshotMsec / 1000 - HEADER_RATE_BYTES;
+		if ( rateBytes < bytes ) {
+			bytes = rateBytes;
+		}
+	}
+
+	bytes -= msg->cursize + SNAP_TAIL_BYTES;
+	return bytes > 0 ? bytes * 8 : 0;
+}
+
+/*
+=======================
+SV_DeltaEntityBits
+
+What SV_WriteDeltaEntity will take, through the delta cache so the
+real write is only a copy
+=======================
+*/
+static int SV_DeltaEntityBits( entityState_t *from, entityState_t *to, qboolean force ) {
+	msg_t scratch;
+	byte scratchBuf[MAX_DELTA_BYTES];
+
+	MSG_Init( &scratch, scratchBuf, sizeof( scratchBuf ) );
+	scratch.allowoverflow = qtrue;
+	SV_WriteDeltaEntity( &scratch, from, to, force );
+	if ( scratch.overflowed ) {
+		return MAX_DELTA_BYTES * 8;
+	}
+	return scratch.bit;
+}
+
+/*
+=======================
+SV_EntityPriority
+=======================
+*/
+static float SV_EntityPriority( const entityState_t *ent, const vec3_t org, const vec3_t forward, int stale ) {
+	sharedEntity_t  *gEnt;
+	vec3_t center, dir;
+	float priority;
+
+	gEnt = SV_GentityNum( ent->number );
+	VectorAdd( gEnt->r.absmin, gEnt->r.absmax, center );
+	VectorScale( center, 0.5f, center );
+	VectorSubtract( center, org, dir );
+
+	priority = 1.0f / ( 1.0f + VectorNormalize( dir ) / SNAP_DIST_SCALE );
+
+	// in front of the viewer
+	if ( DotProduct( dir, forward ) > 0 ) {
+		priority *= 2.0f;
+	}
+	// broadcast entities are sent whether they can be seen or not
+	if ( gEnt->r.svFlags & SVF_BROADCAST ) {
+		priority *= 0.5f;
+	}
+	if ( ent->number < MAX_CLIENTS ) {
+		priority *= 2.0f;
+	}
+
+	return priority * ( 1.0f + stale / SNAP_STALE_SCALE );
+}
+
+static int QDECL SV_CompareCandidates( const void *a, const void *b ) {
+	float pa = ( (const snapshotCandidate_t *)a )->priority;
+	float pb = ( (const snapshotCandidate_t *)b )->priority;
+
+	return pa < pb ? 1 : pa > pb ? -1 : 0;
+}
+
+/*
+=======================
+SV_ScheduleSnapshotEntities
+
+Holds back the entity updates of the new frame that don't fit the budget.
+Walks the two frames the same way SV_EmitPacketEntities does.
+=======================
+*/
+static void SV_ScheduleSnapshotEntities( client_t *client, clientSnapshot_t *oldframe, clientSnapshot_t *frame, msg_t *msg ) {
+	snapshotCandidate_t candidates[MAX_GENTITIES];
+	snapshotCandidate_t *c;
+	byte dropped[MAX_GENTITIES];
+	entityState_t   *oldent, *newent;
+	int oldindex, newindex;
+	int oldnum, newnum;
+	int from_num_entities;
+	int numCandidates, budget, maxDefer, stale;
+	int i, j, sent, deferred;
+	vec3_t org, forward;
+
+	from_num_entities = oldframe ? oldframe->num_entities : 0;
+	budget = SV_SnapshotBudget( client, msg );
+	maxDefer = sv_snapshotMaxDefer->integer;
+	sent = 0;
+	deferred = 0;
+
+	SV_ClientViewOrigin( &frame->ps, org );
+	AngleVectors( frame->ps.viewangles, forward, NULL, NULL );
+
+	numCandidates = 0;
+	newent = NULL;
+	oldent = NULL;
+	newindex = 0;
+	oldindex = 0;
+	while ( newindex < frame->num_entities || oldindex < from_num_entities ) {
+		if ( newindex >= frame->num_entities ) {
+			newnum = 9999;
+		} else {
+			newent = &svs.snapshotEntities[( frame->first_entity + newindex ) % svs.numSnapshotEntities];
+			newnum = newent->number;
+		}
+
+		if ( oldindex >= from_num_entities ) {
+			oldnum = 9999;
+		} else {
+			oldent = &svs.snapshotEntities[( oldframe->first_entity + oldindex ) % svs.numSnapshotEntities];
+			oldnum = oldent->number;
+		}
+
+		if ( newnum > oldnum ) {
+			// removals are a few bits and always go
+			budget -= SV_DeltaEntityBits( oldent, NULL, qtrue );
+			client->entityHeldSince[oldnum] = 0;
+			oldindex++;
+			continue;
+		}
+
+		c = &candidates[numCandidates];
+		c->ent = newent;
+		if ( newnum == oldnum ) {
+			oldindex++;
+			newindex++;
+			if ( !memcmp( oldent, newent, sizeof( *newent ) ) ) {
+				client->entityHeldSince[newnum] = 0;
+				continue;
+			}
+			c->oldent = oldent;
+			c->bits = SV_DeltaEntityBits( oldent, newent, qfalse );
+		} else {
+			newindex++;
+			c->oldent = NULL;
+			c->bits = SV_DeltaEntityBits( &sv.svEntities[newnum].baseline, newent, qtrue );
+		}
+
+		stale = client->entityHeldSince[newnum] ? svs.time - client->entityHeldSince[newnum] : 0;
+
+		// events don't wait, they only stay on an entity for a short while
+		if ( newent->eType >= ET_EVENTS || stale >= maxDefer
+			 || ( c->oldent && ( newent->event != oldent->event || newent->eventSequence != oldent->eventSequence ) ) ) {
+			budget -= c->bits;
+			client->entityHeldSince[newnum] = 0;
+			sent++;
+			continue;
+		}
+
+		c->priority = SV_EntityPriority( newent, org, forward, stale );
+		numCandidates++;
+	}
+
+	qsort( candidates, numCandidates, sizeof( candidates[0] ), SV_CompareCandidates );
+
+	memset( dropped, 0, sizeof( dropped ) );
+	for ( i = 0, c = candidates ; i < numCandidates ; i++, c++ ) {
+		// something smaller further down may still fit
+		if ( c->bits <= budget ) {
+			budget -= c->bits;
+			client->entityHeldSince[c->ent->number] = 0;
+			sent++;
+			continue;
+		}
+
+		if ( !client->entityHeldSince[c->ent->number] ) {
+			client->entityHeldSince[c->ent->number] = svs.time;
+		}
+		if ( c->oldent ) {
+			*c->ent = *c->oldent;
+		} else {
+			dropped[c->ent->number] = 1;
+		}
+		deferred++;
+	}
+
+	// take the new entities that wait out of the frame
+	if ( deferred ) {
+		for ( i = 0, j = 0 ; i < frame->num_entities ; i++ ) {
+			newent = &svs.snapshotEntities[( frame->first_entity + i ) % svs.numSnapshotEntities];
+			if ( dropped[newent->number] ) {
+				continue;
+			}
+			if ( j != i ) {
+				svs.snapshotEntities[( frame->first_entity + j ) % svs.numSnapshotEntities] = *newent;
+			}
+			j++;
+		}
+		frame->num_entities = j;
+	}
+
+	client->snapshotStats.updates += sent;
+	client->snapshotStats.deferred += deferred;
+}
+
+
+
 
 /*
 ==================
-SV_WriteSnapshotToClient
+SV_SnapshotDeltaFrame
+
+Picks the previous frame the new snapshot will be delta compressed
+against, or NULL if the client has to get a full snapshot
 ==================
 */
-static void SV_WriteSnapshotToClient( client_t *client, msg_t *msg ) {
-	clientSnapshot_t    *frame, *oldframe;
-	int lastframe;
-	int i;
-	int snapFlags;
-
-	// this is the snapshot we are creating
-	frame = &client->frames[ client->netchan.outgoingSequence & PACKET_MASK ];
+static clientSnapshot_t *SV_SnapshotDeltaFrame( client_t *client, int *lastframe ) {
+	clientSnapshot_t    *oldframe;
 
 	// try to use a previous frame as the source for delta compressing the snapshot
 	if ( client->deltaMessage <= 0 || client->state != CS_ACTIVE ) {
 		// client is asking for a retransmit
 		oldframe = NULL;
-		lastframe = 0;
+		*lastframe = 0;
 	} else if ( client->netchan.outgoingSequence - client->deltaMessage
 				>= ( PACKET_BACKUP - 3 ) ) {
 		// client hasn't gotten a good message through in a long time
 		Com_DPrintf( "%s: Delta request from out of date packet.\n", client->name );
 		oldframe = NULL;
-		lastframe = 0;
+		*lastframe = 0;
 	} else {
 		// we have a valid snapshot to delta from
 		oldframe = &client->frames[ client->deltaMessage & PACKET_MASK ];
-		lastframe = client->netchan.outgoingSequence - client->deltaMessage;
+		*lastframe = client->netchan.outgoingSequence - client->deltaMessage;
 
 		// the snapshot's entities may still have rolled off the buffer, though
 		if ( oldframe->first_entity <= svs.nextSnapshotEntities - svs.numSnapshotEntities ) {
 			Com_DPrintf( "%s: Delta request from out of date entities.\n", client->name );
 			oldframe = NULL;
-			lastframe = 0;
+			*lastframe = 0;
 		}
 	}
 
-	MSG_WriteByte( msg, svc_snapshot );
+	return oldframe;
+}
+
+
+/*
+==================
+SV_WriteSnapshotHeader
+
+Everything in a snapshot up to the entities
+==================
+*/
+static void SV_WriteSnapshotHeader( client_t *client, clientSnapshot_t *oldframe, clientSnapshot_t *frame,
+									int lastframe, msg_t *msg ) {
+	int snapFlags;
 
 	// NOTE, MRE: now sent at the start of every message from server to client
 	// let the client know which reliable clientCommands we have received
@@ -192,12 +700,38 @@ static void SV_WriteSnapshotToClient( client_t *client, msg_t *msg ) {
 	} else {
 		MSG_WriteDeltaPlayerstate( msg, NULL, &frame->ps );
 	}
+}
 
-	// delta encode the entities
-	SV_EmitPacketEntities( oldframe, frame, msg );
 
-	// padding for rate debugging
-	if ( sv_padPackets->integer ) {
+/*
+==================
+SV_WriteSnapshotFrame
+
+Doesn't touch anything but the client and the message,
+so it is safe to call from the snapshot workers
+==================
+*/
+static void SV_WriteSnapshotFrame( client_t *client, clientSnapshot_t *oldframe, int lastframe, msg_t *msg ) {
+	clientSnapshot_t    *frame;
+	int i;
+
+	// this is the snapshot we are creating
+	frame = &client->frames[ client->netchan.outgoingSequence & PACKET_MASK ];
+	frame->deltaMessage = oldframe ? client->netchan.outgoingSequence - lastframe : -1;
+
+	MSG_WriteByte( msg, svc_snapshot );
+	SV_WriteSnapshotHeader( client, oldframe, frame, lastframe, msg );
+
+	// hold back what doesn't fit
+	if ( sv_snapshotPriority->integer && client->state == CS_ACTIVE ) {
+		SV_ScheduleSnapshotEntities( client, oldframe, frame, msg );
+	}
+
+	// delta encode the entities
+	SV_EmitPacketEntities( oldframe, frame, msg );
+
+	// padding for rate debugging
+	if ( sv_padPackets->integer ) {
 		for ( i = 0 ; i < sv_padPackets->integer ; i++ ) {
 			MSG_WriteByte( msg, svc_nop );
 		}
@@ -205,6 +739,20 @@ static void SV_WriteSnapshotToClient( client_t *client, msg_t *msg ) {
 }
 
 
+/*
+==================
+SV_WriteSnapshotToClient
+==================
+*/
+static clientSnapshot_t *SV_WriteSnapshotToClient( client_t *client, int *lastframe, msg_t *msg ) {
+	clientSnapshot_t    *oldframe;
+
+	oldframe = SV_SnapshotDeltaFrame( client, lastframe );
+	SV_WriteSnapshotFrame( client, oldframe, *lastframe, msg );
+	return oldframe;
+}
+
+
 /*
 ==================
 SV_UpdateServerCommandsToClient
@@ -238,8 +786,13 @@ Build a client snapshot structure
 typedef struct {
 	int numSnapshotEntities;
 	int snapshotEntities[MAX_SNAPSHOT_ENTITIES];
+	byte added[MAX_GENTITIES / 8];          // prevents double adding from portal views
+	const char  *error;                     // for the main thread to Com_Error with, NULL if none
 } snapshotEntityNumbers_t;
 
+#define SNAPSHOT_HAS_ENTITY( eNums, num ) ( ( eNums )->added[( num ) >> 3] & ( 1 << ( ( num ) & 7 ) ) )
+#define SNAPSHOT_MARK_ENTITY( eNums, num ) ( ( eNums )->added[( num ) >> 3] |= ( 1 << ( ( num ) & 7 ) ) )
+
 /*
 =======================
 SV_QsortEntityNumbers
@@ -252,7 +805,7 @@ static int QDECL SV_QsortEntityNumbers( const void *a, const void *b ) {
 	eb = (int *)b;
 
 	if ( *ea == *eb ) {
-		Com_Error( ERR_DROP, "SV_QsortEntityStates: duplicated entity" );
+		return 0;       // SV_GatherClientSnapshot looks for these
 	}
 
 	if ( *ea < *eb ) {
@@ -262,6 +815,22 @@ static int QDECL SV_QsortEntityNumbers( const void *a, const void *b ) {
 	return 1;
 }
 
+/*
+===============
+SV_SnapshotSvEntity
+
+SV_SvEntityForGentity for the snapshot workers, which can't Com_Error.
+A bad entity is left in eNums->error and NULL returned.
+===============
+*/
+static svEntity_t *SV_SnapshotSvEntity( sharedEntity_t *gEnt, snapshotEntityNumbers_t *eNums ) {
+	if ( !gEnt || gEnt->s.number < 0 || gEnt->s.number >= MAX_GENTITIES ) {
+		eNums->error = "SV_SvEntityForGentity: bad gEnt";
+		return NULL;
+	}
+	return &sv.svEntities[ gEnt->s.number ];
+}
+
 
 /*
 ===============
@@ -270,10 +839,10 @@ SV_AddEntToSnapshot
 */
 static void SV_AddEntToSnapshot( svEntity_t *svEnt, sharedEntity_t *gEnt, snapshotEntityNumbers_t *eNums ) {
 	// if we have already added this entity to this snapshot, don't add again
-	if ( svEnt->snapshotCounter == sv.snapshotCounter ) {
+	if ( SNAPSHOT_HAS_ENTITY( eNums, gEnt->s.number ) ) {
 		return;
 	}
-	svEnt->snapshotCounter = sv.snapshotCounter;
+	SNAPSHOT_MARK_ENTITY( eNums, gEnt->s.number );
 
 	// if we are full, silently discard entities
 	if ( eNums->numSnapshotEntities == MAX_SNAPSHOT_ENTITIES ) {
@@ -284,6 +853,303 @@ static void SV_AddEntToSnapshot( svEntity_t *svEnt, sharedEntity_t *gEnt, snapsh
 	eNums->numSnapshotEntities++;
 }
 
+/*
+=============================================================================
+
+Visibility cache
+
+Every client standing in the same cluster and area gets the same answer
+from the PVS and area tests, so they are done once per viewpoint and kept
+in sv.visCache.  An entity is only tested again after it relinks, and an
+area portal change flushes the whole cache.
+
+An entry looked up this frame is never replaced, a caller may still hold
+it while portal recursion looks up other viewpoints.
+
+=============================================================================
+*/
+
+#define VIS_TEST( bits, num )   ( ( bits )[( num ) >> 3] & ( 1 << ( ( num ) & 7 ) ) )
+#define VIS_SET( bits, num )    ( ( bits )[( num ) >> 3] |= ( 1 << ( ( num ) & 7 ) ) )
+#define VIS_CLEAR( bits, num )  ( ( bits )[( num ) >> 3] &= ~( 1 << ( ( num ) & 7 ) ) )
+
+// set while the snapshot workers are gathering, lookups must not modify the cache
+static qboolean visCacheReadOnly;
+
+/*
+===============
+SV_EntityVisibleFrom
+
+PVS and area test of a single entity
+===============
+*/
+static qboolean SV_EntityVisibleFrom( svEntity_t *svEnt, int clientarea, byte *clientpvs ) {
+	int i, l;
+
+	// check area
+	if ( !CM_AreasConnected( clientarea, svEnt->areanum ) ) {
+		// doors can legally straddle two areas, so
+		// we may need to check another one
+		if ( !CM_AreasConnected( clientarea, svEnt->areanum2 ) ) {
+			return qfalse;
+		}
+	}
+
+	// check individual leafs
+	if ( !svEnt->numClusters ) {
+		return qfalse;
+	}
+	l = 0;
+	for ( i = 0 ; i < svEnt->numClusters ; i++ ) {
+		l = svEnt->clusternums[i];
+		if ( clientpvs[l >> 3] & ( 1 << ( l & 7 ) ) ) {
+			return qtrue;
+		}
+	}
+
+	// if we haven't found it to be visible,
+	// check overflow clusters that coudln't be stored
+	if ( svEnt->lastCluster ) {
+		for ( ; l <= svEnt->lastCluster ; l++ ) {
+			if ( clientpvs[l >> 3] & ( 1 << ( l & 7 ) ) ) {
+				break;
+			}
+		}
+		if ( l == svEnt->lastCluster ) {
+			return qfalse;    // not visible
+		}
+		return qtrue;
+	}
+
+	return qfalse;
+}
+
+/*
+===============
+SV_VisCacheFlush
+===============
+*/
+void SV_VisCacheFlush( void ) {
+	if ( sv.visCache.numEntries ) {
+		sv.visCache.flushes++;
+	}
+	sv.visCache.numEntries = 0;
+}
+
+/*
+===============
+SV_VisCacheRelink
+
+Called from SV_LinkEntity, the entity has to be tested again
+===============
+*/
+void SV_VisCacheRelink( int num ) {
+	int i;
+	visCacheEntry_t *vc;
+
+	for ( i = 0, vc = sv.visCache.entries ; i < sv.visCache.numEntries ; i++, vc++ ) {
+		if ( VIS_TEST( vc->tested, num ) ) {
+			VIS_CLEAR( vc->tested, num );
+			vc->stale = qtrue;
+		}
+	}
+}
+
+/*
+===============
+SV_VisCacheUpdate
+
+Tests every entity that hasn't been tested from this viewpoint yet,
+returns the number of tests done
+===============
+*/
+static int SV_VisCacheUpdate( visCacheEntry_t *vc ) {
+	int e;
+	int count;
+	byte *clientpvs;
+
+	clientpvs = CM_ClusterPVS( vc->cluster );
+
+	count = 0;
+	for ( e = 0 ; e < sv.num_entities ; e++ ) {
+		if ( VIS_TEST( vc->tested, e ) ) {
+			continue;
+		}
+		VIS_SET( vc->tested, e );
+		count++;
+
+		if ( SV_EntityVisibleFrom( &sv.svEntities[e], vc->area, clientpvs ) ) {
+			VIS_SET( vc->visible, e );
+		} else {
+			VIS_CLEAR( vc->visible, e );
+		}
+	}
+
+	vc->numEntities = sv.num_entities;
+	vc->stale = qfalse;
+
+	return count;
+}
+
+/*
+===============
+SV_VisCacheForView
+
+Returns the up to date cache entry for a viewpoint, or NULL if the
+entities have to be tested one by one
+===============
+*/
+static visCacheEntry_t *SV_VisCacheForView( int cluster, int area ) {
+	int i;
+	visCacheEntry_t *vc, *oldest;
+
+	if ( !sv_visCache->integer ) {
+		return NULL;
+	}
+
+	oldest = NULL;
+	for ( i = 0, vc = sv.visCache.entries ; i < sv.visCache.numEntries ; i++, vc++ ) {
+		if ( vc->cluster == cluster && vc->area == area ) {
+			break;
+		}
+		if ( !oldest || vc->lastUsed < oldest->lastUsed ) {
+			oldest = vc;
+		}
+	}
+
+	if ( i < sv.visCache.numEntries ) {
+		if ( vc->stale || vc->numEntities != sv.num_entities ) {
+			if ( visCacheReadOnly ) {
+				return NULL;
+			}
+			sv.visCache.retests += SV_VisCacheUpdate( vc );
+		}
+		if ( !visCacheReadOnly ) {
+			sv.visCache.hits++;
+			vc->lastUsed = svs.time;
+		}
+		return vc;
+	}
+
+	if ( visCacheReadOnly ) {
+		return NULL;
+	}
+
+	sv.visCache.misses++;
+
+	if ( sv.visCache.numEntries < MAX_VIS_CACHE ) {
+		vc = &sv.visCache.entries[sv.visCache.numEntries++];
+	} else if ( oldest->lastUsed != svs.time ) {
+		vc = oldest;
+	} else {
+		sv.visCache.full++;
+		return NULL;
+	}
+
+	memset( vc, 0, sizeof( *vc ) );
+	vc->cluster = cluster;
+	vc->area = area;
+	vc->lastUsed = svs.time;
+	SV_VisCacheUpdate( vc );
+
+	return vc;
+}
+
+/*
+===============
+SV_VisCache_f
+===============
+*/
+void SV_VisCache_f( void ) {
+	int lookups;
+
+	if ( Cmd_Argc() > 1 && !Q_stricmp( Cmd_Argv( 1 ), "reset" ) ) {
+		sv.visCache.hits = 0;
+		sv.visCache.misses = 0;
+		sv.visCache.retests = 0;
+		sv.visCache.flushes = 0;
+		sv.visCache.full = 0;
+		return;
+	}
+
+	lookups = sv.visCache.hits + sv.visCache.misses;
+
+	Com_Printf( "sv_visCache %s, %i of %i viewpoints cached\n", sv_visCache->integer ? "on" : "off",
+				sv.visCache.numEntries, MAX_VIS_CACHE );
+	Com_Printf( "%i hits, %i misses (%.1f%% hit)\n", sv.visCache.hits, sv.visCache.misses,
+				lookups ? 100.0f * sv.visCache.hits / lookups : 0.0f );
+	Com_Printf( "%i entity retests, %i flushes\n", sv.visCache.retests, sv.visCache.flushes );
+	Com_Printf( "%i lookups tested one by one with every entry in use\n", sv.visCache.full );
+}
+
+/*
+===============
+SV_SnapshotStats_f
+
+snapstats [reset]
+===============
+*/
+void SV_SnapshotStats_f( void ) {
+	snapshotStats_t *st;
+	client_t        *cl;
+	int i, msec, start;
+	int messages, fragmented, updates, deferred, split, parts;
+	int64_t bytes;
+
+	if ( !com_sv_running->integer ) {
+		Com_Printf( "Server is not running.\n" );
+		return;
+	}
+
+	if ( Cmd_Argc() > 1 && !Q_stricmp( Cmd_Argv( 1 ), "reset" ) ) {
+		for ( i = 0, cl = svs.clients ; i < sv_maxclients->integer ; i++, cl++ ) {
+			memset( &cl->snapshotStats, 0, sizeof( cl->snapshotStats ) );
+			cl->snapshotStats.time = svs.time;
+		}
+		Com_Printf( "snapshot stats reset\n" );
+		return;
+	}
+
+	Com_Printf( "sv_snapshotPriority %s, sv_snapshotParts %s, sv_snapshotMTU %i, fragments over %i bytes\n",
+				sv_snapshotPriority->integer ? "on" : "off", sv_snapshotParts->integer ? "on" : "off",
+				sv_snapshotMTU->integer, FRAGMENT_SIZE );
+	Com_Printf( "cl  rate  bytes/s msgs/s  avg  frag%%  held%% name\n" );
+	Com_Printf( "-- ----- -------- ------ ---- ------ ------ ---------------\n" );
+
+	messages = fragmented = updates = deferred = split = parts = 0;
+	bytes = 0;
+	for ( i = 0, cl = svs.clients ; i < sv_maxclients->integer ; i++, cl++ ) {
+		if ( cl->state < CS_CONNECTED || ( cl->gentity && cl->gentity->r.svFlags & SVF_BOT ) ) {
+			continue;
+		}
+		st = &cl->snapshotStats;
+		start = st->time > cl->lastConnectTime ? st->time : cl->lastConnectTime;
+		msec = svs.time - start;
+		if ( msec < 1 ) {
+			msec = 1;
+		}
+
+		Com_Printf( "%2i %5i %8i %6.1f %4i %5.1f%% %5.1f%% %s\n", i, SV_ClientRate( cl ),
+					(int)( st->bytes * 1000 / msec ), st->messages * 1000.0f / msec,
+					st->messages ? (int)( st->bytes / st->messages ) : 0,
+					st->messages ? 100.0f * st->fragmented / st->messages : 0.0f,
+					st->updates + st->deferred ? 100.0f * st->deferred / ( st->updates + st->deferred ) : 0.0f,
+					cl->name );
+
+		messages += st->messages;
+		fragmented += st->fragmented;
+		updates += st->updates;
+		deferred += st->deferred;
+		split += st->split;
+		parts += st->parts;
+		bytes += st->bytes;
+	}
+
+	Com_Printf( "%i messages, %i fragmented, %i bytes\n", messages, fragmented, (int)bytes );
+	Com_Printf( "%i snapshots split into %i svc_snapshotPart\n", split, parts );
+	Com_Printf( "%i entity updates sent, %i held back\n", updates, deferred );
+}
+
 /*
 ===============
 SV_AddEntitiesVisibleFromPoint
@@ -293,14 +1159,13 @@ static void SV_AddEntitiesVisibleFromPoint( vec3_t origin, clientSnapshot_t *fra
 //									snapshotEntityNumbers_t *eNums, qboolean portal, clientSnapshot_t *oldframe, qboolean localClient ) {
 //									snapshotEntityNumbers_t *eNums, qboolean portal ) {
 											snapshotEntityNumbers_t *eNums, qboolean portal, qboolean localClient  ) {
-	int e, i;
+	int e;
 	sharedEntity_t *ent, *playerEnt;
 	svEntity_t  *svEnt;
-	int l;
 	int clientarea, clientcluster;
 	int leafnum;
 	byte    *clientpvs;
-	byte    *bitvector;
+	visCacheEntry_t *vis;
 
 	// during an error shutdown message we may need to transmit
 	// the shutdown message after the server has shutdown, so
@@ -317,7 +1182,7 @@ static void SV_AddEntitiesVisibleFromPoint( vec3_t origin, clientSnapshot_t *fra
 	frame->areabytes = CM_WriteAreaBits( frame->areabits, clientarea );
 
 	clientpvs = CM_ClusterPVS( clientcluster );
-
+	vis = SV_VisCacheForView( clientcluster, clientarea );
 
 	playerEnt = SV_GentityNum( frame->ps.clientNum );
 
@@ -352,10 +1217,13 @@ static void SV_AddEntitiesVisibleFromPoint( vec3_t origin, clientSnapshot_t *fra
 			}
 		}
 
-		svEnt = SV_SvEntityForGentity( ent );
+		svEnt = SV_SnapshotSvEntity( ent, eNums );
+		if ( !svEnt ) {
+			continue;
+		}
 
 		// don't double add an entity through portals
-		if ( svEnt->snapshotCounter == sv.snapshotCounter ) {
+		if ( SNAPSHOT_HAS_ENTITY( eNums, e ) ) {
 			continue;
 		}
 
@@ -376,45 +1244,13 @@ static void SV_AddEntitiesVisibleFromPoint( vec3_t origin, clientSnapshot_t *fra
 		}
 
 		// ignore if not touching a PV leaf
-		// check area
-		if ( !CM_AreasConnected( clientarea, svEnt->areanum ) ) {
-			// doors can legally straddle two areas, so
-			// we may need to check another one
-			if ( !CM_AreasConnected( clientarea, svEnt->areanum2 ) ) {
+		if ( vis ) {
+			if ( !VIS_TEST( vis->visible, e ) ) {
 				continue;
 			}
-		}
-
-		bitvector = clientpvs;
-
-		// check individual leafs
-		if ( !svEnt->numClusters ) {
+		} else if ( !SV_EntityVisibleFrom( svEnt, clientarea, clientpvs ) ) {
 			continue;
 		}
-		l = 0;
-		for ( i = 0 ; i < svEnt->numClusters ; i++ ) {
-			l = svEnt->clusternums[i];
-			if ( bitvector[l >> 3] & ( 1 << ( l & 7 ) ) ) {
-				break;
-			}
-		}
-
-		// if we haven't found it to be visible,
-		// check overflow clusters that coudln't be stored
-		if ( i == svEnt->numClusters ) {
-			if ( svEnt->lastCluster ) {
-				for ( ; l <= svEnt->lastCluster ; l++ ) {
-					if ( bitvector[l >> 3] & ( 1 << ( l & 7 ) ) ) {
-						break;
-					}
-				}
-				if ( l == svEnt->lastCluster ) {
-					continue;    // not visible
-				}
-			} else {
-				continue;
-			}
-		}
 
 		//----(SA) added "visibility dummies"
 		if ( ent->r.svFlags & SVF_VISDUMMY ) {
@@ -425,9 +1261,9 @@ static void SV_AddEntitiesVisibleFromPoint( vec3_t origin, clientSnapshot_t *fra
 
 			if ( ment ) {
 				svEntity_t *master = 0;
-				master = SV_SvEntityForGentity( ment );
+				master = SV_SnapshotSvEntity( ment, eNums );
 
-				if ( master->snapshotCounter == sv.snapshotCounter || !ment->r.linked ) {
+				if ( !master || SNAPSHOT_HAS_ENTITY( eNums, ment->s.number ) || !ment->r.linked ) {
 					continue;
 					//continue;
 				}
@@ -453,11 +1289,15 @@ static void SV_AddEntitiesVisibleFromPoint( vec3_t origin, clientSnapshot_t *fra
 					}
 
 					if ( ment ) {
-						master = SV_SvEntityForGentity( ment );
+						master = SV_SnapshotSvEntity( ment, eNums );
 					} else {
 						continue;
 					}
 
+					if ( !master ) {
+						continue;
+					}
+
 					if ( !( ment->r.linked ) ) {
 						continue;
 					}
@@ -471,7 +1311,7 @@ static void SV_AddEntitiesVisibleFromPoint( vec3_t origin, clientSnapshot_t *fra
 						continue;
 					}
 
-					if ( master->snapshotCounter == sv.snapshotCounter ) {
+					if ( SNAPSHOT_HAS_ENTITY( eNums, h ) ) {
 						continue;
 					}
 
@@ -501,7 +1341,29 @@ static void SV_AddEntitiesVisibleFromPoint( vec3_t origin, clientSnapshot_t *fra
 
 /*
 =============
-SV_BuildClientSnapshot
+SV_ClientViewOrigin
+=============
+*/
+static void SV_ClientViewOrigin( const playerState_t *ps, vec3_t org ) {
+	// find the client's viewpoint
+	VectorCopy( ps->origin, org );
+	org[2] += ps->viewheight;
+
+//----(SA)	added for 'lean'
+	// need to account for lean, so areaportal doors draw properly
+	if ( ps->leanf != 0 ) {
+		vec3_t right, v3ViewAngles;
+		VectorCopy( ps->viewangles, v3ViewAngles );
+		v3ViewAngles[2] += ps->leanf / 2.0f;
+		AngleVectors( v3ViewAngles, NULL, right, NULL );
+		VectorMA( org, ps->leanf, right, org );
+	}
+//----(SA)	end
+}
+
+/*
+=============
+SV_GatherClientSnapshot
 
 Decides which entities are going to be visible to the client, and
 copies off the playerstate and areabits.
@@ -509,30 +1371,26 @@ copies off the playerstate and areabits.
 This properly handles multiple recursive portals, but the render
 currently doesn't.
 
-For viewing through other player's eyes, clent can be something other than client->gentity
+Only reads shared server state, so the snapshot workers can run
+it for several clients at once.  Errors are left in eNums->error for
+the caller to raise once it is back on the main thread.
 =============
 */
-static void SV_BuildClientSnapshot( client_t *client ) {
+static void SV_GatherClientSnapshot( client_t *client, snapshotEntityNumbers_t *eNums ) {
 	vec3_t org;
-//	clientSnapshot_t			*frame, *oldframe;
 	clientSnapshot_t            *frame;
-	snapshotEntityNumbers_t entityNumbers;
 	int i;
-	sharedEntity_t              *ent;
-	entityState_t               *state;
-	svEntity_t                  *svEnt;
 	sharedEntity_t              *clent;
 	int clientNum;
 	playerState_t               *ps;
 
-	// bump the counter used to prevent double adding
-	sv.snapshotCounter++;
-
 	// this is the frame we are creating
 	frame = &client->frames[ client->netchan.outgoingSequence & PACKET_MASK ];
 
 	// clear everything in this snapshot
-	entityNumbers.numSnapshotEntities = 0;
+	eNums->numSnapshotEntities = 0;
+	memset( eNums->added, 0, sizeof( eNums->added ) );
+	eNums->error = NULL;
 	memset( frame->areabits, 0, sizeof( frame->areabits ) );
 
 	// show_bug.cgi?id=62
@@ -551,133 +1409,169 @@ static void SV_BuildClientSnapshot( client_t *client ) {
 	// be regenerated from the playerstate
 	clientNum = frame->ps.clientNum;
 	if ( clientNum < 0 || clientNum >= MAX_GENTITIES ) {
-		Com_Error( ERR_DROP, "SV_SvEntityForGentity: bad gEnt" );
+		eNums->error = "SV_SvEntityForGentity: bad gEnt";
+		return;
 	}
-	svEnt = &sv.svEntities[ clientNum ];
-
-	svEnt->snapshotCounter = sv.snapshotCounter;
-
-	// find the client's viewpoint
-	VectorCopy( ps->origin, org );
-	org[2] += ps->viewheight;
+	SNAPSHOT_MARK_ENTITY( eNums, clientNum );
 
-//----(SA)	added for 'lean'
-	// need to account for lean, so areaportal doors draw properly
-	if ( frame->ps.leanf != 0 ) {
-		vec3_t right, v3ViewAngles;
-		VectorCopy( ps->viewangles, v3ViewAngles );
-		v3ViewAngles[2] += frame->ps.leanf / 2.0f;
-		AngleVectors( v3ViewAngles, NULL, right, NULL );
-		VectorMA( org, frame->ps.leanf, right, org );
-	}
-//----(SA)	end
+	SV_ClientViewOrigin( ps, org );
 
 	// add all the entities directly visible to the eye, which
 	// may include portal entities that merge other viewpoints
-	SV_AddEntitiesVisibleFromPoint( org, frame, &entityNumbers, qfalse, client->netchan.remoteAddress.type == NA_LOOPBACK );
+	SV_AddEntitiesVisibleFromPoint( org, frame, eNums, qfalse, client->netchan.remoteAddress.type == NA_LOOPBACK );
 
 	// if there were portals visible, there may be out of order entities
 	// in the list which will need to be resorted for the delta compression
 	// to work correctly.  This also catches the error condition
 	// of an entity being included twice.
-	qsort( entityNumbers.snapshotEntities, entityNumbers.numSnapshotEntities,
-		   sizeof( entityNumbers.snapshotEntities[0] ), SV_QsortEntityNumbers );
+	qsort( eNums->snapshotEntities, eNums->numSnapshotEntities,
+		   sizeof( eNums->snapshotEntities[0] ), SV_QsortEntityNumbers );
+	for ( i = 1 ; i < eNums->numSnapshotEntities ; i++ ) {
+		if ( eNums->snapshotEntities[i] == eNums->snapshotEntities[i - 1] ) {
+			eNums->error = "SV_QsortEntityStates: duplicated entity";
+			break;
+		}
+	}
 
 	// now that all viewpoint's areabits have been OR'd together, invert
 	// all of them to make it a mask vector, which is what the renderer wants
 	for ( i = 0 ; i < MAX_MAP_AREA_BYTES / 4 ; i++ ) {
 		( (int *)frame->areabits )[i] = ( (int *)frame->areabits )[i] ^ -1;
 	}
+}
 
-	// copy the entity states out
-	frame->num_entities = 0;
-	frame->first_entity = svs.nextSnapshotEntities;
-	for ( i = 0 ; i < entityNumbers.numSnapshotEntities ; i++ ) {
-		ent = SV_GentityNum( entityNumbers.snapshotEntities[i] );
-		state = &svs.snapshotEntities[svs.nextSnapshotEntities % svs.numSnapshotEntities];
-		*state = ent->s;
-		svs.nextSnapshotEntities++;
-		// this should never hit, map should always be restarted first in SV_Frame
-		if ( svs.nextSnapshotEntities >= 0x7FFFFFFE ) {
-			Com_Error( ERR_FATAL, "svs.nextSnapshotEntities wrapped" );
-		}
-		frame->num_entities++;
+/*
+=============
+SV_ReserveSnapshotEntities
+
+Claims count slots in svs.snapshotEntities and returns the first one
+=============
+*/
+static int SV_ReserveSnapshotEntities( int count ) {
+	int first;
+
+	first = svs.nextSnapshotEntities;
+	svs.nextSnapshotEntities += count;
+
+	// this should never hit, map should always be restarted first in SV_Frame
+	if ( svs.nextSnapshotEntities >= 0x7FFFFFFE ) {
+		Com_Error( ERR_FATAL, "svs.nextSnapshotEntities wrapped" );
 	}
-}
 
+	return first;
+}
 
 /*
-====================
-SV_RateMsec
+=============
+SV_CopySnapshotEntities
 
-Return the number of msec a given size message is supposed
-to take to clear, based on the current rate
-TTimo - use sv_maxRate or sv_dl_maxRate depending on regular or downloading client
-====================
+Copies the entity states out into slots already reserved with
+SV_ReserveSnapshotEntities
+=============
 */
-#define HEADER_RATE_BYTES   48      // include our header, IP header, and some overhead
-static int SV_RateMsec( client_t *client, int messageSize ) {
-	int rate;
-	int rateMsec;
-	int maxRate;
+static void SV_CopySnapshotEntities( clientSnapshot_t *frame, const snapshotEntityNumbers_t *eNums, int first ) {
+	int i;
+	sharedEntity_t              *ent;
 
-	// individual messages will never be larger than fragment size
-	if ( messageSize > 1500 ) {
-		messageSize = 1500;
-	}
-	// low watermark for sv_maxRate, never 0 < sv_maxRate < 1000 (0 is no limitation)
-	if ( sv_maxRate->integer && sv_maxRate->integer < 1000 ) {
-		Cvar_Set( "sv_MaxRate", "1000" );
+	frame->num_entities = eNums->numSnapshotEntities;
+	frame->first_entity = first;
+	for ( i = 0 ; i < eNums->numSnapshotEntities ; i++ ) {
+		ent = SV_GentityNum( eNums->snapshotEntities[i] );
+		svs.snapshotEntities[( first + i ) % svs.numSnapshotEntities] = ent->s;
 	}
-	rate = client->rate;
-	// work on the appropriate max rate (client or download)
-	if ( !*client->downloadName ) {
-		maxRate = sv_maxRate->integer;
-	} else
-	{
-		maxRate = sv_dl_maxRate->integer;
+}
+
+/*
+=============
+SV_BuildClientSnapshot
+
+For viewing through other player's eyes, clent can be something other than client->gentity
+=============
+*/
+static void SV_BuildClientSnapshot( client_t *client ) {
+	clientSnapshot_t            *frame;
+	snapshotEntityNumbers_t entityNumbers;
+	int first;
+
+	// this is the frame we are creating
+	frame = &client->frames[ client->netchan.outgoingSequence & PACKET_MASK ];
+
+	SV_GatherClientSnapshot( client, &entityNumbers );
+	if ( entityNumbers.error ) {
+		Com_Error( ERR_DROP, "%s", entityNumbers.error );
 	}
-	if ( maxRate ) {
-		if ( maxRate < rate ) {
-			rate = maxRate;
-		}
+
+	first = SV_ReserveSnapshotEntities( entityNumbers.numSnapshotEntities );
+	SV_CopySnapshotEntities( frame, &entityNumbers, first );
+}
+
+
+/*
+====================
+SV_RateMsec
+
+Return the number of msec a given size message is supposed
+to take to clear, based on the current rate
+TTimo - use sv_maxRate or sv_dl_maxRate depending on regular or downloading client
+====================
+*/
+static int SV_RateMsec( client_t *client, int messageSize ) {
+	int rateMsec;
+
+	// individual messages will never be larger than fragment size
+	if ( messageSize > 1500 ) {
+		messageSize = 1500;
 	}
-	rateMsec = ( messageSize + HEADER_RATE_BYTES ) * 1000 / rate;
+	// low watermark for sv_maxRate, never 0 < sv_maxRate < 1000 (0 is no limitation)
+	if ( sv_maxRate->integer && sv_maxRate->integer < 1000 ) {
+		Cvar_Set( "sv_MaxRate", "1000" );
+	}
+	rateMsec = ( messageSize + HEADER_RATE_BYTES ) * 1000 / SV_ClientRate( client );
 
 	return rateMsec;
 }
 
 /*
 =======================
-SV_SendMessageToClient
-
-Called by SV_SendClientSnapshot and SV_SendClientGameState
+SV_TransmitMessage
 =======================
 */
-void SV_SendMessageToClient( msg_t *msg, client_t *client ) {
-	int rateMsec;
+static void SV_TransmitMessage( msg_t *msg, client_t *client ) {
+	int64_t prof;
 
 	// record information about the message
 	client->frames[client->netchan.outgoingSequence & PACKET_MASK].messageSize = msg->cursize;
-	client->frames[client->netchan.outgoingSequence & PACKET_MASK].messageSent = svs.time;
+	client->frames[client->netchan.outgoingSequence & PACKET_MASK].messageSent = Sys_Milliseconds();
 	client->frames[client->netchan.outgoingSequence & PACKET_MASK].messageAcked = -1;
 
 	// send the datagram
+	prof = SV_ProfileBegin();
 	SV_Netchan_Transmit( client, msg );
+	SV_ProfileEnd( SVP_SENDS, prof );
 
-	// set nextSnapshotTime based on rate and requested number of updates
+	// the length includes the svc_EOF the transmit added
+	client->snapshotStats.messages++;
+	client->snapshotStats.bytes += msg->cursize;
+	if ( msg->cursize >= FRAGMENT_SIZE ) {
+		client->snapshotStats.fragmented++;
+	}
+}
 
+/*
+=======================
+SV_ScheduleNextSnapshot
+
+Sets nextSnapshotTime based on rate and requested number of updates,
+rateMsec is what the messages just sent take to clear
+=======================
+*/
+static void SV_ScheduleNextSnapshot( client_t *client, int rateMsec ) {
 	// local clients get snapshots every frame
-	// TTimo - show_bug.cgi?id=491
-	// added sv_lanForceRate check
-	if ( client->netchan.remoteAddress.type == NA_LOOPBACK || ( sv_lanForceRate->integer && Sys_IsLANAddress( client->netchan.remoteAddress ) ) ) {
+	if ( SV_ClientUnrated( client ) ) {
 		client->nextSnapshotTime = svs.time - 1;
 		return;
 	}
 
-	// normal rate / snapshotMsec calculation
-	rateMsec = SV_RateMsec( client, msg->cursize );
-
 	// TTimo - during a download, ignore the snapshotMsec
 	// the update server on steroids, with this disabled and sv_fps 60, the download can reach 30 kb/s
 	// on a regular server, we will still top at 20 kb/s because of sv_fps 20
@@ -702,6 +1596,304 @@ void SV_SendMessageToClient( msg_t *msg, client_t *client ) {
 	}
 }
 
+/*
+=======================
+SV_SendMessageToClient
+
+Called by SV_SendClientSnapshot and SV_SendClientGameState
+=======================
+*/
+void SV_SendMessageToClient( msg_t *msg, client_t *client ) {
+	client->frames[client->netchan.outgoingSequence & PACKET_MASK].part = -1;
+
+	SV_TransmitMessage( msg, client );
+	SV_ScheduleNextSnapshot( client, SV_RateMsec( client, msg->cursize ) );
+}
+
+
+/*
+=============================================================================
+
+Snapshot parts
+
+A snapshot over sv_snapshotMTU would go out as one fragmented message,
+and losing any fragment loses all of it.  For clients with
+cl_snapshotParts it is split at entity boundaries instead, into
+svc_snapshotPart messages of their own.  Every part is a complete
+snapshot against the same delta frame, carrying the updates for a range
+of entity numbers, so a lost part only delays those entities.
+
+The client fills in the rest of the entities from the parts it already
+has, so the frame recorded for part k has the new states up to the end
+of its range and the delta frame's after it.  That is only true if no
+part before it went missing; the client acknowledges the last one that
+does match, and the next snapshot deltas from that.
+
+=============================================================================
+*/
+
+typedef struct {
+	int number;
+	entityState_t   *from;              // the baseline for an add
+	entityState_t   *to;                // NULL for a removal
+	qboolean force;
+} snapshotItem_t;
+
+/*
+=======================
+SV_SnapshotItems
+
+The entity deltas SV_EmitPacketEntities would write, minus the
+unchanged ones that write nothing
+=======================
+*/
+static int SV_SnapshotItems( clientSnapshot_t *from, clientSnapshot_t *to, snapshotItem_t *items ) {
+	entityState_t   *oldent, *newent;
+	int oldindex, newindex;
+	int oldnum, newnum;
+	int from_num_entities;
+	int count;
+
+	from_num_entities = from ? from->num_entities : 0;
+
+	count = 0;
+	newent = NULL;
+	oldent = NULL;
+	newindex = 0;
+	oldindex = 0;
+	while ( newindex < to->num_entities || oldindex < from_num_entities ) {
+		if ( newindex >= to->num_entities ) {
+			newnum = 9999;
+		} else {
+			newent = &svs.snapshotEntities[( to->first_entity + newindex ) % svs.numSnapshotEntities];
+			newnum = newent->number;
+		}
+
+		if ( oldindex >= from_num_entities ) {
+			oldnum = 9999;
+		} else {
+			oldent = &svs.snapshotEntities[( from->first_entity + oldindex ) % svs.numSnapshotEntities];
+			oldnum = oldent->number;
+		}
+
+		if ( newnum == oldnum ) {
+			oldindex++;
+			newindex++;
+			if ( memcmp( oldent, newent, sizeof( *newent ) ) ) {
+				items[count].number = newnum;
+				items[count].from = oldent;
+				items[count].to = newent;
+				items[count].force = qfalse;
+				count++;
+			}
+		} else if ( newnum < oldnum ) {
+			newindex++;
+			items[count].number = newnum;
+			items[count].from = &sv.svEntities[newnum].baseline;
+			items[count].to = newent;
+			items[count].force = qtrue;
+			count++;
+		} else {
+			oldindex++;
+			items[count].number = oldnum;
+			items[count].from = oldent;
+			items[count].to = NULL;
+			items[count].force = qtrue;
+			count++;
+		}
+	}
+
+	return count;
+}
+
+/*
+=======================
+SV_SnapshotPartFrame
+
+What the client has after the parts up to the one ending at end:
+the full frame's entities below end, the delta frame's from there
+=======================
+*/
+static void SV_SnapshotPartFrame( clientSnapshot_t *frame, const clientSnapshot_t *full,
+								  const clientSnapshot_t *oldframe, int end ) {
+	entityState_t   *ent;
+	int i, count, first;
+
+	*frame = *full;
+	if ( end == MAX_GENTITIES - 1 ) {
+		return;
+	}
+
+	count = 0;
+	for ( i = 0 ; i < full->num_entities ; i++ ) {
+		if ( svs.snapshotEntities[( full->first_entity + i ) % svs.numSnapshotEntities].number < end ) {
+			count++;
+		}
+	}
+	for ( i = 0 ; oldframe && i < oldframe->num_entities ; i++ ) {
+		if ( svs.snapshotEntities[( oldframe->first_entity + i ) % svs.numSnapshotEntities].number >= end ) {
+			count++;
+		}
+	}
+
+	first = SV_ReserveSnapshotEntities( count );
+	frame->first_entity = first;
+	frame->num_entities = count;
+
+	for ( i = 0 ; i < full->num_entities ; i++ ) {
+		ent = &svs.snapshotEntities[( full->first_entity + i ) % svs.numSnapshotEntities];
+		if ( ent->number < end ) {
+			svs.snapshotEntities[first++ % svs.numSnapshotEntities] = *ent;
+		}
+	}
+	for ( i = 0 ; oldframe && i < oldframe->num_entities ; i++ ) {
+		ent = &svs.snapshotEntities[( oldframe->first_entity + i ) % svs.numSnapshotEntities];
+		if ( ent->number >= end ) {
+			svs.snapshotEntities[first++ % svs.numSnapshotEntities] = *ent;
+		}
+	}
+}
+
+/*
+=======================
+SV_SendSnapshotParts
+
+Sends the snapshot just built for the client as svc_snapshotPart
+messages, or returns qfalse if it has to go whole
+=======================
+*/
+static qboolean SV_SendSnapshotParts( client_t *client, clientSnapshot_t *oldframe, int lastframe ) {
+	static snapshotItem_t items[MAX_GENTITIES];
+	clientSnapshot_t full;
+	clientSnapshot_t    *frame;
+	snapshotItem_t      *item;
+	byte msg_buf[MAX_MSGLEN];
+	msg_t msg;
+	int numItems, maxParts, part;
+	int start, next, inPart, bits, limit;
+	int rateMsec, reserve, oldest;
+
+	// every part deltas from the same frame, which has to stay in reach
+	maxParts = MAX_SNAPSHOT_PARTS;
+	if ( oldframe && PACKET_BACKUP - 4 - lastframe < maxParts ) {
+		maxParts = PACKET_BACKUP - 4 - lastframe;
+	}
+	if ( maxParts < 2 ) {
+		return qfalse;
+	}
+
+	full = client->frames[client->netchan.outgoingSequence & PACKET_MASK];
+
+	// the part frames are reserved after every client's delta frame was
+	// picked, so another client's parts may already have overwritten ours,
+	// and ours must not overwrite what the parts are written from
+	reserve = full.num_entities;
+	oldest = full.first_entity;
+	if ( oldframe ) {
+		reserve += oldframe->num_entities;
+		if ( oldframe->first_entity < oldest ) {
+			oldest = oldframe->first_entity;
+		}
+	}
+	if ( oldest <= svs.nextSnapshotEntities + maxParts * reserve - svs.numSnapshotEntities ) {
+		return qfalse;
+	}
+
+	numItems = SV_SnapshotItems( oldframe, &full, items );
+	limit = SV_SnapshotMTU() * 8;
+
+	rateMsec = 0;
+	start = 0;
+	next = 0;
+	for ( part = 0 ; next < numItems || !part ; part++ ) {
+		MSG_Init( &msg, msg_buf, sizeof( msg_buf ) );
+		msg.allowoverflow = qtrue;
+
+		MSG_WriteLong( &msg, client->lastClientCommand );
+		if ( !part ) {
+			SV_UpdateServerCommandsToClient( client, &msg );
+		}
+
+		MSG_WriteByte( &msg, svc_snapshotPart );
+		MSG_WriteByte( &msg, part );
+		SV_WriteSnapshotHeader( client, oldframe, &full, oldframe ? lastframe + part : 0, &msg );
+
+		// as many as fit, but always at least one, the last part takes the rest
+		for ( inPart = 0 ; next < numItems ; next++, inPart++ ) {
+			item = &items[next];
+			if ( inPart && part < maxParts - 1 ) {
+				bits = SV_DeltaEntityBits( item->from, item->to, item->force );
+				if ( msg.bit + bits + SNAP_TAIL_BYTES * 8 > limit ) {
+					break;
+				}
+			}
+			SV_WriteDeltaEntity( &msg, item->from, item->to, item->force );
+		}
+		MSG_WriteBits( &msg, ( MAX_GENTITIES - 1 ), GENTITYNUM_BITS );   // end of packetentities
+
+		// the entity numbers this part is for
+		MSG_WriteBits( &msg, start, GENTITYNUM_BITS );
+		start = next < numItems ? items[next].number : MAX_GENTITIES - 1;
+		MSG_WriteBits( &msg, start, GENTITYNUM_BITS );
+
+		if ( msg.overflowed ) {
+			Com_Printf( "WARNING: msg overflowed for %s\n", client->name );
+			MSG_Clear( &msg );
+		}
+
+		frame = &client->frames[client->netchan.outgoingSequence & PACKET_MASK];
+		SV_SnapshotPartFrame( frame, &full, oldframe, start );
+		frame->part = part;
+
+		SV_TransmitMessage( &msg, client );
+		rateMsec += SV_RateMsec( client, msg.cursize );
+
+		sv.bpsTotalBytes += msg.cursize;            // NERVE - SMF - net debugging
+		sv.ubpsTotalBytes += msg.uncompsize / 8;    // NERVE - SMF - net debugging
+	}
+
+	client->snapshotStats.split++;
+	client->snapshotStats.parts += part;
+
+	SV_ScheduleNextSnapshot( client, rateMsec );
+	return qtrue;
+}
+
+
+
+/*
+=======================
+SV_FinishClientSnapshot
+
+Adds download data and transmits a snapshot message
+=======================
+*/
+static void SV_FinishClientSnapshot( client_t *client, clientSnapshot_t *oldframe, int lastframe, msg_t *msg ) {
+	// too long for one packet, split it up if the client can take that
+	// and nothing fragmented is still on its way
+	if ( client->snapshotParts && sv_snapshotParts->integer && client->state == CS_ACTIVE
+		 && !*client->downloadName && !client->netchan.unsentFragments
+		 && !msg->overflowed && msg->cursize + 1 > SV_SnapshotMTU() ) {
+		if ( SV_SendSnapshotParts( client, oldframe, lastframe ) ) {
+			return;
+		}
+	}
+
+	// Add any download data if the client is downloading
+	SV_WriteDownloadToClient( client, msg );
+
+	// check for overflow
+	if ( msg->overflowed ) {
+		Com_Printf( "WARNING: msg overflowed for %s\n", client->name );
+		MSG_Clear( msg );
+	}
+
+	SV_SendMessageToClient( msg, client );
+
+	sv.bpsTotalBytes += msg->cursize;           // NERVE - SMF - net debugging
+	sv.ubpsTotalBytes += msg->uncompsize / 8;   // NERVE - SMF - net debugging
+}
+
 
 /*
 =======================
@@ -714,6 +1906,8 @@ Also called by SV_FinalMessage
 void SV_SendClientSnapshot( client_t *client ) {
 	byte msg_buf[MAX_MSGLEN];
 	msg_t msg;
+	clientSnapshot_t    *oldframe;
+	int lastframe;
 
 	// build the snapshot
 	SV_BuildClientSnapshot( client );
@@ -736,21 +1930,570 @@ void SV_SendClientSnapshot( client_t *client ) {
 
 	// send over all the relevant entityState_t
 	// and the playerState_t
-	SV_WriteSnapshotToClient( client, &msg );
+	oldframe = SV_WriteSnapshotToClient( client, &lastframe, &msg );
 
-	// Add any download data if the client is downloading
-	SV_WriteDownloadToClient( client, &msg );
+	SV_FinishClientSnapshot( client, oldframe, lastframe, &msg );
+}
 
-	// check for overflow
-	if ( msg.overflowed ) {
-		Com_Printf( "WARNING: msg overflowed for %s\n", client->name );
-		MSG_Clear( &msg );
+
+/*
+=============================================================================
+
+Threaded snapshots
+
+With sv_snapshotWorkers set, building and encoding the snapshots is spread
+over the worker pool.  Only the steps that touch shared server state
+(reserving snapshot entity slots, picking the delta frame and transmitting)
+stay on the main thread.
+
+=============================================================================
+*/
+
+typedef struct {
+	client_t                *client;
+	qboolean bot;
+	int first;                              // first reserved slot in svs.snapshotEntities
+	clientSnapshot_t        *oldframe;
+	int lastframe;
+	msg_t msg;
+	byte msgBuffer[MAX_MSGLEN];
+	snapshotEntityNumbers_t entityNumbers;
+} snapshotJob_t;
+
+static snapshotJob_t    *snapshotJobs;
+static int maxSnapshotJobs;
+
+/*
+=======================
+SV_AllocSnapshotJobs
+=======================
+*/
+static void SV_AllocSnapshotJobs( int count ) {
+	if ( count <= maxSnapshotJobs ) {
+		return;
+	}
+
+	// like svs.clients, keep this large block out of the zone
+	SV_FreeSnapshotJobs();
+	snapshotJobs = calloc( count, sizeof( snapshotJob_t ) );
+	if ( !snapshotJobs ) {
+		Com_Error( ERR_FATAL, "SV_AllocSnapshotJobs: couldn't allocate %i jobs", count );
+	}
+	maxSnapshotJobs = count;
+}
+
+/*
+=======================
+SV_FreeSnapshotJobs
+=======================
+*/
+void SV_FreeSnapshotJobs( void ) {
+	if ( snapshotJobs ) {
+		free( snapshotJobs );
+	}
+	snapshotJobs = NULL;
+	maxSnapshotJobs = 0;
+}
+
+/*
+=======================
+SV_FixEntityNumbers
+
+SV_AddEntitiesVisibleFromPoint repairs bad entity numbers as it goes,
+do it up front so the workers never have to write to an entity
+=======================
+*/
+static void SV_FixEntityNumbers( void ) {
+	int e;
+	sharedEntity_t  *ent;
+
+	for ( e = 0 ; e < sv.num_entities ; e++ ) {
+		ent = SV_GentityNum( e );
+		if ( ent->r.linked && ent->s.number != e ) {
+			Com_DPrintf( "FIXING ENT->S.NUMBER!!!\n" );
+			ent->s.number = e;
+		}
+	}
+}
+
+/*
+=======================
+SV_PrimeVisCache
+
+The workers can only read the visibility cache, so bring the
+entries for every client's own viewpoint up to date first
+=======================
+*/
+static void SV_PrimeVisCache( int numJobs ) {
+	int i;
+	int leafnum;
+	vec3_t org;
+	client_t        *client;
+
+	if ( !sv_visCache->integer || !sv.state ) {
+		return;
 	}
 
-	SV_SendMessageToClient( &msg, client );
+	for ( i = 0 ; i < numJobs ; i++ ) {
+		client = snapshotJobs[i].client;
+		if ( !client->gentity || client->state == CS_ZOMBIE ) {
+			continue;
+		}
 
-	sv.bpsTotalBytes += msg.cursize;            // NERVE - SMF - net debugging
-	sv.ubpsTotalBytes += msg.uncompsize / 8;    // NERVE - SMF - net debugging
+		SV_ClientViewOrigin( SV_GameClientNum( client - svs.clients ), org );
+		leafnum = CM_PointLeafnum( org );
+		SV_VisCacheForView( CM_LeafCluster( leafnum ), CM_LeafArea( leafnum ) );
+	}
+}
+
+/*
+=======================
+SV_GatherSnapshotJob
+=======================
+*/
+static void SV_GatherSnapshotJob( void *data, int index ) {
+	snapshotJob_t   *job = &( (snapshotJob_t *)data )[index];
+
+	SV_GatherClientSnapshot( job->client, &job->entityNumbers );
+}
+
+/*
+=======================
+SV_EncodeSnapshotJob
+
+Copies the entity states into the reserved slots and writes the
+message for everyone except bots, which read the frame directly
+=======================
+*/
+static void SV_EncodeSnapshotJob( void *data, int index ) {
+	snapshotJob_t   *job = &( (snapshotJob_t *)data )[index];
+	client_t        *client = job->client;
+
+	SV_CopySnapshotEntities( &client->frames[ client->netchan.outgoingSequence & PACKET_MASK ],
+							 &job->entityNumbers, job->first );
+
+	if ( job->bot ) {
+		return;
+	}
+
+	MSG_Init( &job->msg, job->msgBuffer, sizeof( job->msgBuffer ) );
+	job->msg.allowoverflow = qtrue;
+
+	// NOTE, MRE: all server->client messages now acknowledge
+	// let the client know which reliable clientCommands we have received
+	MSG_WriteLong( &job->msg, client->lastClientCommand );
+
+	// (re)send any reliable server commands
+	SV_UpdateServerCommandsToClient( client, &job->msg );
+
+	// send over all the relevant entityState_t
+	// and the playerState_t
+	SV_WriteSnapshotFrame( client, job->oldframe, job->lastframe, &job->msg );
+}
+
+/*
+=======================
+SV_SendClientSnapshotsThreaded
+
+Same result as calling SV_SendClientSnapshot for each of the clients in turn.
+The benchmark passes transmit qfalse to build and encode without sending.
+=======================
+*/
+static void SV_SendClientSnapshotsThreaded( int numJobs, qboolean transmit ) {
+	int i;
+	int total;
+	snapshotJob_t   *job;
+
+	SV_FixEntityNumbers();
+	SV_PrimeVisCache( numJobs );
+
+	visCacheReadOnly = qtrue;
+	Threads_RunJobs( SV_GatherSnapshotJob, snapshotJobs, numJobs );
+	visCacheReadOnly = qfalse;
+
+	// what the workers ran into, now that they are all done
+	total = 0;
+	for ( i = 0, job = snapshotJobs ; i < numJobs ; i++, job++ ) {
+		if ( job->entityNumbers.error ) {
+			Com_Error( ERR_DROP, "%s", job->entityNumbers.error );
+		}
+		total += job->entityNumbers.numSnapshotEntities;
+	}
+
+	if ( total > svs.numSnapshotEntities ) {
+		// the snapshots would overwrite each other in the ring
+		// before they are sent, so finish them one at a time
+		for ( i = 0, job = snapshotJobs ; i < numJobs ; i++, job++ ) {
+			job->first = SV_ReserveSnapshotEntities( job->entityNumbers.numSnapshotEntities );
+			if ( !job->bot ) {
+				job->oldframe = SV_SnapshotDeltaFrame( job->client, &job->lastframe );
+			}
+			SV_EncodeSnapshotJob( snapshotJobs, i );
+			if ( transmit && !job->bot ) {
+				SV_FinishClientSnapshot( job->client, job->oldframe, job->lastframe, &job->msg );
+			}
+		}
+		return;
+	}
+
+	for ( i = 0, job = snapshotJobs ; i < numJobs ; i++, job++ ) {
+		job->first = SV_ReserveSnapshotEntities( job->entityNumbers.numSnapshotEntities );
+	}
+
+	// pick the delta frames once every slot for this frame has been handed out,
+	// so none of them can be overwritten while the workers read them
+	for ( i = 0, job = snapshotJobs ; i < numJobs ; i++, job++ ) {
+		if ( !job->bot ) {
+			job->oldframe = SV_SnapshotDeltaFrame( job->client, &job->lastframe );
+		}
+	}
+
+	Threads_RunJobs( SV_EncodeSnapshotJob, snapshotJobs, numJobs );
+
+	if ( !transmit ) {
+		return;
+	}
+
+	for ( i = 0, job = snapshotJobs ; i < numJobs ; i++, job++ ) {
+		if ( !job->bot ) {
+			SV_FinishClientSnapshot( job->client, job->oldframe, job->lastframe, &job->msg );
+		}
+	}
+}
+
+
+// what the benchmark puts back in every client afterwards
+typedef struct {
+	clientSnapshot_t frame;                 // the one the snapshots are built into
+	int reliableSent;
+	int entityHeldSince[MAX_GENTITIES];
+	snapshotStats_t snapshotStats;
+} snapshotBenchSave_t;
+
+/*
+=======================
+SV_SnapshotBenchRoom
+
+Returns how many slots past svs.nextSnapshotEntities can be written
+without overwriting a frame some client may still delta from
+=======================
+*/
+static int SV_SnapshotBenchRoom( void ) {
+	int i, j;
+	int oldest;
+	client_t            *c;
+	clientSnapshot_t    *frame;
+
+	oldest = svs.nextSnapshotEntities;
+	for ( i = 0, c = svs.clients ; i < sv_maxclients->integer ; i++, c++ ) {
+		if ( c->state < CS_CONNECTED ) {
+			continue;
+		}
+		for ( j = 0, frame = c->frames ; j < PACKET_BACKUP ; j++, frame++ ) {
+			// anything further back has already rolled off the buffer
+			if ( frame->first_entity > svs.nextSnapshotEntities - svs.numSnapshotEntities
+				 && frame->first_entity < oldest ) {
+				oldest = frame->first_entity;
+			}
+		}
+	}
+
+	return oldest + svs.numSnapshotEntities - svs.nextSnapshotEntities;
+}
+
+/*
+=======================
+SV_SnapshotBenchRestore
+=======================
+*/
+static void SV_SnapshotBenchRestore( snapshotBenchSave_t *save, int numJobs ) {
+	int i;
+	client_t            *c;
+	snapshotBenchSave_t *s;
+
+	for ( i = 0, s = save ; i < numJobs ; i++, s++ ) {
+		c = snapshotJobs[i].client;
+		c->frames[ c->netchan.outgoingSequence & PACKET_MASK ] = s->frame;
+		c->reliableSent = s->reliableSent;
+		memcpy( c->entityHeldSince, s->entityHeldSince, sizeof( c->entityHeldSince ) );
+		c->snapshotStats = s->snapshotStats;
+	}
+	free( save );
+}
+
+/*
+=======================
+SV_SnapshotBench_f
+
+Times building and encoding snapshots for every connected client with
+0 up to N snapshot workers.  Nothing is transmitted, every run reuses
+the same free slots in svs.snapshotEntities and the clients' delta
+and scheduler state is put back afterwards.
+=======================
+*/
+void SV_SnapshotBench_f( void ) {
+	int i, workers, maxWorkers, frames;
+	int numJobs, total, nextSnapshotEntities;
+	int64_t start, base, usec;
+	client_t    *c;
+	snapshotJob_t       *job;
+	snapshotBenchSave_t *save, *s;
+
+	if ( !com_sv_running->integer ) {
+		Com_Printf( "Server is not running.\n" );
+		return;
+	}
+
+	if ( Cmd_Argc() < 2 ) {
+		Com_Printf( "usage: snapshotbench <maxworkers> [frames]\n" );
+		return;
+	}
+
+	maxWorkers = atoi( Cmd_Argv( 1 ) );
+	if ( maxWorkers < 0 ) {
+		maxWorkers = 0;
+	} else if ( maxWorkers > MAX_WORKER_THREADS ) {
+		maxWorkers = MAX_WORKER_THREADS;
+	}
+	frames = Cmd_Argc() > 2 ? atoi( Cmd_Argv( 2 ) ) : 100;
+	if ( frames < 1 ) {
+		frames = 1;
+	}
+
+	SV_AllocSnapshotJobs( sv_maxclients->integer );
+
+	numJobs = 0;
+	for ( i = 0, c = svs.clients ; i < sv_maxclients->integer ; i++, c++ ) {
+		if ( c->state < CS_CONNECTED ) {
+			continue;
+		}
+		snapshotJobs[numJobs].client = c;
+		snapshotJobs[numJobs].bot = ( c->gentity && c->gentity->r.svFlags & SVF_BOT );
+		numJobs++;
+	}
+
+	if ( !numJobs ) {
+		Com_Printf( "No clients connected.\n" );
+		return;
+	}
+
+	save = calloc( numJobs, sizeof( *save ) );
+	if ( !save ) {
+		Com_Printf( "Couldn't allocate %i clients.\n", numJobs );
+		return;
+	}
+
+	// the world doesn't move during the benchmark,
+	// so every run needs as many slots as this
+	total = 0;
+	for ( i = 0, job = snapshotJobs, s = save ; i < numJobs ; i++, job++, s++ ) {
+		c = job->client;
+		s->frame = c->frames[ c->netchan.outgoingSequence & PACKET_MASK ];
+		s->reliableSent = c->reliableSent;
+		memcpy( s->entityHeldSince, c->entityHeldSince, sizeof( s->entityHeldSince ) );
+		s->snapshotStats = c->snapshotStats;
+
+		SV_GatherClientSnapshot( c, &job->entityNumbers );
+		total += job->entityNumbers.numSnapshotEntities;
+	}
+
+	if ( total > SV_SnapshotBenchRoom() ) {
+		Com_Printf( "Not enough free snapshot entities for %i, the clients still need them.\n", total );
+		SV_SnapshotBenchRestore( save, numJobs );
+		return;
+	}
+
+	Com_Printf( "%i clients, %i frames\n", numJobs, frames );
+
+	nextSnapshotEntities = svs.nextSnapshotEntities;
+	base = 0;
+	for ( workers = 0 ; workers <= maxWorkers ; workers++ ) {
+		Threads_InitWorkers( workers );
+		if ( Threads_NumWorkers() != workers ) {
+			break;
+		}
+
+		start = Sys_Microseconds();
+		for ( i = 0 ; i < frames ; i++ ) {
+			SV_SendClientSnapshotsThreaded( numJobs, qfalse );
+			svs.nextSnapshotEntities = nextSnapshotEntities;
+		}
+		usec = Sys_Microseconds() - start;
+		if ( !base ) {
+			base = usec;
+		}
+
+		Com_Printf( "%2i threads: %8.3f msec/frame  %5.2fx\n", workers + 1,
+					usec / ( 1000.0 * frames ), usec ? (double)base / usec : 0.0 );
+	}
+
+	SV_SnapshotBenchRestore( save, numJobs );
+
+	Threads_InitWorkers( sv_snapshotWorkers->integer );
+}
+
+
+/*
+=======================
+SV_DeltaCheckDecode
+
+Writes one entity delta through the cache and reads it back the way
+CL_ParsePacketEntities does, the client keeps its state when the
+delta is empty
+=======================
+*/
+static qboolean SV_DeltaCheckDecode( entityState_t *from, entityState_t *to ) {
+	entityState_t decoded;
+	msg_t msg;
+	byte buf[MAX_DELTA_BYTES + 16];
+	int num;
+
+	MSG_Init( &msg, buf, sizeof( buf ) );
+	SV_WriteDeltaEntity( &msg, from, to, qfalse );
+	MSG_WriteBits( &msg, MAX_GENTITIES - 1, GENTITYNUM_BITS );
+
+	decoded = *from;
+	MSG_BeginReading( &msg );
+	num = MSG_ReadBits( &msg, GENTITYNUM_BITS );
+	if ( num != MAX_GENTITIES - 1 ) {
+		MSG_ReadDeltaEntity( &msg, from, &decoded, num );
+	}
+	return !memcmp( &decoded, to, sizeof( decoded ) );
+}
+
+/*
+=======================
+SV_DeltaCheckHeldBack
+
+An entity held back goes out as a delta from the old state to itself
+after its real update was sized through the cache, the client has to
+end up with the old state, and a client that does get the update with
+the new one
+=======================
+*/
+static void SV_DeltaCheckHeldBack( clientSnapshot_t *frame ) {
+	entityState_t oldState, newState;
+	entityState_t   *ent;
+	int i, failed;
+
+	failed = 0;
+	for ( i = 0 ; i < frame->num_entities ; i++ ) {
+		ent = &svs.snapshotEntities[( frame->first_entity + i ) % svs.numSnapshotEntities];
+		oldState = *ent;
+		newState = *ent;
+		newState.pos.trBase[0] += 64;
+		newState.angles[1] += 90;
+
+		SV_BeginDeltaCache( qtrue );
+		SV_DeltaEntityBits( &oldState, &newState, qfalse );
+		if ( !SV_DeltaCheckDecode( &oldState, &oldState ) || !SV_DeltaCheckDecode( &oldState, &newState ) ) {
+			failed++;
+		}
+		SV_EndDeltaCache();
+	}
+	Com_Printf( "held back entities: %i of %i decode %s\n", frame->num_entities - failed,
+				frame->num_entities, failed ? "right, the rest WRONG" : "right" );
+}
+
+/*
+=======================
+SV_DeltaBench_f
+
+Replays the current frame to a number of synthetic clients and times
+SV_EmitPacketEntities with and without the delta cache.  The clients
+delta from the last snapshots of the real clients, or from the baselines
+if nobody is connected.  Then checks what a client decodes for every
+entity of the frame when it is held back.
+=======================
+*/
+#define MAX_BENCH_FROMS     MAX_CLIENTS
+void SV_DeltaBench_f( void ) {
+	int i, e, pass, numClients, frames;
+	int numFroms;
+	int64_t start, usec[2];
+	int bytes[2];
+	unsigned checksum[2];
+	clientSnapshot_t to;
+	clientSnapshot_t    *froms[MAX_BENCH_FROMS];
+	client_t            *c;
+	sharedEntity_t      *ent;
+	msg_t msg;
+	static byte msgBuffer[MAX_MSGLEN];
+
+	if ( !com_sv_running->integer ) {
+		Com_Printf( "Server is not running.\n" );
+		return;
+	}
+
+	numClients = Cmd_Argc() > 1 ? atoi( Cmd_Argv( 1 ) ) : 64;
+	if ( numClients < 1 ) {
+		numClients = 1;
+	}
+	frames = Cmd_Argc() > 2 ? atoi( Cmd_Argv( 2 ) ) : 100;
+	if ( frames < 1 ) {
+		frames = 1;
+	}
+
+	// the frame to replay, every entity that could be sent to someone
+	Com_Memset( &to, 0, sizeof( to ) );
+	for ( e = 0 ; e < sv.num_entities && to.num_entities < MAX_SNAPSHOT_ENTITIES ; e++ ) {
+		ent = SV_GentityNum( e );
+		if ( ent->r.linked && !( ent->r.svFlags & SVF_NOCLIENT ) && ent->s.number == e ) {
+			to.num_entities++;
+		}
+	}
+	if ( to.num_entities > svs.numSnapshotEntities ) {
+		to.num_entities = svs.numSnapshotEntities;
+	}
+	to.first_entity = SV_ReserveSnapshotEntities( to.num_entities );
+	for ( e = 0, i = 0 ; e < sv.num_entities && i < to.num_entities ; e++ ) {
+		ent = SV_GentityNum( e );
+		if ( ent->r.linked && !( ent->r.svFlags & SVF_NOCLIENT ) && ent->s.number == e ) {
+			svs.snapshotEntities[( to.first_entity + i++ ) % svs.numSnapshotEntities] = ent->s;
+		}
+	}
+
+	numFroms = 0;
+	for ( i = 0, c = svs.clients ; i < sv_maxclients->integer && numFroms < MAX_BENCH_FROMS ; i++, c++ ) {
+		if ( c->state != CS_ACTIVE ) {
+			continue;
+		}
+		froms[numFroms] = &c->frames[( c->netchan.outgoingSequence - 1 ) & PACKET_MASK];
+		if ( froms[numFroms]->first_entity > svs.nextSnapshotEntities - svs.numSnapshotEntities ) {
+			numFroms++;
+		}
+	}
+
+	Com_Printf( "%i entities, %i clients delta from %i frames%s, %i frames\n", to.num_entities,
+				numClients, numFroms, numFroms ? "" : " (baselines)", frames );
+
+	for ( pass = 0 ; pass < 2 ; pass++ ) {
+		bytes[pass] = 0;
+		checksum[pass] = 0;
+		start = Sys_Microseconds();
+		for ( e = 0 ; e < frames ; e++ ) {
+			SV_BeginDeltaCache( pass );
+			for ( i = 0 ; i < numClients ; i++ ) {
+				MSG_Init( &msg, msgBuffer, sizeof( msgBuffer ) );
+				msg.allowoverflow = qtrue;
+				SV_EmitPacketEntities( numFroms ? froms[i % numFroms] : NULL, &to, &msg );
+				if ( !e ) {
+					bytes[pass] += msg.cursize;
+					checksum[pass] ^= Com_BlockChecksum( msg.data, msg.cursize ) + i;
+				}
+			}
+			SV_EndDeltaCache();
+		}
+		usec[pass] = Sys_Microseconds() - start;
+	}
+
+	Com_Printf( "uncached: %8.3f msec/frame\n", usec[0] / ( 1000.0 * frames ) );
+	Com_Printf( "cached:   %8.3f msec/frame  %5.2fx\n", usec[1] / ( 1000.0 * frames ),
+				usec[1] ? (double)usec[0] / usec[1] : 0.0 );
+	Com_Printf( "%i bytes per frame, output %s\n", bytes[0],
+				( bytes[0] == bytes[1] && checksum[0] == checksum[1] ) ? "matches" : "DIFFERS" );
+
+	SV_DeltaCheckHeldBack( &to );
 }
 
 
@@ -764,10 +2507,28 @@ void SV_SendClientMessages( void ) {
 	int i;
 	client_t    *c;
 	int numclients = 0;         // NERVE - SMF - net debugging
+	int numJobs = 0;
+	qboolean threaded;
+	int64_t prof;
 
 	sv.bpsTotalBytes = 0;       // NERVE - SMF - net debugging
 	sv.ubpsTotalBytes = 0;      // NERVE - SMF - net debugging
 
+	SV_BeginDeltaCache( sv_deltaCache->integer );
+
+	// queue the snapshots so they go out with as few system calls as possible
+	Sys_BeginPacketBatch();
+
+	if ( sv_snapshotWorkers->modified ) {
+		Threads_InitWorkers( sv_snapshotWorkers->integer );
+		sv_snapshotWorkers->modified = qfalse;
+	}
+
+	threaded = ( sv_snapshotWorkers->integer > 0 && Threads_NumWorkers() > 0 );
+	if ( threaded ) {
+		SV_AllocSnapshotJobs( sv_maxclients->integer );
+	}
+
 	// send a message to each connected client
 	for ( i = 0, c = svs.clients ; i < sv_maxclients->integer ; i++, c++ ) {
 		if ( !c->state ) {
@@ -785,14 +2546,32 @@ void SV_SendClientMessages( void ) {
 		if ( c->netchan.unsentFragments ) {
 			c->nextSnapshotTime = svs.time +
 								  SV_RateMsec( c, c->netchan.unsentLength - c->netchan.unsentFragmentStart );
+			prof = SV_ProfileBegin();
 			SV_Netchan_TransmitNextFragment( c );
+			SV_ProfileEnd( SVP_SENDS, prof );
 			continue;
 		}
 
 		// generate and send a new message
-		SV_SendClientSnapshot( c );
+		if ( threaded ) {
+			snapshotJobs[numJobs].client = c;
+			snapshotJobs[numJobs].bot = ( c->gentity && c->gentity->r.svFlags & SVF_BOT );
+			numJobs++;
+		} else {
+			SV_SendClientSnapshot( c );
+		}
 	}
 
+	if ( numJobs ) {
+		SV_SendClientSnapshotsThreaded( numJobs, qtrue );
+	}
+
+	SV_EndDeltaCache();
+
+	prof = SV_ProfileBegin();
+	Sys_FlushPacketBatch();
+	SV_ProfileEnd( SVP_SENDS, prof );
+
 	// NERVE - SMF - net debugging
 	if ( sv_showAverageBPS->integer && numclients > 0 ) {
 		float ave = 0, uave = 0;
@@ -65,6 +65,15 @@ the world is carved up with an evenly spaced, axially aligned bsp tree.  Entitie
 are kept in chains either at the final leafs, or at the first node that splits
 them, which prevents having to deal with multiple fragments of a single entity.
 
+With sv_worldGrid 1 the world is instead covered by a loose grid of square
+cells sized from the world bounds.  An entity goes in the chain of the cell
+that holds the center of its box, so it never reaches more than half a cell
+past that cell, and a query looks at every cell within half a cell of its
+box.  Entities wider than a cell go in a second, coarser grid the same way,
+and the few too big even for that go in a chain that every query looks at.
+On big open maps this keeps the chains short, where the tree puts anything
+that crosses one of its few splits high up and scans it for every query.
+
 ===============================================================================
 */
 
@@ -81,26 +90,115 @@ typedef struct worldSector_s {
 worldSector_t sv_worldSectors[AREA_NODES];
 int sv_numworldSectors;
 
+#define GRID_MAX_CELLS  64          // along each axis
+#define GRID_MIN_SIZE   256         // smallest cell
+#define GRID_COARSE     8           // coarse cells are this many cells across
+#define GRID_LEVELS     2
+
+typedef struct {
+	float cellSize;
+	int cells[2];
+	worldSector_t   *sectors;
+} gridLevel_t;
+
+typedef struct {
+	vec3_t origin;
+	gridLevel_t levels[GRID_LEVELS];    // fine, then coarse
+	worldSector_t large;                // entities too big for any cell
+	worldSector_t fine[GRID_MAX_CELLS * GRID_MAX_CELLS];
+	worldSector_t coarse[( GRID_MAX_CELLS / GRID_COARSE ) * ( GRID_MAX_CELLS / GRID_COARSE )];
+} worldGrid_t;
+
+static worldGrid_t sv_grid;
+static qboolean sv_useWorldGrid;    // sv_worldGrid when the world was cleared
+
+static int sv_traceLogCount;            // bursts logged for tracebench
+
+
+/*
+===============
+SV_SectorCount
+===============
+*/
+static int SV_SectorCount( const worldSector_t *sec ) {
+	const svEntity_t  *ent;
+	int c;
+
+	c = 0;
+	for ( ent = sec->entities ; ent ; ent = ent->nextEntityInWorldSector ) {
+		c++;
+	}
+	return c;
+}
 
 /*
 ===============
 SV_SectorList_f
 ===============
 */
+#define SECTOR_HISTOGRAM    8
 void SV_SectorList_f( void ) {
-	int i, c;
+	int i, c, b, numSectors;
+	int histogram[SECTOR_HISTOGRAM];
+	int total, occupied, most;
 	worldSector_t   *sec;
-	svEntity_t      *ent;
+	gridLevel_t     *fine, *coarse;
+
+	fine = &sv_grid.levels[0];
+	coarse = &sv_grid.levels[1];
+	if ( sv_useWorldGrid ) {
+		numSectors = fine->cells[0] * fine->cells[1] + coarse->cells[0] * coarse->cells[1];
+		Com_Printf( "%i x %i cells of %i units, %i x %i cells of %i units, %i oversize entities\n",
+					fine->cells[0], fine->cells[1], (int)fine->cellSize,
+					coarse->cells[0], coarse->cells[1], (int)coarse->cellSize, SV_SectorCount( &sv_grid.large ) );
+	} else {
+		numSectors = AREA_NODES;
+	}
 
-	for ( i = 0 ; i < AREA_NODES ; i++ ) {
-		sec = &sv_worldSectors[i];
+	memset( histogram, 0, sizeof( histogram ) );
+	total = occupied = most = 0;
+	for ( i = 0 ; i < numSectors ; i++ ) {
+		if ( !sv_useWorldGrid ) {
+			sec = &sv_worldSectors[i];
+		} else if ( i < fine->cells[0] * fine->cells[1] ) {
+			sec = &fine->sectors[i];
+		} else {
+			sec = &coarse->sectors[i - fine->cells[0] * fine->cells[1]];
+		}
+
+		c = SV_SectorCount( sec );
+		if ( !sv_useWorldGrid ) {
+			Com_Printf( "sector %i: %i entities\n", i, c );
+		}
+
+		// bucket 0 is empty, then 1, 2-3, 4-7 and so on
+		for ( b = 0 ; b < SECTOR_HISTOGRAM - 1 && c >= ( 1 << b ) ; b++ ) {
+		}
+		histogram[b]++;
 
-		c = 0;
-		for ( ent = sec->entities ; ent ; ent = ent->nextEntityInWorldSector ) {
-			c++;
+		total += c;
+		if ( c ) {
+			occupied++;
+		}
+		if ( c > most ) {
+			most = c;
+		}
+	}
+
+	Com_Printf( "occupancy:\n" );
+	for ( b = 0 ; b < SECTOR_HISTOGRAM ; b++ ) {
+		if ( b == 0 ) {
+			Com_Printf( "%9s: %i sectors\n", "empty", histogram[b] );
+		} else if ( b == 1 ) {
+			Com_Printf( "%9i: %i sectors\n", 1, histogram[b] );
+		} else if ( b == SECTOR_HISTOGRAM - 1 ) {
+			Com_Printf( "%8i+: %i sectors\n", 1 << ( b - 1 ), histogram[b] );
+		} else {
+			Com_Printf( "%5i-%-3i: %i sectors\n", 1 << ( b - 1 ), ( 1 << b ) - 1, histogram[b] );
 		}
-		Com_Printf( "sector %i: %i entities\n", i, c );
 	}
+	Com_Printf( "%i entities in %i of %i sectors, %.1f per used sector, %i at most\n", total, occupied, numSectors,
+				occupied ? (float)total / occupied : 0.0f, most );
 }
 
 /*
@@ -145,6 +243,123 @@ worldSector_t *SV_CreateworldSector( int depth, vec3_t mins, vec3_t maxs ) {
 	return anode;
 }
 
+/*
+===============
+SV_CreateWorldGrid
+
+Cells are square and sized so the grid covers the world bounds
+===============
+*/
+static void SV_CreateWorldGrid( const vec3_t mins, const vec3_t maxs ) {
+	float size;
+	gridLevel_t     *level;
+	int i, j;
+
+	memset( &sv_grid, 0, sizeof( sv_grid ) );
+	VectorCopy( mins, sv_grid.origin );
+
+	size = maxs[0] - mins[0];
+	if ( maxs[1] - mins[1] > size ) {
+		size = maxs[1] - mins[1];
+	}
+	size = ceil( size / GRID_MAX_CELLS );
+	if ( size < GRID_MIN_SIZE ) {
+		size = GRID_MIN_SIZE;
+	}
+
+	sv_grid.levels[0].cellSize = size;
+	sv_grid.levels[0].sectors = sv_grid.fine;
+	sv_grid.levels[1].cellSize = size * GRID_COARSE;
+	sv_grid.levels[1].sectors = sv_grid.coarse;
+
+	for ( j = 0 ; j < GRID_LEVELS ; j++ ) {
+		level = &sv_grid.levels[j];
+		for ( i = 0 ; i < 2 ; i++ ) {
+			level->cells[i] = ceil( ( maxs[i] - mins[i] ) / level->cellSize );
+			if ( level->cells[i] < 1 ) {
+				level->cells[i] = 1;
+			}
+			if ( level->cells[i] > GRID_MAX_CELLS / ( j ? GRID_COARSE : 1 ) ) {
+				level->cells[i] = GRID_MAX_CELLS / ( j ? GRID_COARSE : 1 );
+			}
+		}
+	}
+
+	sv_grid.large.axis = -1;
+	for ( i = 0 ; i < GRID_MAX_CELLS * GRID_MAX_CELLS ; i++ ) {
+		sv_grid.fine[i].axis = -1;
+	}
+	for ( i = 0 ; i < ( GRID_MAX_CELLS / GRID_COARSE ) * ( GRID_MAX_CELLS / GRID_COARSE ) ; i++ ) {
+		sv_grid.coarse[i].axis = -1;
+	}
+}
+
+/*
+===============
+SV_GridCell
+
+The cell along axis i that holds v, clamped to the grid
+===============
+*/
+static int SV_GridCell( const gridLevel_t *level, float v, int i ) {
+	float f;
+
+	f = ( v - sv_grid.origin[i] ) / level->cellSize;
+	if ( f < 0 ) {
+		return 0;
+	}
+	if ( f >= level->cells[i] ) {
+		return level->cells[i] - 1;
+	}
+	return (int)f;
+}
+
+/*
+===============
+SV_SectorForBox
+
+The sector an entity with this absolute box is chained in
+===============
+*/
+static worldSector_t *SV_SectorForBox( const vec3_t absmin, const vec3_t absmax ) {
+	worldSector_t   *node;
+
+	if ( sv_useWorldGrid ) {
+		gridLevel_t *level;
+		int i;
+
+		// the first level where it can't reach more than half a cell
+		// out of its own cell
+		for ( i = 0, level = sv_grid.levels ; i < GRID_LEVELS ; i++, level++ ) {
+			if ( absmax[0] - absmin[0] <= level->cellSize && absmax[1] - absmin[1] <= level->cellSize ) {
+				return &level->sectors[SV_GridCell( level, 0.5 * ( absmin[1] + absmax[1] ), 1 ) * level->cells[0]
+									   + SV_GridCell( level, 0.5 * ( absmin[0] + absmax[0] ), 0 )];
+			}
+		}
+
+		// every query has to look at it
+		return &sv_grid.large;
+	}
+
+	// find the first world sector node that the ent's box crosses
+	node = sv_worldSectors;
+	while ( 1 )
+	{
+		if ( node->axis == -1 ) {
+			break;
+		}
+		if ( absmin[node->axis] > node->dist ) {
+			node = node->children[0];
+		} else if ( absmax[node->axis] < node->dist ) {
+			node = node->children[1];
+		} else {
+			break;      // crosses the node
+		}
+	}
+
+	return node;
+}
+
 /*
 ===============
 SV_ClearWorld
@@ -157,11 +372,16 @@ void SV_ClearWorld( void ) {
 
 	memset( sv_worldSectors, 0, sizeof( sv_worldSectors ) );
 	sv_numworldSectors = 0;
+	sv_traceLogCount = 0;
 
 	// get world map bounds
 	h = CM_InlineModel( 0 );
 	CM_ModelBounds( h, mins, maxs );
 	SV_CreateworldSector( 0, mins, maxs );
+
+	// only picked up here, everything gets linked again after a clear
+	sv_useWorldGrid = ( sv_worldGrid->integer != 0 );
+	SV_CreateWorldGrid( mins, maxs );
 }
 
 
@@ -231,6 +451,9 @@ void SV_LinkEntity( sharedEntity_t *gEnt ) {
 		SV_UnlinkEntity( gEnt );    // unlink from old position
 	}
 
+	// the clusters and areas are about to change
+	SV_VisCacheRelink( ent - sv.svEntities );
+
 	// encode the size into the entityState_t for client prediction
 	if ( gEnt->r.bmodel ) {
 		gEnt->s.solid = SOLID_BMODEL;       // a solid_box will never create this value
@@ -351,21 +574,7 @@ void SV_LinkEntity( sharedEntity_t *gEnt ) {
 
 	gEnt->r.linkcount++;
 
-	// find the first world sector node that the ent's box crosses
-	node = sv_worldSectors;
-	while ( 1 )
-	{
-		if ( node->axis == -1 ) {
-			break;
-		}
-		if ( gEnt->r.absmin[node->axis] > node->dist ) {
-			node = node->children[0];
-		} else if ( gEnt->r.absmax[node->axis] < node->dist ) {
-			node = node->children[1];
-		} else {
-			break;      // crosses the node
-		}
-	}
+	node = SV_SectorForBox( gEnt->r.absmin, gEnt->r.absmax );
 
 	// link it in
 	ent->worldSector = node;
@@ -375,6 +584,52 @@ void SV_LinkEntity( sharedEntity_t *gEnt ) {
 	gEnt->r.linked = qtrue;
 }
 
+/*
+===============
+SV_RelinkSectors
+
+Moves every linked entity into the tree or the grid, only for areabench
+===============
+*/
+static void SV_RelinkSectors( qboolean useGrid ) {
+	static int linked[MAX_GENTITIES];
+	int i, numLinked;
+	svEntity_t      *ent;
+	sharedEntity_t  *gEnt;
+	worldSector_t   *node;
+
+	numLinked = 0;
+	for ( i = 0 ; i < sv.num_entities ; i++ ) {
+		ent = &sv.svEntities[i];
+		if ( ent->worldSector ) {
+			ent->worldSector = NULL;
+			linked[numLinked++] = i;
+		}
+	}
+
+	for ( i = 0 ; i < AREA_NODES ; i++ ) {
+		sv_worldSectors[i].entities = NULL;
+	}
+	sv_grid.large.entities = NULL;
+	for ( i = 0 ; i < GRID_MAX_CELLS * GRID_MAX_CELLS ; i++ ) {
+		sv_grid.fine[i].entities = NULL;
+	}
+	for ( i = 0 ; i < ( GRID_MAX_CELLS / GRID_COARSE ) * ( GRID_MAX_CELLS / GRID_COARSE ) ; i++ ) {
+		sv_grid.coarse[i].entities = NULL;
+	}
+
+	sv_useWorldGrid = useGrid;
+
+	for ( i = 0 ; i < numLinked ; i++ ) {
+		ent = &sv.svEntities[linked[i]];
+		gEnt = SV_GEntityForSvEntity( ent );
+		node = SV_SectorForBox( gEnt->r.absmin, gEnt->r.absmax );
+		ent->worldSector = node;
+		ent->nextEntityInWorldSector = node->entities;
+		node->entities = ent;
+	}
+}
+
 /*
 ============================================================================
 
@@ -390,16 +645,17 @@ typedef struct {
 	const float *maxs;
 	int         *list;
 	int count, maxcount;
+	int scanned;                // entities looked at, for areabench
 } areaParms_t;
 
 
 /*
 ====================
-SV_AreaEntities_r
+SV_AreaEntitiesInSector
 
 ====================
 */
-void SV_AreaEntities_r( worldSector_t *node, areaParms_t *ap ) {
+static void SV_AreaEntitiesInSector( worldSector_t *node, areaParms_t *ap ) {
 	svEntity_t  *check, *next;
 	sharedEntity_t *gcheck;
 
@@ -407,6 +663,7 @@ void SV_AreaEntities_r( worldSector_t *node, areaParms_t *ap ) {
 		next = check->nextEntityInWorldSector;
 
 		gcheck = SV_GEntityForSvEntity( check );
+		ap->scanned++;
 
 		if ( gcheck->r.absmin[0] > ap->maxs[0]
 			 || gcheck->r.absmin[1] > ap->maxs[1]
@@ -425,6 +682,16 @@ void SV_AreaEntities_r( worldSector_t *node, areaParms_t *ap ) {
 		ap->list[ap->count] = check - sv.svEntities;
 		ap->count++;
 	}
+}
+
+/*
+====================
+SV_AreaEntities_r
+
+====================
+*/
+void SV_AreaEntities_r( worldSector_t *node, areaParms_t *ap ) {
+	SV_AreaEntitiesInSector( node, ap );
 
 	if ( node->axis == -1 ) {
 		return;     // terminal node
@@ -439,6 +706,52 @@ void SV_AreaEntities_r( worldSector_t *node, areaParms_t *ap ) {
 	}
 }
 
+/*
+====================
+SV_AreaEntitiesGrid
+
+Cells are visited in rows, so the cells for a smaller box come up in
+the same order as they do for a bigger one
+====================
+*/
+static void SV_AreaEntitiesGrid( areaParms_t *ap ) {
+	gridLevel_t     *level;
+	float margin;
+	int i, x, y, x0, x1, y0, y1;
+
+	SV_AreaEntitiesInSector( &sv_grid.large, ap );
+
+	for ( i = GRID_LEVELS - 1 ; i >= 0 ; i-- ) {
+		level = &sv_grid.levels[i];
+
+		// entities reach up to half a cell out of their own cell
+		margin = 0.5 * level->cellSize + 1;
+		x0 = SV_GridCell( level, ap->mins[0] - margin, 0 );
+		x1 = SV_GridCell( level, ap->maxs[0] + margin, 0 );
+		y0 = SV_GridCell( level, ap->mins[1] - margin, 1 );
+		y1 = SV_GridCell( level, ap->maxs[1] + margin, 1 );
+
+		for ( y = y0 ; y <= y1 ; y++ ) {
+			for ( x = x0 ; x <= x1 ; x++ ) {
+				SV_AreaEntitiesInSector( &level->sectors[y * level->cells[0] + x], ap );
+			}
+		}
+	}
+}
+
+/*
+================
+SV_AreaQuery
+================
+*/
+static void SV_AreaQuery( areaParms_t *ap ) {
+	if ( sv_useWorldGrid ) {
+		SV_AreaEntitiesGrid( ap );
+	} else {
+		SV_AreaEntities_r( sv_worldSectors, ap );
+	}
+}
+
 /*
 ================
 SV_AreaEntities
@@ -452,12 +765,114 @@ int SV_AreaEntities( const vec3_t mins, const vec3_t maxs, int *entityList, int
 	ap.list = entityList;
 	ap.count = 0;
 	ap.maxcount = maxcount;
+	ap.scanned = 0;
 
-	SV_AreaEntities_r( sv_worldSectors, &ap );
+	SV_AreaQuery( &ap );
 
 	return ap.count;
 }
 
+/*
+================
+SV_AreaBench_f
+
+Times the area queries the current entities would make, a move box
+around each of them and a shot from each client, with the sector tree
+and with the grid
+================
+*/
+#define MAX_BENCH_QUERIES   4096
+void SV_AreaBench_f( void ) {
+	static vec3_t queryMins[MAX_BENCH_QUERIES], queryMaxs[MAX_BENCH_QUERIES];
+	static int list[MAX_GENTITIES];
+	int numQueries, numLinked, iterations;
+	int i, j, it, pass;
+	int64_t start, usec[2];
+	int found[2], scanned[2];
+	unsigned checksum[2];
+	qboolean oldGrid;
+	vec3_t forward, end;
+	sharedEntity_t  *gEnt;
+	areaParms_t ap;
+
+	if ( !com_sv_running->integer ) {
+		Com_Printf( "Server is not running.\n" );
+		return;
+	}
+
+	iterations = Cmd_Argc() > 1 ? atoi( Cmd_Argv( 1 ) ) : 100;
+	if ( iterations < 1 ) {
+		iterations = 1;
+	}
+
+	numQueries = numLinked = 0;
+	for ( i = 0 ; i < sv.num_entities && numQueries < MAX_BENCH_QUERIES - 1 ; i++ ) {
+		if ( !sv.svEntities[i].worldSector ) {
+			continue;
+		}
+		gEnt = SV_GentityNum( i );
+		numLinked++;
+
+		// moving about
+		for ( j = 0 ; j < 3 ; j++ ) {
+			queryMins[numQueries][j] = gEnt->r.absmin[j] - 32;
+			queryMaxs[numQueries][j] = gEnt->r.absmax[j] + 32;
+		}
+		numQueries++;
+
+		// shooting the way they face
+		if ( i < sv_maxclients->integer ) {
+			AngleVectors( gEnt->r.currentAngles, forward, NULL, NULL );
+			VectorMA( gEnt->r.currentOrigin, 8192, forward, end );
+			ClearBounds( queryMins[numQueries], queryMaxs[numQueries] );
+			AddPointToBounds( gEnt->r.currentOrigin, queryMins[numQueries], queryMaxs[numQueries] );
+			AddPointToBounds( end, queryMins[numQueries], queryMaxs[numQueries] );
+			numQueries++;
+		}
+	}
+
+	Com_Printf( "%i linked entities, %i queries, %i iterations\n", numLinked, numQueries, iterations );
+
+	oldGrid = sv_useWorldGrid;
+	for ( pass = 0 ; pass < 2 ; pass++ ) {
+		SV_RelinkSectors( pass );
+
+		found[pass] = scanned[pass] = 0;
+		checksum[pass] = 0;
+		start = Sys_Microseconds();
+		for ( it = 0 ; it < iterations ; it++ ) {
+			for ( i = 0 ; i < numQueries ; i++ ) {
+				ap.mins = queryMins[i];
+				ap.maxs = queryMaxs[i];
+				ap.list = list;
+				ap.count = 0;
+				ap.maxcount = MAX_GENTITIES;
+				ap.scanned = 0;
+				SV_AreaQuery( &ap );
+
+				if ( !it ) {
+					found[pass] += ap.count;
+					scanned[pass] += ap.scanned;
+					// the two disagree on order, not on what they find
+					for ( j = 0 ; j < ap.count ; j++ ) {
+						checksum[pass] += ( list[j] + 1 ) * ( i + 1 );
+					}
+				}
+			}
+		}
+		usec[pass] = Sys_Microseconds() - start;
+	}
+	SV_RelinkSectors( oldGrid );
+
+	for ( pass = 0 ; pass < 2 ; pass++ ) {
+		Com_Printf( "%s %8.3f usec/query, %6.1f entities scanned, %6.1f found\n", pass ? "grid:" : "tree:",
+					numQueries ? usec[pass] / ( (double)iterations * numQueries ) : 0.0,
+					numQueries ? (float)scanned[pass] / numQueries : 0.0f,
+					numQueries ? (float)found[pass] / numQueries : 0.0f );
+	}
+	Com_Printf( "results %s\n", ( found[0] == found[1] && checksum[0] == checksum[1] ) ? "match" : "DIFFER" );
+}
+
 
 
 //===========================================================================
@@ -529,21 +944,18 @@ void SV_ClipToEntity( trace_t *trace, const vec3_t start, const vec3_t mins, con
 
 /*
 ====================
-SV_ClipMoveToEntities
+SV_ClipMoveToEntityList
 
 ====================
 */
-void SV_ClipMoveToEntities( moveclip_t *clip ) {
-	int i, num;
-	int touchlist[MAX_GENTITIES];
+static void SV_ClipMoveToEntityList( moveclip_t *clip, const int *touchlist, int num ) {
+	int i;
 	sharedEntity_t *touch;
 	int passOwnerNum;
 	trace_t trace;
 	clipHandle_t clipHandle;
 	float       *origin, *angles;
 
-	num = SV_AreaEntities( clip->boxmins, clip->boxmaxs, touchlist, MAX_GENTITIES );
-
 	if ( clip->passEntityNum != ENTITYNUM_NONE ) {
 		passOwnerNum = ( SV_GentityNum( clip->passEntityNum ) )->r.ownerNum;
 		if ( passOwnerNum == ENTITYNUM_NONE ) {
@@ -630,6 +1042,21 @@ void SV_ClipMoveToEntities( moveclip_t *clip ) {
 	}
 }
 
+/*
+====================
+SV_ClipMoveToEntities
+
+====================
+*/
+void SV_ClipMoveToEntities( moveclip_t *clip ) {
+	int num;
+	int touchlist[MAX_GENTITIES];
+
+	num = SV_AreaEntities( clip->boxmins, clip->boxmaxs, touchlist, MAX_GENTITIES );
+
+	SV_ClipMoveToEntityList( clip, touchlist, num );
+}
+
 
 /*
 ==================
@@ -691,6 +1118,339 @@ void SV_Trace( trace_t *results, const vec3_t start, const vec3_t mins, const ve
 
 
 
+/*
+===============================================================================
+
+BATCHED TRACES
+
+A burst of traces from the same place, like a spread of hitscan pellets or
+a sight check against several points, clips all its rays against the world
+together with CM_BoxTraceBatch and gathers the entities around the whole
+burst with a single area query.  Each ray then clips against the entities
+its own query would have returned, in the same order, so the results are
+exactly those of calling SV_Trace for every ray.
+
+===============================================================================
+*/
+
+#define MAX_TRACE_BATCH     32
+
+// the last bursts the game issued, for tracebench
+#define MAX_TRACE_LOG       64
+
+typedef struct {
+	vec3_t starts[MAX_TRACE_BATCH];
+	vec3_t ends[MAX_TRACE_BATCH];
+	vec3_t mins, maxs;
+	int count;
+	int passEntityNum;
+	int contentmask;
+} traceBurst_t;
+
+static traceBurst_t sv_traceLog[MAX_TRACE_LOG];
+static qboolean sv_traceLogPaused;
+
+/*
+==================
+SV_LogTraceBurst
+==================
+*/
+static void SV_LogTraceBurst( int count, const vec3_t *starts, const vec3_t mins, const vec3_t maxs,
+							  const vec3_t *ends, int passEntityNum, int contentmask ) {
+	traceBurst_t    *burst;
+
+	if ( sv_traceLogPaused ) {
+		return;
+	}
+	if ( count > MAX_TRACE_BATCH ) {
+		count = MAX_TRACE_BATCH;
+	}
+
+	burst = &sv_traceLog[sv_traceLogCount % MAX_TRACE_LOG];
+	sv_traceLogCount++;
+
+	memcpy( burst->starts, starts, count * sizeof( vec3_t ) );
+	memcpy( burst->ends, ends, count * sizeof( vec3_t ) );
+	VectorCopy( mins, burst->mins );
+	VectorCopy( maxs, burst->maxs );
+	burst->count = count;
+	burst->passEntityNum = passEntityNum;
+	burst->contentmask = contentmask;
+}
+
+/*
+==================
+SV_TraceBatch
+
+Same as calling SV_Trace for each start / end pair, all the rays share
+mins / maxs, passEntityNum and contentmask.  There are no capsule batches.
+==================
+*/
+void SV_TraceBatch( trace_t *results, int count, const vec3_t *starts, const vec3_t mins, const vec3_t maxs,
+					const vec3_t *ends, int passEntityNum, int contentmask ) {
+	moveclip_t clip;
+	vec3_t boxmins[MAX_TRACE_BATCH], boxmaxs[MAX_TRACE_BATCH];
+	vec3_t areamins, areamaxs;
+	int touchlist[MAX_GENTITIES];
+	int raylist[MAX_GENTITIES];
+	int first, num, numRays, numTouch, numListed;
+	int i, j, k;
+	trace_t         *tr;
+	sharedEntity_t  *touch;
+
+	if ( !mins ) {
+		mins = vec3_origin;
+	}
+	if ( !maxs ) {
+		maxs = vec3_origin;
+	}
+	if ( count <= 0 ) {
+		return;
+	}
+
+	SV_LogTraceBurst( count, starts, mins, maxs, ends, passEntityNum, contentmask );
+
+	for ( first = 0 ; first < count ; first += MAX_TRACE_BATCH ) {
+		num = count - first;
+		if ( num > MAX_TRACE_BATCH ) {
+			num = MAX_TRACE_BATCH;
+		}
+
+		// clip to world
+		CM_BoxTraceBatch( results + first, num, starts + first, ends + first, mins, maxs, contentmask );
+
+		// the box of each move, the same one SV_Trace would use
+		ClearBounds( areamins, areamaxs );
+		numRays = 0;
+		for ( i = 0 ; i < num ; i++ ) {
+			tr = &results[first + i];
+			tr->entityNum = tr->fraction != 1.0 ? ENTITYNUM_WORLD : ENTITYNUM_NONE;
+			if ( tr->fraction == 0 ) {
+				continue;   // blocked immediately by the world
+			}
+
+			for ( k = 0 ; k < 3 ; k++ ) {
+				if ( ends[first + i][k] > starts[first + i][k] ) {
+					boxmins[i][k] = starts[first + i][k] + mins[k] - 1;
+					boxmaxs[i][k] = ends[first + i][k] + maxs[k] + 1;
+				} else {
+					boxmins[i][k] = ends[first + i][k] + mins[k] - 1;
+					boxmaxs[i][k] = starts[first + i][k] + maxs[k] + 1;
+				}
+			}
+			AddPointToBounds( boxmins[i], areamins, areamaxs );
+			AddPointToBounds( boxmaxs[i], areamins, areamaxs );
+			numRays++;
+		}
+		if ( !numRays ) {
+			continue;
+		}
+
+		// one walk of the sectors for the whole burst
+		numTouch = SV_AreaEntities( areamins, areamaxs, touchlist, MAX_GENTITIES );
+
+		for ( i = 0 ; i < num ; i++ ) {
+			tr = &results[first + i];
+			if ( tr->fraction == 0 ) {
+				continue;
+			}
+
+			// a sector walk for a smaller box visits a subset of the
+			// same sectors in the same order, so filtering the list
+			// keeps the order SV_AreaEntities would have given
+			numListed = 0;
+			for ( j = 0 ; j < numTouch ; j++ ) {
+				touch = SV_GentityNum( touchlist[j] );
+				if ( touch->r.absmin[0] > boxmaxs[i][0]
+					 || touch->r.absmin[1] > boxmaxs[i][1]
+					 || touch->r.absmin[2] > boxmaxs[i][2]
+					 || touch->r.absmax[0] < boxmins[i][0]
+					 || touch->r.absmax[1] < boxmins[i][1]
+					 || touch->r.absmax[2] < boxmins[i][2] ) {
+					continue;
+				}
+				raylist[numListed++] = touchlist[j];
+			}
+			if ( !numListed ) {
+				continue;
+			}
+
+			memset( &clip, 0, sizeof( moveclip_t ) );
+			clip.trace = *tr;
+			clip.contentmask = contentmask;
+			clip.start = starts[first + i];
+			VectorCopy( ends[first + i], clip.end );
+			clip.mins = mins;
+			clip.maxs = maxs;
+			clip.passEntityNum = passEntityNum;
+			VectorCopy( boxmins[i], clip.boxmins );
+			VectorCopy( boxmaxs[i], clip.boxmaxs );
+
+			// clip to other solid entities
+			SV_ClipMoveToEntityList( &clip, raylist, numListed );
+
+			*tr = clip.trace;
+		}
+	}
+}
+
+/*
+==================
+SV_RandomOpenPoint
+==================
+*/
+static void SV_RandomOpenPoint( const vec3_t mins, const vec3_t maxs, vec3_t point ) {
+	int i, tries;
+
+	for ( tries = 0 ; tries < 64 ; tries++ ) {
+		for ( i = 0 ; i < 3 ; i++ ) {
+			point[i] = mins[i] + random() * ( maxs[i] - mins[i] );
+		}
+		if ( !( CM_PointContents( point, 0 ) & CONTENTS_SOLID ) ) {
+			return;
+		}
+	}
+}
+
+/*
+==================
+SV_MakeTraceBursts
+
+Bursts shaped like the ones the game fires when nothing has been logged
+yet, spreads of pellets and sight checks against the corners of a box.
+==================
+*/
+static int SV_MakeTraceBursts( traceBurst_t *bursts, int maxBursts ) {
+	vec3_t worldmins, worldmaxs;
+	vec3_t forward, right, up, target;
+	traceBurst_t    *burst;
+	int i, j;
+
+	CM_ModelBounds( CM_InlineModel( 0 ), worldmins, worldmaxs );
+
+	for ( i = 0 ; i < maxBursts ; i++ ) {
+		burst = &bursts[i];
+		Com_Memset( burst, 0, sizeof( *burst ) );
+		burst->passEntityNum = ENTITYNUM_NONE;
+		burst->contentmask = CONTENTS_SOLID | CONTENTS_BODY | CONTENTS_CORPSE;
+
+		SV_RandomOpenPoint( worldmins, worldmaxs, burst->starts[0] );
+
+		if ( i & 1 ) {
+			// ten pellets in a cone
+			burst->count = 10;
+			for ( j = 0 ; j < 3 ; j++ ) {
+				forward[j] = crandom();
+			}
+			VectorNormalize( forward );
+			PerpendicularVector( right, forward );
+			CrossProduct( forward, right, up );
+			for ( j = 0 ; j < burst->count ; j++ ) {
+				VectorCopy( burst->starts[0], burst->starts[j] );
+				VectorMA( burst->starts[j], 8192, forward, burst->ends[j] );
+				VectorMA( burst->ends[j], crandom() * 20, right, burst->ends[j] );
+				VectorMA( burst->ends[j], crandom() * 20, up, burst->ends[j] );
+			}
+		} else {
+			// head, chest and feet of someone else
+			burst->count = 4;
+			SV_RandomOpenPoint( worldmins, worldmaxs, target );
+			for ( j = 0 ; j < burst->count ; j++ ) {
+				VectorCopy( burst->starts[0], burst->starts[j] );
+				VectorCopy( target, burst->ends[j] );
+				burst->ends[j][0] += ( j & 1 ) ? 12 : -12;
+				burst->ends[j][2] += ( j & 2 ) ? 40 : -20;
+			}
+		}
+	}
+
+	return maxBursts;
+}
+
+/*
+==================
+SV_TraceBench_f
+
+Replays the last bursts of traces the game issued, or made up ones if there
+are none, through serial SV_Trace calls and through SV_TraceBatch
+==================
+*/
+void SV_TraceBench_f( void ) {
+	static traceBurst_t bursts[MAX_TRACE_LOG];
+	static trace_t results[2][MAX_TRACE_LOG][MAX_TRACE_BATCH];
+	int numBursts, rays, iterations;
+	int i, j, it, pass, mismatches;
+	int64_t start, usec[2];
+	traceBurst_t    *burst;
+	trace_t         *a, *b;
+
+	if ( !com_sv_running->integer ) {
+		Com_Printf( "Server is not running.\n" );
+		return;
+	}
+
+	iterations = Cmd_Argc() > 1 ? atoi( Cmd_Argv( 1 ) ) : 100;
+	if ( iterations < 1 ) {
+		iterations = 1;
+	}
+
+	if ( sv_traceLogCount ) {
+		numBursts = sv_traceLogCount < MAX_TRACE_LOG ? sv_traceLogCount : MAX_TRACE_LOG;
+		Com_Memcpy( bursts, sv_traceLog, numBursts * sizeof( traceBurst_t ) );
+		Com_Printf( "replaying %i logged bursts\n", numBursts );
+	} else {
+		numBursts = SV_MakeTraceBursts( bursts, MAX_TRACE_LOG );
+		Com_Printf( "no bursts logged, using %i synthetic ones\n", numBursts );
+	}
+
+	rays = 0;
+	for ( i = 0 ; i < numBursts ; i++ ) {
+		rays += bursts[i].count;
+	}
+
+	sv_traceLogPaused = qtrue;
+	for ( pass = 0 ; pass < 2 ; pass++ ) {
+		start = Sys_Microseconds();
+		for ( it = 0 ; it < iterations ; it++ ) {
+			for ( i = 0, burst = bursts ; i < numBursts ; i++, burst++ ) {
+				if ( pass ) {
+					SV_TraceBatch( results[pass][i], burst->count, (const vec3_t *)burst->starts, burst->mins, burst->maxs,
+								   (const vec3_t *)burst->ends, burst->passEntityNum, burst->contentmask );
+					continue;
+				}
+				for ( j = 0 ; j < burst->count ; j++ ) {
+					SV_Trace( &results[pass][i][j], burst->starts[j], burst->mins, burst->maxs, burst->ends[j],
+							  burst->passEntityNum, burst->contentmask, qfalse );
+				}
+			}
+		}
+		usec[pass] = Sys_Microseconds() - start;
+	}
+	sv_traceLogPaused = qfalse;
+
+	mismatches = 0;
+	for ( i = 0 ; i < numBursts ; i++ ) {
+		for ( j = 0 ; j < bursts[i].count ; j++ ) {
+			a = &results[0][i][j];
+			b = &results[1][i][j];
+			if ( a->fraction != b->fraction || !VectorCompare( a->endpos, b->endpos )
+				 || a->entityNum != b->entityNum || a->allsolid != b->allsolid || a->startsolid != b->startsolid
+				 || a->contents != b->contents || a->surfaceFlags != b->surfaceFlags
+				 || !VectorCompare( a->plane.normal, b->plane.normal ) || a->plane.dist != b->plane.dist ) {
+				mismatches++;
+			}
+		}
+	}
+
+	Com_Printf( "%i rays, %i iterations\n", rays, iterations );
+	Com_Printf( "serial: %10.0f rays/sec\n", usec[0] ? rays * (double)iterations * 1000000.0 / usec[0] : 0.0 );
+	Com_Printf( "batch:  %10.0f rays/sec  %5.2fx\n", usec[1] ? rays * (double)iterations * 1000000.0 / usec[1] : 0.0,
+				usec[1] ? (double)usec[0] / usec[1] : 0.0 );
+	Com_Printf( "results %s (%i mismatches)\n", mismatches ? "DIFFER" : "match", mismatches );
+}
+
+
+
 /*
 =============
 SV_PointContents
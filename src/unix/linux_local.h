@@ -36,6 +36,7 @@ If you have questions concerning this license or the applicable additional terms
 
 void Sys_QueEvent( int time, sysEventType_t type, int value, int value2, int ptrLength, void *ptr );
 qboolean Sys_GetPacket( netadr_t *net_from, msg_t *net_message );
+qboolean Sys_GetTimedPacket( netadr_t *net_from, msg_t *net_message, int *time );
 void Sys_SendKeyEvents( void );
 
 // Input subsystem
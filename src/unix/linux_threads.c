@@ -82,4 +82,219 @@ int Threads_Create(void* (*thread_function)(void*), void* arguments) {
 
 	Com_DPrintf("Thread created.\n");
 	return g_pthread_create(&thread_id, NULL, thread_function, arguments);
-}
\ No newline at end of file
+}
+
+/*
+===============
+Threads_CreateJoinable
+===============
+*/
+int Threads_CreateJoinable(threadHandle_t* thread, void* (*thread_function)(void*), void* arguments) {
+	if (g_pthread_create == NULL) {
+		return -1;
+	}
+
+	Com_DPrintf("Thread created.\n");
+	return g_pthread_create(thread, NULL, thread_function, arguments);
+}
+
+/*
+===============
+Threads_Join
+===============
+*/
+void Threads_Join(threadHandle_t thread) {
+	pthread_join(thread, NULL);
+}
+
+/*
+=============================================================================
+
+WORKER POOL
+
+=============================================================================
+*/
+
+typedef struct {
+	pthread_mutex_t lock;
+	pthread_cond_t wake;            // a new batch was posted or the pool is stopping
+	pthread_cond_t done;            // the last job of the batch has finished
+
+	pthread_t threads[MAX_WORKER_THREADS];
+	int numThreads;
+	qboolean quit;
+
+	threadJob_t job;
+	void* data;
+	int count;
+	int next;                       // next index to hand out
+	int pending;                    // handed out or not, but not yet finished
+} workerPool_t;
+
+static workerPool_t pool = {
+	PTHREAD_MUTEX_INITIALIZER,
+	PTHREAD_COND_INITIALIZER,
+	PTHREAD_COND_INITIALIZER
+};
+
+/*
+===============
+Threads_DrainJobs
+
+Must be called with the pool locked, returns locked
+===============
+*/
+static void Threads_DrainJobs(void) {
+	threadJob_t job;
+	void* data;
+	int index;
+
+	while (pool.next < pool.count) {
+		index = pool.next++;
+		job = pool.job;
+		data = pool.data;
+
+		pthread_mutex_unlock(&pool.lock);
+		job(data, index);
+		pthread_mutex_lock(&pool.lock);
+
+		if (--pool.pending == 0) {
+			pthread_cond_signal(&pool.done);
+		}
+	}
+}
+
+/*
+===============
+Threads_WorkerLoop
+===============
+*/
+static void* Threads_WorkerLoop(void* arguments) {
+	pthread_mutex_lock(&pool.lock);
+	for (;;) {
+		while (!pool.quit && pool.next >= pool.count) {
+			pthread_cond_wait(&pool.wake, &pool.lock);
+		}
+		if (pool.quit) {
+			break;
+		}
+		Threads_DrainJobs();
+	}
+	pthread_mutex_unlock(&pool.lock);
+
+	return NULL;
+}
+
+/*
+===============
+Threads_InitWorkers
+===============
+*/
+void Threads_InitWorkers(int numWorkers) {
+	int i;
+
+	if (numWorkers < 0) {
+		numWorkers = 0;
+	} else if (numWorkers > MAX_WORKER_THREADS) {
+		numWorkers = MAX_WORKER_THREADS;
+	}
+
+	if (numWorkers == pool.numThreads) {
+		return;
+	}
+
+	// stop the current workers
+	if (pool.numThreads) {
+		pthread_mutex_lock(&pool.lock);
+		pool.quit = qtrue;
+		pthread_cond_broadcast(&pool.wake);
+		pthread_mutex_unlock(&pool.lock);
+
+		for (i = 0; i < pool.numThreads; i++) {
+			pthread_join(pool.threads[i], NULL);
+		}
+		pool.numThreads = 0;
+		pool.quit = qfalse;
+	}
+
+	if (g_pthread_create == NULL) {
+		return;
+	}
+
+	for (i = 0; i < numWorkers; i++) {
+		if (g_pthread_create(&pool.threads[i], NULL, Threads_WorkerLoop, NULL) != 0) {
+			Com_Printf("Threads_InitWorkers: only %i of %i workers started\n", i, numWorkers);
+			break;
+		}
+		pool.numThreads++;
+	}
+
+	Com_DPrintf("%i worker threads running.\n", pool.numThreads);
+}
+
+/*
+===============
+Threads_NumWorkers
+===============
+*/
+int Threads_NumWorkers(void) {
+	return pool.numThreads;
+}
+
+/*
+===============
+Threads_RunJobs
+===============
+*/
+void Threads_RunJobs(threadJob_t job, void* data, int count) {
+	int i;
+
+	if (count <= 0) {
+		return;
+	}
+
+	if (!pool.numThreads || count == 1) {
+		for (i = 0; i < count; i++) {
+			job(data, i);
+		}
+		return;
+	}
+
+	pthread_mutex_lock(&pool.lock);
+	pool.job = job;
+	pool.data = data;
+	pool.count = count;
+	pool.next = 0;
+	pool.pending = count;
+	pthread_cond_broadcast(&pool.wake);
+
+	// the calling thread works too
+	Threads_DrainJobs();
+
+	while (pool.pending) {
+		pthread_cond_wait(&pool.done, &pool.lock);
+	}
+	pool.count = 0;
+	pool.next = 0;
+	pthread_mutex_unlock(&pool.lock);
+}
+
+/*
+=============================================================================
+
+ATOMICS
+
+=============================================================================
+*/
+
+int Threads_AtomicAdd(volatile int* value, int amount) {
+	return __sync_fetch_and_add(value, amount);
+}
+
+qboolean Threads_CompareExchange(volatile int* value, int expected, int desired) {
+	return __sync_bool_compare_and_swap(value, expected, desired) ? qtrue : qfalse;
+}
+
+void Threads_MemoryBarrier(void) {
+	__sync_synchronize();
+}
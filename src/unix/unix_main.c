@@ -1088,6 +1088,7 @@ sysEvent_t Sys_GetEvent( void ) {
 	char    *s;
 	msg_t netmsg;
 	netadr_t adr;
+	int time;
 
 	// return if we have data
 	if ( eventHead > eventTail ) {
@@ -1113,7 +1114,7 @@ sysEvent_t Sys_GetEvent( void ) {
 
 	// check for network packets
 	MSG_Init( &netmsg, sys_packetReceived, sizeof( sys_packetReceived ) );
-	if ( Sys_GetPacket( &adr, &netmsg ) ) {
+	if ( Sys_GetTimedPacket( &adr, &netmsg, &time ) ) {
 		netadr_t    *buf;
 		int len;
 
@@ -1122,7 +1123,7 @@ sysEvent_t Sys_GetEvent( void ) {
 		buf = Z_Malloc( len );
 		*buf = adr;
 		memcpy( buf + 1, netmsg.data, netmsg.cursize );
-		Sys_QueEvent( 0, SE_PACKET, 0, 0, len, buf );
+		Sys_QueEvent( time, SE_PACKET, 0, 0, len, buf );
 	}
 
 	// return if we have data
@@ -28,6 +28,10 @@ If you have questions concerning this license or the applicable additional terms
 
 // unix_net.c
 
+#ifdef __linux__
+#define _GNU_SOURCE     // recvmmsg / sendmmsg
+#endif
+
 #include "../game/q_shared.h"
 #include "../qcommon/qcommon.h"
 
@@ -43,6 +47,12 @@ If you have questions concerning this license or the applicable additional terms
 #include <sys/uio.h>
 #include <errno.h>
 
+#ifdef __linux__
+#include <poll.h>
+#include <fcntl.h>
+#include "../qcommon/threads.h"
+#endif
+
 #ifdef MACOS_X
 #import <sys/sockio.h>
 #import <net/if.h>
@@ -53,10 +63,14 @@ If you have questions concerning this license or the applicable additional terms
 #endif
 
 static cvar_t   *noudp;
+static cvar_t   *net_batch;
+static cvar_t   *net_ipv6;
+static cvar_t   *net_recvThread;
 
 netadr_t net_local_adr;
 
 int ip_socket;
+static int ip_family;           // AF_INET6 when ip_socket is dual-stack
 
 #define MAX_IPS     16
 static int numIP;
@@ -67,64 +81,142 @@ char *NET_ErrorString( void );
 
 //=============================================================================
 
-void NetadrToSockadr( netadr_t *a, struct sockaddr_in *s ) {
+/*
+==================
+NetadrToSockadr
+
+The dual-stack socket reaches IPv4 hosts through v4-mapped addresses.
+Returns the length of the address, 0 if it can't be sent to
+==================
+*/
+socklen_t NetadrToSockadr( netadr_t *a, struct sockaddr_storage *s ) {
+	struct sockaddr_in      *s4;
+	struct sockaddr_in6     *s6;
+
 	memset( s, 0, sizeof( *s ) );
 
-	if ( a->type == NA_BROADCAST ) {
-		s->sin_family = AF_INET;
+	if ( a->type == NA_IP6 ) {
+		s6 = (struct sockaddr_in6 *)s;
+		s6->sin6_family = AF_INET6;
+		memcpy( &s6->sin6_addr, a->ip6, sizeof( a->ip6 ) );
+		s6->sin6_port = a->port;
+		s6->sin6_scope_id = a->scope_id;
+		return sizeof( *s6 );
+	}
 
-		s->sin_port = a->port;
-		*(int *)&s->sin_addr = -1;
-	} else if ( a->type == NA_IP )     {
-		s->sin_family = AF_INET;
+	if ( a->type != NA_IP && a->type != NA_BROADCAST ) {
+		return 0;
+	}
+
+	if ( ip_family == AF_INET6 ) {
+		s6 = (struct sockaddr_in6 *)s;
+		s6->sin6_family = AF_INET6;
+		s6->sin6_addr.s6_addr[10] = 0xff;
+		s6->sin6_addr.s6_addr[11] = 0xff;
+		if ( a->type == NA_BROADCAST ) {
+			memset( &s6->sin6_addr.s6_addr[12], 0xff, 4 );
+		} else {
+			memcpy( &s6->sin6_addr.s6_addr[12], a->ip, 4 );
+		}
+		s6->sin6_port = a->port;
+		return sizeof( *s6 );
+	}
 
-		*(int *)&s->sin_addr = *(int *)&a->ip;
-		s->sin_port = a->port;
+	s4 = (struct sockaddr_in *)s;
+	s4->sin_family = AF_INET;
+	if ( a->type == NA_BROADCAST ) {
+		*(int *)&s4->sin_addr = -1;
+	} else {
+		*(int *)&s4->sin_addr = *(int *)&a->ip;
 	}
+	s4->sin_port = a->port;
+	return sizeof( *s4 );
 }
 
-void SockadrToNetadr( struct sockaddr_in *s, netadr_t *a ) {
-	*(int *)&a->ip = *(int *)&s->sin_addr;
-	a->port = s->sin_port;
+/*
+==================
+SockadrToNetadr
+
+v4-mapped addresses from the dual-stack socket come back as plain NA_IP
+==================
+*/
+void SockadrToNetadr( struct sockaddr_storage *s, netadr_t *a ) {
+	struct sockaddr_in6     *s6;
+
+	memset( a, 0, sizeof( *a ) );
+
+	if ( s->ss_family == AF_INET6 ) {
+		s6 = (struct sockaddr_in6 *)s;
+		if ( IN6_IS_ADDR_V4MAPPED( &s6->sin6_addr ) ) {
+			a->type = NA_IP;
+			memcpy( a->ip, &s6->sin6_addr.s6_addr[12], 4 );
+		} else {
+			a->type = NA_IP6;
+			memcpy( a->ip6, &s6->sin6_addr, sizeof( a->ip6 ) );
+			a->scope_id = s6->sin6_scope_id;
+		}
+		a->port = s6->sin6_port;
+		return;
+	}
+
+	*(int *)&a->ip = *(int *)&( (struct sockaddr_in *)s )->sin_addr;
+	a->port = ( (struct sockaddr_in *)s )->sin_port;
 	a->type = NA_IP;
 }
 
 char    *NET_BaseAdrToString( netadr_t a ) {
 	static char s[64];
 
-	Com_sprintf( s, sizeof( s ), "%i.%i.%i.%i", a.ip[0], a.ip[1], a.ip[2], a.ip[3] );
+	if ( a.type == NA_IP6 ) {
+		inet_ntop( AF_INET6, a.ip6, s, sizeof( s ) );
+	} else {
+		Com_sprintf( s, sizeof( s ), "%i.%i.%i.%i", a.ip[0], a.ip[1], a.ip[2], a.ip[3] );
+	}
 
 	return s;
 }
 
 /*
 =============
-Sys_StringToAdr
+Sys_StringToSockaddr
 
 idnewt
 192.246.40.70
+::1
+
+Names that resolve to both are used over IPv4
 =============
 */
-qboolean    Sys_StringToSockaddr( const char *s, struct sockaddr *sadr ) {
-	struct hostent  *h;
-	//char	*colon; // bk001204 - unused
+qboolean    Sys_StringToSockaddr( const char *s, struct sockaddr_storage *sadr ) {
+	struct addrinfo hints;
+	struct addrinfo *res, *r, *found;
 
 	memset( sadr, 0, sizeof( *sadr ) );
-	( (struct sockaddr_in *)sadr )->sin_family = AF_INET;
+	memset( &hints, 0, sizeof( hints ) );
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_DGRAM;
 
-	( (struct sockaddr_in *)sadr )->sin_port = 0;
+	if ( getaddrinfo( s, NULL, &hints, &res ) ) {
+		return qfalse;
+	}
 
-	if ( s[0] >= '0' && s[0] <= '9' ) {
-		*(int *)&( (struct sockaddr_in *)sadr )->sin_addr = inet_addr( s );
-	} else
-	{
-		if ( !( h = gethostbyname( s ) ) ) {
-			return qfalse;
+	found = NULL;
+	for ( r = res ; r ; r = r->ai_next ) {
+		if ( r->ai_family == AF_INET ) {
+			found = r;
+			break;
+		}
+		if ( r->ai_family == AF_INET6 && !found ) {
+			found = r;
 		}
-		*(int *)&( (struct sockaddr_in *)sadr )->sin_addr = *(int *)h->h_addr_list[0];
 	}
 
-	return qtrue;
+	if ( found ) {
+		memcpy( sadr, found->ai_addr, found->ai_addrlen );
+	}
+	freeaddrinfo( res );
+
+	return found ? qtrue : qfalse;
 }
 
 /*
@@ -139,9 +231,9 @@ idnewt:28000
 =============
 */
 qboolean    Sys_StringToAdr( const char *s, netadr_t *a ) {
-	struct sockaddr_in sadr;
+	struct sockaddr_storage sadr;
 
-	if ( !Sys_StringToSockaddr( s, (struct sockaddr *)&sadr ) ) {
+	if ( !Sys_StringToSockaddr( s, &sadr ) ) {
 		return qfalse;
 	}
 
@@ -153,9 +245,9 @@ qboolean    Sys_StringToAdr( const char *s, netadr_t *a ) {
 
 //=============================================================================
 
-qboolean    Sys_GetPacket( netadr_t *net_from, msg_t *net_message ) {
+static qboolean NET_GetPacket( netadr_t *net_from, msg_t *net_message ) {
 	int ret;
-	struct sockaddr_in from;
+	struct sockaddr_storage from;
 	int fromlen;
 	int net_socket;
 	int protocol;
@@ -204,14 +296,15 @@ qboolean    Sys_GetPacket( netadr_t *net_from, msg_t *net_message ) {
 
 //=============================================================================
 
-void    Sys_SendPacket( int length, const void *data, netadr_t to ) {
+static void NET_SendPacketTo( int length, const void *data, netadr_t to ) {
 	int ret;
-	struct sockaddr_in addr;
+	struct sockaddr_storage addr;
+	socklen_t addrlen;
 	int net_socket;
 
 	if ( to.type == NA_BROADCAST ) {
 		net_socket = ip_socket;
-	} else if ( to.type == NA_IP )     {
+	} else if ( to.type == NA_IP || to.type == NA_IP6 ) {
 		net_socket = ip_socket;
 	} else {
 		Com_Error( ERR_FATAL, "NET_SendPacket: bad address type" );
@@ -222,9 +315,13 @@ void    Sys_SendPacket( int length, const void *data, netadr_t to ) {
 		return;
 	}
 
-	NetadrToSockadr( &to, &addr );
+	addrlen = NetadrToSockadr( &to, &addr );
+	if ( !addrlen ) {
+		Com_Printf( "NET_SendPacket: no IPv6 socket for %s\n", NET_AdrToString( to ) );
+		return;
+	}
 
-	ret = sendto( net_socket, data, length, 0, (struct sockaddr *)&addr, sizeof( addr ) );
+	ret = sendto( net_socket, data, length, 0, (struct sockaddr *)&addr, addrlen );
 	if ( ret == -1 ) {
 		Com_Printf( "NET_SendPacket ERROR: %s to %s\n", NET_ErrorString(),
 					NET_AdrToString( to ) );
@@ -233,6 +330,774 @@ void    Sys_SendPacket( int length, const void *data, netadr_t to ) {
 
 //=============================================================================
 
+/*
+=============================================================================
+
+BATCHED PACKETS
+
+On linux the socket is drained with one recvmmsg into a ring of packets
+that Sys_GetPacket hands out one at a time.  Between Sys_BeginPacketBatch
+and Sys_FlushPacketBatch outgoing packets are queued and go out with a
+single sendmmsg.  net_batch 0, or a kernel without the calls, falls back
+to a recvfrom / sendto per packet.
+
+=============================================================================
+*/
+
+#define MAX_RECV_BATCH      32
+#define MAX_SEND_BATCH      64
+#define MAX_BATCH_PACKET    1500        // bigger packets are sent on their own
+
+typedef struct {
+	int recvCalls;
+	int recvPackets;
+	int sendCalls;
+	int sendPackets;
+
+	// packets handed over by the receive thread
+	int queuedPackets;
+	int queueDelayTotal;            // msec between arrival and Sys_GetPacket
+	int queueDelayMax;
+} netStats_t;
+
+static netStats_t netStats;
+
+#ifdef __linux__
+
+typedef struct {
+	qboolean disabled;                  // the kernel doesn't have the calls
+
+	// received packets not handed out yet
+	struct mmsghdr recvHdrs[MAX_RECV_BATCH];
+	struct iovec recvIovs[MAX_RECV_BATCH];
+	struct sockaddr_storage recvAddrs[MAX_RECV_BATCH];
+	byte recvData[MAX_RECV_BATCH][MAX_MSGLEN];
+	int recvCount;
+	int recvNext;
+
+	// queued outgoing packets
+	qboolean sending;
+	struct mmsghdr sendHdrs[MAX_SEND_BATCH];
+	struct iovec sendIovs[MAX_SEND_BATCH];
+	struct sockaddr_storage sendAddrs[MAX_SEND_BATCH];
+	netadr_t sendTo[MAX_SEND_BATCH];
+	byte sendData[MAX_SEND_BATCH][MAX_BATCH_PACKET];
+	int sendCount;
+} netBatch_t;
+
+static netBatch_t netBatch;
+
+/*
+==================
+NET_ReceiveBatch
+
+Reads up to MAX_RECV_BATCH packets into netBatch without printing
+anything, so the receive thread can use it too
+==================
+*/
+static int NET_ReceiveBatch( void ) {
+	int i;
+
+	for ( i = 0 ; i < MAX_RECV_BATCH ; i++ ) {
+		netBatch.recvIovs[i].iov_base = netBatch.recvData[i];
+		netBatch.recvIovs[i].iov_len = sizeof( netBatch.recvData[i] );
+		memset( &netBatch.recvHdrs[i], 0, sizeof( netBatch.recvHdrs[i] ) );
+		netBatch.recvHdrs[i].msg_hdr.msg_name = &netBatch.recvAddrs[i];
+		netBatch.recvHdrs[i].msg_hdr.msg_namelen = sizeof( netBatch.recvAddrs[i] );
+		netBatch.recvHdrs[i].msg_hdr.msg_iov = &netBatch.recvIovs[i];
+		netBatch.recvHdrs[i].msg_hdr.msg_iovlen = 1;
+	}
+
+	return recvmmsg( ip_socket, netBatch.recvHdrs, MAX_RECV_BATCH, MSG_DONTWAIT, NULL );
+}
+
+/*
+==================
+NET_FillRecvBatch
+==================
+*/
+static void NET_FillRecvBatch( void ) {
+	int ret;
+
+	netBatch.recvCount = 0;
+	netBatch.recvNext = 0;
+
+	ret = NET_ReceiveBatch();
+	if ( ret == -1 ) {
+		if ( errno == ENOSYS ) {
+			Com_Printf( "recvmmsg not available, not batching packets\n" );
+			netBatch.disabled = qtrue;
+		} else if ( errno != EWOULDBLOCK && errno != EAGAIN && errno != ECONNREFUSED ) {
+			Com_Printf( "NET_GetPacket: %s\n", NET_ErrorString() );
+		}
+		return;
+	}
+
+	netStats.recvCalls++;
+	netStats.recvPackets += ret;
+	netBatch.recvCount = ret;
+}
+
+/*
+==================
+NET_GetBatchedPacket
+==================
+*/
+static qboolean NET_GetBatchedPacket( netadr_t *net_from, msg_t *net_message ) {
+	struct mmsghdr  *hdr;
+	int len;
+
+	while ( 1 ) {
+		if ( netBatch.recvNext >= netBatch.recvCount ) {
+			if ( netBatch.disabled || !net_batch->integer ) {
+				return qfalse;
+			}
+			NET_FillRecvBatch();
+			if ( !netBatch.recvCount ) {
+				return qfalse;
+			}
+		}
+
+		hdr = &netBatch.recvHdrs[netBatch.recvNext];
+		SockadrToNetadr( &netBatch.recvAddrs[netBatch.recvNext], net_from );
+		net_message->readcount = 0;
+		len = hdr->msg_len;
+
+		if ( ( hdr->msg_hdr.msg_flags & MSG_TRUNC ) || len >= net_message->maxsize ) {
+			Com_Printf( "Oversize packet from %s\n", NET_AdrToString( *net_from ) );
+			netBatch.recvNext++;
+			continue;
+		}
+
+		Com_Memcpy( net_message->data, netBatch.recvData[netBatch.recvNext], len );
+		net_message->cursize = len;
+		netBatch.recvNext++;
+		return qtrue;
+	}
+}
+
+/*
+==================
+NET_QueuePacket
+
+Returns qfalse if the packet has to be sent right away
+==================
+*/
+static qboolean NET_QueuePacket( int length, const void *data, netadr_t to ) {
+	if ( !netBatch.sending || netBatch.disabled || length > MAX_BATCH_PACKET ) {
+		return qfalse;
+	}
+	if ( to.type != NA_IP && to.type != NA_IP6 && to.type != NA_BROADCAST ) {
+		return qfalse;
+	}
+	if ( to.type == NA_IP6 && ip_family != AF_INET6 ) {
+		return qfalse;
+	}
+
+	if ( netBatch.sendCount == MAX_SEND_BATCH ) {
+		Sys_FlushPacketBatch();
+		netBatch.sending = qtrue;
+	}
+
+	Com_Memcpy( netBatch.sendData[netBatch.sendCount], data, length );
+	netBatch.sendIovs[netBatch.sendCount].iov_len = length;
+	netBatch.sendTo[netBatch.sendCount] = to;
+	netBatch.sendCount++;
+
+	return qtrue;
+}
+
+/*
+=============================================================================
+
+RECEIVE THREAD
+
+With net_recvThread 1 a thread blocks on the socket, stamps every packet
+with Sys_Milliseconds as it arrives and appends it to a byte ring that
+Sys_GetPacket drains.  Only the thread writes writePos and only the main
+thread writes readPos, so the ring needs nothing more than barriers.
+A long server frame no longer leaves packets sitting in the socket
+buffer, and ping is measured from the real arrival time.
+
+The thread never prints; the main thread reports its counters in
+net_stats.  Stopping the thread joins it and leaves whatever it queued
+in the ring, which Sys_GetPacket keeps draining before the socket.
+
+=============================================================================
+*/
+
+#define RECV_RING_SIZE      ( 1 << 20 )
+#define RECV_RING_MASK      ( RECV_RING_SIZE - 1 )
+#define RECV_RECORD_SIZE( len )   ( ( sizeof( recvRecord_t ) + ( len ) + 15 ) & ~15 )
+
+typedef struct {
+	int length;                     // -1 skips to the start of the ring
+	int time;
+	netadr_t from;
+} recvRecord_t;
+
+typedef struct {
+	volatile qboolean running;      // cleared by the thread as it exits
+	volatile qboolean quit;
+	threadHandle_t thread;
+	int wakePipe[2];                // written after each batch to wake NET_Sleep
+
+	volatile unsigned writePos;     // only written by the thread
+	volatile unsigned readPos;      // only written by the main thread
+
+	// only written by the thread
+	volatile int packets;
+	volatile int dropped;           // the ring was full, or the packet too big
+	volatile int errors;
+} recvThread_t;
+
+static recvThread_t recvThread;
+static byte recvRing[RECV_RING_SIZE] __attribute__ ( ( aligned( 16 ) ) );
+
+/*
+==================
+NET_PushRecvRing
+==================
+*/
+static void NET_PushRecvRing( netadr_t *from, const byte *data, int length, int time ) {
+	recvRecord_t    *rec;
+	unsigned pos, offset, size, pad;
+
+	size = RECV_RECORD_SIZE( length );
+	pos = recvThread.writePos;
+	offset = pos & RECV_RING_MASK;
+
+	// records never wrap, the end of the ring is skipped instead
+	pad = 0;
+	if ( RECV_RING_SIZE - offset < size ) {
+		pad = RECV_RING_SIZE - offset;
+	}
+
+	if ( pad + size > RECV_RING_SIZE - ( pos - recvThread.readPos ) ) {
+		recvThread.dropped++;
+		return;
+	}
+
+	if ( pad ) {
+		if ( pad >= sizeof( recvRecord_t ) ) {
+			( (recvRecord_t *)( recvRing + offset ) )->length = -1;
+		}
+		pos += pad;
+		offset = 0;
+	}
+
+	rec = (recvRecord_t *)( recvRing + offset );
+	rec->length = length;
+	rec->time = time;
+	rec->from = *from;
+	memcpy( rec + 1, data, length );
+
+	// the record has to be visible before the position that publishes it
+	Threads_MemoryBarrier();
+	recvThread.writePos = pos + size;
+	recvThread.packets++;
+}
+
+/*
+==================
+NET_PopRecvRing
+==================
+*/
+static qboolean NET_PopRecvRing( netadr_t *net_from, msg_t *net_message, int *time ) {
+	recvRecord_t    *rec;
+	unsigned pos, offset, remaining;
+	int length;
+
+	while ( 1 ) {
+		pos = recvThread.readPos;
+		if ( pos == recvThread.writePos ) {
+			return qfalse;
+		}
+		Threads_MemoryBarrier();
+
+		offset = pos & RECV_RING_MASK;
+		remaining = RECV_RING_SIZE - offset;
+		rec = (recvRecord_t *)( recvRing + offset );
+
+		if ( remaining < sizeof( recvRecord_t ) || rec->length < 0 ) {
+			recvThread.readPos = pos + remaining;
+			continue;
+		}
+
+		length = rec->length;
+		*net_from = rec->from;
+		*time = rec->time;
+		if ( length <= net_message->maxsize ) {
+			Com_Memcpy( net_message->data, rec + 1, length );
+		}
+
+		// done reading the record before the thread may overwrite it
+		Threads_MemoryBarrier();
+		recvThread.readPos = pos + RECV_RECORD_SIZE( length );
+
+		if ( length > net_message->maxsize ) {
+			Com_Printf( "Oversize packet from %s\n", NET_AdrToString( *net_from ) );
+			continue;
+		}
+		net_message->readcount = 0;
+		net_message->cursize = length;
+		return qtrue;
+	}
+}
+
+/*
+==================
+NET_RecvThread
+==================
+*/
+static void *NET_RecvThread( void *arg ) {
+	struct pollfd pfd;
+	socklen_t addrlen;
+	qboolean batch;
+	int i, ret, time;
+	netadr_t from;
+
+	batch = qtrue;
+	while ( !recvThread.quit ) {
+		// wake up now and then to notice quit, which bounds the join
+		pfd.fd = ip_socket;
+		pfd.events = POLLIN;
+		pfd.revents = 0;
+		if ( poll( &pfd, 1, 50 ) <= 0 ) {
+			continue;
+		}
+
+		if ( batch ) {
+			ret = NET_ReceiveBatch();
+			if ( ret == -1 && errno == ENOSYS ) {
+				batch = qfalse;
+				continue;
+			}
+		} else {
+			addrlen = sizeof( netBatch.recvAddrs[0] );
+			ret = recvfrom( ip_socket, netBatch.recvData[0], sizeof( netBatch.recvData[0] ), MSG_DONTWAIT,
+							(struct sockaddr *)&netBatch.recvAddrs[0], &addrlen );
+			if ( ret != -1 ) {
+				netBatch.recvHdrs[0].msg_len = ret;
+				netBatch.recvHdrs[0].msg_hdr.msg_flags = 0;
+				ret = 1;
+			}
+		}
+
+		if ( ret == -1 ) {
+			if ( errno != EWOULDBLOCK && errno != EAGAIN && errno != ECONNREFUSED && errno != EINTR ) {
+				recvThread.errors++;
+			}
+			continue;
+		}
+
+		time = Sys_Milliseconds();
+		for ( i = 0 ; i < ret ; i++ ) {
+			if ( ( netBatch.recvHdrs[i].msg_hdr.msg_flags & MSG_TRUNC ) || netBatch.recvHdrs[i].msg_len >= MAX_MSGLEN ) {
+				recvThread.dropped++;
+				continue;
+			}
+			SockadrToNetadr( &netBatch.recvAddrs[i], &from );
+			NET_PushRecvRing( &from, netBatch.recvData[i], netBatch.recvHdrs[i].msg_len, time );
+		}
+
+		if ( write( recvThread.wakePipe[1], "", 1 ) == -1 ) {
+			// the pipe is full, which is enough to wake the main thread
+		}
+	}
+
+	Threads_MemoryBarrier();
+	recvThread.running = qfalse;
+	return NULL;
+}
+
+/*
+==================
+NET_StopRecvThread
+==================
+*/
+static void NET_StopRecvThread( void ) {
+	if ( !recvThread.running ) {
+		return;
+	}
+
+	// the thread polls with a timeout, so it always sees quit
+	recvThread.quit = qtrue;
+	Threads_Join( recvThread.thread );
+	recvThread.running = qfalse;
+
+	close( recvThread.wakePipe[0] );
+	close( recvThread.wakePipe[1] );
+	Com_Printf( "Network receive thread stopped\n" );
+}
+
+/*
+==================
+NET_StartRecvThread
+==================
+*/
+static void NET_StartRecvThread( void ) {
+	struct mmsghdr  *hdr;
+	netadr_t from;
+	int time;
+
+	if ( recvThread.running || !ip_socket ) {
+		return;
+	}
+
+	if ( pipe( recvThread.wakePipe ) == -1 ) {
+		Com_Printf( "WARNING: network receive thread: pipe: %s\n", NET_ErrorString() );
+		return;
+	}
+	fcntl( recvThread.wakePipe[0], F_SETFL, O_NONBLOCK );
+	fcntl( recvThread.wakePipe[1], F_SETFL, O_NONBLOCK );
+
+	// the thread owns netBatch's receive side from now on, so anything
+	// still unread in it goes into the ring behind what is already there
+	time = Sys_Milliseconds();
+	for ( ; netBatch.recvNext < netBatch.recvCount ; netBatch.recvNext++ ) {
+		hdr = &netBatch.recvHdrs[netBatch.recvNext];
+		if ( ( hdr->msg_hdr.msg_flags & MSG_TRUNC ) || hdr->msg_len >= MAX_MSGLEN ) {
+			continue;
+		}
+		SockadrToNetadr( &netBatch.recvAddrs[netBatch.recvNext], &from );
+		NET_PushRecvRing( &from, netBatch.recvData[netBatch.recvNext], hdr->msg_len, time );
+	}
+	netBatch.recvCount = 0;
+	netBatch.recvNext = 0;
+
+	recvThread.quit = qfalse;
+	recvThread.running = qtrue;
+	Threads_MemoryBarrier();
+
+	if ( Threads_CreateJoinable( &recvThread.thread, NET_RecvThread, NULL ) != 0 ) {
+		recvThread.running = qfalse;
+		close( recvThread.wakePipe[0] );
+		close( recvThread.wakePipe[1] );
+		Com_Printf( "WARNING: couldn't start the network receive thread\n" );
+		return;
+	}
+	Com_Printf( "Network receive thread started\n" );
+}
+
+/*
+==================
+NET_WaitRecvThread
+
+Sleeps until the receive thread queues something.  Returns qfalse if
+there is no thread and the socket has to be waited on instead.
+==================
+*/
+static qboolean NET_WaitRecvThread( int msec, qboolean withStdin ) {
+	struct timeval timeout;
+	fd_set fdset;
+	char drain[64];
+
+	if ( !recvThread.running ) {
+		return qfalse;
+	}
+
+	while ( read( recvThread.wakePipe[0], drain, sizeof( drain ) ) > 0 ) {
+	}
+	if ( recvThread.readPos != recvThread.writePos ) {
+		return qtrue;
+	}
+
+	FD_ZERO( &fdset );
+	if ( withStdin ) {
+		FD_SET( 0, &fdset );
+	}
+	FD_SET( recvThread.wakePipe[0], &fdset );
+	timeout.tv_sec = msec / 1000;
+	timeout.tv_usec = ( msec % 1000 ) * 1000;
+	select( recvThread.wakePipe[0] + 1, &fdset, NULL, NULL, &timeout );
+	return qtrue;
+}
+
+#endif  // __linux__
+
+/*
+==================
+Sys_GetTimedPacket
+
+time is the Sys_Milliseconds the packet arrived at when the receive
+thread saw it, or 0 if it was only just read from the socket
+==================
+*/
+qboolean    Sys_GetTimedPacket( netadr_t *net_from, msg_t *net_message, int *time ) {
+#ifdef __linux__
+	int delay;
+#endif
+
+	*time = 0;
+#ifdef __linux__
+	if ( net_recvThread->modified ) {
+		net_recvThread->modified = qfalse;
+		NET_StopRecvThread();
+		if ( net_recvThread->integer ) {
+			NET_StartRecvThread();
+		}
+	}
+
+	// the ring can outlive the thread, drain it before the socket
+	if ( recvThread.running || recvThread.readPos != recvThread.writePos ) {
+		if ( NET_PopRecvRing( net_from, net_message, time ) ) {
+			delay = Sys_Milliseconds() - *time;
+			netStats.queuedPackets++;
+			netStats.queueDelayTotal += delay;
+			if ( delay > netStats.queueDelayMax ) {
+				netStats.queueDelayMax = delay;
+			}
+			return qtrue;
+		}
+		*time = 0;
+		if ( recvThread.running ) {
+			return qfalse;
+		}
+	}
+
+	if ( !ip_socket ) {
+		return qfalse;
+	}
+	if ( netBatch.recvNext < netBatch.recvCount || ( net_batch->integer && !netBatch.disabled ) ) {
+		return NET_GetBatchedPacket( net_from, net_message );
+	}
+#endif
+	if ( NET_GetPacket( net_from, net_message ) ) {
+		netStats.recvCalls++;
+		netStats.recvPackets++;
+		return qtrue;
+	}
+	return qfalse;
+}
+
+/*
+==================
+Sys_GetPacket
+==================
+*/
+qboolean    Sys_GetPacket( netadr_t *net_from, msg_t *net_message ) {
+	int time;
+
+	return Sys_GetTimedPacket( net_from, net_message, &time );
+}
+
+/*
+==================
+Sys_SendPacket
+==================
+*/
+void    Sys_SendPacket( int length, const void *data, netadr_t to ) {
+#ifdef __linux__
+	if ( NET_QueuePacket( length, data, to ) ) {
+		return;
+	}
+#endif
+	NET_SendPacketTo( length, data, to );
+	netStats.sendCalls++;
+	netStats.sendPackets++;
+}
+
+/*
+==================
+Sys_BeginPacketBatch
+==================
+*/
+void Sys_BeginPacketBatch( void ) {
+#ifdef __linux__
+	// anything left over from an interrupted frame goes out first
+	Sys_FlushPacketBatch();
+	netBatch.sending = ( net_batch->integer && ip_socket ) ? qtrue : qfalse;
+#endif
+}
+
+/*
+==================
+Sys_FlushPacketBatch
+==================
+*/
+void Sys_FlushPacketBatch( void ) {
+#ifdef __linux__
+	int i, ret, sent;
+
+	netBatch.sending = qfalse;
+	if ( !netBatch.sendCount ) {
+		return;
+	}
+
+	for ( i = 0 ; i < netBatch.sendCount ; i++ ) {
+		netBatch.sendIovs[i].iov_base = netBatch.sendData[i];
+		memset( &netBatch.sendHdrs[i], 0, sizeof( netBatch.sendHdrs[i] ) );
+		netBatch.sendHdrs[i].msg_hdr.msg_name = &netBatch.sendAddrs[i];
+		netBatch.sendHdrs[i].msg_hdr.msg_namelen = NetadrToSockadr( &netBatch.sendTo[i], &netBatch.sendAddrs[i] );
+		netBatch.sendHdrs[i].msg_hdr.msg_iov = &netBatch.sendIovs[i];
+		netBatch.sendHdrs[i].msg_hdr.msg_iovlen = 1;
+	}
+
+	sent = 0;
+	while ( sent < netBatch.sendCount ) {
+		ret = sendmmsg( ip_socket, netBatch.sendHdrs + sent, netBatch.sendCount - sent, 0 );
+		if ( ret == -1 ) {
+			if ( errno == ENOSYS ) {
+				Com_Printf( "sendmmsg not available, not batching packets\n" );
+				netBatch.disabled = qtrue;
+			} else {
+				Com_Printf( "NET_SendPacket ERROR: %s to %s\n", NET_ErrorString(),
+							NET_AdrToString( netBatch.sendTo[sent] ) );
+				sent++;     // skip the packet that failed
+				continue;
+			}
+			break;
+		}
+		netStats.sendCalls++;
+		netStats.sendPackets += ret;
+		sent += ret;
+	}
+
+	// send whatever is left the slow way
+	for ( ; sent < netBatch.sendCount ; sent++ ) {
+		NET_SendPacketTo( netBatch.sendIovs[sent].iov_len, netBatch.sendData[sent], netBatch.sendTo[sent] );
+		netStats.sendCalls++;
+		netStats.sendPackets++;
+	}
+
+	netBatch.sendCount = 0;
+#endif
+}
+
+/*
+==================
+NET_Stats_f
+==================
+*/
+static void NET_Stats_f( void ) {
+	if ( Cmd_Argc() > 1 && !Q_stricmp( Cmd_Argv( 1 ), "reset" ) ) {
+		memset( &netStats, 0, sizeof( netStats ) );
+#ifdef __linux__
+		recvThread.packets = recvThread.dropped = recvThread.errors = 0;
+#endif
+		return;
+	}
+
+	Com_Printf( "net_batch %i%s\n", net_batch->integer,
+#ifdef __linux__
+				netBatch.disabled ? " (not supported)" : ""
+#else
+				" (not supported)"
+#endif
+				);
+	Com_Printf( "received %i packets in %i calls, %.2f per call\n", netStats.recvPackets, netStats.recvCalls,
+				netStats.recvCalls ? (float)netStats.recvPackets / netStats.recvCalls : 0.0f );
+	Com_Printf( "sent %i packets in %i calls, %.2f per call\n", netStats.sendPackets, netStats.sendCalls,
+				netStats.sendCalls ? (float)netStats.sendPackets / netStats.sendCalls : 0.0f );
+#ifdef __linux__
+	if ( recvThread.running || recvThread.packets ) {
+		Com_Printf( "receive thread: %i packets, %i dropped, %i errors\n",
+					recvThread.packets, recvThread.dropped, recvThread.errors );
+		Com_Printf( "queued %i packets, %.1f msec average wait, %i msec max\n", netStats.queuedPackets,
+					netStats.queuedPackets ? (float)netStats.queueDelayTotal / netStats.queuedPackets : 0.0f,
+					netStats.queueDelayMax );
+	}
+#endif
+}
+
+/*
+==================
+NET_LoopTestAddress
+
+Sends a packet to our own socket at name and waits for it to come back
+through Sys_GetPacket.  Returns qfalse if it didn't, with the reason
+printed.  Anything else that arrives meanwhile is dropped.
+==================
+*/
+static qboolean NET_LoopTestAddress( const char *name, netadrtype_t type, int port ) {
+	static byte buf[MAX_MSGLEN];
+	struct sockaddr_storage addr;
+	socklen_t addrlen;
+	netadr_t to, from;
+	msg_t msg;
+	char data[64];
+	int length, start;
+
+	if ( !Sys_StringToAdr( name, &to ) || to.type != type ) {
+		Com_Printf( "%s: FAILED, doesn't parse as %s\n", name, type == NA_IP6 ? "NA_IP6" : "NA_IP" );
+		return qfalse;
+	}
+	to.port = port;
+
+	Com_sprintf( data, sizeof( data ), "net_looptest %s %i", name, Sys_Milliseconds() );
+	length = strlen( data );
+	addrlen = NetadrToSockadr( &to, &addr );
+	if ( sendto( ip_socket, data, length, 0, (struct sockaddr *)&addr, addrlen ) == -1 ) {
+		Com_Printf( "%s: FAILED, sendto: %s\n", name, NET_ErrorString() );
+		return qfalse;
+	}
+
+	start = Sys_Milliseconds();
+	while ( Sys_Milliseconds() - start < 1000 ) {
+		MSG_Init( &msg, buf, sizeof( buf ) );
+		if ( !Sys_GetPacket( &from, &msg ) ) {
+			usleep( 1000 );
+			continue;
+		}
+		if ( msg.cursize != length || memcmp( msg.data, data, length ) ) {
+			continue;
+		}
+		if ( !NET_CompareAdr( from, to ) ) {
+			Com_Printf( "%s: FAILED, came back from %s\n", name, NET_AdrToString( from ) );
+			return qfalse;
+		}
+		if ( !Sys_IsLANAddress( from ) ) {
+			Com_Printf( "%s: FAILED, %s isn't a LAN address\n", name, NET_AdrToString( from ) );
+			return qfalse;
+		}
+		Com_Printf( "%s: ok, from %s\n", name, NET_AdrToString( from ) );
+		return qtrue;
+	}
+
+	Com_Printf( "%s: FAILED, nothing came back\n", name );
+	return qfalse;
+}
+
+/*
+==================
+NET_LoopTest_f
+
+Checks that IPv4 and IPv6 loopback packets both arrive on the one
+socket, as NA_IP and NA_IP6 from where they were sent.  The ::1 half is
+skipped on an IPv4 socket, which is what a host without IPv6 gets.
+Best run on an idle server, other packets that arrive are dropped.
+==================
+*/
+static void NET_LoopTest_f( void ) {
+	struct sockaddr_storage addr;
+	socklen_t addrlen;
+	int port, failed;
+
+	addrlen = sizeof( addr );
+	if ( !ip_socket || getsockname( ip_socket, (struct sockaddr *)&addr, &addrlen ) == -1 ) {
+		Com_Printf( "net_looptest: no IP socket\n" );
+		return;
+	}
+	port = addr.ss_family == AF_INET6 ? ( (struct sockaddr_in6 *)&addr )->sin6_port
+		   : ( (struct sockaddr_in *)&addr )->sin_port;
+
+	Sys_FlushPacketBatch();
+
+	failed = 0;
+	if ( !NET_LoopTestAddress( "127.0.0.1", NA_IP, port ) ) {
+		failed++;
+	}
+	if ( ip_family != AF_INET6 ) {
+		Com_Printf( "::1: skipped, the socket is IPv4 only (net_ipv6 %i)\n", net_ipv6->integer );
+	} else if ( !NET_LoopTestAddress( "::1", NA_IP6, port ) ) {
+		failed++;
+	}
+	Com_Printf( "net_looptest: %s\n", failed ? "FAILED" : "passed" );
+}
+
+//=============================================================================
+
 /*
 ==================
 Sys_IsLANAddress
@@ -247,6 +1112,17 @@ qboolean    Sys_IsLANAddress( netadr_t adr ) {
 		return qtrue;
 	}
 
+	if ( adr.type == NA_IP6 ) {
+		// loopback, link local and unique local addresses
+		if ( IN6_IS_ADDR_LOOPBACK( (struct in6_addr *)adr.ip6 ) || IN6_IS_ADDR_LINKLOCAL( (struct in6_addr *)adr.ip6 ) ) {
+			return qtrue;
+		}
+		if ( ( adr.ip6[0] & 0xfe ) == 0xfc ) {
+			return qtrue;
+		}
+		return qfalse;
+	}
+
 	if ( adr.type != NA_IP ) {
 		return qfalse;
 	}
@@ -478,6 +1354,12 @@ NET_Init
 */
 void NET_Init( void ) {
 	noudp = Cvar_Get( "net_noudp", "0", 0 );
+	net_batch = Cvar_Get( "net_batch", "1", CVAR_ARCHIVE );
+	net_ipv6 = Cvar_Get( "net_ipv6", "1", CVAR_ARCHIVE | CVAR_LATCH );
+	net_recvThread = Cvar_Get( "net_recvThread", "0", CVAR_ARCHIVE );
+	Cmd_AddCommand( "net_stats", NET_Stats_f );
+	Cmd_AddCommand( "net_looptest", NET_LoopTest_f );
+
 	// open sockets
 	if ( !noudp->value ) {
 		NET_OpenIP();
@@ -492,9 +1374,12 @@ NET_IPSocket
 */
 int NET_IPSocket( char *net_interface, int port ) {
 	int newsocket;
-	struct sockaddr_in address;
+	struct sockaddr_storage address;
+	socklen_t addrlen;
+	int family;
 	qboolean _qtrue = qtrue;
 	int i = 1;
+	int v6only = 0;
 
 	if ( net_interface ) {
 		Com_Printf( "Opening IP socket: %s:%i\n", net_interface, port );
@@ -502,7 +1387,24 @@ int NET_IPSocket( char *net_interface, int port ) {
 		Com_Printf( "Opening IP socket: localhost:%i\n", port );
 	}
 
-	if ( ( newsocket = socket( PF_INET, SOCK_DGRAM, IPPROTO_UDP ) ) == -1 ) {
+	memset( &address, 0, sizeof( address ) );
+	if ( !net_interface || !net_interface[0] || !Q_stricmp( net_interface, "localhost" ) ) {
+		// listen on everything, IPv4 included, unless IPv6 is turned off
+		family = net_ipv6->integer ? AF_INET6 : AF_INET;
+	} else if ( !Sys_StringToSockaddr( net_interface, &address ) ) {
+		Com_Printf( "ERROR: UDP_OpenSocket: couldn't resolve %s\n", net_interface );
+		return 0;
+	} else {
+		family = address.ss_family;
+	}
+
+	newsocket = socket( family == AF_INET6 ? PF_INET6 : PF_INET, SOCK_DGRAM, IPPROTO_UDP );
+	if ( newsocket == -1 && family == AF_INET6 && address.ss_family == 0 ) {
+		Com_Printf( "WARNING: UDP_OpenSocket: no IPv6 (%s), using IPv4\n", NET_ErrorString() );
+		family = AF_INET;
+		newsocket = socket( PF_INET, SOCK_DGRAM, IPPROTO_UDP );
+	}
+	if ( newsocket == -1 ) {
 		Com_Printf( "ERROR: UDP_OpenSocket: socket: %s", NET_ErrorString() );
 		return 0;
 	}
@@ -510,35 +1412,44 @@ int NET_IPSocket( char *net_interface, int port ) {
 	// make it non-blocking
 	if ( ioctl( newsocket, FIONBIO, &_qtrue ) == -1 ) {
 		Com_Printf( "ERROR: UDP_OpenSocket: ioctl FIONBIO:%s\n", NET_ErrorString() );
+		close( newsocket );
 		return 0;
 	}
 
 	// make it broadcast capable
 	if ( setsockopt( newsocket, SOL_SOCKET, SO_BROADCAST, (char *)&i, sizeof( i ) ) == -1 ) {
 		Com_Printf( "ERROR: UDP_OpenSocket: setsockopt SO_BROADCAST:%s\n", NET_ErrorString() );
+		close( newsocket );
 		return 0;
 	}
 
-	if ( !net_interface || !net_interface[0] || !Q_stricmp( net_interface, "localhost" ) ) {
-		address.sin_addr.s_addr = INADDR_ANY;
-	} else {
-		Sys_StringToSockaddr( net_interface, (struct sockaddr *)&address );
-	}
+	if ( family == AF_INET6 ) {
+		// take IPv4 traffic as v4-mapped addresses on the same socket
+		if ( setsockopt( newsocket, IPPROTO_IPV6, IPV6_V6ONLY, (char *)&v6only, sizeof( v6only ) ) == -1 ) {
+			Com_Printf( "WARNING: UDP_OpenSocket: setsockopt IPV6_V6ONLY:%s\n", NET_ErrorString() );
+		}
 
-	if ( port == PORT_ANY ) {
-		address.sin_port = 0;
+		( (struct sockaddr_in6 *)&address )->sin6_family = AF_INET6;
+		if ( port != PORT_ANY ) {
+			( (struct sockaddr_in6 *)&address )->sin6_port = htons( (short)port );
+		}
+		addrlen = sizeof( struct sockaddr_in6 );
 	} else {
-		address.sin_port = htons( (short)port );
+		( (struct sockaddr_in *)&address )->sin_family = AF_INET;
+		if ( port != PORT_ANY ) {
+			( (struct sockaddr_in *)&address )->sin_port = htons( (short)port );
+		}
+		addrlen = sizeof( struct sockaddr_in );
 	}
 
-	address.sin_family = AF_INET;
-
-	if ( bind( newsocket, (void *)&address, sizeof( address ) ) == -1 ) {
+	if ( bind( newsocket, (void *)&address, addrlen ) == -1 ) {
 		Com_Printf( "ERROR: UDP_OpenSocket: bind: %s\n", NET_ErrorString() );
 		close( newsocket );
 		return 0;
 	}
 
+	ip_family = family;
+
 	return newsocket;
 }
 
@@ -548,6 +1459,14 @@ NET_Shutdown
 ====================
 */
 void    NET_Shutdown( void ) {
+	Sys_FlushPacketBatch();
+#ifdef __linux__
+	NET_StopRecvThread();
+	recvThread.readPos = recvThread.writePos;   // queued from the old socket
+	if ( net_recvThread ) {
+		net_recvThread->modified = qtrue;   // restart it on the new socket
+	}
+#endif
 	if ( ip_socket ) {
 		close( ip_socket );
 		ip_socket = 0;
@@ -577,6 +1496,11 @@ void NET_Sleep( int msec ) {
 		return; // we're not a server, just run full speed
 
 	}
+#ifdef __linux__
+	if ( NET_WaitRecvThread( msec, stdin_active ) ) {
+		return;
+	}
+#endif
 	FD_ZERO( &fdset );
 	if ( stdin_active ) {
 		FD_SET( 0, &fdset ); // stdin is processed too
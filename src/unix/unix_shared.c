@@ -32,6 +32,7 @@ If you have questions concerning this license or the applicable additional terms
 #include <stdio.h>
 #include <dirent.h>
 #include <unistd.h>
+#include <fcntl.h>
 #include <sys/mman.h>
 #include <sys/time.h>
 #include <pwd.h>
@@ -433,3 +434,37 @@ int64_t Sys_Microseconds(void)
 
 	return (int64_t)ts.tv_sec * 1000000 + (int64_t)ts.tv_nsec / 1000;
 }
+
+/*
+==================
+Sys_MapFile
+
+Maps a whole file in read only, NULL if it can't be
+==================
+*/
+void *Sys_MapFile( const char *ospath, int *size ) {
+	struct stat st;
+	void        *base;
+	int fd;
+
+	fd = open( ospath, O_RDONLY );
+	if ( fd == -1 ) {
+		return NULL;
+	}
+	if ( fstat( fd, &st ) == -1 || st.st_size <= 0 || st.st_size > 0x7fffffff ) {
+		close( fd );
+		return NULL;
+	}
+	base = mmap( NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0 );
+	// the mapping keeps its own reference to the file
+	close( fd );
+	if ( base == MAP_FAILED ) {
+		return NULL;
+	}
+	*size = st.st_size;
+	return base;
+}
+
+void Sys_UnmapFile( void *base, int size ) {
+	munmap( base, size );
+}
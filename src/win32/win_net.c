@@ -320,6 +320,24 @@ void Sys_SendPacket( int length, const void *data, netadr_t to ) {
 	}
 }
 
+/*
+==================
+Sys_BeginPacketBatch
+
+Winsock has no batched sends, packets always go out right away
+==================
+*/
+void Sys_BeginPacketBatch( void ) {
+}
+
+/*
+==================
+Sys_FlushPacketBatch
+==================
+*/
+void Sys_FlushPacketBatch( void ) {
+}
+
 
 //=============================================================================
 
@@ -199,4 +199,44 @@ char* Sys_GetScreenshotPath(char* filename){
 	char* gamepath = Cvar_VariableString("fs_game");
 
 	return va("%s/%s/screenshots/%s.jpg", basepath, gamepath, filename);
-}
\ No newline at end of file
+}
+
+/*
+==================
+Sys_MapFile
+
+Maps a whole file in read only, NULL if it can't be
+==================
+*/
+void *Sys_MapFile( const char *ospath, int *size ) {
+	HANDLE file, mapping;
+	DWORD high, low;
+	void    *base;
+
+	file = CreateFileA( ospath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL );
+	if ( file == INVALID_HANDLE_VALUE ) {
+		return NULL;
+	}
+	low = GetFileSize( file, &high );
+	if ( low == INVALID_FILE_SIZE || high || low == 0 || low > 0x7fffffff ) {
+		CloseHandle( file );
+		return NULL;
+	}
+	mapping = CreateFileMappingA( file, NULL, PAGE_READONLY, 0, 0, NULL );
+	CloseHandle( file );
+	if ( !mapping ) {
+		return NULL;
+	}
+	// the view keeps its own reference to the mapping
+	base = MapViewOfFile( mapping, FILE_MAP_READ, 0, 0, 0 );
+	CloseHandle( mapping );
+	if ( !base ) {
+		return NULL;
+	}
+	*size = low;
+	return base;
+}
+
+void Sys_UnmapFile( void *base, int size ) {
+	UnmapViewOfFile( base );
+}
@@ -26,6 +26,7 @@ If you have questions concerning this license or the applicable additional terms
 ===========================================================================
 */
 #include "../qcommon/threads.h"
+#include <windows.h>
 
 /*
 ===============
@@ -52,3 +53,251 @@ int Threads_Create(void* (*thread_function)(void*), void* arguments) {
 	return 1;
 }
 
+typedef struct {
+	void* (*func)(void*);
+	void* arguments;
+} threadStart_t;
+
+/*
+===============
+Threads_Start
+
+_beginthreadex wants a __stdcall function
+===============
+*/
+static unsigned __stdcall Threads_Start(void* data) {
+	threadStart_t start = *(threadStart_t*)data;
+
+	free(data);
+	start.func(start.arguments);
+	return 0;
+}
+
+/*
+===============
+Threads_CreateJoinable
+===============
+*/
+int Threads_CreateJoinable(threadHandle_t* thread, void* (*thread_function)(void*), void* arguments) {
+	threadStart_t* start;
+
+	start = malloc(sizeof(*start));
+	if (!start) {
+		return -1;
+	}
+	start->func = thread_function;
+	start->arguments = arguments;
+
+	*thread = _beginthreadex(NULL, 0, Threads_Start, start, 0, NULL);
+	if (!*thread) {
+		free(start);
+		return -1;
+	}
+
+	Com_DPrintf("Thread created.\n");
+	return 0;
+}
+
+/*
+===============
+Threads_Join
+===============
+*/
+void Threads_Join(threadHandle_t thread) {
+	WaitForSingleObject((HANDLE)thread, INFINITE);
+	CloseHandle((HANDLE)thread);
+}
+
+/*
+=============================================================================
+
+WORKER POOL
+
+=============================================================================
+*/
+
+typedef struct {
+	qboolean initialized;
+	CRITICAL_SECTION lock;
+	CONDITION_VARIABLE wake;        // a new batch was posted or the pool is stopping
+	CONDITION_VARIABLE done;        // the last job of the batch has finished
+
+	HANDLE threads[MAX_WORKER_THREADS];
+	int numThreads;
+	qboolean quit;
+
+	threadJob_t job;
+	void* data;
+	int count;
+	int next;                       // next index to hand out
+	int pending;                    // handed out or not, but not yet finished
+} workerPool_t;
+
+static workerPool_t pool;
+
+/*
+===============
+Threads_DrainJobs
+
+Must be called with the pool locked, returns locked
+===============
+*/
+static void Threads_DrainJobs(void) {
+	threadJob_t job;
+	void* data;
+	int index;
+
+	while (pool.next < pool.count) {
+		index = pool.next++;
+		job = pool.job;
+		data = pool.data;
+
+		LeaveCriticalSection(&pool.lock);
+		job(data, index);
+		EnterCriticalSection(&pool.lock);
+
+		if (--pool.pending == 0) {
+			WakeConditionVariable(&pool.done);
+		}
+	}
+}
+
+/*
+===============
+Threads_WorkerLoop
+===============
+*/
+static unsigned __stdcall Threads_WorkerLoop(void* arguments) {
+	EnterCriticalSection(&pool.lock);
+	for (;;) {
+		while (!pool.quit && pool.next >= pool.count) {
+			SleepConditionVariableCS(&pool.wake, &pool.lock, INFINITE);
+		}
+		if (pool.quit) {
+			break;
+		}
+		Threads_DrainJobs();
+	}
+	LeaveCriticalSection(&pool.lock);
+
+	return 0;
+}
+
+/*
+===============
+Threads_InitWorkers
+===============
+*/
+void Threads_InitWorkers(int numWorkers) {
+	int i;
+
+	if (numWorkers < 0) {
+		numWorkers = 0;
+	} else if (numWorkers > MAX_WORKER_THREADS) {
+		numWorkers = MAX_WORKER_THREADS;
+	}
+
+	if (numWorkers == pool.numThreads) {
+		return;
+	}
+
+	if (!pool.initialized) {
+		InitializeCriticalSection(&pool.lock);
+		InitializeConditionVariable(&pool.wake);
+		InitializeConditionVariable(&pool.done);
+		pool.initialized = qtrue;
+	}
+
+	// stop the current workers
+	if (pool.numThreads) {
+		EnterCriticalSection(&pool.lock);
+		pool.quit = qtrue;
+		WakeAllConditionVariable(&pool.wake);
+		LeaveCriticalSection(&pool.lock);
+
+		WaitForMultipleObjects(pool.numThreads, pool.threads, TRUE, INFINITE);
+		for (i = 0; i < pool.numThreads; i++) {
+			CloseHandle(pool.threads[i]);
+		}
+		pool.numThreads = 0;
+		pool.quit = qfalse;
+	}
+
+	for (i = 0; i < numWorkers; i++) {
+		pool.threads[i] = (HANDLE)_beginthreadex(NULL, 0, Threads_WorkerLoop, NULL, 0, NULL);
+		if (!pool.threads[i]) {
+			Com_Printf("Threads_InitWorkers: only %i of %i workers started\n", i, numWorkers);
+			break;
+		}
+		pool.numThreads++;
+	}
+
+	Com_DPrintf("%i worker threads running.\n", pool.numThreads);
+}
+
+/*
+===============
+Threads_NumWorkers
+===============
+*/
+int Threads_NumWorkers(void) {
+	return pool.numThreads;
+}
+
+/*
+===============
+Threads_RunJobs
+===============
+*/
+void Threads_RunJobs(threadJob_t job, void* data, int count) {
+	int i;
+
+	if (count <= 0) {
+		return;
+	}
+
+	if (!pool.numThreads || count == 1) {
+		for (i = 0; i < count; i++) {
+			job(data, i);
+		}
+		return;
+	}
+
+	EnterCriticalSection(&pool.lock);
+	pool.job = job;
+	pool.data = data;
+	pool.count = count;
+	pool.next = 0;
+	pool.pending = count;
+	WakeAllConditionVariable(&pool.wake);
+
+	// the calling thread works too
+	Threads_DrainJobs();
+
+	while (pool.pending) {
+		SleepConditionVariableCS(&pool.done, &pool.lock, INFINITE);
+	}
+	pool.count = 0;
+	pool.next = 0;
+	LeaveCriticalSection(&pool.lock);
+}
+
+/*
+=============================================================================
+
+ATOMICS
+
+=============================================================================
+*/
+
+int Threads_AtomicAdd(volatile int* value, int amount) {
+	return InterlockedExchangeAdd((volatile LONG*)value, amount);
+}
+
+qboolean Threads_CompareExchange(volatile int* value, int expected, int desired) {
+	return InterlockedCompareExchange((volatile LONG*)value, desired, expected) == expected ? qtrue : qfalse;
+}
+
+void Threads_MemoryBarrier(void) {
+	MemoryBarrier();
+}